@@ -10,19 +10,21 @@
 
 namespace config {
     /* Config */
-    Config::Config(const std::vector<ServerContext> &servers) : servers_(servers) {}
+    Config::Config(const std::vector<ServerContext> &servers, const MainContext &mainContext)
+        : mainContext_(mainContext), servers_(servers) {}
 
-    Config::Config(const Config &other) : servers_(other.servers_) {}
+    Config::Config(const Config &other) : mainContext_(other.mainContext_), servers_(other.servers_) {}
 
     Config &Config::operator=(const Config &rhs) {
         if (this != &rhs) {
+            mainContext_ = rhs.mainContext_;
             servers_ = rhs.servers_;
         }
         return *this;
     }
 
     bool Config::operator==(const Config &rhs) const {
-        return servers_ == rhs.servers_;
+        return mainContext_ == rhs.mainContext_ && servers_ == rhs.servers_;
     }
 
     Option<Config> Config::loadConfigFromFile(const std::string &path) {
@@ -48,17 +50,201 @@ namespace config {
                 servers.push_back(ServerContext::fromToml(serverTable));
             }
 
-            return Some(Config(servers));
+            return Some(Config(servers, MainContext::fromToml(configTable)));
         } catch (const std::exception &e) {
             LOG_ERRORF("error while reading config: ", e.what());
             return None;
         }
     }
 
+    const MainContext &Config::getMainContext() const {
+        return mainContext_;
+    }
+
     const std::vector<ServerContext> &Config::getServers() const {
         return servers_;
     }
 
+    /* MainContext */
+    MainContext::MainContext(
+        const EventMethod eventMethod,
+        const bool edgeTriggered,
+        const std::size_t workers,
+        const std::size_t workerProcesses,
+        const std::size_t acceptBudget,
+        const utils::Time::Millis requestTimeoutMs,
+        const utils::Time::Millis cgiTimeoutMs,
+        const utils::Time::Millis keepAliveTimeoutMs,
+        const std::size_t keepAliveRequests
+    )
+        : eventMethod_(eventMethod), edgeTriggered_(edgeTriggered), workers_(workers),
+          workerProcesses_(workerProcesses), acceptBudget_(acceptBudget), requestTimeoutMs_(requestTimeoutMs),
+          cgiTimeoutMs_(cgiTimeoutMs), keepAliveTimeoutMs_(keepAliveTimeoutMs),
+          keepAliveRequests_(keepAliveRequests) {}
+
+    MainContext::MainContext(const MainContext &other)
+        : eventMethod_(other.eventMethod_), edgeTriggered_(other.edgeTriggered_), workers_(other.workers_),
+          workerProcesses_(other.workerProcesses_), acceptBudget_(other.acceptBudget_),
+          requestTimeoutMs_(other.requestTimeoutMs_), cgiTimeoutMs_(other.cgiTimeoutMs_),
+          keepAliveTimeoutMs_(other.keepAliveTimeoutMs_), keepAliveRequests_(other.keepAliveRequests_) {}
+
+    MainContext &MainContext::operator=(const MainContext &rhs) {
+        if (this != &rhs) {
+            eventMethod_ = rhs.eventMethod_;
+            edgeTriggered_ = rhs.edgeTriggered_;
+            workers_ = rhs.workers_;
+            workerProcesses_ = rhs.workerProcesses_;
+            acceptBudget_ = rhs.acceptBudget_;
+            requestTimeoutMs_ = rhs.requestTimeoutMs_;
+            cgiTimeoutMs_ = rhs.cgiTimeoutMs_;
+            keepAliveTimeoutMs_ = rhs.keepAliveTimeoutMs_;
+            keepAliveRequests_ = rhs.keepAliveRequests_;
+        }
+        return *this;
+    }
+
+    bool MainContext::operator==(const MainContext &rhs) const {
+        return eventMethod_ == rhs.eventMethod_ && edgeTriggered_ == rhs.edgeTriggered_ && workers_ == rhs.workers_ &&
+               workerProcesses_ == rhs.workerProcesses_ && acceptBudget_ == rhs.acceptBudget_ &&
+               requestTimeoutMs_ == rhs.requestTimeoutMs_ && cgiTimeoutMs_ == rhs.cgiTimeoutMs_ &&
+               keepAliveTimeoutMs_ == rhs.keepAliveTimeoutMs_ && keepAliveRequests_ == rhs.keepAliveRequests_;
+    }
+
+    MainContext MainContext::fromToml(const toml::Table &configTable) {
+        EventMethod eventMethod = kDefaultEventMethod;
+        if (configTable.hasKey("event_method")) {
+            const std::string method = configTable.getValue("event_method").unwrap().getString().unwrap();
+            if (method == "poll") {
+                eventMethod = kEventMethodPoll;
+            } else if (method == "epoll") {
+                eventMethod = kEventMethodEpoll;
+            } else if (method == "io_uring") {
+                eventMethod = kEventMethodIoUring;
+            } else {
+                LOG_ERRORF("unknown event method: %s", method.c_str());
+                throw std::runtime_error("unknown event method: " + method);
+            }
+        }
+
+        bool edgeTriggered = false;
+        if (configTable.hasKey("edge_triggered")) {
+            const std::string value = configTable.getValue("edge_triggered").unwrap().getString().unwrap();
+            if (value != "on" && value != "off") {
+                LOG_ERRORF("edge_triggered must be 'on' or 'off': %s", value.c_str());
+                throw std::runtime_error("invalid edge_triggered: " + value);
+            }
+            edgeTriggered = value == "on";
+        }
+
+        std::size_t workers = 1;
+        if (configTable.hasKey("workers")) {
+            const long value = configTable.getValue("workers").unwrap().getInteger().unwrap();
+            if (value < 1 || static_cast<std::size_t>(value) > kMaxWorkers) {
+                LOG_ERRORF("workers must be between 1 and %zu: %ld", kMaxWorkers, value);
+                throw std::runtime_error("invalid workers");
+            }
+            workers = static_cast<std::size_t>(value);
+        }
+
+        std::size_t workerProcesses = 0;
+        if (configTable.hasKey("worker_processes")) {
+            const long value = configTable.getValue("worker_processes").unwrap().getInteger().unwrap();
+            if (value < 0 || static_cast<std::size_t>(value) > kMaxWorkers) {
+                LOG_ERRORF("worker_processes must be between 0 and %zu: %ld", kMaxWorkers, value);
+                throw std::runtime_error("invalid worker_processes");
+            }
+            workerProcesses = static_cast<std::size_t>(value);
+        }
+
+        std::size_t acceptBudget = kDefaultAcceptBudget;
+        if (configTable.hasKey("accept_budget")) {
+            const long value = configTable.getValue("accept_budget").unwrap().getInteger().unwrap();
+            if (value < 1 || static_cast<std::size_t>(value) > kMaxAcceptBudget) {
+                LOG_ERRORF("accept_budget must be between 1 and %zu: %ld", kMaxAcceptBudget, value);
+                throw std::runtime_error("invalid accept_budget");
+            }
+            acceptBudget = static_cast<std::size_t>(value);
+        }
+
+        const utils::Time::Millis requestTimeoutMs =
+            timeoutFromToml(configTable, "request_timeout_ms", kDefaultRequestTimeoutMs);
+        const utils::Time::Millis cgiTimeoutMs = timeoutFromToml(configTable, "cgi_timeout_ms", kDefaultCgiTimeoutMs);
+        const utils::Time::Millis keepAliveTimeoutMs =
+            timeoutFromToml(configTable, "keepalive_timeout_ms", kDefaultKeepAliveTimeoutMs);
+
+        std::size_t keepAliveRequests = kDefaultKeepAliveRequests;
+        if (configTable.hasKey("keepalive_requests")) {
+            const long value = configTable.getValue("keepalive_requests").unwrap().getInteger().unwrap();
+            if (value < 0 || static_cast<std::size_t>(value) > kMaxKeepAliveRequests) {
+                LOG_ERRORF("keepalive_requests must be between 0 and %zu: %ld", kMaxKeepAliveRequests, value);
+                throw std::runtime_error("invalid keepalive_requests");
+            }
+            keepAliveRequests = static_cast<std::size_t>(value);
+        }
+
+        return MainContext(
+            eventMethod,
+            edgeTriggered,
+            workers,
+            workerProcesses,
+            acceptBudget,
+            requestTimeoutMs,
+            cgiTimeoutMs,
+            keepAliveTimeoutMs,
+            keepAliveRequests
+        );
+    }
+
+    utils::Time::Millis MainContext::timeoutFromToml(
+        const toml::Table &configTable, const std::string &key, const utils::Time::Millis defaultValue
+    ) {
+        if (!configTable.hasKey(key)) {
+            return defaultValue;
+        }
+        const long value = configTable.getValue(key).unwrap().getInteger().unwrap();
+        if (value < 1 || static_cast<utils::Time::Millis>(value) > kMaxTimeoutMs) {
+            LOG_ERRORF("%s must be between 1 and %lu: %ld", key.c_str(), static_cast<unsigned long>(kMaxTimeoutMs), value);
+            throw std::runtime_error("invalid " + key);
+        }
+        return static_cast<utils::Time::Millis>(value);
+    }
+
+    MainContext::EventMethod MainContext::getEventMethod() const {
+        return eventMethod_;
+    }
+
+    bool MainContext::isEdgeTriggered() const {
+        return edgeTriggered_;
+    }
+
+    std::size_t MainContext::getWorkers() const {
+        return workers_;
+    }
+
+    std::size_t MainContext::getWorkerProcesses() const {
+        return workerProcesses_;
+    }
+
+    std::size_t MainContext::getAcceptBudget() const {
+        return acceptBudget_;
+    }
+
+    utils::Time::Millis MainContext::getRequestTimeoutMs() const {
+        return requestTimeoutMs_;
+    }
+
+    utils::Time::Millis MainContext::getCgiTimeoutMs() const {
+        return cgiTimeoutMs_;
+    }
+
+    utils::Time::Millis MainContext::getKeepAliveTimeoutMs() const {
+        return keepAliveTimeoutMs_;
+    }
+
+    std::size_t MainContext::getKeepAliveRequests() const {
+        return keepAliveRequests_;
+    }
+
     /* ServerContext */
     ServerContext::ServerContext(
         const std::string &host,
@@ -66,14 +252,16 @@ namespace config {
         const std::vector<LocationContext> &locations,
         const std::vector<std::string> &serverName,
         const ErrorPageMap &errorPage,
-        const std::size_t clientMaxBodySize
+        const std::size_t clientMaxBodySize,
+        const GzipConfig &gzip
     )
         : host_(host), port_(port), clientMaxBodySize_(clientMaxBodySize), serverName_(serverName),
-          errorPage_(errorPage), locations_(locations) {}
+          errorPage_(errorPage), locations_(locations), gzip_(gzip) {}
 
     ServerContext::ServerContext(const ServerContext &other)
         : host_(other.host_), port_(other.port_), clientMaxBodySize_(other.clientMaxBodySize_),
-          serverName_(other.serverName_), errorPage_(other.errorPage_), locations_(other.locations_) {}
+          serverName_(other.serverName_), errorPage_(other.errorPage_), locations_(other.locations_),
+          gzip_(other.gzip_) {}
 
     ServerContext &ServerContext::operator=(const ServerContext &rhs) {
         if (this != &rhs) {
@@ -83,13 +271,15 @@ namespace config {
             serverName_ = rhs.serverName_;
             errorPage_ = rhs.errorPage_;
             locations_ = rhs.locations_;
+            gzip_ = rhs.gzip_;
         }
         return *this;
     }
 
     bool ServerContext::operator==(const ServerContext &rhs) const {
         return host_ == rhs.host_ && port_ == rhs.port_ && clientMaxBodySize_ == rhs.clientMaxBodySize_ &&
-            serverName_ == rhs.serverName_ && errorPage_ == rhs.errorPage_ && locations_ == rhs.locations_;
+            serverName_ == rhs.serverName_ && errorPage_ == rhs.errorPage_ && locations_ == rhs.locations_ &&
+            gzip_ == rhs.gzip_;
     }
 
     ServerContext ServerContext::fromToml(const toml::Table &serverTable) {
@@ -144,7 +334,9 @@ namespace config {
             }
         }
 
-        return ServerContext(host, port, locations, serverNames, errorPages, clientMaxBodySize);
+        return ServerContext(
+            host, port, locations, serverNames, errorPages, clientMaxBodySize, GzipConfig::fromToml(serverTable)
+        );
     }
 
     const std::string &ServerContext::getHost() const {
@@ -171,6 +363,87 @@ namespace config {
         return locations_;
     }
 
+    const GzipConfig &ServerContext::getGzip() const {
+        return gzip_;
+    }
+
+    /* GzipConfig */
+    GzipConfig::GzipConfig(
+        const bool enabled, const int level, const std::size_t minLength, const std::vector<std::string> &types
+    )
+        : enabled_(enabled), level_(level), minLength_(minLength), types_(types) {}
+
+    bool GzipConfig::operator==(const GzipConfig &rhs) const {
+        return enabled_ == rhs.enabled_ && level_ == rhs.level_ && minLength_ == rhs.minLength_ &&
+            types_ == rhs.types_;
+    }
+
+    GzipConfig GzipConfig::fromToml(const toml::Table &serverTable) {
+        bool enabled = false;
+        if (serverTable.hasKey("gzip")) {
+            enabled = serverTable.getValue("gzip").unwrap().getString().unwrap() == "on";
+        }
+
+        int level = kDefaultLevel;
+        if (serverTable.hasKey("gzip_level")) {
+            const long value = serverTable.getValue("gzip_level").unwrap().getInteger().unwrap();
+            if (value < 1 || value > 9) {
+                LOG_ERRORF("gzip_level must be between 1 and 9: %ld", value);
+                throw std::runtime_error("invalid gzip_level");
+            }
+            level = static_cast<int>(value);
+        }
+
+        std::size_t minLength = kDefaultMinLength;
+        if (serverTable.hasKey("gzip_min_length")) {
+            const long value = serverTable.getValue("gzip_min_length").unwrap().getInteger().unwrap();
+            if (value < 0) {
+                LOG_ERRORF("gzip_min_length must not be negative: %ld", value);
+                throw std::runtime_error("invalid gzip_min_length");
+            }
+            minLength = static_cast<std::size_t>(value);
+        }
+
+        std::vector<std::string> types = getDefaultTypes();
+        if (serverTable.hasKey("gzip_types")) {
+            const std::vector<toml::Value> typeValues =
+                serverTable.getValue("gzip_types").unwrap().getArray().unwrap().getElements();
+            types.clear();
+            for (std::size_t i = 0; i < typeValues.size(); ++i) {
+                types.push_back(typeValues[i].getString().unwrap());
+            }
+        }
+
+        return GzipConfig(enabled, level, minLength, types);
+    }
+
+    bool GzipConfig::isEnabled() const {
+        return enabled_;
+    }
+
+    int GzipConfig::getLevel() const {
+        return level_;
+    }
+
+    std::size_t GzipConfig::getMinLength() const {
+        return minLength_;
+    }
+
+    const std::vector<std::string> &GzipConfig::getTypes() const {
+        return types_;
+    }
+
+    // すでに圧縮されている画像などは含めない
+    std::vector<std::string> GzipConfig::getDefaultTypes() {
+        std::vector<std::string> types;
+        types.push_back("text/html");
+        types.push_back("text/plain");
+        types.push_back("text/css");
+        types.push_back("application/javascript");
+        types.push_back("application/json");
+        return types;
+    }
+
     /* LocationContext */
     LocationContext::LocationContext(
         const std::string &path, const DocumentRootConfig &docRootConfig, const AllowedMethods &allowedMethods
@@ -222,6 +495,23 @@ namespace config {
             autoindex = autoindexValue == "on";
         }
 
+        std::size_t autoindexCache = 0;
+        if (locationTable.hasKey("autoindex_cache")) {
+            const long value = locationTable.getValue("autoindex_cache").unwrap().getInteger().unwrap();
+            if (value < 0 || static_cast<std::size_t>(value) > DocumentRootConfig::kMaxAutoindexCache) {
+                LOG_ERRORF(
+                    "autoindex_cache must be between 0 and %zu: %ld", DocumentRootConfig::kMaxAutoindexCache, value
+                );
+                throw std::runtime_error("invalid autoindex_cache");
+            }
+            autoindexCache = static_cast<std::size_t>(value);
+        }
+
+        bool precompressed = false;
+        if (locationTable.hasKey("precompressed")) {
+            precompressed = locationTable.getValue("precompressed").unwrap().getString().unwrap() == "on";
+        }
+
         std::vector<std::string> cgiExtensions;
         if (locationTable.hasKey("cgi_extensions")) {
             std::vector<toml::Value> extensionsInConfig =
@@ -250,7 +540,16 @@ namespace config {
             }
         }
 
-        DocumentRootConfig docRootConfig(root, autoindex, index, cgiExtensions);
+        DocumentRootConfig docRootConfig(
+            root,
+            autoindex,
+            index,
+            cgiExtensions,
+            OpenFileCacheConfig::fromToml(locationTable),
+            HotContentCacheConfig::fromToml(locationTable),
+            precompressed,
+            autoindexCache
+        );
         return LocationContext(path, docRootConfig, allowedMethods);
     }
 
@@ -275,13 +574,20 @@ namespace config {
         const std::string &root,
         const bool autoindex,
         const std::string &index,
-        const std::vector<std::string> &cgiExtensions
+        const std::vector<std::string> &cgiExtensions,
+        const OpenFileCacheConfig &openFileCache,
+        const HotContentCacheConfig &hotContentCache,
+        const bool precompressed,
+        const std::size_t autoindexCache
     )
-        : root_(root), autoindex_(autoindex), index_(index), cgiExtensions_(cgiExtensions) {}
+        : root_(root), autoindex_(autoindex), index_(index), cgiExtensions_(cgiExtensions),
+          openFileCache_(openFileCache), hotContentCache_(hotContentCache), precompressed_(precompressed),
+          autoindexCache_(autoindexCache) {}
 
     LocationContext::DocumentRootConfig::DocumentRootConfig(const DocumentRootConfig &other)
-        : root_(other.root_), autoindex_(other.autoindex_), index_(other.index_), cgiExtensions_(other.cgiExtensions_) {
-    }
+        : root_(other.root_), autoindex_(other.autoindex_), index_(other.index_), cgiExtensions_(other.cgiExtensions_),
+          openFileCache_(other.openFileCache_), hotContentCache_(other.hotContentCache_),
+          precompressed_(other.precompressed_), autoindexCache_(other.autoindexCache_) {}
 
     LocationContext::DocumentRootConfig &LocationContext::DocumentRootConfig::operator=(const DocumentRootConfig &rhs) {
         if (this != &rhs) {
@@ -289,13 +595,19 @@ namespace config {
             autoindex_ = rhs.autoindex_;
             index_ = rhs.index_;
             cgiExtensions_ = rhs.cgiExtensions_;
+            openFileCache_ = rhs.openFileCache_;
+            hotContentCache_ = rhs.hotContentCache_;
+            precompressed_ = rhs.precompressed_;
+            autoindexCache_ = rhs.autoindexCache_;
         }
         return *this;
     }
 
     bool LocationContext::DocumentRootConfig::operator==(const DocumentRootConfig &rhs) const {
         return root_ == rhs.root_ && autoindex_ == rhs.autoindex_ && index_ == rhs.index_ &&
-            cgiExtensions_ == rhs.cgiExtensions_;
+            cgiExtensions_ == rhs.cgiExtensions_ && openFileCache_ == rhs.openFileCache_ &&
+            hotContentCache_ == rhs.hotContentCache_ && precompressed_ == rhs.precompressed_ &&
+            autoindexCache_ == rhs.autoindexCache_;
     }
 
     const std::string &LocationContext::DocumentRootConfig::getRoot() const {
@@ -314,9 +626,120 @@ namespace config {
         return cgiExtensions_;
     }
 
+    const OpenFileCacheConfig &LocationContext::DocumentRootConfig::getOpenFileCache() const {
+        return openFileCache_;
+    }
+
+    const HotContentCacheConfig &LocationContext::DocumentRootConfig::getHotContentCache() const {
+        return hotContentCache_;
+    }
+
+    bool LocationContext::DocumentRootConfig::isPrecompressedEnabled() const {
+        return precompressed_;
+    }
+
+    std::size_t LocationContext::DocumentRootConfig::getAutoindexCache() const {
+        return autoindexCache_;
+    }
+
     LocationContext::AllowedMethods LocationContext::getDefaultAllowedMethods() {
         std::vector<http::HttpMethod> allowedMethods;
         allowedMethods.push_back(http::kMethodGet);
         return allowedMethods;
     }
+
+    /* OpenFileCacheConfig */
+    OpenFileCacheConfig::OpenFileCacheConfig(
+        const std::size_t maxEntries, const utils::Time::Millis validMs, const bool cacheErrors
+    )
+        : maxEntries_(maxEntries), validMs_(validMs), cacheErrors_(cacheErrors) {}
+
+    bool OpenFileCacheConfig::operator==(const OpenFileCacheConfig &rhs) const {
+        return maxEntries_ == rhs.maxEntries_ && validMs_ == rhs.validMs_ && cacheErrors_ == rhs.cacheErrors_;
+    }
+
+    OpenFileCacheConfig OpenFileCacheConfig::fromToml(const toml::Table &locationTable) {
+        std::size_t maxEntries = 0;
+        if (locationTable.hasKey("open_file_cache")) {
+            const long value = locationTable.getValue("open_file_cache").unwrap().getInteger().unwrap();
+            if (value < 0 || static_cast<std::size_t>(value) > kMaxEntries) {
+                LOG_ERRORF("open_file_cache must be between 0 and %zu: %ld", kMaxEntries, value);
+                throw std::runtime_error("invalid open_file_cache");
+            }
+            maxEntries = static_cast<std::size_t>(value);
+        }
+
+        utils::Time::Millis validMs = kDefaultValidMs;
+        if (locationTable.hasKey("open_file_cache_valid_ms")) {
+            const long value = locationTable.getValue("open_file_cache_valid_ms").unwrap().getInteger().unwrap();
+            if (value < 1 || static_cast<utils::Time::Millis>(value) > kMaxValidMs) {
+                LOG_ERRORF(
+                    "open_file_cache_valid_ms must be between 1 and %lu: %ld",
+                    static_cast<unsigned long>(kMaxValidMs),
+                    value
+                );
+                throw std::runtime_error("invalid open_file_cache_valid_ms");
+            }
+            validMs = static_cast<utils::Time::Millis>(value);
+        }
+
+        bool cacheErrors = true;
+        if (locationTable.hasKey("open_file_cache_errors")) {
+            cacheErrors = locationTable.getValue("open_file_cache_errors").unwrap().getString().unwrap() == "on";
+        }
+
+        return OpenFileCacheConfig(maxEntries, validMs, cacheErrors);
+    }
+
+    std::size_t OpenFileCacheConfig::getMaxEntries() const {
+        return maxEntries_;
+    }
+
+    utils::Time::Millis OpenFileCacheConfig::getValidMs() const {
+        return validMs_;
+    }
+
+    bool OpenFileCacheConfig::isCacheErrorsEnabled() const {
+        return cacheErrors_;
+    }
+
+    /* HotContentCacheConfig */
+    HotContentCacheConfig::HotContentCacheConfig(const std::size_t maxBytes, const std::size_t maxFileSize)
+        : maxBytes_(maxBytes), maxFileSize_(maxFileSize) {}
+
+    bool HotContentCacheConfig::operator==(const HotContentCacheConfig &rhs) const {
+        return maxBytes_ == rhs.maxBytes_ && maxFileSize_ == rhs.maxFileSize_;
+    }
+
+    HotContentCacheConfig HotContentCacheConfig::fromToml(const toml::Table &locationTable) {
+        std::size_t maxBytes = 0;
+        if (locationTable.hasKey("hot_cache_bytes")) {
+            const long value = locationTable.getValue("hot_cache_bytes").unwrap().getInteger().unwrap();
+            if (value < 0 || static_cast<std::size_t>(value) > kMaxBytes) {
+                LOG_ERRORF("hot_cache_bytes must be between 0 and %zu: %ld", kMaxBytes, value);
+                throw std::runtime_error("invalid hot_cache_bytes");
+            }
+            maxBytes = static_cast<std::size_t>(value);
+        }
+
+        std::size_t maxFileSize = kDefaultMaxFileSize;
+        if (locationTable.hasKey("hot_cache_max_file_size")) {
+            const long value = locationTable.getValue("hot_cache_max_file_size").unwrap().getInteger().unwrap();
+            if (value < 0 || static_cast<std::size_t>(value) > kMaxBytes) {
+                LOG_ERRORF("hot_cache_max_file_size must be between 0 and %zu: %ld", kMaxBytes, value);
+                throw std::runtime_error("invalid hot_cache_max_file_size");
+            }
+            maxFileSize = static_cast<std::size_t>(value);
+        }
+
+        return HotContentCacheConfig(maxBytes, maxFileSize);
+    }
+
+    std::size_t HotContentCacheConfig::getMaxBytes() const {
+        return maxBytes_;
+    }
+
+    std::size_t HotContentCacheConfig::getMaxFileSize() const {
+        return maxFileSize_;
+    }
 }
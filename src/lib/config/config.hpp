@@ -4,6 +4,7 @@
 #include "http/method.hpp"
 #include "http/status.hpp"
 #include "toml/value.hpp"
+#include "utils/time.hpp"
 #include "utils/types/option.hpp"
 #include <stdint.h> // NOLINT(*-deprecated-headers)
 #include <string>
@@ -11,15 +12,86 @@
 #include <vector>
 
 namespace config {
+    class MainContext;
     class LocationContext;
     class ServerContext;
 
     typedef std::vector<ServerContext> ServerContextList;
     typedef std::vector<LocationContext> LocationContextList;
 
+    // server より外側 (設定ファイルのトップレベル) の設定
+    class MainContext {
+    public:
+        enum EventMethod { kEventMethodPoll, kEventMethodEpoll, kEventMethodIoUring };
+
+        // signal handler から参照する配列の大きさに使うので、上限を設ける
+        static const std::size_t kMaxWorkers = 64;
+
+        explicit MainContext(
+            EventMethod eventMethod = kDefaultEventMethod,
+            bool edgeTriggered = false,
+            std::size_t workers = 1,
+            std::size_t workerProcesses = 0,
+            std::size_t acceptBudget = kDefaultAcceptBudget,
+            utils::Time::Millis requestTimeoutMs = kDefaultRequestTimeoutMs,
+            utils::Time::Millis cgiTimeoutMs = kDefaultCgiTimeoutMs,
+            utils::Time::Millis keepAliveTimeoutMs = kDefaultKeepAliveTimeoutMs,
+            std::size_t keepAliveRequests = kDefaultKeepAliveRequests
+        );
+        MainContext(const MainContext &other);
+
+        MainContext &operator=(const MainContext &rhs);
+        bool operator==(const MainContext &rhs) const;
+
+        static MainContext fromToml(const toml::Table &configTable);
+
+        EventMethod getEventMethod() const;
+        // epoll でのみ有効
+        bool isEdgeTriggered() const;
+        // イベントループを動かすスレッドの数
+        std::size_t getWorkers() const;
+        // fork する worker プロセスの数。0 ならマスタープロセスを作らず、そのまま動かす
+        std::size_t getWorkerProcesses() const;
+        // 1 回の accept のイベントで accept する接続の上限
+        std::size_t getAcceptBudget() const;
+        // リクエストを待つ時間 (最後に読み込んでから)
+        utils::Time::Millis getRequestTimeoutMs() const;
+        // CGI の実行時間の上限
+        utils::Time::Millis getCgiTimeoutMs() const;
+        // keep-alive で次のリクエストを待つ時間
+        utils::Time::Millis getKeepAliveTimeoutMs() const;
+        // 1 つのコネクションで受け付けるリクエストの上限。0 なら keep-alive しない
+        std::size_t getKeepAliveRequests() const;
+
+    private:
+        static const EventMethod kDefaultEventMethod = kEventMethodEpoll;
+        static const std::size_t kDefaultAcceptBudget = 64;
+        static const std::size_t kMaxAcceptBudget = 4096;
+        static const utils::Time::Millis kDefaultRequestTimeoutMs = 5000;
+        static const utils::Time::Millis kDefaultCgiTimeoutMs = 5000;
+        static const utils::Time::Millis kDefaultKeepAliveTimeoutMs = 15000;
+        static const std::size_t kDefaultKeepAliveRequests = 100;
+        static const std::size_t kMaxKeepAliveRequests = 1000000;
+        // 1 日
+        static const utils::Time::Millis kMaxTimeoutMs = 86400000;
+        EventMethod eventMethod_;
+        bool edgeTriggered_;
+        std::size_t workers_;
+        std::size_t workerProcesses_;
+        std::size_t acceptBudget_;
+        utils::Time::Millis requestTimeoutMs_;
+        utils::Time::Millis cgiTimeoutMs_;
+        utils::Time::Millis keepAliveTimeoutMs_;
+        std::size_t keepAliveRequests_;
+
+        static utils::Time::Millis timeoutFromToml(
+            const toml::Table &configTable, const std::string &key, utils::Time::Millis defaultValue
+        );
+    };
+
     class Config {
     public:
-        explicit Config(const ServerContextList &servers);
+        explicit Config(const ServerContextList &servers, const MainContext &mainContext = MainContext());
         Config(const Config &other);
 
         Config &operator=(const Config &rhs);
@@ -27,12 +99,47 @@ namespace config {
 
         static Option<Config> loadConfigFromFile(const std::string &path);
 
+        const MainContext &getMainContext() const;
         const ServerContextList &getServers() const;
 
     private:
+        MainContext mainContext_;
         ServerContextList servers_;
     };
 
+    // レスポンスを gzip で圧縮する middleware の設定 (server ごと)
+    class GzipConfig {
+    public:
+        explicit GzipConfig(
+            bool enabled = false,
+            int level = kDefaultLevel,
+            std::size_t minLength = kDefaultMinLength,
+            const std::vector<std::string> &types = getDefaultTypes()
+        );
+
+        bool operator==(const GzipConfig &rhs) const;
+
+        static GzipConfig fromToml(const toml::Table &serverTable);
+
+        bool isEnabled() const;
+        // zlib の圧縮レベル (1-9)
+        int getLevel() const;
+        // 長さが分かっていて、これより短い body は圧縮しない
+        std::size_t getMinLength() const;
+        // 圧縮する Content-Type (パラメータを除いたもの)
+        const std::vector<std::string> &getTypes() const;
+
+    private:
+        static const int kDefaultLevel = 6;
+        static const std::size_t kDefaultMinLength = 256;
+        bool enabled_;
+        int level_;
+        std::size_t minLength_;
+        std::vector<std::string> types_;
+
+        static std::vector<std::string> getDefaultTypes();
+    };
+
     class ServerContext {
     public:
         typedef std::map<http::HttpStatusCode, std::string> ErrorPageMap;
@@ -43,7 +150,8 @@ namespace config {
             const LocationContextList &locations,
             const std::vector<std::string> &serverName = std::vector<std::string>(),
             const ErrorPageMap &errorPage = ErrorPageMap(),
-            std::size_t clientMaxBodySize = kDefaultClientMaxBodySize
+            std::size_t clientMaxBodySize = kDefaultClientMaxBodySize,
+            const GzipConfig &gzip = GzipConfig()
         );
         ServerContext(const ServerContext &other);
 
@@ -58,6 +166,7 @@ namespace config {
         const std::vector<std::string> &getServerName() const;
         const std::map<http::HttpStatusCode, std::string> &getErrorPage() const;
         const LocationContextList &getLocations() const;
+        const GzipConfig &getGzip() const;
 
     private:
         static const std::size_t kDefaultClientMaxBodySize = 1048576; // 1 MiB
@@ -67,6 +176,56 @@ namespace config {
         std::vector<std::string> serverName_;
         ErrorPageMap errorPage_;
         LocationContextList locations_;
+        GzipConfig gzip_;
+    };
+
+    // 静的ファイルの open_file_cache の設定 (location ごと)
+    class OpenFileCacheConfig {
+    public:
+        explicit OpenFileCacheConfig(
+            std::size_t maxEntries = 0, utils::Time::Millis validMs = kDefaultValidMs, bool cacheErrors = true
+        );
+
+        bool operator==(const OpenFileCacheConfig &rhs) const;
+
+        static OpenFileCacheConfig fromToml(const toml::Table &locationTable);
+
+        // worker スレッドごとに持つエントリの上限。0 ならキャッシュしない
+        std::size_t getMaxEntries() const;
+        // エントリを確かめ直さずに使う時間
+        utils::Time::Millis getValidMs() const;
+        // ファイルがないこと (ENOENT, ENOTDIR) もキャッシュする
+        bool isCacheErrorsEnabled() const;
+
+    private:
+        static const utils::Time::Millis kDefaultValidMs = 60000;
+        static const std::size_t kMaxEntries = 100000;
+        // 1 日
+        static const utils::Time::Millis kMaxValidMs = 86400000;
+        std::size_t maxEntries_;
+        utils::Time::Millis validMs_;
+        bool cacheErrors_;
+    };
+
+    // 小さいファイルのレスポンスをメモリに持つキャッシュの設定 (location ごと)
+    class HotContentCacheConfig {
+    public:
+        explicit HotContentCacheConfig(std::size_t maxBytes = 0, std::size_t maxFileSize = kDefaultMaxFileSize);
+
+        bool operator==(const HotContentCacheConfig &rhs) const;
+
+        static HotContentCacheConfig fromToml(const toml::Table &locationTable);
+
+        // worker スレッドごとに使うメモリの上限。0 ならキャッシュしない
+        std::size_t getMaxBytes() const;
+        // これより大きいファイルはキャッシュしない
+        std::size_t getMaxFileSize() const;
+
+    private:
+        static const std::size_t kDefaultMaxFileSize = 64 * 1024;
+        static const std::size_t kMaxBytes = 1024 * 1024 * 1024;
+        std::size_t maxBytes_;
+        std::size_t maxFileSize_;
     };
 
     class LocationContext {
@@ -77,7 +236,11 @@ namespace config {
                 const std::string &root,
                 bool autoindex = false,
                 const std::string &index = "index.html",
-                const std::vector<std::string> &cgiExtensions = std::vector<std::string>()
+                const std::vector<std::string> &cgiExtensions = std::vector<std::string>(),
+                const OpenFileCacheConfig &openFileCache = OpenFileCacheConfig(),
+                const HotContentCacheConfig &hotContentCache = HotContentCacheConfig(),
+                bool precompressed = false,
+                std::size_t autoindexCache = 0
             );
             DocumentRootConfig(const DocumentRootConfig &other);
 
@@ -88,12 +251,24 @@ namespace config {
             bool isAutoindexEnabled() const;
             const std::string &getIndex() const;
             const std::vector<std::string> &getCgiExtensions() const;
+            const OpenFileCacheConfig &getOpenFileCache() const;
+            const HotContentCacheConfig &getHotContentCache() const;
+            // ファイルの隣にある圧縮済みのファイル (.br, .gz) を返すか
+            bool isPrecompressedEnabled() const;
+            // worker スレッドごとにキャッシュするディレクトリの一覧の数。0 ならキャッシュしない
+            std::size_t getAutoindexCache() const;
+
+            static const std::size_t kMaxAutoindexCache = 10000;
 
         private:
             std::string root_;
             bool autoindex_;
             std::string index_;
             std::vector<std::string> cgiExtensions_;
+            OpenFileCacheConfig openFileCache_;
+            HotContentCacheConfig hotContentCache_;
+            bool precompressed_;
+            std::size_t autoindexCache_;
         };
 
         typedef std::vector<http::HttpMethod> AllowedMethods;
@@ -1,31 +1,74 @@
 #include "action.hpp"
-#include "http/handler/router.hpp"
+#include "../handler/lingering_close_handler.hpp"
 #include "utils/logger.hpp"
+#include "utils/time.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
 
-void AddConnectionAction::execute(ActionContext &ctx) {
-    ctx.getState().getConnectionRepository().set(conn_->getFd(), conn_);
-}
-
-void RemoveConnectionAction::execute(ActionContext &ctx) {
-    ctx.getState().getConnectionRepository().remove(conn_.getFd());
-}
-
-void RegisterEventHandlerAction::execute(ActionContext &ctx) {
-    ctx.getState().getEventHandlerRepository().set(conn_.getFd(), type_, handler_);
-}
-
-void RegisterEventHandlerByFdAction::execute(ActionContext &ctx) {
-    ctx.getState().getEventHandlerRepository().set(fd_, type_, handler_);
-}
-
-void UnregisterEventHandlerAction::execute(ActionContext &ctx) {
-    ctx.getState().getEventHandlerRepository().remove(conn_.getFd(), type_);
-}
-
-void RegisterEventAction::execute(ActionContext &ctx) {
-    ctx.getState().getEventNotifier().registerEvent(event_);
-}
+void executeAction(ActionContext &ctx, const ActionQueue::Command &command) {
+    ServerState &state = ctx.getState();
+    const Event::EventType type = static_cast<Event::EventType>(command.eventFlags);
 
-void UnregisterEventAction::execute(ActionContext &ctx) {
-    ctx.getState().getEventNotifier().unregisterEvent(event_);
+    switch (command.kind) {
+        case ActionQueue::Command::kAddConnection:
+            command.conn->setRemainingRequests(state.getKeepAliveRequests());
+            state.getConnectionRepository().set(command.fd, command.conn);
+            // リクエストが届くまでのタイムアウト
+            state.getConnectionRepository().setTimeout(
+                command.fd, utils::Time::getCachedMonotonicMillis() + state.getRequestTimeoutMs()
+            );
+            break;
+        case ActionQueue::Command::kRemoveConnection:
+            state.getConnectionRepository().remove(command.fd);
+            break;
+        case ActionQueue::Command::kRegisterEventHandler:
+            state.getEventHandlerRepository().set(command.fd, type, command.handler);
+            break;
+        case ActionQueue::Command::kUnregisterEventHandler:
+            state.getEventHandlerRepository().remove(command.fd, type);
+            break;
+        case ActionQueue::Command::kRegisterEvent:
+            state.getEventNotifier().registerEvent(Event(command.fd, command.eventFlags));
+            break;
+        case ActionQueue::Command::kUnregisterEvent:
+            state.getEventNotifier().unregisterEvent(Event(command.fd, command.eventFlags));
+            break;
+        case ActionQueue::Command::kKeepAlive: {
+            const Option<Ref<Connection> > conn = state.getConnectionRepository().get(command.fd);
+            if (conn.isNone()) {
+                break;
+            }
+            // 次のリクエストのデータが届くまでは、keep-alive のタイムアウトを使う
+            conn.unwrap().get().setIdle(true);
+            conn.unwrap().get().updateActivity();
+            state.getConnectionRepository().setTimeout(
+                command.fd, utils::Time::getCachedMonotonicMillis() + state.getKeepAliveTimeoutMs()
+            );
+            break;
+        }
+        case ActionQueue::Command::kLingeringClose: {
+            // 書き込み側だけ閉じて FIN を送る。close は LingeringCloseHandler が EOF を読んだか、タイマーが期限切れになってから
+            if (shutdown(command.fd, SHUT_WR) == -1) {
+                LOG_DEBUGF("shutdown failed for fd %d: %s", command.fd, std::strerror(errno));
+                state.getEventNotifier().unregisterEvent(Event(command.fd, Event::kRead | Event::kWrite));
+                state.getEventHandlerRepository().remove(command.fd, Event::kRead);
+                state.getEventHandlerRepository().remove(command.fd, Event::kWrite);
+                state.getConnectionRepository().remove(command.fd);
+                break;
+            }
+            // registerEvent は監視するイベントを上書きするので、write の監視は外れる
+            state.getEventNotifier().registerEvent(Event(command.fd, Event::kRead));
+            state.getEventHandlerRepository().remove(command.fd, Event::kWrite);
+            state.getEventHandlerRepository().set(command.fd, Event::kRead, new LingeringCloseHandler());
+            state.getConnectionRepository().setLingerTimeout(
+                command.fd, utils::Time::getCachedMonotonicMillis() + LingeringCloseHandler::kTimeoutMs
+            );
+            break;
+        }
+        case ActionQueue::Command::kCustom:
+            command.action->execute(ctx);
+            delete command.action;
+            break;
+    }
 }
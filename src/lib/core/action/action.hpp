@@ -2,10 +2,10 @@
 #define SRC_LIB_CORE_ACTION_ACTION_HPP
 
 #include "event/event_handler.hpp"
-#include "http/request/request.hpp"
 #include "../server_state.hpp"
 #include "../virtual_server_resolver.hpp"
 #include "cgi/request.hpp"
+#include "http/response/response_filter.hpp"
 
 class ActionContext {
 public:
@@ -18,102 +18,38 @@ private:
     ServerState &state_;
 };
 
-class AddConnectionAction : public IAction {
-public:
-    explicit AddConnectionAction(Connection *conn) : conn_(conn) {}
-    void execute(ActionContext &ctx);
+// ActionQueue に積まれたコマンドを 1 つ実行する。コマンドが持っていたオブジェクトの所有権は ServerState に移る
+void executeAction(ActionContext &ctx, const ActionQueue::Command &command);
 
-private:
-    Connection *conn_;
-};
-
-class RemoveConnectionAction : public IAction {
-public:
-    explicit RemoveConnectionAction(Connection &conn) : conn_(conn) {}
-    void execute(ActionContext &ctx);
-
-private:
-    Connection &conn_;
-};
-
-class RegisterEventHandlerAction : public IAction {
-public:
-    RegisterEventHandlerAction(Connection &conn, const Event::EventType type, IEventHandler *handler)
-        : conn_(conn), type_(type), handler_(handler) {}
-    void execute(ActionContext &ctx);
-
-private:
-    Connection &conn_;
-    Event::EventType type_;
-    IEventHandler *handler_;
-};
-
-class RegisterEventHandlerByFdAction : public IAction {
-public:
-    RegisterEventHandlerByFdAction(const int fd, const Event::EventType type, IEventHandler *handler)
-        : fd_(fd), type_(type), handler_(handler) {}
-    void execute(ActionContext &ctx);
-
-private:
-    int fd_;
-    Event::EventType type_;
-    IEventHandler *handler_;
-};
-
-class UnregisterEventHandlerAction : public IAction {
-public:
-    explicit UnregisterEventHandlerAction(Connection &conn, const Event::EventType type) : conn_(conn), type_(type) {}
-    void execute(ActionContext &ctx);
-
-private:
-    Connection &conn_;
-    Event::EventType type_;
-};
-
-class RegisterEventAction : public IAction {
-public:
-    explicit RegisterEventAction(const Event &event) : event_(event) {}
-    void execute(ActionContext &ctx);
-
-private:
-    Event event_;
-};
-
-class UnregisterEventAction : public IAction {
+class RunCgiAction : public IAction {
 public:
-    explicit UnregisterEventAction(const Event &event) : event_(event) {}
+    RunCgiAction(const cgi::Request &cgiRequest, const int clientFd, const http::IResponseFilter *filter = NULL)
+        : cgiRequest_(cgiRequest), clientFd_(clientFd), filter_(filter) {}
     void execute(ActionContext &ctx);
 
 private:
-    Event event_;
-};
-
-class ServeHttpAction : public IAction {
-public:
-    typedef IEventHandler *(EventHandlerFactory)(const http::Response &);
-
-    ServeHttpAction(const Context &eventCtx, const http::Request &req, EventHandlerFactory *factory)
-        : eventCtx_(eventCtx), req_(req), factory_(factory) {}
-    void execute(ActionContext &actionCtx);
+    cgi::Request cgiRequest_;
+    int clientFd_;
+    // CGI のレスポンスに適用する (NULL なら何もしない)
+    const http::IResponseFilter *filter_;
 
-private:
-    Context eventCtx_;
-    http::Request req_;
-    EventHandlerFactory *factory_;
+    std::vector<std::string> createEnvStrings() const;
+    std::string getCgiProgram() const;
+    static void childRoutine(int socketFd, const std::string &cgiProgram, char *const envp[]);
+    void parentRoutine(const ActionContext &ctx, int socketFd, pid_t childPid) const;
 };
 
-class RunCgiAction : public IAction {
+/**
+ * IBodySource に中継するデータが溜まりすぎて止めていた、生産者 (CGI のソケット) の読み込みを再開する
+ * 生産者が body の書き込み (WriteCgiRequestBodyHandler) を続けている場合は、write イベントの監視も残す
+ */
+class ResumeProducerAction : public IAction {
 public:
-    explicit RunCgiAction(const cgi::Request &cgiRequest, const int clientFd)
-        : cgiRequest_(cgiRequest), clientFd_(clientFd) {}
+    explicit ResumeProducerAction(const int producerFd) : producerFd_(producerFd) {}
     void execute(ActionContext &ctx);
 
 private:
-    cgi::Request cgiRequest_;
-    int clientFd_;
-
-    void childRoutine(int socketFd) const;
-    void parentRoutine(const ActionContext &ctx, int socketFd, pid_t childPid) const;
+    int producerFd_;
 };
 
 #endif
@@ -0,0 +1,18 @@
+#include "action.hpp"
+#include "utils/logger.hpp"
+
+void ResumeProducerAction::execute(ActionContext &ctx) {
+    ServerState &state = ctx.getState();
+    if (state.getConnectionRepository().get(producerFd_).isNone()) {
+        // 再開する前に、生産者が終了した
+        return;
+    }
+
+    // registerEvent は監視するイベントを上書きするので、登録されている handler から決める
+    uint32_t flags = Event::kRead;
+    if (state.getEventHandlerRepository().get(producerFd_, Event::kWrite).isSome()) {
+        flags |= Event::kWrite;
+    }
+    LOG_DEBUGF("resume reading from producer fd %d", producerFd_);
+    state.getEventNotifier().registerEvent(Event(producerFd_, flags));
+}
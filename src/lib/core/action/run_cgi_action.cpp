@@ -25,6 +25,19 @@ void RunCgiAction::execute(ActionContext &ctx) {
 
     LOG_DEBUGF("socketParent: %d, socketChild: %d", socketParent.get(), socketChild.get());
 
+    /**
+     * execve に渡すものは fork の前に作っておき、子プロセスではメモリ確保などをしない
+     * worker スレッドがある場合、他のスレッドがロックを持ったまま fork される可能性があるため
+     */
+    const std::string cgiProgram = this->getCgiProgram();
+    const std::vector<std::string> envStrings = this->createEnvStrings();
+    std::vector<char *> envp;
+    envp.reserve(envStrings.size() + 1);
+    for (std::size_t i = 0; i < envStrings.size(); i++) {
+        envp.push_back(const_cast<char *>(envStrings[i].c_str()));
+    }
+    envp.push_back(NULL);
+
     LOG_DEBUG("Forking CGI process");
     const pid_t childPid = fork();
     if (childPid == -1) {
@@ -32,21 +45,13 @@ void RunCgiAction::execute(ActionContext &ctx) {
     }
 
     if (childPid == 0) {
-        this->childRoutine(socketChild.release());
+        childRoutine(socketChild.release(), cgiProgram, envp.data());
     } else {
         this->parentRoutine(ctx, socketParent.release(), childPid);
     }
 }
 
-void RunCgiAction::childRoutine(const int socketFd) const {
-    // CGI の標準入出力を socket にする
-    if (dup2(socketFd, STDIN_FILENO) == -1) {
-        throw std::runtime_error("dup2 failed");
-    }
-    if (dup2(socketFd, STDOUT_FILENO) == -1) {
-        throw std::runtime_error("dup2 failed");
-    }
-
+std::vector<std::string> RunCgiAction::createEnvStrings() const {
     const std::vector<cgi::MetaVariable> &variables = cgiRequest_.getVariables();
 
     std::map<std::string, std::string> envMap;
@@ -73,12 +78,12 @@ void RunCgiAction::childRoutine(const int socketFd) const {
     for (std::map<std::string, std::string>::const_iterator it = envMap.begin(); it != envMap.end(); ++it) {
         envStrings.push_back(it->first + "=" + it->second);
     }
-    std::vector<char *> envp;
-    envp.reserve(envStrings.size() + 1);
-    for (std::size_t i = 0; i < envStrings.size(); i++) {
-        envp.push_back(const_cast<char *>(envStrings[i].c_str()));
-    }
-    envp.push_back(NULL);
+    return envStrings;
+}
+
+// 実行する CGI プログラムのパス (見つからなければ空文字列)
+std::string RunCgiAction::getCgiProgram() const {
+    const std::vector<cgi::MetaVariable> &variables = cgiRequest_.getVariables();
 
     // SCRIPT_NAME と DOCUMENT_ROOT を探して CGI プログラムパスを取得
     std::string scriptName;
@@ -91,20 +96,32 @@ void RunCgiAction::childRoutine(const int socketFd) const {
         }
     }
 
-    // TODO: エラーハンドリングはこれでいい?
     if (scriptName.empty() || documentRoot.empty()) {
-        std::exit(126);
+        return "";
     }
 
     // ドキュメントルートとスクリプト名を結合して実際のファイルパスを生成
-    const std::string cgiProgram = scriptName[0] == '/' ? documentRoot + scriptName : documentRoot + "/" + scriptName;
+    return scriptName[0] == '/' ? documentRoot + scriptName : documentRoot + "/" + scriptName;
+}
+
+// fork した子プロセスで実行される。exit ではなく _exit で終了する (親のデストラクタや atexit を動かさない)
+void RunCgiAction::childRoutine(const int socketFd, const std::string &cgiProgram, char *const envp[]) {
+    // CGI の標準入出力を socket にする
+    if (dup2(socketFd, STDIN_FILENO) == -1 || dup2(socketFd, STDOUT_FILENO) == -1) {
+        _exit(126);
+    }
+
+    // TODO: エラーハンドリングはこれでいい?
+    if (cgiProgram.empty()) {
+        _exit(126);
+    }
 
     // CGI を実行
     char *const argv[] = {const_cast<char *>(cgiProgram.c_str()), NULL};
-    execve(cgiProgram.c_str(), argv, envp.data());
+    execve(cgiProgram.c_str(), argv, envp);
 
     // exec に失敗
-    std::exit(errno == ENOENT ? 127 : 126);
+    _exit(errno == ENOENT ? 127 : 126);
 }
 
 void RunCgiAction::parentRoutine(const ActionContext &ctx, const int socketFd, const pid_t childPid) const {
@@ -114,7 +131,7 @@ void RunCgiAction::parentRoutine(const ActionContext &ctx, const int socketFd, c
 
     // 子プロセスからの出力の読み込みを待つ
     uint32_t eventTypeFlag = Event::kRead;
-    ctx.getState().getEventHandlerRepository().set(socketFd, Event::kRead, new ReadCgiResponseHandler(clientFd_));
+    ctx.getState().getEventHandlerRepository().set(socketFd, Event::kRead, new ReadCgiResponseHandler(clientFd_, filter_));
 
     const Option<std::string> body = cgiRequest_.getBody();
     if (body.isSome()) {
@@ -135,6 +152,10 @@ void RunCgiAction::parentRoutine(const ActionContext &ctx, const int socketFd, c
     ctx.getState().getEventNotifier().unregisterEvent(Event(clientFd_, Event::kWrite));
     ctx.getState().getEventHandlerRepository().remove(clientFd_, Event::kRead);
     ctx.getState().getEventHandlerRepository().remove(clientFd_, Event::kWrite);
-    CgiProcessRepository::Data data = {clientFd_, socketFd, utils::Time::getCurrentTime()};
+    CgiProcessRepository::Data data = {clientFd_, socketFd};
     ctx.getState().getCgiProcessRepository().set(childPid, data);
+    ctx.getState().getCgiProcessRepository().setTimeout(
+        childPid, utils::Time::getCachedMonotonicMillis() + ctx.getState().getCgiTimeoutMs()
+    );
+    ctx.getState().getChildReaper().track(childPid);
 }
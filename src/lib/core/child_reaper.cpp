@@ -1,26 +1,33 @@
 #include "child_reaper.hpp"
+#include <cerrno>
 #include <sys/wait.h>
 
 void ChildReaper::attachToEventNotifier(IEventNotifier *notifier) const {
     selfPipe_.registerWithEventNotifier(notifier);
 }
 
-std::vector<ChildReaper::ReapedProcess> ChildReaper::onSignalEvent() const {
+void ChildReaper::track(const pid_t pid) {
+    children_.insert(pid);
+}
+
+std::vector<ChildReaper::ReapedProcess> ChildReaper::onSignalEvent() {
     std::vector<ReapedProcess> result;
 
     selfPipe_.drain();
-    while (true) {
+    for (std::set<pid_t>::iterator it = children_.begin(); it != children_.end();) {
         int status = 0;
-        const pid_t pid = waitpid(-1, &status, WNOHANG);
-        result.push_back({pid, WEXITSTATUS(status)});
+        const pid_t pid = waitpid(*it, &status, WNOHANG);
+        if (pid == 0 || (pid == -1 && errno == EINTR)) {
+            // まだ終了していない (EINTR は次の SIGCHLD で再試行する)
+            ++it;
+            continue;
+        }
 
         if (pid > 0) {
-            continue;
+            result.push_back({pid, WEXITSTATUS(status)});
         }
-        if (pid == 0) break;
-        if (pid == -1 && errno == ECHILD) break;
-        if (pid == -1 && errno == EINTR) continue;
-        break;
+        // ECHILD などは回収しようがないので、追跡をやめる
+        children_.erase(it++);
     }
     return result;
 }
@@ -2,8 +2,13 @@
 #define SRC_LIB_CORE_WEBSERV_CHILD_REAPER_HPP
 
 #include "self_pipe_sigchld.hpp"
+#include <set>
+#include <vector>
 
-// 子プロセスの回収
+/**
+ * 子プロセスの回収
+ * 他のイベントループが起動した子プロセスを横取りしないように、track した pid だけを waitpid する
+ */
 class ChildReaper {
 public:
     // 回収したプロセスの pid と status
@@ -15,11 +20,14 @@ public:
     ChildReaper() {};
 
     void attachToEventNotifier(IEventNotifier *notifier) const;
-    std::vector<ReapedProcess> onSignalEvent() const;
+    // fork した子プロセスを回収対象にする
+    void track(pid_t pid);
+    std::vector<ReapedProcess> onSignalEvent();
     int getReadFd() const;
 
 private:
     SelfPipeSigchld selfPipe_;
+    std::set<pid_t> children_;
 };
 
 #endif
@@ -0,0 +1,363 @@
+#include "event_loop.hpp"
+#include "action/action.hpp"
+#include "event/event_notifier.hpp"
+#include "./handler/accept_handler.hpp"
+#include "handler/write_response_body_handler.hpp"
+#include "http/response/response_builder.hpp"
+#include "utils/logger.hpp"
+#include "utils/time.hpp"
+#include <cerrno>
+#include <climits>
+#include <signal.h>
+#include <cstring>
+
+volatile sig_atomic_t EventLoop::reloadRequested_ = 0;
+
+EventLoop::EventLoop(
+    const config::MainContext &mainConfig,
+    const std::vector<Listener *> &listeners,
+    const VirtualServerList &virtualServers
+)
+    : virtualServers_(virtualServers), state_(mainConfig) {
+    for (std::vector<Listener *>::const_iterator it = listeners.begin(); it != listeners.end(); ++it) {
+        Listener *listener = *it;
+        const int fd = listener->getFd();
+        listenerFds_.insert(fd);
+
+        // Listener の fd に対する read を待ち、AcceptHandler で処理する
+        state_.getEventNotifier().registerEvent(Event(fd, Event::kRead));
+        // TODO: read 待ちでええんか?
+        state_.getEventHandlerRepository().set(fd, Event::kRead, new AcceptHandler(*listener, mainConfig.getAcceptBudget()));
+    }
+}
+
+void EventLoop::run() {
+    VirtualServerResolverFactory vsResolverFactory(virtualServers_);
+    // ループごとに確保しないように使い回す
+    std::vector<Event> events;
+    std::vector<TimerWheel::Expired> expiredTimers;
+
+    // このスレッドの時刻のキャッシュを有効にする
+    utils::Time::updateCachedClock();
+    while (true) {
+        const IEventNotifier::WaitEventsResult waitResult =
+            state_.getEventNotifier().waitEvents(events, this->computeWaitTimeout());
+        // このループ内の時刻はすべてこれを使う
+        utils::Time::updateCachedClock();
+        // SIGHUP で epoll_wait が中断された場合もここを通る
+        this->reloadIfRequested();
+        if (waitResult.isErr()) {
+            if (errno == EINTR)
+                LOG_DEBUG("waitEvents interrupted by signal, retrying...");
+            else
+                LOG_ERROR("EventNotifier::waitEvents failed");
+            continue;
+        }
+
+        for (std::size_t i = 0; i < events.size(); i++) {
+            const Event &ev = events[i];
+            LOG_DEBUGF("event arrived for fd %d (flags: %x)", ev.getFd(), ev.getTypeFlags());
+
+            // SIGCHLD を監視する self-pipe のイベント
+            // TODO: 関数切り分けて〜
+            if (ev.getFd() == state_.getChildReaper().getReadFd()) {
+                const std::vector<ChildReaper::ReapedProcess> result = state_.getChildReaper().onSignalEvent();
+                if (!result.empty()) LOG_DEBUG("child process reaped");
+                for (std::vector<ChildReaper::ReapedProcess>::const_iterator it = result.begin(); it != result.end();
+                     ++it) {
+                    const Option<CgiProcessRepository::Data> data = state_.getCgiProcessRepository().get(it->pid);
+                    state_.getCgiProcessRepository().remove(it->pid);
+
+                    if (it->status == 0) continue;
+
+                    // CGI スクリプトがエラーで終わった場合
+                    if (data.isNone()) {
+                        LOG_WARNF(
+                            "reaped child process %d with non-zero status %d, but no client fd found",
+                            it->pid,
+                            it->status
+                        );
+                        continue;
+                    }
+                    const int clientFd = data.unwrap().clientFd;
+                    const int processSocketFd = data.unwrap().processSocketFd;
+                    // 子プロセスとのソケットの諸々を解除
+                    state_.getEventNotifier().unregisterEvent(Event(processSocketFd, Event::kRead));
+                    state_.getEventNotifier().unregisterEvent(Event(processSocketFd, Event::kWrite));
+                    state_.getEventHandlerRepository().remove(processSocketFd, Event::kRead);
+                    state_.getEventHandlerRepository().remove(processSocketFd, Event::kWrite);
+                    state_.getConnectionRepository().remove(processSocketFd);
+                    // エラーレスポンスを返す
+                    http::ResponseBuilder builder;
+                    state_.getEventNotifier().registerEvent(Event(clientFd, Event::kWrite));
+                    state_.getEventHandlerRepository().set(
+                        clientFd,
+                        Event::kWrite,
+                        new WriteResponseHandler(builder.status(http::kStatusInternalServerError).build())
+                    );
+                }
+                continue;
+            }
+
+            Option<Ref<Connection> > conn = state_.getConnectionRepository().get(ev.getFd());
+            const Context ctx(ev, conn, vsResolverFactory);
+
+            invokeHandlers(ctx);
+        }
+
+        // タイムアウトチェック
+        this->processTimers(expiredTimers);
+    }
+}
+
+void EventLoop::installReloadHandler() {
+    struct sigaction act;
+    std::memset(&act, 0, sizeof(act));
+    act.sa_handler = &EventLoop::onReloadSignal;
+    sigemptyset(&act.sa_mask);
+    // read などが EINTR で失敗しないようにする (epoll_wait は再開されないので、すぐに読み直せる)
+    act.sa_flags = SA_RESTART;
+    if (sigaction(SIGHUP, &act, NULL) == -1) {
+        LOG_ERRORF("failed to install SIGHUP handler: %s", std::strerror(errno));
+    }
+}
+
+void EventLoop::onReloadSignal(int) {
+    reloadRequested_ = 1;
+}
+
+// VirtualServer は全ループで共有しているので、読み直すのはフラグを取った 1 つのループだけ
+void EventLoop::reloadIfRequested() {
+    if (!reloadRequested_ || !__sync_bool_compare_and_swap(&reloadRequested_, 1, 0)) {
+        return;
+    }
+    LOG_INFO("received SIGHUP, reloading error pages");
+    for (VirtualServerList::const_iterator it = virtualServers_.begin(); it != virtualServers_.end(); ++it) {
+        (*it)->reloadErrorPages();
+    }
+}
+
+void EventLoop::invokeHandlers(const Context &ctx) {
+    const Event &event = ctx.getEvent();
+
+    // イベントごとに確保しないように static にしておく
+    static const Event::EventType types[] = {Event::kRead, Event::kWrite};
+    // TODO: handler の呼び方が壊れてる
+    for (std::size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        const Event::EventType type = types[i];
+        const bool shouldCallHandler = (event.getTypeFlags() & type) != 0;
+
+        if (!(shouldCallHandler || event.isError())) {
+            // 待っていないイベントは無視
+            continue;
+        }
+
+        const Option<Ref<IEventHandler> > handler = state_.getEventHandlerRepository().get(event.getFd(), type);
+        if (handler.isNone()) {
+            continue;
+        }
+        this->invokeSingleHandler(ctx, handler.unwrap(), shouldCallHandler);
+    }
+}
+
+void EventLoop::invokeSingleHandler(const Context &ctx, const Ref<IEventHandler> &handler, const bool shouldCallHandler) {
+    const Event &event = ctx.getEvent();
+
+    if (event.isError()) {
+        const IEventHandler::ErrorHandleResult result = handler.get().onErrorEvent(ctx, event, actions_);
+        this->executeActions();
+        if (result.shouldFallback) {
+            this->onErrorEvent(event);
+            return;
+        }
+        // この場合はそのまま handler を呼ぶ
+    }
+
+    if (!shouldCallHandler) {
+        return;
+    }
+
+    const IEventHandler::InvokeResult result = handler.get().invoke(ctx, actions_);
+    if (result.isErr()) {
+        actions_.discard();
+        this->onHandlerError(ctx, result.unwrapErr());
+        return;
+    }
+    this->executeActions();
+}
+
+/**
+ * TODO: 可能ならエラーレスポンスを返す (Internal Server Error, Payload Too Large など)
+ * ここでやることではないかもしれない
+ */
+void EventLoop::onHandlerError(const Context &ctx, const error::AppError err) {
+    // IO のエラーは epoll で検知するので、ここでは無視 (EAGAIN の可能性があるため)
+    if (err == error::kRecoverable || err == error::kIOUnknown) {
+        return;
+    }
+
+    // 致命的なエラーはコネクションを切断
+    LOG_WARNF("handler error");
+    const Event &ev = ctx.getEvent();
+    if (listenerFds_.count(ev.getFd()) == 0) {
+        state_.getEventNotifier().unregisterEvent(Event(ev.getFd(), Event::kRead | Event::kWrite));
+        state_.getEventHandlerRepository().remove(ev.getFd(), Event::kRead);
+        state_.getEventHandlerRepository().remove(ev.getFd(), Event::kWrite);
+        state_.getConnectionRepository().remove(ev.getFd());
+    }
+}
+
+void EventLoop::onErrorEvent(const Event &event) {
+    if (!event.isError()) {
+        return;
+    }
+
+    const int fd = event.getFd();
+    LOG_WARNF("error event arrived for fd %d", fd);
+
+    // (たぶん) 継続不可なので cleanup
+    if (listenerFds_.count(fd) == 0) {
+        state_.getEventNotifier().unregisterEvent(Event(fd, Event::kRead | Event::kWrite));
+        state_.getEventHandlerRepository().remove(fd, Event::kRead);
+        state_.getEventHandlerRepository().remove(fd, Event::kWrite);
+        state_.getConnectionRepository().remove(fd);
+    }
+}
+
+void EventLoop::executeActions() {
+    if (actions_.empty()) {
+        return;
+    }
+    ActionContext actionCtx(state_);
+    for (std::size_t i = 0; i < actions_.size(); ++i) {
+        executeAction(actionCtx, actions_[i]);
+    }
+    actions_.clear();
+}
+
+// 一番近いタイマーの期限まで待つ (タイマーがなければ無期限)
+int EventLoop::computeWaitTimeout() {
+    const Option<utils::Time::Millis> next = state_.getTimerWheel().nextDeadline();
+    if (next.isNone()) {
+        return -1;
+    }
+
+    const utils::Time::Millis now = utils::Time::getCachedMonotonicMillis();
+    if (next.unwrap() <= now) {
+        return 0;
+    }
+    const utils::Time::Millis timeout = next.unwrap() - now;
+    return timeout > static_cast<utils::Time::Millis>(INT_MAX) ? INT_MAX : static_cast<int>(timeout);
+}
+
+void EventLoop::processTimers(std::vector<TimerWheel::Expired> &expired) {
+    const utils::Time::Millis now = utils::Time::getCachedMonotonicMillis();
+    expired.clear();
+    state_.getTimerWheel().advance(now, expired);
+
+    for (std::vector<TimerWheel::Expired>::const_iterator it = expired.begin(); it != expired.end(); ++it) {
+        switch (it->kind) {
+            case kTimerRequest:
+                this->onRequestTimeout(it->key, now);
+                break;
+            case kTimerCgi:
+                this->onCgiTimeout(it->key);
+                break;
+            case kTimerLingeringClose:
+                this->onLingerTimeout(it->key);
+                break;
+            default:
+                LOG_WARNF("unknown timer kind: %d", it->kind);
+                break;
+        }
+    }
+}
+
+void EventLoop::onRequestTimeout(const int fd, const utils::Time::Millis now) {
+    const Option<Ref<Connection> > conn = state_.getConnectionRepository().get(fd);
+    if (conn.isNone()) {
+        return;
+    }
+
+    // 読み込みのたびにタイマーを入れ直すのではなく、期限切れになったときに最後のアクティビティを確認する
+    const bool idle = conn.unwrap().get().isIdle();
+    const utils::Time::Millis timeout = idle ? state_.getKeepAliveTimeoutMs() : state_.getRequestTimeoutMs();
+    const utils::Time::Millis deadline = conn.unwrap().get().getLastActivityTime() + timeout;
+    if (deadline > now) {
+        state_.getConnectionRepository().setTimeout(fd, deadline);
+        return;
+    }
+
+    // Read ハンドラーが登録されているかチェック（リクエスト待ち状態）
+    const Option<Ref<IEventHandler> > readHandler = state_.getEventHandlerRepository().get(fd, Event::kRead);
+    if (readHandler.isNone()) {
+        // レスポンスを処理中。リクエスト待ちに戻ったときのために、もう一度確認する
+        state_.getConnectionRepository().setTimeout(fd, now + state_.getRequestTimeoutMs());
+        return;
+    }
+
+    if (idle) {
+        // keep-alive で待っていたが、次のリクエストが来なかった。レスポンスは返さずに閉じる
+        LOG_DEBUGF("keep-alive timeout for fd %d", fd);
+        state_.getEventNotifier().unregisterEvent(Event(fd, Event::kRead | Event::kWrite));
+        state_.getEventHandlerRepository().remove(fd, Event::kRead);
+        state_.getEventHandlerRepository().remove(fd, Event::kWrite);
+        state_.getConnectionRepository().remove(fd);
+        return;
+    }
+
+    LOG_INFOF("Request timeout for fd %d", fd);
+    // リクエストを読み切っていないので、レスポンスを返したら閉じる
+    conn.unwrap().get().disableKeepAlive();
+
+    // タイムアウトレスポンスを設定
+    http::ResponseBuilder builder;
+    http::Response response = builder.status(http::kStatusRequestTimeout).build();
+
+    // Read ハンドラーを削除し、Write ハンドラーを設定
+    state_.getEventNotifier().unregisterEvent(Event(fd, Event::kRead));
+    state_.getEventHandlerRepository().remove(fd, Event::kRead);
+    state_.getEventNotifier().registerEvent(Event(fd, Event::kWrite));
+    state_.getEventHandlerRepository().set(fd, Event::kWrite, new WriteResponseHandler(response));
+}
+
+// クライアントがデータを送り続けているか、EOF を送ってこない。読み捨てるのをやめて閉じる
+void EventLoop::onLingerTimeout(const int fd) {
+    LOG_DEBUGF("lingering close timeout for fd %d", fd);
+    state_.getEventNotifier().unregisterEvent(Event(fd, Event::kRead | Event::kWrite));
+    state_.getEventHandlerRepository().remove(fd, Event::kRead);
+    state_.getEventHandlerRepository().remove(fd, Event::kWrite);
+    state_.getConnectionRepository().remove(fd);
+}
+
+void EventLoop::onCgiTimeout(const pid_t pid) {
+    const Option<CgiProcessRepository::Data> cgiData = state_.getCgiProcessRepository().get(pid);
+    if (cgiData.isNone()) {
+        return;
+    }
+    const CgiProcessRepository::Data &data = cgiData.unwrap();
+
+    LOG_INFOF("CGI timeout for pid %d", pid);
+
+    // CGI プロセスを強制終了
+    if (kill(pid, SIGTERM) == -1) {
+        LOG_WARNF("Failed to terminate CGI process %d: %s", pid, std::strerror(errno));
+    }
+
+    // プロセスソケットをクリーンアップ
+    const int processSocketFd = data.processSocketFd;
+    const int clientFd = data.clientFd;
+
+    state_.getEventNotifier().unregisterEvent(Event(processSocketFd, Event::kRead));
+    state_.getEventNotifier().unregisterEvent(Event(processSocketFd, Event::kWrite));
+    state_.getEventHandlerRepository().remove(processSocketFd, Event::kRead);
+    state_.getEventHandlerRepository().remove(processSocketFd, Event::kWrite);
+    state_.getConnectionRepository().remove(processSocketFd);
+    state_.getCgiProcessRepository().remove(pid);
+
+    // Gateway Timeout レスポンスを返す
+    http::ResponseBuilder builder;
+    http::Response response = builder.status(http::kStatusGatewayTimeout).build();
+    state_.getEventNotifier().registerEvent(Event(clientFd, Event::kWrite));
+    state_.getEventHandlerRepository().set(clientFd, Event::kWrite, new WriteResponseHandler(response));
+}
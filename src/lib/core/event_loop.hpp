@@ -0,0 +1,63 @@
+#ifndef SRC_LIB_CORE_EVENT_LOOP_HPP
+#define SRC_LIB_CORE_EVENT_LOOP_HPP
+
+#include "event/event_handler.hpp"
+#include "transport/listener.hpp"
+#include "server_state.hpp"
+#include "virtual_server.hpp"
+#include "config/config.hpp"
+#include "utils/non_copyable.hpp"
+#include <csignal>
+#include <set>
+#include <vector>
+
+/**
+ * 1 スレッドで動くイベントループ
+ * ServerState はループごとに持ち、他のループとは共有しない
+ * VirtualServer (Router) は全ループで共有されるので、リクエストの処理中に変更してはいけない
+ */
+class EventLoop : public NonCopyable {
+public:
+    typedef std::vector<VirtualServer *> VirtualServerList;
+
+    // listeners は他のループと共有しないこと (所有権は移らない)
+    EventLoop(
+        const config::MainContext &mainConfig,
+        const std::vector<Listener *> &listeners,
+        const VirtualServerList &virtualServers
+    );
+
+    void run();
+
+    /**
+     * SIGHUP を受けたら、いずれかのループが次のイテレーションでエラーページを読み直すようにする
+     * デフォルトの動作 (終了) で処理中のコネクションを落とさないように、ループを動かすプロセスで呼ぶ
+     */
+    static void installReloadHandler();
+
+private:
+    // SIGHUP を受けてから、まだどのループも読み直していない
+    static volatile sig_atomic_t reloadRequested_;
+
+    const VirtualServerList &virtualServers_;
+
+    ServerState state_;
+    std::set<int> listenerFds_;
+    // handler が積んだ処理。実行したら clear して使い回す
+    ActionQueue actions_;
+
+    static void onReloadSignal(int signum);
+    void reloadIfRequested();
+    void onHandlerError(const Context &ctx, error::AppError err);
+    void onErrorEvent(const Event &event);
+    void executeActions();
+    void invokeHandlers(const Context &ctx);
+    void invokeSingleHandler(const Context &ctx, const Ref<IEventHandler> &handler, bool shouldCallHandler);
+    int computeWaitTimeout();
+    void processTimers(std::vector<TimerWheel::Expired> &expired);
+    void onRequestTimeout(int fd, utils::Time::Millis now);
+    void onLingerTimeout(int fd);
+    void onCgiTimeout(pid_t pid);
+};
+
+#endif
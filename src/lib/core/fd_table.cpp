@@ -0,0 +1,42 @@
+#include "fd_table.hpp"
+#include <sys/resource.h>
+
+const std::size_t FdTable::kInitialCapacity;
+
+FdTable::FdTable() {
+    std::size_t capacity = kInitialCapacity;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < capacity) {
+        capacity = static_cast<std::size_t>(limit.rlim_cur);
+    }
+    slots_.resize(capacity, emptySlot());
+}
+
+FdTable::Slot &FdTable::at(const int fd) {
+    const std::size_t index = static_cast<std::size_t>(fd);
+    if (index >= slots_.size()) {
+        // fd は上限まで増えうるので、倍々で伸ばす
+        std::size_t newSize = slots_.empty() ? 1 : slots_.size();
+        while (newSize <= index) {
+            newSize *= 2;
+        }
+        slots_.resize(newSize, emptySlot());
+    }
+    return slots_[index];
+}
+
+FdTable::Slot *FdTable::find(const int fd) {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= slots_.size()) {
+        return NULL;
+    }
+    return &slots_[fd];
+}
+
+std::size_t FdTable::size() const {
+    return slots_.size();
+}
+
+FdTable::Slot FdTable::emptySlot() {
+    const Slot slot = {NULL, NULL, NULL, TimerWheel::kInvalidTimerId};
+    return slot;
+}
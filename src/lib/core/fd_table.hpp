@@ -0,0 +1,48 @@
+#ifndef SRC_LIB_CORE_FD_TABLE_HPP
+#define SRC_LIB_CORE_FD_TABLE_HPP
+
+#include "timer_wheel.hpp"
+#include "utils/non_copyable.hpp"
+#include <cstddef>
+#include <vector>
+
+class Connection;
+class IEventHandler;
+
+/**
+ * fd を index とするスロットのテーブル
+ * fd は小さい整数が詰めて使われるので、map の代わりに配列で O(1) で引く
+ * 1 つの fd に関するものを 1 つのスロットに並べておき、イベントの処理でまとめてキャッシュに載るようにする
+ *
+ * ポインタの所有権は持たない (ConnectionRepository, EventHandlerRepository が持つ)
+ */
+class FdTable : public NonCopyable {
+public:
+    struct Slot {
+        Connection *conn;
+        IEventHandler *readHandler;
+        IEventHandler *writeHandler;
+        // kTimerRequest (lingering close 中は kTimerLingeringClose) のタイマー
+        TimerWheel::TimerId requestTimer;
+    };
+
+    FdTable();
+
+    // fd (0 以上) のスロットを返す。範囲外ならテーブルを伸ばす
+    // 返した参照はテーブルが伸びると無効になるので、次に at を呼ぶまでしか使わないこと
+    Slot &at(int fd);
+    // 範囲外なら NULL
+    Slot *find(int fd);
+    // 確保済みのスロットの数 (fd の上限ではない)
+    std::size_t size() const;
+
+private:
+    // 最初に確保するスロットの数の上限 (fd の上限がこれより小さければ、そちらに合わせる)
+    static const std::size_t kInitialCapacity = 1024;
+
+    std::vector<Slot> slots_;
+
+    static Slot emptySlot();
+};
+
+#endif
@@ -4,19 +4,45 @@
 #include "utils/logger.hpp"
 #include "utils/types/try.hpp"
 
-AcceptHandler::AcceptHandler(Listener &listener) : listener_(listener) {}
+AcceptHandler::AcceptHandler(Listener &listener, const std::size_t budget) : listener_(listener), budget_(budget) {}
 
-IEventHandler::InvokeResult AcceptHandler::invoke(const Context &ctx) {
+/**
+ * 接続が殺到したときに、1 回のイベントでキューに溜まった接続をまとめて accept する
+ * 他のコネクションを待たせないように、budget 個で打ち切る
+ */
+IEventHandler::InvokeResult AcceptHandler::invoke(const Context &ctx, ActionQueue &actions) {
     LOG_DEBUG("start AcceptHandler");
 
-    // TODO: accept がブロックしたら?
-    const Listener::AcceptConnectionResult result = listener_.acceptConnection();
-    if (result.isErr()) {
-        LOG_WARNF("failed to accept connection: %s", result.unwrapErr().c_str());
-        return Err(error::kUnknown);
+    std::size_t accepted = 0;
+    while (accepted < budget_) {
+        const Listener::AcceptConnectionResult result = listener_.acceptConnection();
+        if (result.isErr()) {
+            LOG_WARNF("failed to accept connection: %s", result.unwrapErr().c_str());
+            if (accepted == 0) {
+                return Err(error::kUnknown);
+            }
+            // それまでに accept した接続は登録する
+            return Ok();
+        }
+        if (result.unwrap().isNone()) {
+            // キューが空になった
+            return Ok();
+        }
+
+        pushAcceptActions(ctx, actions, result.unwrap().unwrap());
+        ++accepted;
     }
 
-    Connection *newConnection = result.unwrap();
+    /**
+     * budget を使い切ったので、残りは次の wait に回す
+     * edge-triggered だと新しい接続が来るまで通知されないので、登録し直して通知させる
+     */
+    LOG_DEBUGF("accept budget exhausted (%zu connections)", accepted);
+    actions.registerEvent(Event(listener_.getFd(), Event::kRead));
+    return Ok();
+}
+
+void AcceptHandler::pushAcceptActions(const Context &ctx, ActionQueue &actions, Connection *newConnection) {
     const Event eventToRegister = Event(newConnection->getFd(), Event::kRead);
     /**
      * actions を Server が実行して初めて Context に Connection が含まれるようになる
@@ -24,13 +50,10 @@ IEventHandler::InvokeResult AcceptHandler::invoke(const Context &ctx) {
      */
     const Context newCtx = ctx.withNewValues(eventToRegister, Some(utils::ref(*newConnection)));
 
-    // caller が処理すべき action を返す
-    std::vector<IAction *> actions;
-    actions.push_back(new RegisterEventAction(eventToRegister));
-    actions.push_back(new AddConnectionAction(newConnection));
-    actions.push_back(new RegisterEventHandlerAction(
-        *newConnection, Event::kRead, new ReadRequestHandler(newCtx.getResolver().unwrap())
-    ));
-
-    return Ok(actions);
+    // caller が処理すべき action を積む
+    actions.registerEvent(eventToRegister);
+    actions.addConnection(newConnection);
+    actions.registerEventHandler(
+        newConnection->getFd(), Event::kRead, new ReadRequestHandler(newCtx.getResolver().unwrap())
+    );
 }
@@ -7,12 +7,16 @@
 
 class AcceptHandler : public IEventHandler {
 public:
-    explicit AcceptHandler(Listener &listener);
+    // 1 回の invoke で budget 個まで accept する
+    AcceptHandler(Listener &listener, std::size_t budget);
 
-    InvokeResult invoke(const Context &ctx);
+    InvokeResult invoke(const Context &ctx, ActionQueue &actions);
 
 private:
     Listener &listener_;
+    std::size_t budget_;
+
+    static void pushAcceptActions(const Context &ctx, ActionQueue &actions, Connection *newConnection);
 };
 
 #endif
@@ -0,0 +1,34 @@
+#include "lingering_close_handler.hpp"
+#include "utils/logger.hpp"
+#include <unistd.h>
+
+const utils::Time::Millis LingeringCloseHandler::kTimeoutMs;
+
+IEventHandler::InvokeResult LingeringCloseHandler::invoke(const Context &ctx, ActionQueue &actions) {
+    LOG_DEBUG("start LingeringCloseHandler::invoke");
+
+    const int fd = ctx.getEvent().getFd();
+    // edge-triggered でも通知を取りこぼさないように、読めなくなるまで読む
+    for (std::size_t reads = 0; reads < kMaxReadsPerEvent; ++reads) {
+        char buffer[4096];
+        const ssize_t bytesRead = read(fd, buffer, sizeof(buffer));
+        if (bytesRead == 0) {
+            LOG_DEBUGF("lingering close finished (fd: %d)", fd);
+            close(fd, actions);
+            return Ok();
+        }
+        if (bytesRead == -1) {
+            // 今届いている分はすべて読んだ。エラーならエラーイベントで閉じられる
+            return Ok();
+        }
+    }
+    // 1 つのコネクションがイベントループを占有しないように、登録し直して続きを通知させる
+    actions.registerEvent(Event(fd, Event::kRead));
+    return Ok();
+}
+
+void LingeringCloseHandler::close(const int fd, ActionQueue &actions) {
+    actions.unregisterEvent(Event(fd, Event::kRead | Event::kWrite));
+    actions.unregisterEventHandler(fd, Event::kRead);
+    actions.removeConnection(fd);
+}
@@ -0,0 +1,25 @@
+#ifndef SRC_LIB_CORE_HANDLER_LINGERING_CLOSE_HANDLER_HPP
+#define SRC_LIB_CORE_HANDLER_LINGERING_CLOSE_HANDLER_HPP
+
+#include "event/event_handler.hpp"
+#include "utils/time.hpp"
+
+/**
+ * レスポンスを送り終えて shutdown(SHUT_WR) したコネクションで、クライアントから届くデータを読み捨てる
+ * 読んでいないデータが残ったまま close すると RST が送られ、送信中のレスポンスの末尾がクライアントに捨てられるため
+ * EOF を読んだら閉じる。届き続ける場合も、kTimeoutMs で閉じる (ConnectionRepository::setLingerTimeout)
+ */
+class LingeringCloseHandler : public IEventHandler {
+public:
+    // shutdown してから閉じるまでの時間の上限
+    static const utils::Time::Millis kTimeoutMs = 5000;
+
+    InvokeResult invoke(const Context &ctx, ActionQueue &actions);
+
+private:
+    static const std::size_t kMaxReadsPerEvent = 16;
+
+    static void close(int fd, ActionQueue &actions);
+};
+
+#endif
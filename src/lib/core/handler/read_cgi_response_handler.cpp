@@ -9,65 +9,150 @@
 #include "write_response_body_handler.hpp"
 #include "../../utils/types/option.hpp"
 #include "../../http/request/request_parser.hpp"
+#include "utils/string.hpp"
 #include "utils/types/try.hpp"
 
-IEventHandler::InvokeResult ReadCgiResponseHandler::invoke(const Context &ctx) {
+ReadCgiResponseHandler::~ReadCgiResponseHandler() {
+    if (relay_.get() != NULL && !relay_->isFinished()) {
+        relay_->abort();
+    }
+}
+
+IEventHandler::InvokeResult ReadCgiResponseHandler::invoke(const Context &ctx, ActionQueue &actions) {
     LOG_DEBUG("start ReadCgiResponseHandler::invoke");
 
     Connection &conn = ctx.getConnection().unwrap();
 
-    char buffer[4096];
-    const ssize_t bytesRead = read(conn.getFd(), buffer, sizeof(buffer));
-    if (bytesRead == -1) {
-        LOG_WARN("failed to read CGI response");
-        return Err(error::AppError::kUnknown);
-    }
+    // edge-triggered でも CGI の終了を取りこぼさないように、読めなくなるまで読む
+    for (bool first = true;; first = false) {
+        char buffer[4096];
+        const ssize_t bytesRead = read(conn.getFd(), buffer, sizeof(buffer));
+        if (bytesRead == -1) {
+            if (!first) {
+                // 今届いている分はすべて読んだ
+                return Ok();
+            }
+            LOG_WARN("failed to read CGI response");
+            return Err(error::AppError::kUnknown);
+        }
+
+        if (relay_.get() != NULL) {
+            if (!this->relayBody(actions, conn, buffer, bytesRead)) {
+                return Ok();
+            }
+            continue;
+        }
+
+        if (bytesRead == 0) {
+            // ヘッダーの終わりが見つからないまま CGI が終了した
+            const cgi::Response &cgiRes = TRY(createCgiResponseFromBuffer(responseBuffer_));
+            pushNextActions(actions, conn, clientFd_, this->applyFilter(toHttpResponse(cgiRes)));
+            return Ok();
+        }
 
-    if (bytesRead != 0) {
         // データを蓄積
         LOG_DEBUGF("CGI response: %zd bytes read, total: %zu", bytesRead, responseBuffer_.size());
         responseBuffer_.append(buffer, bytesRead);
-        // まだデータが来る可能性がある
-        return Err(error::kRecoverable);
-    }
+        const std::size_t headerEnd = responseBuffer_.find("\n\n");
+        if (headerEnd == std::string::npos) {
+            continue;
+        }
 
-    const cgi::Response &cgiRes = TRY(createCgiResponseFromBuffer(responseBuffer_));
-    return Ok(makeNextActions(conn, clientFd_, toHttpResponse(cgiRes)));
+        // ヘッダーからレスポンスを作って返し始め、読み込み済みの body から中継する
+        TRY(this->startRelay(actions, headerEnd));
+        const std::string body = responseBuffer_.substr(headerEnd + 2);
+        responseBuffer_.clear();
+        if (!body.empty() && !this->relayBody(actions, conn, body.data(), body.size())) {
+            return Ok();
+        }
+    }
 }
 
-IEventHandler::ErrorHandleResult ReadCgiResponseHandler::onErrorEvent(const Context &, const Event &event) {
+IEventHandler::ErrorHandleResult
+ReadCgiResponseHandler::onErrorEvent(const Context &, const Event &event, ActionQueue &) {
     LOG_WARNF("ReadCgiResponseHandler received an error event %d", event.getTypeFlags());
 
     if (event.getTypeFlags() & Event::kHangUp) {
-        return ErrorHandleResult(false, std::vector<IAction *>());
+        return ErrorHandleResult(false);
     }
 
     return ErrorHandleResult();
 }
 
-std::vector<IAction *>
-ReadCgiResponseHandler::makeNextActions(Connection &conn, const int clientFd, const http::Response &httpResponse) {
-    // クライアントへレスポンスを送信するアクションを作成
-    std::vector<IAction *> actions;
+IEventHandler::InvokeResult ReadCgiResponseHandler::startRelay(ActionQueue &actions, const std::size_t headerEnd) {
+    const cgi::Response cgiRes = TRY(createCgiResponseFromBuffer(responseBuffer_.substr(0, headerEnd + 2)));
+    relay_ = SharedPtr<http::RelayBodySource>(new http::RelayBodySource(getContentLength(cgiRes)));
+
+    LOG_DEBUG("CGI response headers read, start relaying the body");
+    actions.registerEvent(Event(clientFd_, Event::kWrite));
+    actions.registerEventHandler(
+        clientFd_, Event::kWrite, new WriteResponseHandler(this->applyFilter(toStreamingHttpResponse(cgiRes, relay_)))
+    );
+    return Ok();
+}
+
+/**
+ * 読んだ body をクライアントへのレスポンスに追加する (size が 0 なら CGI の出力の終わり)
+ * クライアントの WriteResponseHandler は、データが届くのを待って write イベントの監視を止めていることがあるので、再開させる
+ * 続けて CGI から読んでよければ true を返す
+ */
+bool ReadCgiResponseHandler::relayBody(
+    ActionQueue &actions, Connection &conn, const char *data, const std::size_t size
+) {
+    if (relay_.useCount() == 1) {
+        // クライアントのコネクションが閉じられ、レスポンスが破棄された
+        LOG_DEBUG("client connection closed while relaying CGI response");
+        relay_->abort();
+        closeCgiSocket(actions, conn);
+        return false;
+    }
+
+    bool readMore = true;
+    if (size == 0) {
+        LOG_DEBUG("CGI response fully read");
+        relay_->finish();
+        closeCgiSocket(actions, conn);
+        readMore = false;
+    } else {
+        relay_->append(data, size);
+        if (relay_->isFull()) {
+            // クライアントへの書き込みが追いつくまで、CGI からの読み込みを止める
+            LOG_DEBUG("CGI response relay is full, pause reading");
+            actions.unregisterEvent(Event(conn.getFd(), Event::kRead));
+            relay_->pauseProducer(conn.getFd());
+            readMore = false;
+        }
+    }
+    actions.registerEvent(Event(clientFd_, Event::kWrite));
+    return readMore;
+}
+
+void ReadCgiResponseHandler::pushNextActions(
+    ActionQueue &actions, Connection &conn, const int clientFd, const http::Response &httpResponse
+) {
+    // クライアントへレスポンスを送信するアクションを積む
 
     // CGIソケットのクリーンアップ
-    actions.push_back(new UnregisterEventAction(Event(conn.getFd(), Event::kRead)));
-    actions.push_back(new UnregisterEventHandlerAction(conn, Event::kRead));
-    actions.push_back(new RemoveConnectionAction(conn));
+    closeCgiSocket(actions, conn);
 
     // クライアントへのレスポンス送信
     // clientFd_に対してWriteイベントとハンドラを登録
-    actions.push_back(new RegisterEventAction(Event(clientFd, Event::kWrite)));
+    actions.registerEvent(Event(clientFd, Event::kWrite));
 
     // クライアントへのレスポンス送信
     // NOTE: クライアントConnectionは既にRepositoryに存在しているはず
-    // AddConnectionActionは使わず、既存のConnectionを保持する
-    // RegisterEventHandlerByFdActionを使用してfdで直接ハンドラーを登録
-    actions.push_back(
-        new RegisterEventHandlerByFdAction(clientFd, Event::kWrite, new WriteResponseHandler(httpResponse))
-    );
+    // addConnection は使わず、既存のConnectionを保持する
+    actions.registerEventHandler(clientFd, Event::kWrite, new WriteResponseHandler(httpResponse));
+}
 
-    return actions;
+http::Response ReadCgiResponseHandler::applyFilter(const http::Response &response) const {
+    return filter_ == NULL ? response : filter_->filter(response);
+}
+
+void ReadCgiResponseHandler::closeCgiSocket(ActionQueue &actions, const Connection &conn) {
+    actions.unregisterEvent(Event(conn.getFd(), Event::kRead));
+    actions.unregisterEventHandler(conn.getFd(), Event::kRead);
+    actions.removeConnection(conn.getFd());
 }
 
 http::HttpStatusCode ReadCgiResponseHandler::determineStatusCode(const cgi::Response &response) {
@@ -140,8 +225,22 @@ http::Response ReadCgiResponseHandler::toHttpResponse(const cgi::Response &respo
     if (response.getBody().isSome()) {
         builder.body(response.getBody().unwrap(), statusCode);
     }
+    copyHeaders(builder, response);
+
+    return builder.build();
+}
+
+http::Response ReadCgiResponseHandler::toStreamingHttpResponse(
+    const cgi::Response &response, const SharedPtr<http::IBodySource> &body
+) {
+    http::ResponseBuilder builder;
+    copyHeaders(builder, response);
+    // Content-Length は body の長さから付け直す
+    builder.stream(body, determineStatusCode(response));
+    return builder.build();
+}
 
-    // ヘッダーを設定
+void ReadCgiResponseHandler::copyHeaders(http::ResponseBuilder &builder, const cgi::Response &response) {
     for (std::map<std::string, std::string>::const_iterator it = response.getHeaders().begin();
          it != response.getHeaders().end();
          ++it) {
@@ -149,6 +248,18 @@ http::Response ReadCgiResponseHandler::toHttpResponse(const cgi::Response &respo
         if (it->first == "Status") continue;
         builder.header(it->first, it->second);
     }
+}
 
-    return builder.build();
+// CGI が Content-Length を返していれば、その長さだけ中継する
+Option<std::size_t> ReadCgiResponseHandler::getContentLength(const cgi::Response &response) {
+    const cgi::Headers::const_iterator it = response.getHeaders().find("Content-Length");
+    if (it == response.getHeaders().end()) {
+        return None;
+    }
+    const utils::StoulResult length = utils::stoul(it->second);
+    if (length.isErr()) {
+        LOG_WARNF("invalid Content-Length from CGI: %s", it->second.c_str());
+        return None;
+    }
+    return Some(static_cast<std::size_t>(length.unwrap()));
 }
@@ -4,23 +4,44 @@
 #include "event/event_handler.hpp"
 #include "cgi/response.hpp"
 #include "http/response/response.hpp"
+#include "http/response/response_builder.hpp"
+#include "http/response/response_filter.hpp"
+#include "utils/shared_ptr.hpp"
 
+/**
+ * CGI の出力を読み、クライアントへのレスポンスにする
+ * ヘッダーを読み終えたら、CGI の終了を待たずにレスポンスを返し始め、残りの body は読んだ分から中継する
+ */
 class ReadCgiResponseHandler : public IEventHandler {
 public:
-    explicit ReadCgiResponseHandler(const int clientFd) : clientFd_(clientFd) {}
-    ~ReadCgiResponseHandler() {}
+    explicit ReadCgiResponseHandler(const int clientFd, const http::IResponseFilter *filter = NULL)
+        : clientFd_(clientFd), filter_(filter) {}
+    // body を中継し終える前に破棄された (CGI のタイムアウトなど) 場合は、レスポンスを打ち切る
+    ~ReadCgiResponseHandler();
 
-    InvokeResult invoke(const Context &ctx);
-    ErrorHandleResult onErrorEvent(const Context &ctx, const Event &event);
+    InvokeResult invoke(const Context &ctx, ActionQueue &actions);
+    ErrorHandleResult onErrorEvent(const Context &ctx, const Event &event, ActionQueue &actions);
 
 private:
     std::string responseBuffer_;
     int clientFd_;
+    // クライアントに送る前にレスポンスに適用する (NULL なら何もしない)
+    const http::IResponseFilter *filter_;
+    // ヘッダーを読み終えるまでは NULL
+    SharedPtr<http::RelayBodySource> relay_;
 
-    static std::vector<IAction *> makeNextActions(Connection &conn, int clientFd, const http::Response &httpResponse);
+    InvokeResult startRelay(ActionQueue &actions, std::size_t headerEnd);
+    bool relayBody(ActionQueue &actions, Connection &conn, const char *data, std::size_t size);
+    static void
+    pushNextActions(ActionQueue &actions, Connection &conn, int clientFd, const http::Response &httpResponse);
+    http::Response applyFilter(const http::Response &response) const;
+    static void closeCgiSocket(ActionQueue &actions, const Connection &conn);
+    static void copyHeaders(http::ResponseBuilder &builder, const cgi::Response &response);
+    static Option<std::size_t> getContentLength(const cgi::Response &response);
     static http::HttpStatusCode determineStatusCode(const cgi::Response &response);
     static Result<cgi::Response, error::AppError> createCgiResponseFromBuffer(const std::string &buf);
     static http::Response toHttpResponse(const cgi::Response &response);
+    static http::Response toStreamingHttpResponse(const cgi::Response &response, const SharedPtr<http::IBodySource> &body);
 };
 
 #endif
@@ -1,19 +1,17 @@
 #include "read_request_handler.hpp"
 #include "write_response_body_handler.hpp"
-#include "core/action/action.hpp"
+#include "http/handler/router.hpp"
 #include "http/response/response_builder.hpp"
 #include "utils/logger.hpp"
+#include "utils/string.hpp"
 #include "utils/types/try.hpp"
-
-// http::Response は ServeHttpAction で生成されるので、event handler を生成する関数を渡す
-IEventHandler *writeResponseHandlerFactory(const http::Response &res) {
-    return new WriteResponseHandler(res);
-}
+#include <algorithm>
+#include <cctype>
 
 ReadRequestHandler::ReadRequestHandler(const VirtualServerResolver &vsResolver)
     : resolver_(new ConfigResolver(vsResolver)), reqReader_(*resolver_) {}
 
-IEventHandler::InvokeResult ReadRequestHandler::invoke(const Context &ctx) {
+IEventHandler::InvokeResult ReadRequestHandler::invoke(const Context &ctx, ActionQueue &actions) {
     LOG_DEBUG("start ReadRequestHandler");
     const auto conn = ctx.getConnection().unwrap();
 
@@ -21,36 +19,223 @@ IEventHandler::InvokeResult ReadRequestHandler::invoke(const Context &ctx) {
     ctx.getConnection().unwrap().get().updateActivity();
 
     ReadBuffer &readBuf = conn.get().getReadBuffer();
-    const Result<Option<http::Request>, error::AppError> result = reqReader_.readRequest(readBuf);
+    const http::RequestReader::ReadRequestResult result = this->readRequest(conn.get(), actions);
     if (result.isErr()) {
-        if (result.unwrapErr() == error::kHttpPayloadTooLarge) {
-            http::ResponseBuilder builder;
-            const http::Response res = builder.status(http::kStatusPayloadTooLarge).build();
-
-            std::vector<IAction *> actions;
-            actions.push_back(new RegisterEventAction(Event(ctx.getEvent().getFd(), Event::kWrite)));
-            actions.push_back(new UnregisterEventHandlerAction(ctx.getConnection().unwrap(), Event::kRead));
-            actions.push_back(new RegisterEventHandlerAction(conn, Event::kWrite, new WriteResponseHandler(res)));
-            return Ok(actions);
+        if (conn.get().isIdle() && readBuf.size() == 0) {
+            // keep-alive で待っていたコネクションを、クライアントが閉じた
+            LOG_DEBUGF("connection closed by peer while idle (fd: %d)", conn.get().getFd());
+            actions.unregisterEvent(Event(conn.get().getFd(), Event::kRead | Event::kWrite));
+            actions.unregisterEventHandler(conn.get().getFd(), Event::kRead);
+            actions.removeConnection(conn.get().getFd());
+            return Ok();
         }
-        return Err(result.unwrapErr());
+        return this->onReadError(conn.get(), result.unwrapErr(), actions);
     }
 
+    // 次のリクエストのデータが届いたので、keep-alive のタイムアウトではなくなる
+    conn.get().setIdle(false);
+
     const Option<http::Request> req = result.unwrap();
     if (req.isNone()) {
-        // read は高々 1 回なので、パースまで完了しなかった
+        // 届いている分はすべて読んだが、パースまで完了しなかった
+        // read の上限に達した場合は登録し直しているので、Err にして actions を捨ててはいけない
         LOG_DEBUG("request is not fully read");
-        return Err(error::kRecoverable);
+        return Ok();
+    }
+
+    this->serveRequests(ctx, req.unwrap(), actions);
+    return Ok();
+}
+
+IEventHandler::InvokeResult ReadRequestHandler::invokeBuffered(const Context &ctx, ActionQueue &actions) {
+    LOG_DEBUG("start ReadRequestHandler::invokeBuffered");
+    Connection &conn = ctx.getConnection().unwrap();
+    conn.updateActivity();
+
+    const http::RequestReader::ReadRequestResult result = reqReader_.readBufferedRequest(conn.getReadBuffer());
+    if (result.isErr()) {
+        return this->onReadError(conn, result.unwrapErr(), actions);
+    }
+
+    const Option<http::Request> req = result.unwrap();
+    if (req.isNone()) {
+        // リクエストの途中までしか届いていないので、続きは read イベントを待って読む
+        LOG_DEBUG("pipelined request is not fully read");
+        const uint32_t writeFlag = conn.getResponseQueue().empty() ? 0 : Event::kWrite;
+        actions.registerEvent(Event(conn.getFd(), Event::kRead | writeFlag));
+        return Ok();
+    }
+
+    this->serveRequests(ctx, req.unwrap(), actions);
+    return Ok();
+}
+
+/**
+ * リクエストが揃うか、ソケットから読めなくなるまで読む
+ * edge-triggered では、届いているデータを読み残すと次の通知が来ないため
+ * 1 つのコネクションがイベントループを占有しないように read の回数には上限を設け、超えたら登録し直して通知させる
+ */
+http::RequestReader::ReadRequestResult ReadRequestHandler::readRequest(Connection &conn, ActionQueue &actions) {
+    for (std::size_t reads = 0; reads < kMaxReadsPerEvent; ++reads) {
+        const http::RequestReader::ReadRequestResult result = reqReader_.readRequest(conn.getReadBuffer());
+        if (result.isErr()) {
+            // 2 回目以降の read の失敗は、届いている分を読み切った (EAGAIN) とみなす
+            if (reads > 0 && result.unwrapErr() == error::kIOUnknown) {
+                return Ok(None);
+            }
+            return result;
+        }
+        if (result.unwrap().isSome()) {
+            return result;
+        }
+    }
+    LOG_DEBUGF("read budget exhausted (fd: %d)", conn.getFd());
+    const uint32_t writeFlag = conn.getResponseQueue().empty() ? 0 : Event::kWrite;
+    actions.registerEvent(Event(conn.getFd(), Event::kRead | writeFlag));
+    return Ok(None);
+}
+
+IEventHandler::InvokeResult
+ReadRequestHandler::onReadError(Connection &conn, const error::AppError err, ActionQueue &actions) {
+    if (err != error::kHttpPayloadTooLarge) {
+        return Err(err);
+    }
+
+    // body を読み切っていないので、レスポンスを返したら閉じる
+    conn.disableKeepAlive();
+    http::ResponseBuilder builder;
+    const http::Response res = builder.status(http::kStatusPayloadTooLarge).build();
+
+    actions.registerEvent(Event(conn.getFd(), Event::kWrite));
+    actions.unregisterEventHandler(conn.getFd(), Event::kRead);
+    actions.registerEventHandler(conn.getFd(), Event::kWrite, new WriteResponseHandler(res));
+    return Ok();
+}
+
+/**
+ * バッファに揃っているリクエストを順に処理し、レスポンスをコネクションのキューに積む
+ * まとめて積んだレスポンスは、WriteResponseHandler が writev でまとめて書き込む
+ *
+ * CGI はレスポンスが非同期に届くので、そこで止める (後続のリクエストのレスポンスが先に書き込まれないように)
+ * キューが深くなりすぎた場合も止める (WriteResponseHandler が low watermark を下回ったら再開する)
+ * 残りのリクエストは、書き込みが進んだ後に ReadBuffer から読まれる
+ */
+void ReadRequestHandler::serveRequests(const Context &ctx, const http::Request &firstReq, ActionQueue &actions) {
+    Connection &conn = ctx.getConnection().unwrap();
+    ResponseQueue &responses = conn.getResponseQueue();
+    const int fd = conn.getFd();
+
+    Option<http::Request> req = Some(firstReq);
+    while (req.isSome()) {
+        LOG_DEBUGF("HTTP request parsed");
+        conn.beginRequest(isKeepAliveRequested(req.unwrap()), req.unwrap().getHttpVersion() != "HTTP/1.0");
+
+        if (!serveFromHotCache(ctx, req.unwrap())) {
+            const Either<IAction *, http::Response> resOrAction = serve(ctx, req.unwrap());
+            if (resOrAction.isLeft()) {
+                LOG_DEBUG("ReadRequestHandler: action is returned");
+                // CGI の実行中は、コネクションのイベント・handler は解除される
+                actions.unregisterEventHandler(fd, Event::kRead);
+                actions.push(resOrAction.unwrapLeft());
+                return;
+            }
+            WriteResponseHandler::enqueue(conn, resOrAction.unwrapRight());
+        }
+
+        if (!conn.isKeepAlive() || responses.size() >= kMaxPipelinedRequests || responses.isAboveHighWatermark()) {
+            // 閉じるか、レスポンスが溜まりすぎている。残りは書き込みが進んでから読む
+            break;
+        }
+
+        const http::RequestReader::ReadRequestResult next = reqReader_.readBufferedRequest(conn.getReadBuffer());
+        if (next.isErr()) {
+            // ここまでのレスポンスを返してから閉じる
+            conn.disableKeepAlive();
+            if (next.unwrapErr() == error::kHttpPayloadTooLarge) {
+                http::ResponseBuilder builder;
+                const http::Response res = builder.status(http::kStatusPayloadTooLarge).build();
+                WriteResponseHandler::enqueue(conn, res);
+            }
+            break;
+        }
+        req = next.unwrap();
+    }
+
+    if (conn.isKeepAlive() && reqReader_.isReadingRequest()) {
+        // 次のリクエストを途中まで読んでいるので、この handler のまま書き込みと並行して続きを読む
+        actions.registerEvent(Event(fd, Event::kRead | Event::kWrite));
+        actions.registerEventHandler(
+            fd, Event::kWrite, new WriteResponseHandler(WriteResponseHandler::kReaderActive)
+        );
+        return;
     }
 
-    LOG_DEBUGF("HTTP request parsed");
+    actions.registerEvent(Event(fd, Event::kWrite));
+    actions.unregisterEventHandler(fd, Event::kRead);
+    actions.registerEventHandler(fd, Event::kWrite, new WriteResponseHandler());
+}
 
-    std::vector<IAction *> actions;
-    actions.push_back(new RegisterEventAction(Event(ctx.getEvent().getFd(), Event::kWrite)));
-    actions.push_back(new UnregisterEventHandlerAction(ctx.getConnection().unwrap(), Event::kRead));
-    actions.push_back(new ServeHttpAction(ctx, req.unwrap(), writeResponseHandlerFactory));
+Either<IAction *, http::Response> ReadRequestHandler::serve(const Context &ctx, const http::Request &req) {
+    // Host ヘッダーは必須なので存在するはず
+    const std::string hostHeader = req.getHeader("Host").unwrap();
+    // accept 後は resolver は存在するはず
+    const Option<Ref<VirtualServer> > vs = ctx.getResolver().unwrap().resolve(hostHeader);
 
-    return Ok(actions);
+    // accept したので Connection, VirtualServer は存在するはず
+    const http::RequestContext reqContext(req, ctx.getConnection().unwrap());
+    return vs.unwrap().get().getRouter().serve(reqContext);
+}
+
+/**
+ * HotContentCache にあるファイルなら、Router を通さずにキャッシュしたレスポンスを積んで true を返す
+ * 条件付きリクエストと Range リクエストは、ファイルの stat が必要なので StaticFileHandler に任せる
+ */
+bool ReadRequestHandler::serveFromHotCache(const Context &ctx, const http::Request &req) {
+    if (req.getMethod() != http::kMethodGet || req.getHeader("Range").isSome() || req.getHeader("If-Range").isSome() ||
+        req.getHeader("If-None-Match").isSome() || req.getHeader("If-Modified-Since").isSome()) {
+        return false;
+    }
+    const Option<Ref<VirtualServer> > vs = ctx.getResolver().unwrap().resolve(req.getHeader("Host").unwrap());
+    http::HotContentCache *cache = vs.unwrap().get().findHotContentCache(req.getRequestTarget());
+    if (cache == NULL) {
+        return false;
+    }
+    const http::HotContentCache::Content *content = cache->lookup(req.getRequestTarget());
+    if (content == NULL) {
+        return false;
+    }
+
+    LOG_INFOF("<-- GET %s", req.getRequestTarget().c_str());
+    WriteResponseHandler::enqueueCached(ctx.getConnection().unwrap(), *content);
+    LOG_INFOF("--> GET %s 200 (cached)", req.getRequestTarget().c_str());
+    return true;
+}
+
+/**
+ * HTTP/1.1 はデフォルトで keep-alive し、Connection: close で閉じる
+ * HTTP/1.0 は Connection: keep-alive がある場合のみ keep-alive する
+ */
+bool ReadRequestHandler::isKeepAliveRequested(const http::Request &req) {
+    bool hasClose = false;
+    bool hasKeepAlive = false;
+    const Option<std::string> connectionHeader = req.getHeader("Connection");
+    if (connectionHeader.isSome()) {
+        const std::vector<std::string> tokens = utils::split(connectionHeader.unwrap(), ',');
+        for (std::vector<std::string>::const_iterator it = tokens.begin(); it != tokens.end(); ++it) {
+            std::string token = utils::trim(*it);
+            std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+            hasClose = hasClose || token == "close";
+            hasKeepAlive = hasKeepAlive || token == "keep-alive";
+        }
+    }
+
+    if (hasClose) {
+        return false;
+    }
+    if (req.getHttpVersion() == "HTTP/1.0") {
+        return hasKeepAlive;
+    }
+    return true;
 }
 
 ConfigResolver::ConfigResolver(const VirtualServerResolver &vsResolver) : resolver_(vsResolver) {}
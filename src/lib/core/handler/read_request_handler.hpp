@@ -3,17 +3,39 @@
 
 #include "event/event_handler.hpp"
 #include "http/request/reader/request_reader.hpp"
+#include "http/response/response.hpp"
+#include "utils/types/either.hpp"
 #include "../virtual_server_resolver.hpp"
 #include <memory>
 
 class ReadRequestHandler : public IEventHandler {
 public:
     explicit ReadRequestHandler(const VirtualServerResolver &vsResolver);
-    InvokeResult invoke(const Context &ctx);
+    InvokeResult invoke(const Context &ctx, ActionQueue &actions);
+
+    /**
+     * read せずに、ReadBuffer に残っているリクエスト (パイプライニング) を処理する
+     * レスポンスを書き終えた WriteResponseHandler が、この handler を登録するときに呼ぶ
+     */
+    InvokeResult invokeBuffered(const Context &ctx, ActionQueue &actions);
+
+    // クライアントがレスポンスの後もコネクションを使い続けたいか (HTTP のバージョンと Connection ヘッダーから決める)
+    static bool isKeepAliveRequested(const http::Request &req);
 
 private:
+    // 書き込みが終わっていないレスポンスがこれだけ溜まったら、次のリクエストは読まない
+    static const std::size_t kMaxPipelinedRequests = 16;
+    // 1 回のイベントで read する回数の上限
+    static const std::size_t kMaxReadsPerEvent = 16;
+
     std::auto_ptr<http::IConfigResolver> resolver_; // RequestReader に渡す参照先として必要
     http::RequestReader reqReader_;
+
+    http::RequestReader::ReadRequestResult readRequest(Connection &conn, ActionQueue &actions);
+    InvokeResult onReadError(Connection &conn, error::AppError err, ActionQueue &actions);
+    void serveRequests(const Context &ctx, const http::Request &firstReq, ActionQueue &actions);
+    static Either<IAction *, http::Response> serve(const Context &ctx, const http::Request &req);
+    static bool serveFromHotCache(const Context &ctx, const http::Request &req);
 };
 
 class ConfigResolver : public http::IConfigResolver {
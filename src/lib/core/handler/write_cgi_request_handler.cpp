@@ -10,7 +10,7 @@ WriteCgiRequestBodyHandler::WriteCgiRequestBodyHandler(const std::string &cgiBod
 
 WriteCgiRequestBodyHandler::~WriteCgiRequestBodyHandler() {}
 
-IEventHandler::InvokeResult WriteCgiRequestBodyHandler::invoke(const Context &ctx) {
+IEventHandler::InvokeResult WriteCgiRequestBodyHandler::invoke(const Context &ctx, ActionQueue &actions) {
     LOG_DEBUG("start WriteCgiRequestBodyHandler::invoke");
 
     Connection &conn = ctx.getConnection().unwrap();
@@ -21,10 +21,9 @@ IEventHandler::InvokeResult WriteCgiRequestBodyHandler::invoke(const Context &ct
         LOG_DEBUG("CGI request body fully written");
         shutdown(conn.getFd(), SHUT_WR);
 
-        std::vector<IAction *> actions;
-        actions.push_back(new UnregisterEventAction(Event(conn.getFd(), Event::kWrite)));
-        actions.push_back(new UnregisterEventHandlerAction(conn, Event::kWrite));
-        return Ok(actions);
+        actions.unregisterEvent(Event(conn.getFd(), Event::kWrite));
+        actions.unregisterEventHandler(conn.getFd(), Event::kWrite);
+        return Ok();
     }
 
     errno = 0;
@@ -33,22 +32,20 @@ IEventHandler::InvokeResult WriteCgiRequestBodyHandler::invoke(const Context &ct
         // 子が読み込みを待たずに終了すると、EPIPE が起こり得る
         LOG_DEBUG("write failed with EPIPE, likely because the CGI process has terminated");
         shutdown(conn.getFd(), SHUT_WR);
-        std::vector<IAction *> actions;
-        actions.push_back(new UnregisterEventAction(Event(conn.getFd(), Event::kWrite)));
-        actions.push_back(new UnregisterEventHandlerAction(conn, Event::kWrite));
-        return Ok(actions);
+        actions.unregisterEvent(Event(conn.getFd(), Event::kWrite));
+        actions.unregisterEventHandler(conn.getFd(), Event::kWrite);
+        return Ok();
     }
 
     if (bytesWritten == -1) {
         LOG_WARN("failed to write CGI request body");
         // エラー時のクリーンアップ
-        std::vector<IAction *> actions;
-        actions.push_back(new UnregisterEventAction(Event(conn.getFd(), Event::kRead)));
-        actions.push_back(new UnregisterEventAction(Event(conn.getFd(), Event::kWrite)));
-        actions.push_back(new UnregisterEventHandlerAction(conn, Event::kRead));
-        actions.push_back(new UnregisterEventHandlerAction(conn, Event::kWrite));
-        actions.push_back(new RemoveConnectionAction(conn));
-        return Ok(actions);
+        actions.unregisterEvent(Event(conn.getFd(), Event::kRead));
+        actions.unregisterEvent(Event(conn.getFd(), Event::kWrite));
+        actions.unregisterEventHandler(conn.getFd(), Event::kRead);
+        actions.unregisterEventHandler(conn.getFd(), Event::kWrite);
+        actions.removeConnection(conn.getFd());
+        return Ok();
     }
 
     bytesWritten_ += bytesWritten;
@@ -59,10 +56,9 @@ IEventHandler::InvokeResult WriteCgiRequestBodyHandler::invoke(const Context &ct
         LOG_DEBUG("CGI request body fully written");
         shutdown(conn.getFd(), SHUT_WR);
 
-        std::vector<IAction *> actions;
-        actions.push_back(new UnregisterEventAction(Event(conn.getFd(), Event::kWrite)));
-        actions.push_back(new UnregisterEventHandlerAction(conn, Event::kWrite));
-        return Ok(actions);
+        actions.unregisterEvent(Event(conn.getFd(), Event::kWrite));
+        actions.unregisterEventHandler(conn.getFd(), Event::kWrite);
+        return Ok();
     }
 
     // まだ書き込むデータが残っている
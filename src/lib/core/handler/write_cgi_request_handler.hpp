@@ -8,7 +8,7 @@ public:
     explicit WriteCgiRequestBodyHandler(const std::string &cgiBody);
     ~WriteCgiRequestBodyHandler();
 
-    InvokeResult invoke(const Context &ctx);
+    InvokeResult invoke(const Context &ctx, ActionQueue &actions);
 
 private:
     std::string body_;
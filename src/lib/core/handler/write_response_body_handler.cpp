@@ -1,33 +1,132 @@
 #include "write_response_body_handler.hpp"
+#include "read_request_handler.hpp"
 #include "core/action/action.hpp"
+#include "http/response/response_serializer.hpp"
 #include "utils/logger.hpp"
-#include <cerrno>
-#include <unistd.h>
+#include "utils/string.hpp"
+#include "utils/types/try.hpp"
+
+WriteResponseHandler::WriteResponseHandler(const ReaderState reader) : response_(None), reader_(reader) {}
 
 WriteResponseHandler::WriteResponseHandler(const http::Response &response)
-    : responseMessage_(response.toString()), totalBytesWritten_(0) {}
+    : response_(Some(response)), reader_(kReaderPaused) {}
 
-IEventHandler::InvokeResult WriteResponseHandler::invoke(const Context &ctx) {
+IEventHandler::InvokeResult WriteResponseHandler::invoke(const Context &ctx, ActionQueue &actions) {
     LOG_DEBUG("start WriteResponseHandler::invoke");
 
     Connection &conn = ctx.getConnection().unwrap();
-    const size_t bytesToWrite = responseMessage_.size() - totalBytesWritten_;
+    ResponseQueue &responses = conn.getResponseQueue();
+    if (response_.isSome()) {
+        enqueue(conn, response_.unwrap());
+        response_ = None;
+    }
 
-    errno = 0;
-    const ssize_t bytesWritten = write(conn.getFd(), responseMessage_.c_str() + totalBytesWritten_, bytesToWrite);
-    if (bytesWritten == -1) {
-        LOG_WARN("failed to write response");
-        return Err(error::kIOUnknown);
+    const bool flushed = TRY(responses.flush(conn.getFd()));
+    const Option<int> producer = responses.takeResumableProducer();
+    if (producer.isSome()) {
+        // body の中継元のバッファに空きができたので、止めていた読み込みを再開させる
+        actions.push(new ResumeProducerAction(producer.unwrap()));
+    }
+    if (!flushed && responses.isWaitingForBody()) {
+        // body のデータがまだ届いていない。届いたら生産者が write イベントの監視を再開する
+        LOG_DEBUG("waiting for response body");
+        actions.unregisterEvent(Event(conn.getFd(), Event::kWrite));
+        return Ok();
+    }
+    if (!flushed) {
+        // 送信バッファがいっぱい。write イベントの監視は続けて、次の write イベントで続きを書く
+        LOG_DEBUGF("response partially written, %zu bytes left", responses.bytes());
+        if (reader_ == kReaderPaused && conn.isKeepAlive() && responses.isBelowLowWatermark()
+            && !responses.isStreaming() && conn.getReadBuffer().size() > 0) {
+            // 書き込み待ちが減ったので、止めていたパイプライニングのリクエストの処理を再開する
+            return this->resumeReading(ctx, actions);
+        }
+        return Ok();
     }
-    totalBytesWritten_ += bytesWritten;
 
     LOG_DEBUG("response written");
 
-    std::vector<IAction *> actions;
-    actions.push_back(new UnregisterEventAction(ctx.getEvent()));
-    actions.push_back(new UnregisterEventHandlerAction(conn, Event::kRead));
-    actions.push_back(new UnregisterEventHandlerAction(conn, Event::kWrite));
-    actions.push_back(new RemoveConnectionAction(ctx.getConnection().unwrap()));
+    if (!conn.isKeepAlive()) {
+        // 読んでいないリクエストが残っているかもしれないので、すぐには閉じない (RST でレスポンスが失われる)
+        actions.lingeringClose(conn.getFd());
+        return Ok();
+    }
+
+    actions.unregisterEventHandler(conn.getFd(), Event::kWrite);
+    if (reader_ == kReaderActive) {
+        // ReadRequestHandler がリクエストの続きを待っている
+        // registerEvent は監視するイベントを上書きするので、write の監視は外れる
+        actions.registerEvent(Event(conn.getFd(), Event::kRead));
+        return Ok();
+    }
+    if (conn.getReadBuffer().size() > 0) {
+        // パイプライニングされたリクエストがすでに読み込まれている。read イベントは来ないので、ここで処理する
+        return this->resumeReading(ctx, actions);
+    }
+
+    // コネクションを閉じずに、新しい ReadRequestHandler で次のリクエストを待つ
+    actions.registerEvent(Event(conn.getFd(), Event::kRead));
+    actions.registerEventHandler(conn.getFd(), Event::kRead, new ReadRequestHandler(ctx.getResolver().unwrap()));
+    actions.keepAlive(conn.getFd());
+    return Ok();
+}
+
+// 新しい ReadRequestHandler を登録して、ReadBuffer に残っているリクエストを処理させる
+IEventHandler::InvokeResult WriteResponseHandler::resumeReading(const Context &ctx, ActionQueue &actions) {
+    ReadRequestHandler *next = new ReadRequestHandler(ctx.getResolver().unwrap());
+    actions.registerEventHandler(ctx.getConnection().unwrap().get().getFd(), Event::kRead, next);
+    // next がリクエストの途中まで読んだ場合は、この handler のまま書き込みを続ける
+    reader_ = kReaderActive;
+    return next->invokeBuffered(ctx, actions);
+}
+
+void WriteResponseHandler::enqueue(Connection &conn, const http::Response &response) {
+    ResponseQueue &responses = conn.getResponseQueue();
+    http::Headers headers = response.getHeaders();
+
+    if (response.getBodySource().isSome()) {
+        const SharedPtr<http::IBodySource> &source = response.getBodySource().unwrap();
+        const Option<std::size_t> length = source->getLength();
+        const bool chunked = length.isNone() && conn.isChunkedAccepted();
+        if (length.isSome()) {
+            headers["Content-Length"] = utils::toString(length.unwrap());
+        } else if (chunked) {
+            headers.erase("Content-Length");
+            headers["Transfer-Encoding"] = "chunked";
+        } else {
+            // HTTP/1.0 のクライアントには、コネクションを閉じることで body の終わりを示す
+            headers.erase("Content-Length");
+            conn.disableKeepAlive();
+        }
+        headers["Connection"] = conn.isKeepAlive() ? "keep-alive" : "close";
+        responses.pushStream(serializeHeader(response, headers), source, chunked);
+        return;
+    }
+
+    const bool keepAlive = conn.isKeepAlive();
+    headers["Connection"] = keepAlive ? "keep-alive" : "close";
+    // keep-alive ではメッセージの終わりを Content-Length で示す必要がある (CGI のレスポンスには付いていないことがある)
+    if (response.getFileBody().isSome()) {
+        // ファイルの body は読み込まずに、fd のまま sendfile で送る
+        const http::FileBody &file = response.getFileBody().unwrap();
+        headers["Content-Length"] = utils::toString(file.getLength());
+        responses.pushFile(serializeHeader(response, headers), file.getFd(), file.getOffset(), file.getLength());
+        return;
+    }
+
+    const std::string &body = response.getBody().isSome() ? response.getBody().unwrap() : "";
+    if (headers.find("Content-Length") == headers.end() && !http::isBodylessStatus(response.getStatusCode())) {
+        headers["Content-Length"] = utils::toString(body.size());
+    }
+    responses.push(serializeHeader(response, headers), body);
+}
+
+void WriteResponseHandler::enqueueCached(Connection &conn, const http::HotContentCache::Content &content) {
+    conn.getResponseQueue().push(
+        http::ResponseSerializer::completeHeader(content.headerPrefix, conn.isKeepAlive()), content.body
+    );
+}
 
-    return Ok(actions);
+std::string WriteResponseHandler::serializeHeader(const http::Response &response, const http::Headers &headers) {
+    return http::ResponseSerializer::serializeHeader(response.getStatusCode(), headers, response.getHttpVersion());
 }
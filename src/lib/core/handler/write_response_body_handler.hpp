@@ -2,16 +2,45 @@
 #define SRC_LIB_CORE_HANDLER_WRITE_RESPONSE_HANDLER_HPP
 
 #include "event/event_handler.hpp"
+#include "http/hot_content_cache.hpp"
 #include "http/response/response.hpp"
 
+/**
+ * コネクションの ResponseQueue に溜まったレスポンスを書き込む
+ * すべて書き終えるまで write イベントを待ち続け、部分的な書き込みは次の write イベントで再開する
+ * 書き終えたら、keep-alive なら次のリクエストの読み込みに戻り、そうでなければ閉じる
+ */
 class WriteResponseHandler : public IEventHandler {
 public:
+    // 書き込み中に ReadRequestHandler が登録されているか
+    enum ReaderState {
+        // 登録されていない。キューが low watermark を下回ったら、新しい ReadRequestHandler で再開する
+        kReaderPaused,
+        // リクエストの途中まで読んでいるので、登録されたまま
+        kReaderActive
+    };
+
+    // ResponseQueue にすでに積まれているレスポンスを書き込む
+    explicit WriteResponseHandler(ReaderState reader = kReaderPaused);
+    // response をキューの末尾に積んでから書き込む
     explicit WriteResponseHandler(const http::Response &response);
-    InvokeResult invoke(const Context &ctx);
+    InvokeResult invoke(const Context &ctx, ActionQueue &actions);
+
+    /**
+     * Connection, Content-Length (または Transfer-Encoding) ヘッダーを付けて、ヘッダーと body を別々にキューに積む
+     * 長さの分からない body を chunked で送れない場合は、コネクションを閉じて body の終わりを示す
+     */
+    static void enqueue(Connection &conn, const http::Response &response);
+    // HotContentCache のレスポンスに Date, Connection ヘッダーを付けてキューに積む
+    static void enqueueCached(Connection &conn, const http::HotContentCache::Content &content);
 
 private:
-    std::string responseMessage_;
-    size_t totalBytesWritten_;
+    // Connection ヘッダーはコネクションの状態で決まるので、最初の invoke でキューに積む
+    Option<http::Response> response_;
+    ReaderState reader_;
+
+    InvokeResult resumeReading(const Context &ctx, ActionQueue &actions);
+    static std::string serializeHeader(const http::Response &response, const http::Headers &headers);
 };
 
 #endif
@@ -1,11 +1,21 @@
 #include "self_pipe_sigchld.hpp"
 #include "utils/fd.hpp"
+#include "utils/logger.hpp"
+#include <cerrno>
 #include <unistd.h>
 
-SelfPipeSigchld *SelfPipeSigchld::instance_ = NULL;
+const std::size_t SelfPipeSigchld::kMaxInstances;
+int SelfPipeSigchld::writeFds_[kMaxInstances];
+volatile sig_atomic_t SelfPipeSigchld::instanceCount_ = 0;
+sig_t SelfPipeSigchld::prevSigchldHandler_ = SIG_DFL;
+sig_t SelfPipeSigchld::prevSigpipeHandler_ = SIG_DFL;
+
+SelfPipeSigchld::SelfPipeSigchld() : readFd_(-1), writeFd_(-1) {
+    if (static_cast<std::size_t>(instanceCount_) >= kMaxInstances) {
+        LOG_ERROR("too many SelfPipeSigchld instances");
+        return;
+    }
 
-SelfPipeSigchld::SelfPipeSigchld()
-    : readFd_(-1), writeFd_(-1), prevSigchldHandler_(SIG_DFL), prevSigpipeHandler_(SIG_DFL) {
     int pipeFds[2];
     if (pipe(pipeFds) == -1) {
         return;
@@ -19,23 +29,38 @@ SelfPipeSigchld::SelfPipeSigchld()
     utils::setCloseOnExec(readFd_);
     utils::setCloseOnExec(writeFd_);
 
-    // シングルトン的に、このインスタンスをハンドラから参照する
-    instance_ = this;
+    // handler が読む前に fd を書いてから、数を増やす
+    writeFds_[instanceCount_] = writeFd_;
+    instanceCount_ = instanceCount_ + 1;
 
-    prevSigchldHandler_ = signal(SIGCHLD, &SelfPipeSigchld::handler);
-    prevSigpipeHandler_ = signal(SIGPIPE, SIG_IGN);
+    // 最初のインスタンスだけが handler を設定する
+    if (instanceCount_ == 1) {
+        prevSigchldHandler_ = signal(SIGCHLD, &SelfPipeSigchld::handler);
+        prevSigpipeHandler_ = signal(SIGPIPE, SIG_IGN);
+    }
 }
 
 SelfPipeSigchld::~SelfPipeSigchld() {
-    signal(SIGCHLD, prevSigchldHandler_);
-    signal(SIGPIPE, prevSigpipeHandler_);
+    if (writeFd_ != -1) {
+        // 末尾の fd で埋めて詰める
+        for (sig_atomic_t i = 0; i < instanceCount_; ++i) {
+            if (writeFds_[i] == writeFd_) {
+                writeFds_[i] = writeFds_[instanceCount_ - 1];
+                instanceCount_ = instanceCount_ - 1;
+                break;
+            }
+        }
+        if (instanceCount_ == 0) {
+            signal(SIGCHLD, prevSigchldHandler_);
+            signal(SIGPIPE, prevSigpipeHandler_);
+        }
+    }
     if (readFd_ != -1) {
         close(readFd_);
     }
     if (writeFd_ != -1) {
         close(writeFd_);
     }
-    instance_ = NULL;
 }
 
 void SelfPipeSigchld::registerWithEventNotifier(IEventNotifier *notifier) const {
@@ -58,10 +83,13 @@ int SelfPipeSigchld::getReadFd() const {
     return readFd_;
 }
 
-// signal handler から pipe 経由で通知を送る
+// signal handler から pipe 経由で、すべてのイベントループに通知を送る
 void SelfPipeSigchld::handler(int) {
-    if (instance_ && instance_->writeFd_ >= 0) {
-        const char c = 1;
-        write(instance_->writeFd_, &c, 1);
+    // 割り込まれた処理が errno を見るかもしれないので、write で上書きされないように戻す
+    const int savedErrno = errno;
+    const char c = 1;
+    for (sig_atomic_t i = 0; i < instanceCount_; ++i) {
+        write(writeFds_[i], &c, 1);
     }
+    errno = savedErrno;
 }
@@ -2,8 +2,14 @@
 #define SRC_LIB_CORE_WEBSERV_SELF_PIPE_SIGCHLD_HPP
 
 #include "event/event_notifier.hpp"
+#include <cstddef>
 #include <sys/signal.h>
 
+/**
+ * SIGCHLD を self-pipe で通知する
+ * イベントループごとにインスタンスを作り、signal handler はすべての pipe に書き込む
+ * NOTE: 生成・破棄は worker スレッドの起動前・終了後に行うこと (handler と配列の更新を排他できない)
+ */
 class SelfPipeSigchld {
 public:
     SelfPipeSigchld();
@@ -14,11 +20,16 @@ public:
     int getReadFd() const;
 
 private:
+    static const std::size_t kMaxInstances = 64;
+
     int readFd_;
     int writeFd_;
-    sig_t prevSigchldHandler_;
-    sig_t prevSigpipeHandler_;
-    static SelfPipeSigchld *instance_;
+
+    // signal handler から参照するので、async-signal-safe に読める固定長の配列にする
+    static int writeFds_[kMaxInstances];
+    static volatile sig_atomic_t instanceCount_;
+    static sig_t prevSigchldHandler_;
+    static sig_t prevSigpipeHandler_;
 
     static void handler(int signum);
 };
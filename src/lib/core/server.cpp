@@ -1,51 +1,59 @@
 #include "server.hpp"
-#include "action/action.hpp"
-#include "event/event_notifier.hpp"
-#include "./handler/accept_handler.hpp"
-#include "handler/write_response_body_handler.hpp"
-#include "http/response/response_builder.hpp"
-#include "transport/listener.hpp"
 #include "utils/logger.hpp"
 #include "utils/time.hpp"
-#include <map>
-#include <signal.h>
+#include <pthread.h>
+#include <cerrno>
 #include <cstring>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
 
-Server::Server(const config::Config &config) : config_(config) {
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
+Server::Server(const config::Config &config) : config_(config), pendingRespawns_(0), respawnDeadline_(0) {
     const config::ServerContextList &servers = config_.getServers();
-    // キーは (host, port)。本当は値を Address にしたいが、デフォルトコンストラクタがないので無理だった。
-    std::map<std::pair<std::string, std::string>, Listener *> listenerMap;
-    listeners_.reserve(servers.size()); // 重複があると必要な要素はこれより少ない
+    const std::size_t workers = config_.getMainContext().getWorkers();
     virtualServers_.reserve(servers.size());
-    for (config::ServerContextList::const_iterator it = servers.begin(); it != servers.end(); ++it) {
-        const std::pair<std::string, std::string> bindPair =
-            std::make_pair(it->getHost(), utils::toString(it->getPort()));
-
-        // 同じホスト、ポートの組は listen しない
-        Listener *listener = listenerMap[bindPair];
-        if (listener == NULL) {
-            listener = new Listener(bindPair.first, bindPair.second);
-            listenerMap[bindPair] = listener;
-
-            const int fd = listener->getFd();
-            listeners_.push_back(listener);
-            listenerFds_.insert(fd);
+    listenerSets_.resize(workers);
+
+    /**
+     * Listener は worker スレッドごとに作る
+     * SO_REUSEPORT で同じアドレスに bind しているので、カーネルが accept を worker に振り分ける
+     * worker プロセスを使う場合も、bind はマスタープロセスで 1 回だけ行い、fork で引き継ぐ
+     */
+    for (std::size_t worker = 0; worker < workers; ++worker) {
+        // キーは (host, port)。本当は値を Address にしたいが、デフォルトコンストラクタがないので無理だった。
+        std::map<std::pair<std::string, std::string>, Listener *> listenerMap;
+        ListenerList &listeners = listenerSets_[worker];
+        listeners.reserve(servers.size()); // 重複があると必要な要素はこれより少ない
+        for (config::ServerContextList::const_iterator it = servers.begin(); it != servers.end(); ++it) {
+            const std::pair<std::string, std::string> bindPair =
+                std::make_pair(it->getHost(), utils::toString(it->getPort()));
+
+            // 同じホスト、ポートの組は listen しない
+            Listener *listener = listenerMap[bindPair];
+            if (listener == NULL) {
+                listener = new Listener(bindPair.first, bindPair.second);
+                listenerMap[bindPair] = listener;
+                listeners.push_back(listener);
+            }
 
-            // Listener の fd に対する read を待ち、AcceptHandler で処理する
-            state_.getEventNotifier().registerEvent(Event(fd, Event::kRead));
-            // TODO: read 待ちでええんか?
-            state_.getEventHandlerRepository().set(fd, Event::kRead, new AcceptHandler(*listener));
+            // Virtual Server は全 worker で共有するので、1 回だけ作成
+            if (worker == 0) {
+                VirtualServer *vs = new VirtualServer(*it, listener->getBindAddress());
+                virtualServers_.push_back(vs);
+            }
         }
-
-        // Virtual Server を作成
-        VirtualServer *vs = new VirtualServer(*it, listener->getBindAddress());
-        virtualServers_.push_back(vs);
     }
 }
 
 Server::~Server() {
-    for (std::vector<Listener *>::const_iterator it = listeners_.begin(); it != listeners_.end(); ++it) {
-        delete *it;
+    for (std::vector<ListenerList>::const_iterator it = listenerSets_.begin(); it != listenerSets_.end(); ++it) {
+        for (ListenerList::const_iterator jt = it->begin(); jt != it->end(); ++jt) {
+            delete *jt;
+        }
     }
     for (VirtualServerList::const_iterator it = virtualServers_.begin(); it != virtualServers_.end(); ++it) {
         delete *it;
@@ -53,241 +61,214 @@ Server::~Server() {
 }
 
 void Server::start() {
-    VirtualServerResolverFactory vsResolverFactory(virtualServers_);
-
-    while (true) {
-        const IEventNotifier::WaitEventsResult waitResult = state_.getEventNotifier().waitEvents();
-        if (waitResult.isErr()) {
-            if (errno == EINTR)
-                LOG_DEBUG("waitEvents interrupted by signal, retrying...");
-            else
-                LOG_ERROR("EventNotifier::waitEvents failed");
-            continue;
-        }
-
-        const std::vector<Event> events = waitResult.unwrap();
-        for (std::size_t i = 0; i < events.size(); i++) {
-            const Event &ev = events[i];
-            LOG_DEBUGF("event arrived for fd %d (flags: %x)", ev.getFd(), ev.getTypeFlags());
-
-            // SIGCHLD を監視する self-pipe のイベント
-            // TODO: 関数切り分けて〜
-            if (ev.getFd() == state_.getChildReaper().getReadFd()) {
-                const std::vector<ChildReaper::ReapedProcess> result = state_.getChildReaper().onSignalEvent();
-                if (!result.empty()) LOG_DEBUG("child process reaped");
-                for (std::vector<ChildReaper::ReapedProcess>::const_iterator it = result.begin(); it != result.end();
-                     ++it) {
-                    const Option<CgiProcessRepository::Data> data = state_.getCgiProcessRepository().get(it->pid);
-                    state_.getCgiProcessRepository().remove(it->pid);
-
-                    if (it->status == 0) continue;
-
-                    // CGI スクリプトがエラーで終わった場合
-                    if (data.isNone()) {
-                        LOG_WARNF(
-                            "reaped child process %d with non-zero status %d, but no client fd found",
-                            it->pid,
-                            it->status
-                        );
-                        continue;
-                    }
-                    const int clientFd = data.unwrap().clientFd;
-                    const int processSocketFd = data.unwrap().processSocketFd;
-                    // 子プロセスとのソケットの諸々を解除
-                    state_.getEventNotifier().unregisterEvent(Event(processSocketFd, Event::kRead));
-                    state_.getEventNotifier().unregisterEvent(Event(processSocketFd, Event::kWrite));
-                    state_.getEventHandlerRepository().remove(processSocketFd, Event::kRead);
-                    state_.getEventHandlerRepository().remove(processSocketFd, Event::kWrite);
-                    state_.getConnectionRepository().remove(processSocketFd);
-                    // エラーレスポンスを返す
-                    http::ResponseBuilder builder;
-                    state_.getEventNotifier().registerEvent(Event(clientFd, Event::kWrite));
-                    state_.getEventHandlerRepository().set(
-                        clientFd,
-                        Event::kWrite,
-                        new WriteResponseHandler(builder.status(http::kStatusInternalServerError).build())
-                    );
-                }
-                continue;
-            }
+    if (config_.getMainContext().getWorkerProcesses() == 0) {
+        EventLoop::installReloadHandler();
+        this->runEventLoops();
+        return;
+    }
+    this->runMaster();
+}
 
-            Option<Ref<Connection> > conn = state_.getConnectionRepository().get(ev.getFd());
-            const Context ctx(ev, conn, vsResolverFactory);
+/**
+ * worker スレッドの数だけイベントループを作って動かす
+ * notifier (epoll fd など) を fork で共有しないように、EventLoop は実際に動かすプロセスで作る
+ */
+void Server::runEventLoops() {
+    // EventLoop がコピー不可なのでポインタで持つ。[0] はこのスレッドで動かす
+    std::vector<EventLoop *> loops;
+    loops.reserve(listenerSets_.size());
+    for (std::vector<ListenerList>::const_iterator it = listenerSets_.begin(); it != listenerSets_.end(); ++it) {
+        loops.push_back(new EventLoop(config_.getMainContext(), *it, virtualServers_));
+    }
 
-            invokeHandlers(ctx);
+    std::vector<pthread_t> threads;
+    threads.reserve(loops.size());
+    for (std::size_t i = 1; i < loops.size(); ++i) {
+        pthread_t thread;
+        const int err = pthread_create(&thread, NULL, &Server::runEventLoop, loops[i]);
+        if (err != 0) {
+            LOG_ERRORF("failed to create worker thread: %s", std::strerror(err));
+            throw std::runtime_error("failed to create worker thread");
         }
+        threads.push_back(thread);
+    }
+    if (loops.size() > 1) {
+        LOG_INFOF("started %zu workers", loops.size());
+    }
+
+    loops[0]->run();
 
-        // タイムアウトチェック
-        removeTimeoutHandlers();
+    for (std::vector<pthread_t>::const_iterator it = threads.begin(); it != threads.end(); ++it) {
+        pthread_join(*it, NULL);
+    }
+    for (std::vector<EventLoop *>::const_iterator it = loops.begin(); it != loops.end(); ++it) {
+        delete *it;
     }
 }
 
-void Server::invokeHandlers(const Context &ctx) {
-    const Event &event = ctx.getEvent();
+void *Server::runEventLoop(void *loop) {
+    static_cast<EventLoop *>(loop)->run();
+    return NULL;
+}
 
-    const std::vector<Event::EventType> types = {Event::kRead, Event::kWrite};
-    // TODO: handler の呼び方が壊れてる
-    for (std::vector<Event::EventType>::const_iterator it = types.begin(); it != types.end(); ++it) {
-        const Event::EventType type = *it;
-        const bool shouldCallHandler = (event.getTypeFlags() & type) != 0;
+/**
+ * マスタープロセスの処理
+ * worker プロセスを fork し、落ちた worker は起動し直す
+ * 終了系のシグナルは worker に転送し、すべての worker が終了したら戻る
+ */
+void Server::runMaster() {
+    // シグナルは sigwaitinfo / sigtimedwait で同期的に受け取る (fork した worker では元に戻す)
+    sigset_t waitMask;
+    sigemptyset(&waitMask);
+    sigaddset(&waitMask, SIGCHLD);
+    sigaddset(&waitMask, SIGTERM);
+    sigaddset(&waitMask, SIGINT);
+    sigaddset(&waitMask, SIGQUIT);
+    sigaddset(&waitMask, SIGHUP);
+    sigset_t originalMask;
+    sigprocmask(SIG_BLOCK, &waitMask, &originalMask);
+
+    const std::size_t workerProcesses = config_.getMainContext().getWorkerProcesses();
+    for (std::size_t i = 0; i < workerProcesses; ++i) {
+        this->spawnWorkerProcess(originalMask);
+    }
+    LOG_INFOF("master process started %zu worker processes", workerProcesses);
 
-        if (!(shouldCallHandler || event.isError())) {
-            // 待っていないイベントは無視
-            continue;
+    bool shuttingDown = false;
+    while (!(shuttingDown && workerProcesses_.empty())) {
+        if (!shuttingDown) {
+            this->respawnPendingWorkerProcesses(originalMask);
         }
-
-        const Option<Ref<IEventHandler> > handler = state_.getEventHandlerRepository().get(event.getFd(), type);
-        if (handler.isNone()) {
+        const int signum = this->waitMasterSignal(waitMask);
+        if (signum == 0) {
             continue;
         }
-        this->invokeSingleHandler(ctx, handler.unwrap(), shouldCallHandler);
-    }
-}
-
-void Server::invokeSingleHandler(const Context &ctx, const Ref<IEventHandler> &handler, const bool shouldCallHandler) {
-    const Event &event = ctx.getEvent();
 
-    if (event.isError()) {
-        const IEventHandler::ErrorHandleResult result = handler.get().onErrorEvent(ctx, event);
-        if (!result.actions.empty()) {
-            ActionContext actionCtx(state_);
-            executeActions(actionCtx, result.actions);
+        switch (signum) {
+            case SIGCHLD:
+                this->reapWorkerProcesses(originalMask, !shuttingDown);
+                break;
+            case SIGHUP:
+                // worker はコネクションを保ったまま、それぞれエラーページを読み直す
+                // 後から起動し直す worker は fork で引き継ぐので、マスターでも読み直しておく
+                LOG_INFO("master received SIGHUP, reloading error pages");
+                this->reloadErrorPages();
+                this->signalWorkerProcesses(SIGHUP);
+                break;
+            default:
+                LOG_INFOF("master received signal %d, shutting down", signum);
+                shuttingDown = true;
+                pendingRespawns_ = 0;
+                this->signalWorkerProcesses(signum);
+                break;
         }
-        if (result.shouldFallback) {
-            this->onErrorEvent(event);
-            return;
-        }
-        // この場合はそのまま handler を呼ぶ
     }
 
-    if (!shouldCallHandler) {
-        return;
-    }
-
-    const Result<std::vector<IAction *>, error::AppError> result = handler.get().invoke(ctx);
-    if (result.isErr()) {
-        this->onHandlerError(ctx, result.unwrapErr());
-        return;
-    }
-    if (!result.unwrap().empty()) {
-        ActionContext actionCtx(state_);
-        executeActions(actionCtx, result.unwrap());
-    }
+    sigprocmask(SIG_SETMASK, &originalMask, NULL);
+    LOG_INFO("all worker processes exited");
 }
 
 /**
- * TODO: 可能ならエラーレスポンスを返す (Internal Server Error, Payload Too Large など)
- * ここでやることではないかもしれない
+ * マスターが待つシグナルを受け取る
+ * 起動し直すのを待っている worker があれば、その時刻までしか待たない (時刻になったか、中断されたら 0)
  */
-void Server::onHandlerError(const Context &ctx, const error::AppError err) {
-    // IO のエラーは epoll で検知するので、ここでは無視 (EAGAIN の可能性があるため)
-    if (err == error::kRecoverable || err == error::kIOUnknown) {
-        return;
+int Server::waitMasterSignal(const sigset_t &waitMask) const {
+    if (pendingRespawns_ == 0) {
+        const int signum = sigwaitinfo(&waitMask, NULL);
+        return signum == -1 ? 0 : signum;
     }
 
-    // 致命的なエラーはコネクションを切断
-    LOG_WARNF("handler error");
-    const Event &ev = ctx.getEvent();
-    if (listenerFds_.count(ev.getFd()) == 0) {
-        state_.getEventNotifier().unregisterEvent(ev);
-        state_.getEventHandlerRepository().remove(ev.getFd(), Event::kRead);
-        state_.getEventHandlerRepository().remove(ev.getFd(), Event::kWrite);
-        state_.getConnectionRepository().remove(ev.getFd());
-    }
+    const utils::Time::Millis now = utils::Time::getMonotonicMillis();
+    const utils::Time::Millis timeoutMs = respawnDeadline_ > now ? respawnDeadline_ - now : 0;
+    struct timespec timeout;
+    timeout.tv_sec = static_cast<time_t>(timeoutMs / 1000);
+    timeout.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000 * 1000;
+    const int signum = sigtimedwait(&waitMask, NULL, &timeout);
+    return signum == -1 ? 0 : signum;
 }
 
-void Server::onErrorEvent(const Event &event) {
-    if (!event.isError()) {
+void Server::spawnWorkerProcess(const sigset_t &originalMask) {
+    const pid_t pid = fork();
+    if (pid == -1) {
+        LOG_ERRORF("failed to fork worker process: %s", std::strerror(errno));
         return;
     }
 
-    const int fd = event.getFd();
-    LOG_WARNF("error event arrived for fd %d", fd);
-
-    // (たぶん) 継続不可なので cleanup
-    if (listenerFds_.count(fd) == 0) {
-        state_.getEventNotifier().unregisterEvent(event);
-        state_.getEventHandlerRepository().remove(fd, Event::kRead);
-        state_.getEventHandlerRepository().remove(fd, Event::kWrite);
-        state_.getConnectionRepository().remove(fd);
+    if (pid == 0) {
+        // SIGHUP をブロックしている間に handler を設定して、起動直後の SIGHUP で終了しないようにする
+        EventLoop::installReloadHandler();
+        sigprocmask(SIG_SETMASK, &originalMask, NULL);
+#if defined(__linux__)
+        // マスターが落ちたら worker も終了する
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+        this->runEventLoops();
+        _exit(0);
     }
-}
-
-void Server::executeActions(ActionContext &actionCtx, std::vector<IAction *> actions) {
-    for (std::vector<IAction *>::const_iterator it = actions.begin(); it != actions.end(); ++it) {
-        IAction *action = *it;
-        action->execute(actionCtx);
-        delete action;
-    }
-}
 
-void Server::removeTimeoutHandlers() {
-    removeTimeoutRequestHandlers();
-    removeTimeoutCgiProcesses();
+    LOG_INFOF("worker process %d started", pid);
+    workerProcesses_[pid] = utils::Time::getCurrentTime();
 }
 
-void Server::removeTimeoutRequestHandlers() {
-    const std::time_t currentTime = utils::Time::getCurrentTime();
-
-    const std::vector<int> timedOutFds =
-        state_.getConnectionRepository().getTimedOutConnectionFds(currentTime, REQUEST_TIMEOUT_SECONDS, listenerFds_);
-
-    for (std::vector<int>::const_iterator it = timedOutFds.begin(); it != timedOutFds.end(); ++it) {
-        const int fd = *it;
+void Server::reapWorkerProcesses(const sigset_t &originalMask, const bool respawn) {
+    while (true) {
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid <= 0) {
+            break;
+        }
 
-        // Read ハンドラーが登録されているかチェック（リクエスト待ち状態）
-        const Option<Ref<IEventHandler> > readHandler = state_.getEventHandlerRepository().get(fd, Event::kRead);
-        if (readHandler.isNone()) {
+        const std::map<pid_t, std::time_t>::iterator it = workerProcesses_.find(pid);
+        if (it == workerProcesses_.end()) {
             continue;
         }
+        const std::time_t startTime = it->second;
+        workerProcesses_.erase(it);
 
-        LOG_INFOF("Request timeout for fd %d", fd);
+        if (WIFSIGNALED(status)) {
+            LOG_WARNF("worker process %d killed by signal %d", pid, WTERMSIG(status));
+        } else {
+            LOG_WARNF("worker process %d exited with status %d", pid, WEXITSTATUS(status));
+        }
 
-        // タイムアウトレスポンスを設定
-        http::ResponseBuilder builder;
-        http::Response response = builder.status(http::kStatusRequestTimeout).build();
+        if (!respawn) {
+            continue;
+        }
+        if (utils::Time::diffTimeSeconds(utils::Time::getCurrentTime(), startTime) >= kMinWorkerLifetimeSeconds) {
+            this->spawnWorkerProcess(originalMask);
+            continue;
+        }
+        // すぐに落ちた worker は、間隔を空けてからまとめて起動し直す (待っている間もシグナルは受け取る)
+        if (pendingRespawns_ == 0) {
+            respawnDeadline_ = utils::Time::getMonotonicMillis() + kMinWorkerLifetimeSeconds * 1000;
+        }
+        ++pendingRespawns_;
+    }
+}
 
-        // Read ハンドラーを削除し、Write ハンドラーを設定
-        state_.getEventNotifier().unregisterEvent(Event(fd, Event::kRead));
-        state_.getEventHandlerRepository().remove(fd, Event::kRead);
-        state_.getEventNotifier().registerEvent(Event(fd, Event::kWrite));
-        state_.getEventHandlerRepository().set(fd, Event::kWrite, new WriteResponseHandler(response));
+void Server::respawnPendingWorkerProcesses(const sigset_t &originalMask) {
+    if (pendingRespawns_ == 0 || utils::Time::getMonotonicMillis() < respawnDeadline_) {
+        return;
+    }
+    LOG_INFOF("respawning %zu worker processes", pendingRespawns_);
+    const std::size_t count = pendingRespawns_;
+    pendingRespawns_ = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        this->spawnWorkerProcess(originalMask);
     }
 }
 
-void Server::removeTimeoutCgiProcesses() {
-    const std::time_t currentTime = utils::Time::getCurrentTime();
-    const std::vector<std::pair<pid_t, CgiProcessRepository::Data> > timedOutProcesses =
-        state_.getCgiProcessRepository().getTimedOutProcesses(currentTime, CGI_TIMEOUT_SECONDS);
+void Server::reloadErrorPages() {
+    for (VirtualServerList::const_iterator it = virtualServers_.begin(); it != virtualServers_.end(); ++it) {
+        (*it)->reloadErrorPages();
+    }
+}
 
-    for (std::vector<std::pair<pid_t, CgiProcessRepository::Data> >::const_iterator it = timedOutProcesses.begin();
-         it != timedOutProcesses.end();
+void Server::signalWorkerProcesses(const int signum) const {
+    for (std::map<pid_t, std::time_t>::const_iterator it = workerProcesses_.begin(); it != workerProcesses_.end();
          ++it) {
-        const pid_t pid = it->first;
-        const CgiProcessRepository::Data &data = it->second;
-
-        LOG_INFOF("CGI timeout for pid %d", pid);
-
-        // CGI プロセスを強制終了
-        if (kill(pid, SIGTERM) == -1) {
-            LOG_WARNF("Failed to terminate CGI process %d: %s", pid, std::strerror(errno));
+        if (kill(it->first, signum) == -1) {
+            LOG_WARNF("failed to send signal %d to worker process %d: %s", signum, it->first, std::strerror(errno));
         }
-
-        // プロセスソケットをクリーンアップ
-        const int processSocketFd = data.processSocketFd;
-        const int clientFd = data.clientFd;
-
-        state_.getEventNotifier().unregisterEvent(Event(processSocketFd, Event::kRead));
-        state_.getEventNotifier().unregisterEvent(Event(processSocketFd, Event::kWrite));
-        state_.getEventHandlerRepository().remove(processSocketFd, Event::kRead);
-        state_.getEventHandlerRepository().remove(processSocketFd, Event::kWrite);
-        state_.getConnectionRepository().remove(processSocketFd);
-        state_.getCgiProcessRepository().remove(pid);
-
-        // Gateway Timeout レスポンスを返す
-        http::ResponseBuilder builder;
-        http::Response response = builder.status(http::kStatusGatewayTimeout).build();
-        state_.getEventNotifier().registerEvent(Event(clientFd, Event::kWrite));
-        state_.getEventHandlerRepository().set(clientFd, Event::kWrite, new WriteResponseHandler(response));
     }
 }
@@ -1,43 +1,57 @@
 #ifndef SRC_LIB_SERVER_HPP
 #define SRC_LIB_SERVER_HPP
 
-#include "event/event_handler.hpp"
+#include "event_loop.hpp"
 #include "transport/listener.hpp"
-#include "server_state.hpp"
 #include "virtual_server.hpp"
 #include "config/config.hpp"
-#include <set>
+#include "utils/time.hpp"
+#include <ctime>
+#include <map>
+#include <signal.h>
+#include <vector>
 
 class Server {
 public:
     explicit Server(const config::Config &config);
     ~Server();
 
+    /**
+     * worker_processes が 0 なら、このプロセスでイベントループを動かす (戻らない)
+     * 1 以上なら、マスタープロセスとして worker プロセスを fork して監視する (終了シグナルを受けると戻る)
+     */
     void start();
 
 private:
     // VirtualServer は http::Router を持っていて、コピー不可なのでポインタで持つ
-    typedef std::vector<VirtualServer *> VirtualServerList;
+    typedef EventLoop::VirtualServerList VirtualServerList;
+    // Listener がコピー不可なのでポインタで持つ
+    typedef std::vector<Listener *> ListenerList;
 
-    static const int REQUEST_TIMEOUT_SECONDS = 5;
-    static const int CGI_TIMEOUT_SECONDS = 5;
+    // すぐに落ち続ける worker を fork し続けないように、再起動の間隔を空ける
+    static const int kMinWorkerLifetimeSeconds = 1;
 
     config::Config config_;
     VirtualServerList virtualServers_;
-
-    ServerState state_;
-    // Listener がコピー不可なのでポインタで持つ
-    std::vector<Listener *> listeners_;
-    std::set<int> listenerFds_;
-
-    void onHandlerError(const Context &ctx, error::AppError err);
-    void onErrorEvent(const Event &event);
-    static void executeActions(ActionContext &actionCtx, std::vector<IAction *> actions);
-    void invokeHandlers(const Context &ctx);
-    void invokeSingleHandler(const Context &ctx, const Ref<IEventHandler> &handler, bool shouldCallHandler);
-    void removeTimeoutHandlers();
-    void removeTimeoutRequestHandlers();
-    void removeTimeoutCgiProcesses();
+    // worker スレッドごとの Listener
+    std::vector<ListenerList> listenerSets_;
+
+    // マスタープロセスでのみ使う。worker の pid -> 起動時刻
+    std::map<pid_t, std::time_t> workerProcesses_;
+    // すぐに落ちたので、起動し直すのを待っている worker の数と、起動し直す時刻
+    std::size_t pendingRespawns_;
+    utils::Time::Millis respawnDeadline_;
+
+    void runEventLoops();
+    static void *runEventLoop(void *loop);
+
+    void runMaster();
+    int waitMasterSignal(const sigset_t &waitMask) const;
+    void spawnWorkerProcess(const sigset_t &originalMask);
+    void respawnPendingWorkerProcesses(const sigset_t &originalMask);
+    void reapWorkerProcesses(const sigset_t &originalMask, bool respawn);
+    void signalWorkerProcesses(int signum) const;
+    void reloadErrorPages();
 };
 
 #endif
@@ -1,24 +1,24 @@
 #include "server_state.hpp"
+#include "event/io_uring_event_notifier.hpp"
 #include "utils/logger.hpp"
 #include "utils/ref.hpp"
 #include "utils/time.hpp"
 #include <vector>
-#include <set>
 
-ConnectionRepository::ConnectionRepository() {}
+ConnectionRepository::ConnectionRepository(FdTable &fds, TimerWheel &timers) : fds_(fds), timers_(timers) {}
 
 ConnectionRepository::~ConnectionRepository() {
-    for (std::map<int, Connection *>::const_iterator it = connections_.begin(); it != connections_.end(); ++it) {
-        delete it->second;
+    for (std::size_t fd = 0; fd < fds_.size(); ++fd) {
+        delete fds_.at(static_cast<int>(fd)).conn;
     }
 }
 
 Option<Ref<Connection> > ConnectionRepository::get(const int fd) {
-    const std::map<int, Connection *>::const_iterator it = connections_.find(fd);
-    if (it == connections_.end()) {
+    const FdTable::Slot *slot = fds_.find(fd);
+    if (slot == NULL || slot->conn == NULL) {
         return None;
     }
-    return Some(Ref<Connection>(*it->second));
+    return Some(Ref<Connection>(*slot->conn));
 }
 
 void ConnectionRepository::set(const int fd, Connection *conn) {
@@ -27,93 +27,116 @@ void ConnectionRepository::set(const int fd, Connection *conn) {
         // 処理は継続する
     }
 
-    if (connections_[fd]) {
+    FdTable::Slot &slot = fds_.at(fd);
+    if (slot.conn) {
         LOG_DEBUGF("outdated Connection object found for fd %d", fd);
-        delete connections_[fd];
+        delete slot.conn;
+        this->cancelTimeout(slot);
     }
-    connections_[fd] = conn;
+    slot.conn = conn;
     LOG_DEBUGF("new connection added to server");
 }
 
+void ConnectionRepository::setTimeout(const int fd, const utils::Time::Millis deadline) {
+    FdTable::Slot &slot = fds_.at(fd);
+    this->cancelTimeout(slot);
+    slot.requestTimer = timers_.schedule(deadline, kTimerRequest, fd);
+}
+
+void ConnectionRepository::setLingerTimeout(const int fd, const utils::Time::Millis deadline) {
+    FdTable::Slot &slot = fds_.at(fd);
+    this->cancelTimeout(slot);
+    slot.requestTimer = timers_.schedule(deadline, kTimerLingeringClose, fd);
+}
+
 void ConnectionRepository::remove(const int fd) {
-    const std::map<int, Connection *>::const_iterator it = connections_.find(fd);
-    if (it == connections_.end()) {
+    FdTable::Slot *slot = fds_.find(fd);
+    if (slot == NULL || slot->conn == NULL) {
         LOG_DEBUGF("ConnectionRepository::remove: fd %d does not exist", fd);
         return;
     }
 
-    delete it->second;
-    connections_.erase(fd);
+    delete slot->conn;
+    slot->conn = NULL;
+    this->cancelTimeout(*slot);
 
     LOG_DEBUGF("connection removed from server");
 }
 
-std::vector<int> ConnectionRepository::getTimedOutConnectionFds(
-    std::time_t currentTime, double timeoutSeconds, const std::set<int> &excludeFds
-) const {
-    std::vector<int> timedOutFds;
-
-    for (std::map<int, Connection *>::const_iterator it = connections_.begin(); it != connections_.end(); ++it) {
-        const int fd = it->first;
-        Connection *conn = it->second;
-
-        // 除外リストに含まれるFDはスキップ
-        if (excludeFds.count(fd) > 0) {
-            continue;
-        }
-
-        // タイムアウトチェック
-        const double elapsed = utils::Time::diffTimeSeconds(currentTime, conn->getLastActivityTime());
-        if (elapsed > timeoutSeconds) {
-            timedOutFds.push_back(fd);
-        }
+void ConnectionRepository::cancelTimeout(FdTable::Slot &slot) {
+    if (slot.requestTimer == TimerWheel::kInvalidTimerId) {
+        return;
     }
-
-    return timedOutFds;
+    // 期限切れになった後の id でも、TimerWheel が無視する
+    timers_.cancel(slot.requestTimer);
+    slot.requestTimer = TimerWheel::kInvalidTimerId;
 }
 
-EventHandlerRepository::EventHandlerRepository() {}
+EventHandlerRepository::EventHandlerRepository(FdTable &fds) : fds_(fds) {}
 
 EventHandlerRepository::~EventHandlerRepository() {
-    for (std::map<Key, IEventHandler *>::const_iterator it = handlers_.begin(); it != handlers_.end(); ++it) {
-        delete it->second;
+    for (std::size_t fd = 0; fd < fds_.size(); ++fd) {
+        FdTable::Slot &slot = fds_.at(static_cast<int>(fd));
+        delete slot.readHandler;
+        delete slot.writeHandler;
     }
 }
 
 Option<Ref<IEventHandler> > EventHandlerRepository::get(const int fd, const Event::EventType type) {
-    const Key key(fd, type);
-    const std::map<Key, IEventHandler *>::const_iterator it = handlers_.find(key);
-    if (it == handlers_.end()) {
+    FdTable::Slot *slot = fds_.find(fd);
+    if (slot == NULL) {
+        return None;
+    }
+    IEventHandler *const *field = handlerField(*slot, type);
+    if (field == NULL || *field == NULL) {
         return None;
     }
-    return Some(Ref<IEventHandler>(*it->second));
+    return Some(Ref<IEventHandler>(**field));
 }
 
 void EventHandlerRepository::set(const int fd, Event::EventType type, IEventHandler *handler) {
-    const Key key(fd, type);
-    if (handlers_[key]) {
+    IEventHandler **field = handlerField(fds_.at(fd), type);
+    if (field == NULL) {
+        LOG_WARNF("EventHandlerRepository::set: unsupported event type %d", type);
+        delete handler;
+        return;
+    }
+    if (*field) {
         LOG_DEBUGF("outdated event handler found for fd %d", fd);
-        delete handlers_[key];
+        delete *field;
     }
 
-    handlers_[key] = handler;
+    *field = handler;
     LOG_DEBUGF("event handler added to fd %d (type: %d)", fd, type);
 }
 
 void EventHandlerRepository::remove(const int fd, Event::EventType type) {
-    const Key key(fd, type);
-    const std::map<Key, IEventHandler *>::const_iterator it = handlers_.find(key);
-    if (it == handlers_.end()) {
+    FdTable::Slot *slot = fds_.find(fd);
+    IEventHandler **field = slot == NULL ? NULL : handlerField(*slot, type);
+    if (field == NULL || *field == NULL) {
         LOG_DEBUG("EventHandlerRepository::remove: handler not found");
         return;
     }
 
-    delete it->second;
-    handlers_.erase(key);
+    delete *field;
+    *field = NULL;
 
     LOG_DEBUGF("event handler removed from fd %d (type: %d)", fd, type);
 }
 
+IEventHandler **EventHandlerRepository::handlerField(FdTable::Slot &slot, const Event::EventType type) {
+    switch (type) {
+        case Event::kRead:
+            return &slot.readHandler;
+        case Event::kWrite:
+            return &slot.writeHandler;
+        default:
+            return NULL;
+    }
+}
+
+CgiProcessRepository::CgiProcessRepository(TimerWheel &timers) : timers_(timers) {}
+
 Option<CgiProcessRepository::Data> CgiProcessRepository::get(const pid_t pid) {
     const std::map<int, Data>::iterator it = pidToData_.find(pid);
     if (it == pidToData_.end()) {
@@ -127,34 +150,69 @@ void CgiProcessRepository::set(const pid_t pid, const Data data) {
     pidToData_[pid] = data;
 }
 
+void CgiProcessRepository::setTimeout(const pid_t pid, const utils::Time::Millis deadline) {
+    this->cancelTimeout(pid);
+    timerIds_[pid] = timers_.schedule(deadline, kTimerCgi, pid);
+}
+
 void CgiProcessRepository::remove(const pid_t pid) {
     pidToData_.erase(pid);
+    this->cancelTimeout(pid);
 }
 
-std::vector<std::pair<pid_t, CgiProcessRepository::Data> >
-CgiProcessRepository::getTimedOutProcesses(std::time_t currentTime, double timeoutSeconds) const {
-    std::vector<std::pair<pid_t, CgiProcessRepository::Data> > timedOutProcesses;
-
-    for (std::map<pid_t, Data>::const_iterator it = pidToData_.begin(); it != pidToData_.end(); ++it) {
-        const pid_t pid = it->first;
-        const Data &data = it->second;
-
-        const double elapsed = utils::Time::diffTimeSeconds(currentTime, data.startTime);
-        if (elapsed > timeoutSeconds) {
-            timedOutProcesses.push_back(std::make_pair(pid, data));
+void CgiProcessRepository::cancelTimeout(const pid_t pid) {
+    const std::map<pid_t, TimerWheel::TimerId>::iterator it = timerIds_.find(pid);
+    if (it == timerIds_.end()) {
+        return;
+    }
+    timers_.cancel(it->second);
+    timerIds_.erase(it);
+}
+
+static IEventNotifier *createEventNotifier(const config::MainContext &mainConfig) {
+    switch (mainConfig.getEventMethod()) {
+        case config::MainContext::kEventMethodIoUring: {
+#if defined(__linux__)
+            // seccomp やカーネルの設定で io_uring が拒否されることがあるので、その場合は epoll を使う
+            Result<IoUringEventNotifier *, error::AppError> result = IoUringEventNotifier::create();
+            if (result.isOk()) {
+                return result.unwrap();
+            }
+            LOG_WARN("io_uring is not available, falling back to epoll");
+            return new EpollEventNotifier(mainConfig.isEdgeTriggered());
+#else
+            LOG_WARN("io_uring is not available on this platform, falling back to poll");
+            return new PollEventNotifier();
+#endif
         }
+        case config::MainContext::kEventMethodEpoll:
+#if defined(__linux__)
+            return new EpollEventNotifier(mainConfig.isEdgeTriggered());
+#else
+            LOG_WARN("epoll is not available on this platform, falling back to poll");
+            return new PollEventNotifier();
+#endif
+        case config::MainContext::kEventMethodPoll:
+        default:
+            return new PollEventNotifier();
     }
-
-    return timedOutProcesses;
 }
 
-ServerState::ServerState() {
+ServerState::ServerState(const config::MainContext &mainConfig)
+    : notifier_(createEventNotifier(mainConfig)), requestTimeoutMs_(mainConfig.getRequestTimeoutMs()),
+      cgiTimeoutMs_(mainConfig.getCgiTimeoutMs()), keepAliveTimeoutMs_(mainConfig.getKeepAliveTimeoutMs()),
+      keepAliveRequests_(mainConfig.getKeepAliveRequests()), timers_(utils::Time::getCachedMonotonicMillis()),
+      connRepo_(fds_, timers_), handlerRepo_(fds_), cgiProcessRepo_(timers_) {
     // self-pipe の読み端を監視対象にする
-    reaper_.attachToEventNotifier(&getEventNotifier());
+    reaper_.attachToEventNotifier(notifier_);
+}
+
+ServerState::~ServerState() {
+    delete notifier_;
 }
 
 IEventNotifier &ServerState::getEventNotifier() {
-    return notifier_;
+    return *notifier_;
 }
 
 ConnectionRepository &ServerState::getConnectionRepository() {
@@ -172,3 +230,23 @@ CgiProcessRepository &ServerState::getCgiProcessRepository() {
 ChildReaper &ServerState::getChildReaper() {
     return reaper_;
 }
+
+TimerWheel &ServerState::getTimerWheel() {
+    return timers_;
+}
+
+utils::Time::Millis ServerState::getRequestTimeoutMs() const {
+    return requestTimeoutMs_;
+}
+
+utils::Time::Millis ServerState::getCgiTimeoutMs() const {
+    return cgiTimeoutMs_;
+}
+
+utils::Time::Millis ServerState::getKeepAliveTimeoutMs() const {
+    return keepAliveTimeoutMs_;
+}
+
+std::size_t ServerState::getKeepAliveRequests() const {
+    return keepAliveRequests_;
+}
@@ -2,20 +2,31 @@
 #define SRC_LIB_CORE_SERVER_STATE_HPP
 
 #include "child_reaper.hpp"
+#include "fd_table.hpp"
+#include "timer_wheel.hpp"
+#include "config/config.hpp"
 #include "event/event_notifier.hpp"
 #include "event/event_handler.hpp"
 #include "transport/connection.hpp"
 #include "utils/types/option.hpp"
 #include <map>
-#include <set>
 #include <vector>
-#include <ctime>
 
 // TODO: 共通化するべき?
 
+// TimerWheel に登録するタイマーの種類
+enum TimerKind {
+    // key は fd
+    kTimerRequest,
+    // key は pid
+    kTimerCgi,
+    // key は fd
+    kTimerLingeringClose
+};
+
 class ConnectionRepository : public NonCopyable {
 public:
-    ConnectionRepository();
+    ConnectionRepository(FdTable &fds, TimerWheel &timers);
     ~ConnectionRepository();
 
     Option<Ref<Connection> > get(int fd);
@@ -24,19 +35,22 @@ public:
      * インターフェースの統一のためにある
      */
     void set(int fd, Connection *conn);
+    // remove されるまでに deadline を過ぎると、kTimerRequest のタイマーが期限切れになる (前の設定は取り消す)
+    void setTimeout(int fd, utils::Time::Millis deadline);
+    // lingering close の期限。deadline を過ぎると kTimerLingeringClose のタイマーが期限切れになる (前の設定は取り消す)
+    void setLingerTimeout(int fd, utils::Time::Millis deadline);
     void remove(int fd);
 
-    // タイムアウトしたコネクションのFDを取得
-    std::vector<int>
-    getTimedOutConnectionFds(std::time_t currentTime, double timeoutSeconds, const std::set<int> &excludeFds) const;
-
 private:
-    std::map<int, Connection *> connections_;
+    FdTable &fds_;
+    TimerWheel &timers_;
+
+    void cancelTimeout(FdTable::Slot &slot);
 };
 
 class EventHandlerRepository : public NonCopyable {
 public:
-    EventHandlerRepository();
+    explicit EventHandlerRepository(FdTable &fds);
     ~EventHandlerRepository();
 
     // get, set, remove が受け取る Event::EventType は、どれか 1 bit が立ったフラグのみを想定している (和はダメ)
@@ -45,8 +59,10 @@ public:
     void remove(int fd, Event::EventType type);
 
 private:
-    typedef std::pair<int, Event::EventType> Key;
-    std::map<Key, IEventHandler *> handlers_;
+    FdTable &fds_;
+
+    // type に対応するスロットのメンバを返す。kRead, kWrite 以外なら NULL
+    static IEventHandler **handlerField(FdTable::Slot &slot, Event::EventType type);
 };
 
 // 名前が微妙
@@ -55,41 +71,58 @@ public:
     struct Data {
         int clientFd;
         int processSocketFd;
-        std::time_t startTime;
     };
 
-    CgiProcessRepository() {}
+    explicit CgiProcessRepository(TimerWheel &timers);
 
     Option<Data> get(pid_t pid);
     void set(pid_t pid, Data data);
+    // remove されるまでに deadline を過ぎると、kTimerCgi のタイマーが期限切れになる (前の設定は取り消す)
+    void setTimeout(pid_t pid, utils::Time::Millis deadline);
     void remove(pid_t pid);
 
-    // タイムアウトしたプロセスを取得
-    std::vector<std::pair<pid_t, Data> > getTimedOutProcesses(std::time_t currentTime, double timeoutSeconds) const;
-
 private:
+    TimerWheel &timers_;
     std::map<pid_t, Data> pidToData_;
+    std::map<pid_t, TimerWheel::TimerId> timerIds_;
+
+    void cancelTimeout(pid_t pid);
 };
 
-class ServerState {
+class ServerState : public NonCopyable {
 public:
-    ServerState();
+    // 使用する IEventNotifier の実装は設定から決める
+    explicit ServerState(const config::MainContext &mainConfig);
+    ~ServerState();
 
     IEventNotifier &getEventNotifier();
     ConnectionRepository &getConnectionRepository();
     EventHandlerRepository &getEventHandlerRepository();
     CgiProcessRepository &getCgiProcessRepository();
     ChildReaper &getChildReaper();
+    TimerWheel &getTimerWheel();
+    // リクエストを待つ時間 (最後に読み込んでから)
+    utils::Time::Millis getRequestTimeoutMs() const;
+    // CGI の実行時間の上限
+    utils::Time::Millis getCgiTimeoutMs() const;
+    // keep-alive で次のリクエストを待つ時間
+    utils::Time::Millis getKeepAliveTimeoutMs() const;
+    // 1 つのコネクションで受け付けるリクエストの上限
+    std::size_t getKeepAliveRequests() const;
 
 private:
     // EventNotifier はあんまり state っぽくない
-#if defined(__linux__) && USE_EPOLL
-    EpollEventNotifier notifier_;
-#else
-    PollEventNotifier notifier_;
-#endif
+    // 実装を実行時に選ぶので、ポインタで持つ
+    IEventNotifier *notifier_;
+    utils::Time::Millis requestTimeoutMs_;
+    utils::Time::Millis cgiTimeoutMs_;
+    utils::Time::Millis keepAliveTimeoutMs_;
+    std::size_t keepAliveRequests_;
 
     ChildReaper reaper_;
+    // 各 repository が参照するので、先に初期化する
+    TimerWheel timers_;
+    FdTable fds_;
 
     ConnectionRepository connRepo_;
     EventHandlerRepository handlerRepo_;
@@ -0,0 +1,197 @@
+#include "timer_wheel.hpp"
+
+const TimerWheel::TimerId TimerWheel::kInvalidTimerId;
+
+TimerWheel::TimerWheel(const utils::Time::Millis now) : current_(now), freeList_(kNil), size_(0) {
+    for (int level = 0; level < kLevels; ++level) {
+        for (int slot = 0; slot < kSlots; ++slot) {
+            heads_[level][slot] = kNil;
+        }
+        occupied_[level] = 0;
+    }
+}
+
+TimerWheel::TimerId TimerWheel::schedule(const utils::Time::Millis deadline, const int kind, const int key) {
+    const int index = this->allocateNode();
+    Node &node = nodes_[index];
+    // 現在の tick のスロットは処理済みなので、早くても次の tick で期限切れにする
+    node.deadline = deadline > current_ ? deadline : current_ + 1;
+    node.kind = kind;
+    node.key = key;
+    node.active = true;
+    this->insert(index);
+    ++size_;
+    return (static_cast<TimerId>(node.generation) << 32) | static_cast<uint32_t>(index);
+}
+
+void TimerWheel::cancel(const TimerId id) {
+    const std::size_t index = static_cast<uint32_t>(id & 0xffffffff);
+    const uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (index >= nodes_.size()) {
+        return;
+    }
+    const Node &node = nodes_[index];
+    if (!node.active || node.generation != generation) {
+        return;
+    }
+    this->unlink(static_cast<int>(index));
+    this->releaseNode(static_cast<int>(index));
+    --size_;
+}
+
+void TimerWheel::advance(const utils::Time::Millis now, std::vector<Expired> &expired) {
+    while (current_ < now) {
+        // 期限切れも下ろす処理も起きない tick は飛ばす
+        const Option<utils::Time::Millis> next = this->nextDeadline();
+        if (next.isNone() || next.unwrap() > now) {
+            current_ = now;
+            break;
+        }
+        current_ = next.unwrap();
+
+        // 下位の階層が一周したら、上位の階層のスロットを下ろしてくる
+        for (int level = 1; level < kLevels; ++level) {
+            if ((current_ >> (kSlotBits * level - kSlotBits)) & kSlotMask) {
+                break;
+            }
+            this->cascade(level);
+        }
+        this->expireSlot(static_cast<int>(current_ & kSlotMask), expired);
+    }
+}
+
+Option<utils::Time::Millis> TimerWheel::nextDeadline() const {
+    if (size_ == 0) {
+        return None;
+    }
+
+    // 各階層で、次に処理されるスロットの時刻を求めて、最小のものを返す
+    utils::Time::Millis next = 0;
+    bool found = false;
+    for (int level = 0; level < kLevels; ++level) {
+        if (occupied_[level] == 0) {
+            continue;
+        }
+        const int shift = kSlotBits * level;
+        const utils::Time::Millis base = current_ >> shift;
+        const int offset = findNextSlot(occupied_[level], static_cast<int>((base + 1) & kSlotMask));
+        const utils::Time::Millis time = (base + 1 + offset) << shift;
+        if (!found || time < next) {
+            next = time;
+            found = true;
+        }
+    }
+    return Some(next);
+}
+
+std::size_t TimerWheel::size() const {
+    return size_;
+}
+
+int TimerWheel::allocateNode() {
+    if (freeList_ != kNil) {
+        const int index = freeList_;
+        freeList_ = nodes_[index].next;
+        return index;
+    }
+
+    Node node = {};
+    node.generation = 1;
+    node.prev = kNil;
+    node.next = kNil;
+    nodes_.push_back(node);
+    return static_cast<int>(nodes_.size() - 1);
+}
+
+void TimerWheel::releaseNode(const int index) {
+    Node &node = nodes_[index];
+    node.active = false;
+    // 古い id で cancel されても無視できるように、世代を進める (0 は kInvalidTimerId と被るので避ける)
+    if (++node.generation == 0) {
+        node.generation = 1;
+    }
+    node.next = freeList_;
+    freeList_ = index;
+}
+
+// deadline までの残り時間から階層を決める
+void TimerWheel::insert(const int index) {
+    const utils::Time::Millis deadline = nodes_[index].deadline;
+    const utils::Time::Millis delta = deadline > current_ ? deadline - current_ : 0;
+
+    for (int level = 0; level < kLevels; ++level) {
+        const int shift = kSlotBits * level;
+        if (delta < (static_cast<utils::Time::Millis>(1) << (shift + kSlotBits))) {
+            const utils::Time::Millis target = deadline > current_ ? deadline : current_;
+            this->link(index, level, static_cast<int>((target >> shift) & kSlotMask));
+            return;
+        }
+    }
+
+    // ホイールに収まらないほど遠い場合は、最上位の一番遠いスロットに入れ、下ろしてきたときに入れ直す
+    const int shift = kSlotBits * (kLevels - 1);
+    this->link(index, kLevels - 1, static_cast<int>(((current_ >> shift) - 1) & kSlotMask));
+}
+
+void TimerWheel::link(const int index, const int level, const int slot) {
+    Node &node = nodes_[index];
+    node.level = level;
+    node.slot = slot;
+    node.prev = kNil;
+    node.next = heads_[level][slot];
+    if (node.next != kNil) {
+        nodes_[node.next].prev = index;
+    }
+    heads_[level][slot] = index;
+    occupied_[level] |= static_cast<uint64_t>(1) << slot;
+}
+
+void TimerWheel::unlink(const int index) {
+    const Node &node = nodes_[index];
+    if (node.prev != kNil) {
+        nodes_[node.prev].next = node.next;
+    } else {
+        heads_[node.level][node.slot] = node.next;
+    }
+    if (node.next != kNil) {
+        nodes_[node.next].prev = node.prev;
+    }
+    if (heads_[node.level][node.slot] == kNil) {
+        occupied_[node.level] &= ~(static_cast<uint64_t>(1) << node.slot);
+    }
+}
+
+void TimerWheel::cascade(const int level) {
+    const int slot = static_cast<int>((current_ >> (kSlotBits * level)) & kSlotMask);
+    int index = heads_[level][slot];
+    heads_[level][slot] = kNil;
+    occupied_[level] &= ~(static_cast<uint64_t>(1) << slot);
+
+    while (index != kNil) {
+        const int next = nodes_[index].next;
+        this->insert(index);
+        index = next;
+    }
+}
+
+void TimerWheel::expireSlot(const int slot, std::vector<Expired> &expired) {
+    int index = heads_[0][slot];
+    heads_[0][slot] = kNil;
+    occupied_[0] &= ~(static_cast<uint64_t>(1) << slot);
+
+    while (index != kNil) {
+        const Node &node = nodes_[index];
+        const int next = node.next;
+        const Expired e = {node.kind, node.key};
+        expired.push_back(e);
+        this->releaseNode(index);
+        --size_;
+        index = next;
+    }
+}
+
+// start から循環的に見て、最初に空でないスロットまでの距離
+int TimerWheel::findNextSlot(const uint64_t occupied, const int start) {
+    const uint64_t rotated = start == 0 ? occupied : (occupied >> start) | (occupied << (kSlots - start));
+    return __builtin_ctzll(rotated);
+}
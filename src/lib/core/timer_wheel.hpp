@@ -0,0 +1,80 @@
+#ifndef SRC_LIB_CORE_TIMER_WHEEL_HPP
+#define SRC_LIB_CORE_TIMER_WHEEL_HPP
+
+#include "utils/non_copyable.hpp"
+#include "utils/time.hpp"
+#include "utils/types/option.hpp"
+#include <stdint.h>
+#include <vector>
+
+/**
+ * 階層タイマーホイール (1 tick = 1 ms)
+ * schedule, cancel は O(1)。advance は空のスロットを飛ばすので、処理するスロットの数に比例する
+ *
+ * 各階層は 64 個のスロットを持ち、level n のスロットは 64^n tick 分を表す
+ * 上位の階層のタイマーは、そのスロットの時刻になったときに下位の階層に入れ直される
+ */
+class TimerWheel : public NonCopyable {
+public:
+    // 世代 (上位 32 bit) とノードの index (下位 32 bit)。cancel 済み・発火済みの id は無視される
+    typedef uint64_t TimerId;
+    static const TimerId kInvalidTimerId = 0;
+
+    // 期限切れになったタイマー
+    struct Expired {
+        int kind;
+        int key;
+    };
+
+    explicit TimerWheel(utils::Time::Millis now);
+
+    // deadline (絶対時刻) に期限切れになるタイマーを登録する
+    TimerId schedule(utils::Time::Millis deadline, int kind, int key);
+    void cancel(TimerId id);
+
+    // now までに期限切れになったタイマーを expired に追加する
+    void advance(utils::Time::Millis now, std::vector<Expired> &expired);
+
+    // 次に advance で処理が必要になる時刻 (タイマーがなければ None)
+    Option<utils::Time::Millis> nextDeadline() const;
+    std::size_t size() const;
+
+private:
+    static const int kLevels = 4;
+    static const int kSlotBits = 6;
+    static const int kSlots = 1 << kSlotBits;
+    static const int kSlotMask = kSlots - 1;
+    static const int kNil = -1;
+
+    struct Node {
+        utils::Time::Millis deadline;
+        int kind;
+        int key;
+        uint32_t generation;
+        bool active;
+        int level;
+        int slot;
+        int prev;
+        int next;
+    };
+
+    utils::Time::Millis current_;
+    std::vector<Node> nodes_;
+    // 空いているノードの index (next で繋ぐ)
+    int freeList_;
+    int heads_[kLevels][kSlots];
+    // スロットが空でないかのビットマップ
+    uint64_t occupied_[kLevels];
+    std::size_t size_;
+
+    int allocateNode();
+    void releaseNode(int index);
+    void insert(int index);
+    void link(int index, int level, int slot);
+    void unlink(int index);
+    void cascade(int level);
+    void expireSlot(int slot, std::vector<Expired> &expired);
+    static int findNextSlot(uint64_t occupied, int start);
+};
+
+#endif
@@ -4,12 +4,14 @@
 #include "http/handler/redirect_handler.hpp"
 #include "http/handler/static_file_handler.hpp"
 #include "http/handler/upload_file_handler.hpp"
-#include "http/handler/middleware/error_page.hpp"
+#include "http/handler/middleware/gzip.hpp"
 #include "http/handler/middleware/logger.hpp"
 #include "utils/logger.hpp"
+#include <algorithm>
 
 VirtualServer::VirtualServer(const config::ServerContext &serverConfig, const Address &bindAddress)
-    : serverConfig_(serverConfig), bindAddress_(bindAddress) {
+    : serverConfig_(serverConfig), bindAddress_(bindAddress), hotCaches_(HotContentCacheMap()),
+      errorPage_(NULL) {
     LOG_DEBUGF("<-- setup virtual server for %s", bindAddress.toString().c_str());
     this->setupRouter();
     LOG_DEBUGF("--> setup complete");
@@ -23,6 +25,18 @@ http::Router &VirtualServer::getRouter() {
     return router_;
 }
 
+http::HotContentCache *VirtualServer::findHotContentCache(const std::string &target) const {
+    const Option<http::HotContentCache *> cache = hotCaches_.match(target);
+    if (cache.isNone() || cache.unwrap() == NULL || !cache.unwrap()->isEnabled()) {
+        return NULL;
+    }
+    return cache.unwrap();
+}
+
+void VirtualServer::reloadErrorPages() {
+    errorPage_->reload();
+}
+
 // NOTE: テストなどに必要。設定に対して http::Router は一意なので、serverConfig_ だけで比較している。
 bool VirtualServer::operator==(const VirtualServer &rhs) const {
     return serverConfig_ == rhs.serverConfig_;
@@ -30,6 +44,15 @@ bool VirtualServer::operator==(const VirtualServer &rhs) const {
 
 void VirtualServer::registerHandlers(const config::LocationContext &location) {
     std::vector<http::HttpMethod> allowedMethods = location.getAllowedMethods();
+    // location の handler で共有する
+    const SharedPtr<http::OpenFileCache> cache(
+        new http::OpenFileCache(location.getDocumentRootConfig().unwrap().getOpenFileCache())
+    );
+    const SharedPtr<http::HotContentCache> hotCache(new http::HotContentCache(
+        location.getDocumentRootConfig().unwrap().getHotContentCache(),
+        location.getDocumentRootConfig().unwrap().getRoot()
+    ));
+    this->registerHotContentCache(location, hotCache);
     for (std::vector<http::HttpMethod>::const_iterator iter = allowedMethods.begin(); iter != allowedMethods.end();
          ++iter) {
         config::LocationContext::DocumentRootConfig documentRootConfig = location.getDocumentRootConfig().unwrap();
@@ -37,7 +60,7 @@ void VirtualServer::registerHandlers(const config::LocationContext &location) {
 
         switch (*iter) {
             case http::kMethodGet: {
-                handler = new http::StaticFileHandler(documentRootConfig);
+                handler = new http::StaticFileHandler(documentRootConfig, cache, hotCache);
                 break;
             }
             case http::kMethodDelete: {
@@ -60,7 +83,8 @@ void VirtualServer::registerHandlers(const config::LocationContext &location) {
             handler = new http::CgiHandler(
                 serverConfig_.getServerName().empty() ? serverConfig_.getHost() : serverConfig_.getServerName()[0],
                 documentRootConfig,
-                handler
+                handler,
+                cache
             );
         }
         router_.on(*iter, location.getPath(), handler);
@@ -74,17 +98,41 @@ void VirtualServer::setupRouter() {
         if (location.getRedirect().isSome()) {
             http::IHandler *handler = new http::RedirectHandler(location.getRedirect().unwrap());
             router_.on(location.getAllowedMethods(), location.getPath(), handler);
+            // リダイレクトはキャッシュしない
+            this->registerHotContentCache(location, SharedPtr<http::HotContentCache>(NULL));
         } else {
             this->registerHandlers(location);
         }
     }
 
+    hotCaches_ = http::Matcher<http::HotContentCache *>(hotCacheMap_);
+
     // middleware
     router_.use(new http::Logger());
-    router_.use(new http::ErrorPage(serverConfig_.getErrorPage()));
+    errorPage_ = new http::ErrorPage(serverConfig_.getErrorPage());
+    router_.use(errorPage_);
+    if (serverConfig_.getGzip().isEnabled()) {
+        // エラーページも圧縮するので、ErrorPage の外側に置く
+        router_.use(new http::Gzip(serverConfig_.getGzip()));
+    }
+}
+
+void VirtualServer::registerHotContentCache(
+    const config::LocationContext &location, const SharedPtr<http::HotContentCache> &cache
+) {
+    const std::vector<http::HttpMethod> &methods = location.getAllowedMethods();
+    if (std::find(methods.begin(), methods.end(), http::kMethodGet) != methods.end()) {
+        // 同じ path の GET は後の location で上書きされる (Router と同じ)
+        hotCacheMap_[location.getPath()] = cache.get();
+        hotCacheOwners_.push_back(cache);
+    } else {
+        // GET を許可しない location が最長一致なら 405 なので、キャッシュから返してはいけない
+        hotCacheMap_.insert(std::make_pair(location.getPath(), static_cast<http::HotContentCache *>(NULL)));
+    }
 }
 
+// リクエストごとに呼ばれるので、アドレスを文字列にせずに比べる
 bool VirtualServer::isMatch(const Address &address) const {
     return bindAddress_.getPort() == address.getPort() &&
-        (bindAddress_.getIp() == "0.0.0.0" || bindAddress_.getIp() == address.getIp());
+        (bindAddress_.isWildcard() || bindAddress_.hasSameIp(address));
 }
@@ -2,7 +2,10 @@
 #define SRC_LIB_CORE_VIRTUAL_SERVER_HPP
 
 #include "config/config.hpp"
+#include "http/handler/matcher.hpp"
+#include "http/handler/middleware/error_page.hpp"
 #include "http/handler/router.hpp"
+#include "http/hot_content_cache.hpp"
 #include "transport/address.hpp"
 
 class VirtualServer {
@@ -12,6 +15,10 @@ public:
 
     const config::ServerContext &getServerConfig() const;
     http::Router &getRouter();
+    // target を GET で処理する location の HotContentCache (キャッシュしない location なら NULL)
+    http::HotContentCache *findHotContentCache(const std::string &target) const;
+    // エラーページのファイルを読み直す (プロセス内で同時に呼ぶのは 1 スレッドだけにすること)
+    void reloadErrorPages();
 
     bool operator==(const VirtualServer &rhs) const;
     void registerHandlers(const config::LocationContext &location);
@@ -20,8 +27,19 @@ private:
     config::ServerContext serverConfig_;
     Address bindAddress_;
     http::Router router_;
+    /**
+     * location の path -> その path の GET を処理する location のキャッシュ (Router と同じく最長一致で探す)
+     * worker スレッドから同時に引かれるので、参照カウントを触らないように生ポインタで持つ (所有は hotCacheOwners_)
+     */
+    typedef std::map<std::string, http::HotContentCache *> HotContentCacheMap;
+    HotContentCacheMap hotCacheMap_;
+    http::Matcher<http::HotContentCache *> hotCaches_;
+    std::vector<SharedPtr<http::HotContentCache> > hotCacheOwners_;
+    // router_ が所有する
+    http::ErrorPage *errorPage_;
 
     void setupRouter();
+    void registerHotContentCache(const config::LocationContext &location, const SharedPtr<http::HotContentCache> &cache);
 
     // Virtual Server の検索に必要
     friend class VirtualServerResolver;
@@ -17,7 +17,7 @@ Option<Ref<VirtualServer> > VirtualServerResolver::resolve(const std::string &ho
             continue;
         }
 
-        if ((*it)->bindAddress_.getIp() == "0.0.0.0") {
+        if ((*it)->bindAddress_.isWildcard()) {
             wildcards.push_back(*it);
         } else {
             candidates.push_back(*it);
@@ -0,0 +1,83 @@
+#include "action_queue.hpp"
+#include "event_handler.hpp"
+#include "transport/connection.hpp"
+
+const std::size_t ActionQueue::kInitialCapacity;
+
+ActionQueue::ActionQueue() {
+    commands_.reserve(kInitialCapacity);
+}
+
+ActionQueue::~ActionQueue() {
+    this->discard();
+}
+
+void ActionQueue::addConnection(Connection *conn) {
+    this->pushCommand(Command::kAddConnection, conn->getFd(), 0);
+    commands_.back().conn = conn;
+}
+
+void ActionQueue::removeConnection(const int fd) {
+    this->pushCommand(Command::kRemoveConnection, fd, 0);
+}
+
+void ActionQueue::registerEventHandler(const int fd, const Event::EventType type, IEventHandler *handler) {
+    this->pushCommand(Command::kRegisterEventHandler, fd, type);
+    commands_.back().handler = handler;
+}
+
+void ActionQueue::unregisterEventHandler(const int fd, const Event::EventType type) {
+    this->pushCommand(Command::kUnregisterEventHandler, fd, type);
+}
+
+void ActionQueue::registerEvent(const Event &event) {
+    this->pushCommand(Command::kRegisterEvent, event.getFd(), event.getTypeFlags());
+}
+
+void ActionQueue::unregisterEvent(const Event &event) {
+    this->pushCommand(Command::kUnregisterEvent, event.getFd(), event.getTypeFlags());
+}
+
+void ActionQueue::keepAlive(const int fd) {
+    this->pushCommand(Command::kKeepAlive, fd, 0);
+}
+
+void ActionQueue::lingeringClose(const int fd) {
+    this->pushCommand(Command::kLingeringClose, fd, 0);
+}
+
+void ActionQueue::push(IAction *action) {
+    this->pushCommand(Command::kCustom, -1, 0);
+    commands_.back().action = action;
+}
+
+bool ActionQueue::empty() const {
+    return commands_.empty();
+}
+
+std::size_t ActionQueue::size() const {
+    return commands_.size();
+}
+
+const ActionQueue::Command &ActionQueue::operator[](const std::size_t index) const {
+    return commands_[index];
+}
+
+void ActionQueue::clear() {
+    // capacity は残るので、次からは確保が起きない
+    commands_.clear();
+}
+
+void ActionQueue::discard() {
+    for (std::vector<Command>::const_iterator it = commands_.begin(); it != commands_.end(); ++it) {
+        delete it->conn;
+        delete it->handler;
+        delete it->action;
+    }
+    commands_.clear();
+}
+
+void ActionQueue::pushCommand(const Command::Kind kind, const int fd, const uint32_t eventFlags) {
+    const Command command = {kind, fd, eventFlags, NULL, NULL, NULL};
+    commands_.push_back(command);
+}
@@ -0,0 +1,80 @@
+#ifndef SRC_LIB_EVENT_ACTION_QUEUE_HPP
+#define SRC_LIB_EVENT_ACTION_QUEUE_HPP
+
+#include "event.hpp"
+#include "utils/non_copyable.hpp"
+#include <cstddef>
+#include <vector>
+
+class Connection;
+class IEventHandler;
+class IAction;
+
+/**
+ * IEventHandler が EventLoop に実行してほしい処理を積むキュー (Command パターン)
+ * よく使う処理は POD のコマンドとして積むので、容量が足りていればヒープ確保は起きない
+ * EventLoop が 1 つ持ち、実行したら clear して使い回す
+ *
+ * EventLoop は積まれた順番通りに実行する
+ */
+class ActionQueue : public NonCopyable {
+public:
+    struct Command {
+        enum Kind {
+            kAddConnection,
+            kRemoveConnection,
+            kRegisterEventHandler,
+            kUnregisterEventHandler,
+            kRegisterEvent,
+            kUnregisterEvent,
+            // レスポンスを送り終えたコネクションで、次のリクエストを待ち始める (keep-alive のタイムアウトを設定する)
+            kKeepAlive,
+            // レスポンスを送り終えたコネクションを shutdown し、クライアントのデータを読み捨ててから閉じる
+            kLingeringClose,
+            // POD で表せない処理は IAction に任せる
+            kCustom
+        };
+
+        Kind kind;
+        int fd;
+        // kRegisterEvent, kUnregisterEvent では Event::EventType の和、handler 系では 1 bit のみ
+        uint32_t eventFlags;
+        // 以下は所有権を持つ。実行されると実行した側に移る
+        Connection *conn;
+        IEventHandler *handler;
+        IAction *action;
+    };
+
+    ActionQueue();
+    // 実行されなかったコマンドが持っているオブジェクトは解放する
+    ~ActionQueue();
+
+    void addConnection(Connection *conn);
+    void removeConnection(int fd);
+    void registerEventHandler(int fd, Event::EventType type, IEventHandler *handler);
+    void unregisterEventHandler(int fd, Event::EventType type);
+    void registerEvent(const Event &event);
+    void unregisterEvent(const Event &event);
+    void keepAlive(int fd);
+    void lingeringClose(int fd);
+    void push(IAction *action);
+
+    bool empty() const;
+    std::size_t size() const;
+    const Command &operator[](std::size_t index) const;
+
+    // 実行後に呼ぶ。所有権は実行した側に移っているので、何も解放しない
+    void clear();
+    // 実行せずに捨てる。コマンドが持っているオブジェクトは解放する
+    void discard();
+
+private:
+    // 1 回の invoke で積まれるのは高々これくらい
+    static const std::size_t kInitialCapacity = 16;
+
+    std::vector<Command> commands_;
+
+    void pushCommand(Command::Kind kind, int fd, uint32_t eventFlags);
+};
+
+#endif
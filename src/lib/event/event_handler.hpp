@@ -4,6 +4,7 @@
 #include "utils/types/error.hpp"
 #include "utils/types/result.hpp"
 #include "utils/types/option.hpp"
+#include "action_queue.hpp"
 #include "event.hpp"
 #include "transport/connection.hpp"
 #include "utils/ref.hpp"
@@ -45,7 +46,7 @@ private:
     IVirtualServerResolverFactory &resolverFactory_;
 };
 
-// IEventHandler が返す Command オブジェクト
+// ActionQueue の POD のコマンドで表せない処理 (RunCgiAction など)
 class IAction {
 public:
     virtual ~IAction() {}
@@ -53,36 +54,31 @@ public:
     virtual void execute(ActionContext &ctx) = 0;
 };
 
-// IEventHandler は Context を受けとり、IAction を返す
+// IEventHandler は Context を受けとり、実行してほしい処理を ActionQueue に積む
 class IEventHandler {
 public:
     virtual ~IEventHandler();
 
-    /**
-     * NOTE: std::vector のコピーを防ぐために、引数で参照をもらう?
-     * RVO が効けば問題にはならない。C++17 ですら保証はされていないが。
-     * https://cpprefjp.github.io/lang/cpp17/guaranteed_copy_elision.html
-     */
     /**
      * Connection の管理は Server の責務
-     * Server に実行してほしい処理を IAction オブジェクトとして返す (Command パターン)
+     * Server に実行してほしい処理を actions に積む (Command パターン)
+     * actions は EventLoop が使い回すので、イベントごとのヒープ確保は起きない
      *
-     * Server は順番通り実行すること
+     * Server は順番通り実行すること。Err を返した場合、積まれた処理は実行せずに捨てる
      */
-    typedef Result<std::vector<IAction *>, error::AppError> InvokeResult;
-    virtual InvokeResult invoke(const Context &ctx) = 0;
+    typedef Result<void, error::AppError> InvokeResult;
+    virtual InvokeResult invoke(const Context &ctx, ActionQueue &actions) = 0;
 
     struct ErrorHandleResult {
         bool shouldFallback;
-        std::vector<IAction *> actions;
 
         ErrorHandleResult() : shouldFallback(true) {}
 
-        ErrorHandleResult(const bool fallback, const std::vector<IAction *> &acts)
-            : shouldFallback(fallback), actions(acts) {}
+        explicit ErrorHandleResult(const bool fallback) : shouldFallback(fallback) {}
     };
 
-    virtual ErrorHandleResult onErrorEvent(const Context &, const Event &) {
+    // actions に積まれた処理は、shouldFallback に関わらず実行される
+    virtual ErrorHandleResult onErrorEvent(const Context &, const Event &, ActionQueue &) {
         return ErrorHandleResult();
     }
 };
@@ -2,24 +2,18 @@
 #include "utils/logger.hpp"
 #include <cstring>
 #include <cerrno>
-#include <map>
 #include <string>
-#include <sys/socket.h>
 
 IEventNotifier::~IEventNotifier() {}
 
-#if defined(__linux__) && USE_EPOLL
+#if defined(__linux__)
 
-#include <sys/epoll.h>
+EpollEventNotifier::EpollEventNotifier(const bool edgeTriggered)
+    : epollFd_(-1), edgeTriggered_(edgeTriggered), readyEvents_(kMaxEvents) {
+    LOG_INFOF("using event method: epoll%s", edgeTriggered_ ? " (edge-triggered)" : "");
 
-EpollEventNotifier::EpollEventNotifier() : epollFd_(-1) {
-    LOG_INFO("using event method: epoll");
-
-    /**
-     * epoll_create() creates a new epoll(7) instance.
-     * Since Linux 2.6.8, the size argument is ignored, but must be greater than zero.
-     */
-    epollFd_.reset(epoll_create(1));
+    // CGI の子プロセスに epoll fd を引き継がないように、close-on-exec にする
+    epollFd_.reset(epoll_create1(EPOLL_CLOEXEC));
     if (epollFd_ == -1) {
         LOG_ERRORF("failed to create epoll fd: %s", std::strerror(errno));
         return;
@@ -28,70 +22,105 @@ EpollEventNotifier::EpollEventNotifier() : epollFd_(-1) {
 }
 
 void EpollEventNotifier::registerEvent(const Event &event) {
-    const int targetFd = event.getFd();
-
-    epoll_event eev = {};
-    eev.events = EPOLLIN | EPOLLOUT;
-    eev.data.fd = targetFd;
-    const int epollOp = registeredEvents_.count(targetFd) == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-    if (epoll_ctl(epollFd_, epollOp, targetFd, &eev) == -1) {
-        LOG_WARNF("failed to add to epoll fd: %s", std::strerror(errno));
+    const int fd = event.getFd();
+    const uint32_t oldFlags = this->getRegisteredFlags(fd);
+    const uint32_t newFlags = event.getTypeFlags() & (Event::kRead | Event::kWrite);
+    // NOTE: 同じフラグでも close 後に再利用された fd の可能性があるので、省略せずに epoll_ctl を呼ぶ
+    if (!this->updateEpoll(fd, oldFlags, newFlags)) {
         return;
     }
-
-    registeredEvents_[targetFd] = event;
-    LOG_DEBUGF("fd %d added to epoll", targetFd);
+    this->setRegisteredFlags(fd, newFlags);
+    LOG_DEBUGF("fd %d registered to epoll (%u -> %u)", fd, oldFlags, newFlags);
 }
 
 void EpollEventNotifier::unregisterEvent(const Event &event) {
     const int fd = event.getFd();
-
-    const std::map<int, Event>::iterator it = registeredEvents_.find(fd);
-    if (it == registeredEvents_.end()) {
+    const uint32_t oldFlags = this->getRegisteredFlags(fd);
+    const uint32_t newFlags = oldFlags & ~event.getTypeFlags();
+    if (oldFlags == newFlags) {
         return;
     }
 
-    const uint32_t oldFlags = it->second.getTypeFlags();
-    const uint32_t rmFlags = event.getTypeFlags();
-    const uint32_t newFlags = oldFlags & ~rmFlags;
-
-    if (newFlags == 0) {
-        // 完全に削除
-        if (epoll_ctl(epollFd_.get(), EPOLL_CTL_DEL, fd, NULL) == -1) {
-            LOG_WARNF("failed to remove from epoll fd: %s", std::strerror(errno));
-            return; // 失敗時はマップを保持して不整合を避ける
-        }
-        registeredEvents_.erase(fd);
-        LOG_DEBUGF("fd %d removed from epoll", fd);
+    if (!this->updateEpoll(fd, oldFlags, newFlags)) {
         return;
     }
-
-    if (newFlags != oldFlags) {
-        registeredEvents_[fd] = Event(fd, newFlags);
-        LOG_DEBUGF("fd %d modified in epoll (%u -> %u)", fd, oldFlags, newFlags);
-    }
+    this->setRegisteredFlags(fd, newFlags);
+    LOG_DEBUGF("fd %d unregistered from epoll (%u -> %u)", fd, oldFlags, newFlags);
 }
 
-EpollEventNotifier::WaitEventsResult EpollEventNotifier::waitEvents(int timeoutMs) {
-    epoll_event evs[1024];
-    const int numEvents = epoll_wait(epollFd_.get(), evs, 1024, timeoutMs);
+EpollEventNotifier::WaitEventsResult EpollEventNotifier::waitEvents(std::vector<Event> &events, const int timeoutMs) {
+    events.clear();
+
+    const int numEvents = epoll_wait(epollFd_.get(), readyEvents_.data(), kMaxEvents, timeoutMs);
     if (numEvents == -1) {
-        LOG_ERRORF("epoll_wait failed: %s", std::strerror(errno));
+        // EINTR は caller がリトライする
+        if (errno != EINTR) {
+            LOG_ERRORF("epoll_wait failed: %s", std::strerror(errno));
+        }
         return Err(error::kUnknown);
     }
 
-    std::vector<Event> events;
-    events.reserve(numEvents);
     for (int i = 0; i < numEvents; i++) {
-        LOG_DEBUGF("epoll events: fd=%d, events=%d", evs[i].data.fd, evs[i].events);
-        const uint32_t flags = EpollEventNotifier::toEventTypeFlags(evs[i].events);
+        const int fd = readyEvents_[i].data.fd;
+        LOG_DEBUGF("epoll events: fd=%d, events=%d", fd, readyEvents_[i].events);
+        const uint32_t flags = EpollEventNotifier::toEventTypeFlags(readyEvents_[i].events);
         // エラー or イベント登録時のフラグと一致するイベントのみ返す
-        if (flags & (registeredEvents_[evs[i].data.fd].getTypeFlags() | Event::kError | Event::kHangUp)) {
-            events.push_back(Event(evs[i].data.fd, flags));
+        if (flags & (this->getRegisteredFlags(fd) | Event::kError | Event::kHangUp)) {
+            events.push_back(Event(fd, flags));
         }
     }
 
-    return Ok(events);
+    return Ok();
+}
+
+uint32_t EpollEventNotifier::getRegisteredFlags(const int fd) const {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= registeredFlags_.size()) {
+        return 0;
+    }
+    return registeredFlags_[fd];
+}
+
+void EpollEventNotifier::setRegisteredFlags(const int fd, const uint32_t flags) {
+    if (fd < 0) {
+        return;
+    }
+    if (static_cast<std::size_t>(fd) >= registeredFlags_.size()) {
+        registeredFlags_.resize(fd + 1, 0);
+    }
+    registeredFlags_[fd] = flags;
+}
+
+/**
+ * oldFlags -> newFlags になるように epoll_ctl を呼ぶ
+ * close された fd は epoll から自動で外れるため、記録と実際の状態がずれることがある
+ * その場合は ADD <-> MOD を切り替えてリトライする
+ */
+bool EpollEventNotifier::updateEpoll(const int fd, const uint32_t oldFlags, const uint32_t newFlags) {
+    if (newFlags == 0) {
+        // ENOENT, EBADF は close 済みなので、削除できたものとみなす
+        if (epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, NULL) == -1 && errno != ENOENT && errno != EBADF) {
+            LOG_WARNF("failed to remove fd %d from epoll: %s", fd, std::strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    epoll_event eev = {};
+    eev.events = this->toEpollEvents(newFlags);
+    eev.data.fd = fd;
+
+    const int op = oldFlags == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(epollFd_, op, fd, &eev) == 0) {
+        return true;
+    }
+    if ((op == EPOLL_CTL_ADD && errno == EEXIST) || (op == EPOLL_CTL_MOD && errno == ENOENT)) {
+        const int retryOp = op == EPOLL_CTL_ADD ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        if (epoll_ctl(epollFd_, retryOp, fd, &eev) == 0) {
+            return true;
+        }
+    }
+    LOG_WARNF("failed to update fd %d in epoll: %s", fd, std::strerror(errno));
+    return false;
 }
 
 uint32_t EpollEventNotifier::toEventTypeFlags(const uint32_t epollEvents) {
@@ -111,8 +140,8 @@ uint32_t EpollEventNotifier::toEventTypeFlags(const uint32_t epollEvents) {
     return flags;
 }
 
-uint32_t EpollEventNotifier::toEpollEvents(const Event &event) {
-    const uint32_t flags = event.getTypeFlags();
+// EPOLLERR, EPOLLHUP は登録しなくても通知される
+uint32_t EpollEventNotifier::toEpollEvents(const uint32_t flags) const {
     uint32_t events = 0;
     if (flags & Event::kRead) {
         events |= EPOLLIN;
@@ -120,90 +149,122 @@ uint32_t EpollEventNotifier::toEpollEvents(const Event &event) {
     if (flags & Event::kWrite) {
         events |= EPOLLOUT;
     }
-    if (flags & Event::kError) {
-        events |= EPOLLERR;
-    }
-    if (flags & Event::kHangUp) {
-        events |= EPOLLHUP;
+    if (edgeTriggered_) {
+        events |= EPOLLET;
     }
     return events;
 }
 
-#else
+#endif
 
-#include <poll.h>
+const int PollEventNotifier::kNoSlot;
 
 PollEventNotifier::PollEventNotifier() {
     LOG_INFO("using event method: poll");
 }
 
 void PollEventNotifier::registerEvent(const Event &event) {
-    registeredEvents_[event.getFd()] = event;
-    LOG_DEBUGF("fd %d added to poll", event.getFd());
+    const int fd = event.getFd();
+    const short pollEvents = toPollEvents(event.getTypeFlags());
+    const int slot = this->findSlot(fd);
+    if (pollEvents == 0) {
+        if (slot != kNoSlot) this->removeSlot(slot);
+        return;
+    }
+
+    if (slot != kNoSlot) {
+        pollFds_[slot].events = pollEvents;
+        LOG_DEBUGF("fd %d modified in poll", fd);
+        return;
+    }
+
+    pollfd pfd = {};
+    pfd.fd = fd;
+    pfd.events = pollEvents;
+    if (static_cast<std::size_t>(fd) >= slots_.size()) {
+        slots_.resize(fd + 1, kNoSlot);
+    }
+    slots_[fd] = static_cast<int>(pollFds_.size());
+    pollFds_.push_back(pfd);
+    LOG_DEBUGF("fd %d added to poll", fd);
 }
 
-/**
- * NOTE: registerEvent は上書きするが、unregister は flag を考慮して待機するイベントを変更、場合によって削除を行う
- * (非対称でちょっと嫌)
- */
 void PollEventNotifier::unregisterEvent(const Event &event) {
-    const std::map<int, Event>::iterator it = registeredEvents_.find(event.getFd());
-    if (it == registeredEvents_.end()) return;
+    const int slot = this->findSlot(event.getFd());
+    if (slot == kNoSlot) return;
 
-    const uint32_t newFlag = it->second.getTypeFlags() & ~event.getTypeFlags();
-    if (newFlag == 0) {
+    const short oldEvents = pollFds_[slot].events;
+    const short newEvents = static_cast<short>(oldEvents & ~toPollEvents(event.getTypeFlags()));
+    if (newEvents == 0) {
         LOG_DEBUGF("fd %d removed from poll", event.getFd());
-        registeredEvents_.erase(event.getFd());
-    } else if (newFlag != it->second.getTypeFlags()) {
-        LOG_DEBUGF("fd %d modified in poll (%d -> %d)", event.getFd(), it->second.getTypeFlags(), newFlag);
-        registeredEvents_[event.getFd()] = Event(event.getFd(), newFlag);
+        this->removeSlot(slot);
+    } else if (newEvents != oldEvents) {
+        LOG_DEBUGF("fd %d modified in poll (%d -> %d)", event.getFd(), oldEvents, newEvents);
+        pollFds_[slot].events = newEvents;
     }
 }
 
-IEventNotifier::WaitEventsResult PollEventNotifier::waitEvents(int timeoutMs) {
-    std::vector<pollfd> fds;
-    for (EventMap::const_iterator it = registeredEvents_.begin(); it != registeredEvents_.end(); ++it) {
-        pollfd pfd = {};
-        pfd.fd = it->first;
-        pfd.events = POLLIN | POLLOUT;
-        fds.push_back(pfd);
-    }
+IEventNotifier::WaitEventsResult PollEventNotifier::waitEvents(std::vector<Event> &events, const int timeoutMs) {
+    events.clear();
 
-    const int result = poll(fds.data(), fds.size(), timeoutMs);
+    const int result = poll(pollFds_.data(), pollFds_.size(), timeoutMs);
     if (result == -1) {
-        LOG_ERRORF("poll failed: %s", std::strerror(errno));
+        // EINTR は caller がリトライする
+        if (errno != EINTR) {
+            LOG_ERRORF("poll failed: %s", std::strerror(errno));
+        }
         return Err(error::kUnknown);
     }
 
-    std::vector<Event> events;
-    for (std::vector<pollfd>::const_iterator it = fds.begin(); it < fds.end(); ++it) {
-        const pollfd pfd = *it;
+    // 準備完了した fd の数だけ見つけたら打ち切る
+    int remaining = result;
+    for (std::size_t i = 0; i < pollFds_.size() && remaining > 0;) {
+        const pollfd &pfd = pollFds_[i];
         if (pfd.revents == 0) {
+            ++i;
             continue;
         }
-        int soerr = 0;
-        socklen_t sl = sizeof(soerr);
-        if (getsockopt(pfd.fd, SOL_SOCKET, SO_ERROR, &soerr, &sl) == 0 && soerr != 0) {
-            // POLLERR を消化する。 ないと主に Linux でエラーになることがある。
-            continue;
-        }
+        --remaining;
 
-        const uint32_t flags = PollEventNotifier::toEventTypeFlags(pfd.revents);
-        if (flags == 0) {
+        if (pfd.revents & POLLNVAL) {
+            // close 済みの fd が残っている。待っても意味がないので外す (i には末尾の要素が入る)
+            LOG_DEBUGF("fd %d is not open, removed from poll", pfd.fd);
+            this->removeSlot(static_cast<int>(i));
             continue;
         }
 
-        // エラー or イベント登録時のフラグと一致するイベントのみ返す
-        if (flags & (registeredEvents_[pfd.fd].getTypeFlags() | POLLERR | POLLHUP)) {
+        // pollfd.events には登録したイベントしか入っていないので、そのまま返してよい
+        const uint32_t flags = PollEventNotifier::toEventTypeFlags(pfd.revents);
+        if (flags != 0) {
             events.push_back(Event(pfd.fd, flags));
         }
+        ++i;
     }
 
-    return Ok(events);
+    return Ok();
+}
+
+int PollEventNotifier::findSlot(const int fd) const {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= slots_.size()) {
+        return kNoSlot;
+    }
+    return slots_[fd];
 }
 
-short PollEventNotifier::toPollEvents(const Event &event) {
-    const uint32_t flags = event.getTypeFlags();
+// 末尾の要素を削除する位置に移動して、配列を詰めたままにする
+void PollEventNotifier::removeSlot(const int slot) {
+    const int removedFd = pollFds_[slot].fd;
+    const int lastSlot = static_cast<int>(pollFds_.size()) - 1;
+    if (slot != lastSlot) {
+        pollFds_[slot] = pollFds_[lastSlot];
+        slots_[pollFds_[slot].fd] = slot;
+    }
+    pollFds_.pop_back();
+    slots_[removedFd] = kNoSlot;
+}
+
+// POLLERR, POLLHUP は登録しなくても通知される
+short PollEventNotifier::toPollEvents(const uint32_t flags) {
     short events = 0;
     if (flags & Event::kRead) {
         events |= POLLIN;
@@ -211,12 +272,6 @@ short PollEventNotifier::toPollEvents(const Event &event) {
     if (flags & Event::kWrite) {
         events |= POLLOUT;
     }
-    if (flags & Event::kError) {
-        events |= POLLERR;
-    }
-    if (flags & Event::kHangUp) {
-        events |= POLLHUP;
-    }
     return events;
 }
 
@@ -236,5 +291,3 @@ uint32_t PollEventNotifier::toEventTypeFlags(const short pollEvents) {
     }
     return flags;
 }
-
-#endif
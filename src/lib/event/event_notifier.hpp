@@ -6,53 +6,88 @@
 #include "utils/types/error.hpp"
 #include "utils/types/result.hpp"
 #include <vector>
-#include <map>
+#include <poll.h>
 
-// TODO: poll, epoll の二重管理が辛いので、今は epoll を無効化
-#define USE_EPOLL 0
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 
 class IEventNotifier {
 public:
     virtual ~IEventNotifier();
 
+    /**
+     * NOTE: registerEvent は監視するイベントを上書きするが、unregister は flag を考慮して待機するイベントを変更、
+     * 場合によって削除を行う (非対称でちょっと嫌)
+     * close 済みの fd が再利用された場合に、古いフラグが残らないように上書きにしている
+     */
     virtual void registerEvent(const Event &event) = 0;
     virtual void unregisterEvent(const Event &event) = 0;
 
-    typedef Result<std::vector<Event>, error::AppError> WaitEventsResult;
-    virtual WaitEventsResult waitEvents(int timeoutMs = 1000) = 0;
+    /**
+     * 準備完了したイベントを events に格納する (events は最初に clear される)
+     * 毎回 std::vector を確保・コピーしないように、caller のバッファを使い回す
+     */
+    typedef Result<void, error::AppError> WaitEventsResult;
+    virtual WaitEventsResult waitEvents(std::vector<Event> &events, int timeoutMs = 1000) = 0;
 };
 
+#if defined(__linux__)
 // epoll の抽象
 class EpollEventNotifier : public IEventNotifier {
 public:
-    EpollEventNotifier();
+    /**
+     * edgeTriggered の場合は EPOLLET で登録する
+     * イベントは再通知されないので、handler 側で EAGAIN まで読み書きする必要がある
+     */
+    explicit EpollEventNotifier(bool edgeTriggered = false);
 
     void registerEvent(const Event &event);
     void unregisterEvent(const Event &event);
-    WaitEventsResult waitEvents(int timeoutMs = 1000);
+    WaitEventsResult waitEvents(std::vector<Event> &events, int timeoutMs = 1000);
 
 private:
+    static const int kMaxEvents = 1024;
+
     AutoFd epollFd_;
-    typedef std::map<int, Event> EventMap;
-    EventMap registeredEvents_;
+    bool edgeTriggered_;
+    // fd を index とした、登録中のイベントフラグ (0 なら未登録)
+    // fd は小さい整数なので、map より速い
+    std::vector<uint32_t> registeredFlags_;
+    // epoll_wait の結果を受け取るバッファ。毎回確保しないように使い回す
+    std::vector<epoll_event> readyEvents_;
 
-    static uint32_t toEpollEvents(const Event &event);
+    uint32_t getRegisteredFlags(int fd) const;
+    void setRegisteredFlags(int fd, uint32_t flags);
+    bool updateEpoll(int fd, uint32_t oldFlags, uint32_t newFlags);
+    uint32_t toEpollEvents(uint32_t flags) const;
     static uint32_t toEventTypeFlags(uint32_t epollEvents);
 };
+#endif
 
+// epoll が使えない環境向けの実装
 class PollEventNotifier : public IEventNotifier {
 public:
     PollEventNotifier();
 
     void registerEvent(const Event &event);
     void unregisterEvent(const Event &event);
-    WaitEventsResult waitEvents(int timeoutMs = 1000);
+    WaitEventsResult waitEvents(std::vector<Event> &events, int timeoutMs = 1000);
 
 private:
-    typedef std::map<int, Event> EventMap;
-    EventMap registeredEvents_;
+    static const int kNoSlot = -1;
+
+    /**
+     * poll(2) にそのまま渡す、隙間のない pollfd の配列
+     * waitEvents のたびに作り直さず、register/unregister で差分だけ更新する
+     */
+    std::vector<pollfd> pollFds_;
+    // fd を index とした、pollFds_ 内の位置 (未登録なら kNoSlot)
+    std::vector<int> slots_;
 
-    static short toPollEvents(const Event &event);
+    int findSlot(int fd) const;
+    void removeSlot(int slot);
+    static short toPollEvents(uint32_t flags);
     static uint32_t toEventTypeFlags(short pollEvents);
 };
 
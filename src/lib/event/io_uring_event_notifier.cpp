@@ -0,0 +1,362 @@
+#include "io_uring_event_notifier.hpp"
+
+#if defined(__linux__)
+
+#include "utils/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const unsigned IoUringEventNotifier::kQueueDepth;
+const int IoUringEventNotifier::kMaxSubmitRetries;
+const uint64_t IoUringEventNotifier::kRemoveUserData;
+
+IoUringEventNotifier::FdState::FdState()
+    : interest(0), armed(false), armedInterest(0), armedUserData(kRemoveUserData), forceRearm(false), dirty(false) {}
+
+IoUringEventNotifier::IoUringEventNotifier()
+    : ringFd_(-1), sqRing_(MAP_FAILED), sqRingSize_(0), cqRing_(MAP_FAILED), cqRingSize_(0), sqes_(NULL),
+      sqesSize_(0), sqHead_(NULL), sqTail_(NULL), sqMask_(0), sqEntries_(0), cqHead_(NULL), cqTail_(NULL), cqMask_(0),
+      cqes_(NULL), nextGeneration_(1) {}
+
+IoUringEventNotifier::~IoUringEventNotifier() {
+    if (sqes_ != NULL) {
+        munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+        munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != MAP_FAILED) {
+        munmap(sqRing_, sqRingSize_);
+    }
+}
+
+Result<IoUringEventNotifier *, error::AppError> IoUringEventNotifier::create() {
+    IoUringEventNotifier *notifier = new IoUringEventNotifier();
+    if (notifier->setup().isErr()) {
+        delete notifier;
+        return Err(error::kUnknown);
+    }
+    LOG_INFO("using event method: io_uring");
+    return Ok(notifier);
+}
+
+Result<void, error::AppError> IoUringEventNotifier::setup() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    // io_uring の fd は close-on-exec で作られるので、CGI の子プロセスには引き継がれない
+    ringFd_.reset(static_cast<int>(syscall(__NR_io_uring_setup, kQueueDepth, &params)));
+    if (ringFd_ == -1) {
+        LOG_WARNF("io_uring_setup failed: %s", std::strerror(errno));
+        return Err(error::kUnknown);
+    }
+
+    // NODROP: CQ が溢れても完了を捨てない
+    // EXT_ARG: io_uring_enter にタイムアウトを直接渡せる
+    const uint32_t requiredFeatures = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & requiredFeatures) != requiredFeatures) {
+        LOG_WARNF("io_uring does not support required features (features: %#x)", params.features);
+        return Err(error::kUnknown);
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        cqRingSize_ = sqRingSize_;
+    }
+
+    sqRing_ = mmap(NULL, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        LOG_WARNF("failed to mmap io_uring sq ring: %s", std::strerror(errno));
+        return Err(error::kUnknown);
+    }
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ =
+            mmap(NULL, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            LOG_WARNF("failed to mmap io_uring cq ring: %s", std::strerror(errno));
+            return Err(error::kUnknown);
+        }
+    }
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_WARNF("failed to mmap io_uring sqes: %s", std::strerror(errno));
+        return Err(error::kUnknown);
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+    // sqe は ring の順に使うので、index の配列は恒等写像で固定しておく
+    unsigned *sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries_; ++i) {
+        sqArray[i] = i;
+    }
+
+    char *cq = static_cast<char *>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    LOG_DEBUGF("io_uring created (fd: %d, sq: %u, cq: %u)", ringFd_.get(), params.sq_entries, params.cq_entries);
+    return Ok();
+}
+
+void IoUringEventNotifier::registerEvent(const Event &event) {
+    const int fd = event.getFd();
+    FdState &state = this->getState(fd);
+    const uint32_t newInterest = event.getTypeFlags() & (Event::kRead | Event::kWrite);
+    // 通知済み (one-shot が発火した) の fd は reapCompletions で dirty になっているので、変更がなければ何もしない
+    if (state.interest == newInterest) {
+        return;
+    }
+    LOG_DEBUGF("fd %d registered to io_uring (%u -> %u)", fd, state.interest, newInterest);
+    state.interest = newInterest;
+    this->markDirty(fd);
+}
+
+void IoUringEventNotifier::unregisterEvent(const Event &event) {
+    const int fd = event.getFd();
+    FdState &state = this->getState(fd);
+    const uint32_t newInterest = state.interest & ~event.getTypeFlags();
+    if (state.interest == newInterest) {
+        return;
+    }
+    LOG_DEBUGF("fd %d unregistered from io_uring (%u -> %u)", fd, state.interest, newInterest);
+    state.interest = newInterest;
+    // コネクションを閉じるときは close の前に必ず unregister されるので、ここで再利用に備える
+    if (newInterest == 0) {
+        state.forceRearm = true;
+    }
+    this->markDirty(fd);
+}
+
+IEventNotifier::WaitEventsResult IoUringEventNotifier::waitEvents(std::vector<Event> &events, const int timeoutMs) {
+    events.clear();
+    this->flushChanges();
+
+    // 溜まった変更の submit と完了待ちを 1 回のシステムコールで行う
+    const unsigned minComplete = timeoutMs == 0 ? 0 : 1;
+    if (this->enter(this->countPendingSubmissions(), minComplete, timeoutMs) == -1) {
+        if (errno == EINTR) {
+            // caller がリトライする
+            return Err(error::kUnknown);
+        }
+        // ETIME: タイムアウト, EBUSY/EAGAIN: CQ を空ければ次は進める
+        if (errno != ETIME && errno != EBUSY && errno != EAGAIN) {
+            LOG_ERRORF("io_uring_enter failed: %s", std::strerror(errno));
+            return Err(error::kUnknown);
+        }
+    }
+
+    this->reapCompletions(events);
+    return Ok();
+}
+
+IoUringEventNotifier::FdState &IoUringEventNotifier::getState(const int fd) {
+    if (static_cast<std::size_t>(fd) >= states_.size()) {
+        states_.resize(fd + 1);
+    }
+    return states_[fd];
+}
+
+void IoUringEventNotifier::markDirty(const int fd) {
+    FdState &state = states_[fd];
+    if (!state.dirty) {
+        state.dirty = true;
+        dirtyFds_.push_back(fd);
+    }
+}
+
+// 溜めておいた interest の変更を SQE にする (submit は waitEvents でまとめて行う)
+void IoUringEventNotifier::flushChanges() {
+    std::size_t flushed = 0;
+    while (flushed < dirtyFds_.size() && this->flushChange(dirtyFds_[flushed])) {
+        ++flushed;
+    }
+    // SQ が空かなかった分は dirty のまま残し、次の waitEvents で submit する
+    dirtyFds_.erase(dirtyFds_.begin(), dirtyFds_.begin() + flushed);
+}
+
+// SQE が取れなかったら false (状態は変えないので、後でやり直せる)
+bool IoUringEventNotifier::flushChange(const int fd) {
+    FdState &state = states_[fd];
+
+    if (state.armed && (state.forceRearm || state.armedInterest != state.interest)) {
+        io_uring_sqe *sqe = this->getSqe();
+        if (sqe == NULL) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = state.armedUserData;
+        sqe->user_data = kRemoveUserData;
+        state.armed = false;
+    }
+    state.forceRearm = false;
+
+    if (!state.armed && state.interest != 0) {
+        io_uring_sqe *sqe = this->getSqe();
+        if (sqe == NULL) {
+            return false;
+        }
+        const uint32_t generation = nextGeneration_++;
+        if (nextGeneration_ == 0) {
+            nextGeneration_ = 1;
+        }
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = toPollEvents(state.interest);
+        sqe->user_data = toUserData(generation, fd);
+        state.armed = true;
+        state.armedInterest = state.interest;
+        state.armedUserData = sqe->user_data;
+    }
+    state.dirty = false;
+    return true;
+}
+
+/**
+ * SQ が一杯なら、待たずに submit だけして空ける
+ * CQ が溢れている (EBUSY) と、完了を刈り取るまで submit できないので、諦めて NULL を返す
+ */
+io_uring_sqe *IoUringEventNotifier::getSqe() {
+    for (int retries = 0; this->countPendingSubmissions() >= sqEntries_; ++retries) {
+        if (retries == kMaxSubmitRetries) {
+            LOG_WARN("io_uring submission queue is full, deferring changes");
+            return NULL;
+        }
+        if (this->enter(sqEntries_, 0, 0) == -1) {
+            if (errno == EBUSY || errno == EAGAIN) {
+                LOG_WARN("io_uring completion queue is full, deferring changes");
+                return NULL;
+            }
+            if (errno != EINTR) {
+                LOG_ERRORF("io_uring_enter failed: %s", std::strerror(errno));
+            }
+        }
+    }
+
+    const unsigned tail = *sqTail_;
+    io_uring_sqe *sqe = &sqes_[tail & sqMask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    // カーネルが sqe の内容を読むのは io_uring_enter の後なので、先に tail を進めてよい
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+unsigned IoUringEventNotifier::countPendingSubmissions() const {
+    return *sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+}
+
+int IoUringEventNotifier::enter(const unsigned toSubmit, const unsigned minComplete, const int timeoutMs) {
+    unsigned flags = 0;
+    if (minComplete > 0) {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+
+    if (minComplete == 0 || timeoutMs < 0) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, ringFd_.get(), toSubmit, minComplete, flags, NULL, 0));
+    }
+
+    __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+    io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+    flags |= IORING_ENTER_EXT_ARG;
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, ringFd_.get(), toSubmit, minComplete, flags, &arg, sizeof(arg))
+    );
+}
+
+void IoUringEventNotifier::reapCompletions(std::vector<Event> &events) {
+    unsigned head = *cqHead_;
+    const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head) {
+        const io_uring_cqe &cqe = cqes_[head & cqMask_];
+        if (cqe.user_data == kRemoveUserData) {
+            continue;
+        }
+
+        // 登録し直した後に届いた、古い POLL_ADD の完了 (キャンセルを含む) は無視する
+        const int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        if (static_cast<std::size_t>(fd) >= states_.size()) {
+            continue;
+        }
+        FdState &state = states_[fd];
+        if (!state.armed || state.armedUserData != cqe.user_data) {
+            continue;
+        }
+
+        // one-shot なので、次の waitEvents で登録し直す
+        state.armed = false;
+        if (cqe.res < 0) {
+            // close 済みの fd が残っている。待っても意味がないので外す
+            LOG_DEBUGF("poll on fd %d failed, removed from io_uring: %s", fd, std::strerror(-cqe.res));
+            state.interest = 0;
+            continue;
+        }
+        this->markDirty(fd);
+
+        const uint32_t flags = toEventTypeFlags(cqe.res) & (state.interest | Event::kError | Event::kHangUp);
+        if (flags != 0) {
+            events.push_back(Event(fd, flags));
+        }
+    }
+
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+uint64_t IoUringEventNotifier::toUserData(const uint32_t generation, const int fd) {
+    return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+// POLLERR, POLLHUP は登録しなくても通知される
+uint32_t IoUringEventNotifier::toPollEvents(const uint32_t flags) {
+    uint32_t events = 0;
+    if (flags & Event::kRead) {
+        events |= POLLIN;
+    }
+    if (flags & Event::kWrite) {
+        events |= POLLOUT;
+    }
+    return events;
+}
+
+uint32_t IoUringEventNotifier::toEventTypeFlags(const uint32_t pollEvents) {
+    uint32_t flags = 0;
+    if (pollEvents & POLLIN) {
+        flags |= Event::kRead;
+    }
+    if (pollEvents & POLLOUT) {
+        flags |= Event::kWrite;
+    }
+    if (pollEvents & POLLERR) {
+        flags |= Event::kError;
+    }
+    if (pollEvents & POLLHUP) {
+        flags |= Event::kHangUp;
+    }
+    return flags;
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef SRC_LIB_EVENT_IO_URING_EVENT_NOTIFIER_HPP
+#define SRC_LIB_EVENT_IO_URING_EVENT_NOTIFIER_HPP
+
+#if defined(__linux__)
+
+#include "event_notifier.hpp"
+#include "utils/auto_fd.hpp"
+#include <linux/io_uring.h>
+
+/**
+ * io_uring の IORING_OP_POLL_ADD を使った IEventNotifier
+ * liburing は使わず、io_uring_setup / io_uring_enter を直接呼ぶ
+ *
+ * register/unregister は変更を溜めておくだけで、waitEvents で 1 回の io_uring_enter にまとめて submit する
+ * POLL_ADD は one-shot なので、通知した fd は次の waitEvents で再登録する (poll と同じ level-triggered の挙動になる)
+ */
+class IoUringEventNotifier : public IEventNotifier {
+public:
+    // カーネルが io_uring を使えない場合は Err を返す (caller は他の実装にフォールバックする)
+    static Result<IoUringEventNotifier *, error::AppError> create();
+    ~IoUringEventNotifier();
+
+    void registerEvent(const Event &event);
+    void unregisterEvent(const Event &event);
+    WaitEventsResult waitEvents(std::vector<Event> &events, int timeoutMs = 1000);
+
+private:
+    static const unsigned kQueueDepth = 256;
+    // SQ が一杯のときに submit を試みる回数
+    static const int kMaxSubmitRetries = 4;
+    // POLL_REMOVE の完了は読み捨てるので、POLL_ADD と区別できる値にする
+    static const uint64_t kRemoveUserData = 0;
+
+    struct FdState {
+        // 監視したいイベント
+        uint32_t interest;
+        // 現在カーネルに登録している POLL_ADD の内容
+        bool armed;
+        uint32_t armedInterest;
+        uint64_t armedUserData;
+        // interest が一度 0 になった。close 後に再利用された fd の可能性があるので、同じ interest でも登録し直す
+        bool forceRearm;
+        bool dirty;
+
+        FdState();
+    };
+
+    AutoFd ringFd_;
+    void *sqRing_;
+    std::size_t sqRingSize_;
+    void *cqRing_;
+    std::size_t cqRingSize_;
+    io_uring_sqe *sqes_;
+    std::size_t sqesSize_;
+
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    io_uring_cqe *cqes_;
+
+    // fd を index とした状態
+    std::vector<FdState> states_;
+    // 次の waitEvents で submit が必要な fd
+    std::vector<int> dirtyFds_;
+    // user_data の上位 32 bit。同じ fd の古い完了を無視するために使う
+    uint32_t nextGeneration_;
+
+    IoUringEventNotifier();
+    Result<void, error::AppError> setup();
+
+    FdState &getState(int fd);
+    void markDirty(int fd);
+    void flushChanges();
+    bool flushChange(int fd);
+    io_uring_sqe *getSqe();
+    unsigned countPendingSubmissions() const;
+    int enter(unsigned toSubmit, unsigned minComplete, int timeoutMs);
+    void reapCompletions(std::vector<Event> &events);
+
+    static uint64_t toUserData(uint32_t generation, int fd);
+    static uint32_t toPollEvents(uint32_t flags);
+    static uint32_t toEventTypeFlags(uint32_t pollEvents);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#include "content_coding.hpp"
+#include "utils/string.hpp"
+#include "utils/types/option.hpp"
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+namespace {
+    std::string toLower(std::string str) {
+        std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+        return str;
+    }
+
+    std::string normalizeCoding(const std::string &coding) {
+        const std::string lower = toLower(utils::trim(coding));
+        return lower == "x-gzip" ? "gzip" : lower;
+    }
+
+    // qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] )
+    Option<http::QValue> parseQValue(const std::string &str) {
+        if (str.empty() || (str[0] != '0' && str[0] != '1') || str.size() > 5) {
+            return None;
+        }
+        if (str.size() > 1 && (str[1] != '.' || str.size() == 2)) {
+            return None;
+        }
+        http::QValue value = str[0] == '1' ? http::kMaxQValue : 0;
+        http::QValue scale = 100;
+        for (std::size_t i = 2; i < str.size(); ++i, scale /= 10) {
+            if (!std::isdigit(static_cast<unsigned char>(str[i]))) {
+                return None;
+            }
+            value += (str[i] - '0') * scale;
+        }
+        if (value > http::kMaxQValue) {
+            return None;
+        }
+        return Some(value);
+    }
+}
+
+http::QValue http::getAcceptedQuality(const std::string &acceptEncoding, const std::string &coding) {
+    const std::string target = normalizeCoding(coding);
+    Option<QValue> exact = None;
+    Option<QValue> wildcard = None;
+
+    const std::vector<std::string> elements = utils::split(acceptEncoding, ',');
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        // coding *( OWS ";" OWS "q=" qvalue )
+        const std::vector<std::string> params = utils::split(elements[i], ';');
+        if (params.empty()) {
+            continue;
+        }
+        const std::string name = normalizeCoding(params[0]);
+        QValue quality = kMaxQValue;
+        bool valid = true;
+        for (std::size_t j = 1; j < params.size(); ++j) {
+            const std::string param = utils::trim(params[j]);
+            if (param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') || param[1] != '=') {
+                continue;
+            }
+            const Option<QValue> parsed = parseQValue(param.substr(2));
+            valid = parsed.isSome();
+            quality = valid ? parsed.unwrap() : 0;
+        }
+        if (!valid) {
+            continue;
+        }
+        if (name == target) {
+            exact = Some(quality);
+        } else if (name == "*") {
+            wildcard = Some(quality);
+        }
+    }
+
+    if (exact.isSome()) {
+        return exact.unwrap();
+    }
+    return wildcard.isSome() ? wildcard.unwrap() : 0;
+}
@@ -0,0 +1,19 @@
+#ifndef SRC_LIB_HTTP_CONTENT_CODING_HPP
+#define SRC_LIB_HTTP_CONTENT_CODING_HPP
+
+#include <string>
+
+namespace http {
+    // q 値を 1000 倍した整数 (0 は受け入れない)
+    typedef int QValue;
+    static const QValue kMaxQValue = 1000;
+
+    /**
+     * Accept-Encoding の値で、coding (identity 以外) がどれだけ好まれるか
+     * coding が書かれていなければ "*" の q 値を使い、どちらもなければ 0
+     * q 値の書式が不正な要素は無視する。x-gzip は gzip と同じに扱う
+     */
+    QValue getAcceptedQuality(const std::string &acceptEncoding, const std::string &coding);
+}
+
+#endif
@@ -0,0 +1,383 @@
+#include "directory_listing.hpp"
+#include "http/response/response_builder.hpp"
+#include "utils/logger.hpp"
+#include "utils/string.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const std::size_t http::DirectoryListingCache::kStreamThreshold;
+
+namespace {
+    bool compareEntry(const http::DirectoryEntry &a, const http::DirectoryEntry &b) {
+        // ".." は常に先頭
+        if (a.name == ".." || b.name == "..") {
+            return a.name == ".." && b.name != "..";
+        }
+        return a.name < b.name;
+    }
+
+    std::string escapeHtml(const std::string &s) {
+        std::string res;
+        res.reserve(s.size());
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            switch (s[i]) {
+                case '&':
+                    res += "&amp;";
+                    break;
+                case '<':
+                    res += "&lt;";
+                    break;
+                case '>':
+                    res += "&gt;";
+                    break;
+                case '"':
+                    res += "&quot;";
+                    break;
+                case '\'':
+                    res += "&#39;";
+                    break;
+                default:
+                    res += s[i];
+            }
+        }
+        return res;
+    }
+
+    // href に使うため、unreserved 以外の文字を percent-encode する
+    std::string encodePath(const std::string &s) {
+        static const char kHex[] = "0123456789ABCDEF";
+        std::string res;
+        res.reserve(s.size());
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            const unsigned char c = static_cast<unsigned char>(s[i]);
+            if (std::isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~') {
+                res += static_cast<char>(c);
+                continue;
+            }
+            res += '%';
+            res += kHex[c >> 4];
+            res += kHex[c & 0xf];
+        }
+        return res;
+    }
+
+    std::string escapeJson(const std::string &s) {
+        std::string res;
+        res.reserve(s.size());
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            const unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c == '"' || c == '\\') {
+                res += '\\';
+                res += static_cast<char>(c);
+            } else if (c < 0x20) {
+                res += utils::format("\\u%04x", c);
+            } else {
+                res += static_cast<char>(c);
+            }
+        }
+        return res;
+    }
+
+    void appendHeader(std::string &buf, const std::string &target, const http::ListingFormat format) {
+        if (format == http::kListingJson) {
+            buf += "[";
+            return;
+        }
+        const std::string title = "Index of " + escapeHtml(target);
+        buf += "<!DOCTYPE html>";
+        buf += "<html>";
+        buf += "<head><title>" + title + "</title></head>";
+        buf += "<body>";
+        buf += "<h1>" + title + "</h1>";
+        buf += "<hr>";
+        buf += "<ul>";
+    }
+
+    // first はそのフォーマットで最初に出力するエントリか (JSON の区切りに使う)
+    void appendEntry(
+        std::string &buf, const http::DirectoryEntry &entry, const http::ListingFormat format, const bool first
+    ) {
+        if (format == http::kListingJson) {
+            if (!first) {
+                buf += ",";
+            }
+            buf += "{\"name\":\"" + escapeJson(entry.name) + "\",\"type\":\"";
+            buf += entry.isDirectory ? "directory" : "file";
+            buf += "\"}";
+            return;
+        }
+        const std::string suffix = entry.isDirectory ? "/" : "";
+        buf += "<li>";
+        buf += "<a href=\"" + encodePath(entry.name) + suffix + "\">";
+        buf += escapeHtml(entry.name) + suffix;
+        buf += "</a>";
+        buf += "</li>";
+    }
+
+    void appendFooter(std::string &buf, const http::ListingFormat format) {
+        if (format == http::kListingJson) {
+            buf += "]";
+            return;
+        }
+        buf += "</ul>";
+        buf += "<hr>";
+        buf += "</body>";
+        buf += "</html>";
+    }
+
+    // JSON には ".." を含めない
+    bool isListed(const http::DirectoryEntry &entry, const http::ListingFormat format) {
+        return format == http::kListingHtml || entry.name != "..";
+    }
+
+    long getMtimeNsec(const struct stat &st) {
+#if defined(__linux__)
+        return st.st_mtim.tv_nsec;
+#else
+        (void)st;
+        return 0;
+#endif
+    }
+}
+
+Result<http::DirectoryEntries, int> http::readDirectory(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        return Err(errno);
+    }
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+        const int error = errno;
+        close(fd);
+        return Err(error);
+    }
+
+    DirectoryEntries entries;
+    const dirent *dp;
+    while ((dp = readdir(dir)) != NULL) {
+        DirectoryEntry entry;
+        entry.name = dp->d_name;
+        if (entry.name == ".") {
+            continue;
+        }
+        entry.isDirectory = dp->d_type == DT_DIR;
+        if (dp->d_type == DT_UNKNOWN) {
+            // d_type に対応していないファイルシステムでは stat する
+            struct stat st = {};
+            entry.isDirectory = fstatat(dirfd(dir), dp->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+        }
+        entries.push_back(entry);
+    }
+    closedir(dir);
+    std::sort(entries.begin(), entries.end(), compareEntry);
+    return Ok(entries);
+}
+
+std::string http::renderDirectoryListing(
+    const DirectoryEntries &entries, const std::string &target, const ListingFormat format
+) {
+    std::string res;
+    appendHeader(res, target, format);
+    bool first = true;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if (!isListed(entries[i], format)) {
+            continue;
+        }
+        appendEntry(res, entries[i], format, first);
+        first = false;
+    }
+    appendFooter(res, format);
+    return res;
+}
+
+http::DirectoryListingBodySource::DirectoryListingBodySource(
+    const SharedPtr<const DirectoryEntries> &entries, const std::string &target, const ListingFormat format
+)
+    : entries_(entries), target_(target), format_(format), next_(0), listed_(0), headerDone_(false) {}
+
+Option<std::size_t> http::DirectoryListingBodySource::getLength() const {
+    return None;
+}
+
+http::IBodySource::PullResult http::DirectoryListingBodySource::pull(std::string &buf, const std::size_t max) {
+    if (!headerDone_) {
+        appendHeader(pending_, target_, format_);
+        headerDone_ = true;
+    }
+    // max を超えるまで組み立てる
+    while (pending_.size() < max && next_ <= entries_->size()) {
+        if (next_ == entries_->size()) {
+            appendFooter(pending_, format_);
+            ++next_;
+            break;
+        }
+        const DirectoryEntry &entry = (*entries_)[next_];
+        if (isListed(entry, format_)) {
+            appendEntry(pending_, entry, format_, listed_ == 0);
+            ++listed_;
+        }
+        ++next_;
+    }
+
+    const std::size_t size = std::min(max, pending_.size());
+    buf.append(pending_, 0, size);
+    pending_.erase(0, size);
+    if (pending_.empty() && next_ > entries_->size()) {
+        return Ok(kPullEnd);
+    }
+    return Ok(kPullMore);
+}
+
+http::DirectoryListingCache::DirectoryListingCache(const std::size_t maxEntries)
+    : maxEntries_(maxEntries), shardKey_() {
+    if (!this->isEnabled()) {
+        // pthread のキーの数には上限があるので、使わない location では作らない
+        return;
+    }
+    const int err = pthread_key_create(&shardKey_, &DirectoryListingCache::deleteShard);
+    if (err != 0) {
+        LOG_ERRORF("failed to create directory listing cache: %s", std::strerror(err));
+        throw std::runtime_error("failed to create directory listing cache");
+    }
+}
+
+// worker スレッドは先に終了していて、それぞれのキャッシュは deleteShard で解放済み
+http::DirectoryListingCache::~DirectoryListingCache() {
+    if (!this->isEnabled()) {
+        return;
+    }
+    deleteShard(pthread_getspecific(shardKey_));
+    pthread_key_delete(shardKey_);
+}
+
+Result<http::Response, int>
+http::DirectoryListingCache::respond(const std::string &path, const std::string &target, const ListingFormat format) {
+    if (!this->isEnabled()) {
+        const Result<DirectoryEntries, int> read = readDirectory(path);
+        if (read.isErr()) {
+            return Err(read.unwrapErr());
+        }
+        return Ok(buildResponse(SharedPtr<const DirectoryEntries>(new DirectoryEntries(read.unwrap())), target, format));
+    }
+
+    struct stat st = {};
+    if (stat(path.c_str(), &st) == -1) {
+        return Err(errno);
+    }
+    Shard &shard = this->getShard();
+    const std::map<std::string, EntryList::iterator>::iterator found = shard.index.find(path);
+    if (found != shard.index.end()) {
+        const EntryList::iterator it = found->second;
+        if (it->dev == st.st_dev && it->ino == st.st_ino && it->mtime == st.st_mtime &&
+            it->mtimeNsec == getMtimeNsec(st)) {
+            ++shard.stats.hits;
+            shard.entries.splice(shard.entries.begin(), shard.entries, it);
+            return Ok(buildResponse(*it, target, format));
+        }
+        // 変更されたので捨てる
+        shard.index.erase(found);
+        shard.entries.erase(it);
+    }
+    ++shard.stats.misses;
+
+    // 読んでいる間に変更されても次のリクエストで気づけるように、読む前の stat を記録する
+    const Result<DirectoryEntries, int> read = readDirectory(path);
+    if (read.isErr()) {
+        return Err(read.unwrapErr());
+    }
+    const SharedPtr<const DirectoryEntries> entries(new DirectoryEntries(read.unwrap()));
+    if (st.st_mtime >= std::time(NULL) - 1) {
+        // 同じ mtime のまま、さらに変更されるかもしれない
+        return Ok(buildResponse(entries, target, format));
+    }
+
+    const Entry entry = {path, st.st_dev, st.st_ino, st.st_mtime, getMtimeNsec(st), entries, None, "", None};
+    shard.entries.push_front(entry);
+    shard.index[path] = shard.entries.begin();
+    if (shard.entries.size() > maxEntries_) {
+        // 最も長く使われていないものを捨てる
+        shard.index.erase(shard.entries.back().path);
+        shard.entries.pop_back();
+        ++shard.stats.evictions;
+    }
+    return Ok(buildResponse(shard.entries.front(), target, format));
+}
+
+bool http::DirectoryListingCache::isEnabled() const {
+    return maxEntries_ > 0;
+}
+
+http::DirectoryListingCache::Stats http::DirectoryListingCache::getStats() const {
+    if (!this->isEnabled()) {
+        const Stats empty = {0, 0, 0};
+        return empty;
+    }
+    return this->getShard().stats;
+}
+
+std::size_t http::DirectoryListingCache::size() const {
+    return this->isEnabled() ? this->getShard().entries.size() : 0;
+}
+
+http::DirectoryListingCache::Shard &http::DirectoryListingCache::getShard() const {
+    Shard *shard = static_cast<Shard *>(pthread_getspecific(shardKey_));
+    if (shard == NULL) {
+        shard = new Shard();
+        shard->stats.hits = 0;
+        shard->stats.misses = 0;
+        shard->stats.evictions = 0;
+        pthread_setspecific(shardKey_, shard);
+    }
+    return *shard;
+}
+
+void http::DirectoryListingCache::deleteShard(void *shard) {
+    delete static_cast<Shard *>(shard);
+}
+
+http::Response http::DirectoryListingCache::buildResponse(
+    const SharedPtr<const DirectoryEntries> &entries, const std::string &target, const ListingFormat format
+) {
+    ResponseBuilder builder;
+    if (entries->size() > kStreamThreshold) {
+        builder.stream(SharedPtr<IBodySource>(new DirectoryListingBodySource(entries, target, format)));
+    } else {
+        const std::string body = renderDirectoryListing(*entries, target, format);
+        builder.body(body, kStatusOk).header("Content-Length", utils::toString(body.size()));
+    }
+    // Accept によって返すフォーマットが変わることを、キャッシュに知らせる
+    return builder
+        .header("Content-Type", format == kListingJson ? "application/json" : "text/html; charset=UTF-8")
+        .header("Vary", "Accept")
+        .build();
+}
+
+// 小さい一覧は、組み立てた body をエントリに残して次から使う
+http::Response
+http::DirectoryListingCache::buildResponse(Entry &entry, const std::string &target, const ListingFormat format) {
+    if (entry.entries->size() > kStreamThreshold) {
+        return buildResponse(entry.entries, target, format);
+    }
+    if (format == kListingJson) {
+        if (entry.json.isNone()) {
+            entry.json = Some(renderDirectoryListing(*entry.entries, target, format));
+        }
+    } else if (entry.html.isNone() || entry.htmlTarget != target) {
+        entry.html = Some(renderDirectoryListing(*entry.entries, target, format));
+        entry.htmlTarget = target;
+    }
+    const std::string &body = format == kListingJson ? entry.json.unwrap() : entry.html.unwrap();
+    return ResponseBuilder()
+        .body(body, kStatusOk)
+        .header("Content-Length", utils::toString(body.size()))
+        .header("Content-Type", format == kListingJson ? "application/json" : "text/html; charset=UTF-8")
+        .header("Vary", "Accept")
+        .build();
+}
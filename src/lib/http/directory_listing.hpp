@@ -0,0 +1,130 @@
+#ifndef SRC_LIB_HTTP_DIRECTORY_LISTING_HPP
+#define SRC_LIB_HTTP_DIRECTORY_LISTING_HPP
+
+#include "http/response/body_source.hpp"
+#include "http/response/response.hpp"
+#include "utils/non_copyable.hpp"
+#include "utils/shared_ptr.hpp"
+#include "utils/types/result.hpp"
+#include <ctime>
+#include <list>
+#include <map>
+#include <pthread.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace http {
+    struct DirectoryEntry {
+        std::string name;
+        bool isDirectory;
+    };
+    typedef std::vector<DirectoryEntry> DirectoryEntries;
+
+    enum ListingFormat {
+        kListingHtml,
+        kListingJson
+    };
+
+    /**
+     * ディレクトリの中身を名前順に読む ("." は含めない。".." は先頭)
+     * Err は errno
+     */
+    Result<DirectoryEntries, int> readDirectory(const std::string &path);
+    // target は一覧のタイトルに使う (HTML のみ)
+    std::string renderDirectoryListing(const DirectoryEntries &entries, const std::string &target, ListingFormat format);
+
+    /**
+     * ディレクトリの一覧を、全体を文字列にせずに少しずつ組み立てながら返す
+     * 長さは分からないので chunked で送られる
+     */
+    class DirectoryListingBodySource : public IBodySource {
+    public:
+        DirectoryListingBodySource(
+            const SharedPtr<const DirectoryEntries> &entries, const std::string &target, ListingFormat format
+        );
+
+        Option<std::size_t> getLength() const;
+        PullResult pull(std::string &buf, std::size_t max);
+
+    private:
+        SharedPtr<const DirectoryEntries> entries_;
+        std::string target_;
+        ListingFormat format_;
+        // 次に組み立てるエントリ。entries_->size() ならフッター
+        std::size_t next_;
+        // 出力したエントリの数
+        std::size_t listed_;
+        bool headerDone_;
+        // 組み立てたが、まだ取り出されていない部分
+        std::string pending_;
+    };
+
+    /**
+     * autoindex の一覧を、ディレクトリのパスごとにキャッシュする
+     * リクエストのたびにディレクトリを stat し、mtime (と inode) が変わっていなければ組み立て済みの body を返す
+     *
+     * mtime の精度では、同じ時刻の間に続けて変更されたことを区別できない
+     * そのため、mtime が現在時刻から 1 秒以内のディレクトリはキャッシュせず、毎回読む
+     *
+     * エントリ数が kStreamThreshold を超える大きいディレクトリは、一覧を文字列にせずに
+     * DirectoryListingBodySource で少しずつ組み立てて送る (読んだエントリはキャッシュする)
+     *
+     * handler は worker スレッドで共有されるので、OpenFileCache と同じくキャッシュの中身はスレッドごとに持つ
+     */
+    class DirectoryListingCache : public NonCopyable {
+    public:
+        static const std::size_t kStreamThreshold = 1000;
+
+        struct Stats {
+            std::size_t hits;
+            std::size_t misses;
+            std::size_t evictions;
+        };
+
+        // maxEntries が 0 ならキャッシュしない
+        explicit DirectoryListingCache(std::size_t maxEntries);
+        ~DirectoryListingCache();
+
+        // path のディレクトリの一覧のレスポンス。Err は errno
+        Result<Response, int> respond(const std::string &path, const std::string &target, ListingFormat format);
+
+        bool isEnabled() const;
+        // 以下はこのスレッドのキャッシュについて
+        Stats getStats() const;
+        std::size_t size() const;
+
+    private:
+        struct Entry {
+            std::string path;
+            dev_t dev;
+            ino_t ino;
+            time_t mtime;
+            long mtimeNsec;
+            SharedPtr<const DirectoryEntries> entries;
+            // 組み立て済みの body (未作成なら None)。HTML はタイトルに target を含むので、その target も持つ
+            Option<std::string> html;
+            std::string htmlTarget;
+            Option<std::string> json;
+        };
+        typedef std::list<Entry> EntryList;
+
+        // スレッドごとのキャッシュ。先頭ほど最近使った
+        struct Shard {
+            EntryList entries;
+            std::map<std::string, EntryList::iterator> index;
+            Stats stats;
+        };
+
+        std::size_t maxEntries_;
+        pthread_key_t shardKey_;
+
+        Shard &getShard() const;
+        static void deleteShard(void *shard);
+        static Response
+        buildResponse(const SharedPtr<const DirectoryEntries> &entries, const std::string &target, ListingFormat format);
+        static Response buildResponse(Entry &entry, const std::string &target, ListingFormat format);
+    };
+}
+
+#endif
@@ -0,0 +1,38 @@
+#include "etag.hpp"
+#include "utils/string.hpp"
+
+namespace {
+    bool isWeak(const std::string &etag) {
+        return utils::startsWith(etag, "W/");
+    }
+
+    std::string opaqueTag(const std::string &etag) {
+        return isWeak(etag) ? etag.substr(2) : etag;
+    }
+}
+
+std::string http::makeETag(const struct stat &st) {
+    return utils::format(
+        "\"%lx-%lx-%lx\"",
+        static_cast<unsigned long>(st.st_mtime),
+        static_cast<unsigned long>(st.st_size),
+        static_cast<unsigned long>(st.st_ino)
+    );
+}
+
+bool http::matchesIfNoneMatch(const std::string &value, const std::string &etag) {
+    if (utils::trim(value) == "*") {
+        return true;
+    }
+    const std::vector<std::string> candidates = utils::split(value, ',');
+    for (std::size_t i = 0; i < candidates.size(); ++i) {
+        if (opaqueTag(utils::trim(candidates[i])) == opaqueTag(etag)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool http::strongETagEquals(const std::string &a, const std::string &b) {
+    return !isWeak(a) && !isWeak(b) && a == b;
+}
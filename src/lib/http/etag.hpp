@@ -0,0 +1,18 @@
+#ifndef SRC_LIB_HTTP_ETAG_HPP
+#define SRC_LIB_HTTP_ETAG_HPP
+
+#include <string>
+#include <sys/stat.h>
+
+namespace http {
+    // ファイルの mtime, 大きさ, inode から作る (内容は読まない)
+    std::string makeETag(const struct stat &st);
+
+    // If-None-Match の値 ("*" またはカンマ区切りの entity-tag) に、弱い比較で一致するものがあるか
+    bool matchesIfNoneMatch(const std::string &value, const std::string &etag);
+
+    // 強い比較。どちらかが弱い entity-tag (W/ で始まる) なら一致しない
+    bool strongETagEquals(const std::string &a, const std::string &b);
+}
+
+#endif
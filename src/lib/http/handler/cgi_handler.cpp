@@ -8,7 +8,7 @@
 #include <sys/stat.h>
 
 // めんどくさくてメソッドにしてない
-static bool fileExistsUnderRoot(const std::string &docRoot, const std::string &urlPath) {
+static bool fileExistsUnderRoot(http::OpenFileCache &cache, const std::string &docRoot, const std::string &urlPath) {
     std::string fsPath = docRoot;
     if (!fsPath.empty() && fsPath.back() != '/') fsPath += '/';
     if (!urlPath.empty() && urlPath[0] == '/')
@@ -16,8 +16,8 @@ static bool fileExistsUnderRoot(const std::string &docRoot, const std::string &u
     else
         fsPath += urlPath;
 
-    struct stat st = {};
-    return ::stat(fsPath.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+    const http::OpenFileCache::LookupResult found = cache.stat(fsPath);
+    return found.isOk() && S_ISREG(found.unwrap().st.st_mode);
 }
 
 namespace http {
@@ -32,7 +32,7 @@ namespace http {
         }
         const cgi::Request &cgiRequest = createResult.unwrap();
 
-        return Left(new RunCgiAction(cgiRequest, ctx.getConnection().get().getFd()));
+        return Left(new RunCgiAction(cgiRequest, ctx.getConnection().get().getFd(), ctx.getResponseFilter()));
     }
 
     bool CgiHandler::isCgiRequest(const RequestContext &ctx) const {
@@ -56,7 +56,7 @@ namespace http {
                 // 拡張子は一致。スクリプト本体の存在確認（PATH_INFO を除いたもの）
                 const std::string script = this->getScriptName(ctx); // 例: /cgi/test.cgi
 
-                if (fileExistsUnderRoot(docRootConfig_.getRoot(), script)) {
+                if (fileExistsUnderRoot(*cache_, docRootConfig_.getRoot(), script)) {
                     return true; // 実体があるので CGI
                 }
                 return false; // 実体が無ければ CGI ではない
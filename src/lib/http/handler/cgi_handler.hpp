@@ -4,6 +4,8 @@
 #include "handler.hpp"
 #include "cgi/request.hpp"
 #include "config/config.hpp"
+#include "http/open_file_cache.hpp"
+#include "utils/shared_ptr.hpp"
 #include <string>
 
 namespace http {
@@ -14,9 +16,10 @@ namespace http {
         CgiHandler(
             const std::string &serverName,
             const config::LocationContext::DocumentRootConfig &docRootConfig,
-            IHandler *fallbackHandler
+            IHandler *fallbackHandler,
+            const SharedPtr<OpenFileCache> &cache
         )
-            : serverName_(serverName), docRootConfig_(docRootConfig), fallbackHandler_(fallbackHandler) {}
+            : serverName_(serverName), docRootConfig_(docRootConfig), fallbackHandler_(fallbackHandler), cache_(cache) {}
 
         ~CgiHandler() {
             delete fallbackHandler_;
@@ -28,6 +31,8 @@ namespace http {
         std::string serverName_;
         config::LocationContext::DocumentRootConfig docRootConfig_;
         IHandler *fallbackHandler_;
+        // スクリプトの存在確認に使う
+        SharedPtr<OpenFileCache> cache_;
 
         bool isCgiRequest(const RequestContext &ctx) const;
         Result<cgi::Request, error::AppError> createCgiRequest(const RequestContext &ctx) const;
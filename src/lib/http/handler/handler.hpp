@@ -2,6 +2,7 @@
 #define SRC_LIB_HTTP_HANDLER_HANDLER_HPP
 
 #include "../response/response.hpp"
+#include "../response/response_filter.hpp"
 #include "../request/request.hpp"
 #include "event/event_handler.hpp"
 #include "utils/types/either.hpp"
@@ -10,7 +11,7 @@ namespace http {
     class RequestContext {
     public:
         RequestContext(const Request &request, const Ref<const Connection> &connection)
-            : request_(request), connection_(connection) {}
+            : request_(request), connection_(connection), responseFilter_(NULL) {}
 
         const Request &getRequest() const {
             return request_;
@@ -20,9 +21,22 @@ namespace http {
             return connection_;
         }
 
+        // handler の外で作られるレスポンス (CGI) に適用する filter (なければ NULL)
+        const IResponseFilter *getResponseFilter() const {
+            return responseFilter_;
+        }
+
+        // filter は Router が持つ middleware などで、CGI のレスポンスを作り終えるまで生きている必要がある
+        RequestContext withResponseFilter(const IResponseFilter *filter) const {
+            RequestContext ctx(*this);
+            ctx.responseFilter_ = filter;
+            return ctx;
+        }
+
     private:
         Ref<const Request> request_;
         Ref<const Connection> connection_;
+        const IResponseFilter *responseFilter_;
     };
 
     class IHandler {
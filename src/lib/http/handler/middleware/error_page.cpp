@@ -1,9 +1,18 @@
 #include "error_page.hpp"
 #include "http/response/response_builder.hpp"
+#include "utils/logger.hpp"
 #include "utils/string.hpp"
 #include <fstream>
+#include <sstream>
 
-http::ErrorPage::ErrorPage(const config::ServerContext::ErrorPageMap &errorPage) : errorPage_(errorPage) {}
+http::ErrorPage::ErrorPage(const config::ServerContext::ErrorPageMap &errorPage) : errorPage_(errorPage) {
+    pthread_rwlock_init(&pagesLock_, NULL);
+    this->reload();
+}
+
+http::ErrorPage::~ErrorPage() {
+    pthread_rwlock_destroy(&pagesLock_);
+}
 
 Either<IAction *, http::Response> http::ErrorPage::intercept(const RequestContext &ctx, IHandler &next) {
     const Either<IAction *, Response> serveRes = next.serve(ctx);
@@ -19,31 +28,94 @@ Either<IAction *, http::Response> http::ErrorPage::intercept(const RequestContex
         return Right(res);
     }
 
-    std::string body;
-    config::ServerContext::ErrorPageMap::iterator customErrorPage = errorPage_.find(status);
-
-    if (customErrorPage != errorPage_.end()) {
-        std::ifstream file(customErrorPage->second);
-        std::stringstream buf;
-        buf << file.rdbuf();
-        body = buf.str();
-    } else {
-        // NOTE: handler のエラーレスポンスは上書きされる
-        const std::string statusStr = utils::format("%d %s", status, getHttpStatusText(status).c_str());
-        body = utils::format(
-            "<!DOCTYPE html>\n"
-            "<html>\n"
-            "<head><title>%s</title></head>\n"
-            "<body>\n"
-            "<center><h1>%s</h1></center>\n"
-            "<hr>\n"
-            "<center>webserv/0.1.0</center>\n"
-            "</body>\n"
-            "</html>\n",
-            statusStr.c_str(),
-            statusStr.c_str()
-        );
-    }
-
-    return Right(ResponseBuilder().html(body, status).build());
+    // NOTE: handler のエラーレスポンスは上書きされる
+    const Option<Response> page = this->findPage(status);
+    // 416 では、エラーページにしても Content-Range でファイルの大きさを伝える
+    const Headers::const_iterator contentRange = res.getHeaders().find("Content-Range");
+    if (page.isSome() && contentRange == res.getHeaders().end()) {
+        return Right(page.unwrap());
+    }
+
+    ResponseBuilder builder;
+    if (contentRange != res.getHeaders().end()) {
+        builder.header(contentRange->first, contentRange->second);
+    }
+    const std::string body = page.isSome() ? page.unwrap().getBody().unwrap() : makeDefaultPage(status);
+    return Right(builder.html(body, status).build());
+}
+
+void http::ErrorPage::reload() {
+    // pages_ を書き換えるのは reload だけなので、組み立てている間はロックしない (reload は同時に呼ばないこと)
+    ResponseMap pages;
+    for (int code = 400; code < 600; ++code) {
+        const Option<HttpStatusCode> status = httpStatusCodeFromInt(code);
+        if (status.isNone()) {
+            continue;
+        }
+
+        std::string body;
+        const config::ServerContext::ErrorPageMap::const_iterator custom = errorPage_.find(status.unwrap());
+        Option<std::string> file = None;
+        if (custom != errorPage_.end()) {
+            file = readFile(custom->second);
+        }
+        const ResponseMap::const_iterator loaded = pages_.find(status.unwrap());
+        if (file.isSome()) {
+            body = file.unwrap();
+        } else if (custom != errorPage_.end() && loaded != pages_.end()) {
+            LOG_WARNF("failed to reload error page, keeping the previous one: %s", custom->second.c_str());
+            pages.insert(*loaded);
+            continue;
+        } else {
+            if (custom != errorPage_.end()) {
+                LOG_WARNF("failed to read error page, using the default one: %s", custom->second.c_str());
+            }
+            body = makeDefaultPage(status.unwrap());
+        }
+        pages.insert(std::make_pair(status.unwrap(), ResponseBuilder().html(body, status.unwrap()).build()));
+    }
+    pthread_rwlock_wrlock(&pagesLock_);
+    pages_.swap(pages);
+    pthread_rwlock_unlock(&pagesLock_);
+}
+
+Option<http::Response> http::ErrorPage::findPage(const HttpStatusCode status) const {
+    pthread_rwlock_rdlock(&pagesLock_);
+    const ResponseMap::const_iterator it = pages_.find(status);
+    Option<Response> page = None;
+    if (it != pages_.end()) {
+        page = Some(it->second);
+    }
+    pthread_rwlock_unlock(&pagesLock_);
+    return page;
+}
+
+Option<std::string> http::ErrorPage::readFile(const std::string &path) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return None;
+    }
+    std::stringstream buf;
+    buf << file.rdbuf();
+    if (file.bad()) {
+        return None;
+    }
+    return Some(buf.str());
+}
+
+std::string http::ErrorPage::makeDefaultPage(const HttpStatusCode status) {
+    const std::string statusStr = utils::format("%d %s", status, getHttpStatusText(status).c_str());
+    return utils::format(
+        "<!DOCTYPE html>\n"
+        "<html>\n"
+        "<head><title>%s</title></head>\n"
+        "<body>\n"
+        "<center><h1>%s</h1></center>\n"
+        "<hr>\n"
+        "<center>webserv/0.1.0</center>\n"
+        "</body>\n"
+        "</html>\n",
+        statusStr.c_str(),
+        statusStr.c_str()
+    );
 }
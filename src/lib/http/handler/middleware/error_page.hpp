@@ -3,15 +3,40 @@
 
 #include "./middleware.hpp"
 #include "config/config.hpp"
+#include "utils/non_copyable.hpp"
+#include <map>
+#include <pthread.h>
 
 namespace http {
-    class ErrorPage : public IMiddleware {
+    /**
+     * 4xx, 5xx のレスポンスをエラーページに置き換える
+     * エラーページ (設定されたファイルと組み込みのページ) は作成時にすべて読み込み、レスポンスを組み立てておく
+     * 404 のスキャンなどでエラーが続いても、ファイルを開いたり body を組み立てたりしない
+     */
+    class ErrorPage : public IMiddleware, public NonCopyable {
     public:
         explicit ErrorPage(const config::ServerContext::ErrorPageMap &errorPage);
+        ~ErrorPage();
         Either<IAction *, Response> intercept(const RequestContext &ctx, IHandler &next);
 
+        /**
+         * 設定されたエラーページのファイルを読み直す (SIGHUP)
+         * 読めなかったファイルは、前に読み込んだページを使い続ける
+         * worker スレッドがリクエストを処理している間に呼んでもよいが、reload 同士を同時に呼んではいけない
+         */
+        void reload();
+
     private:
+        typedef std::map<HttpStatusCode, Response> ResponseMap;
+
         config::ServerContext::ErrorPageMap errorPage_;
+        ResponseMap pages_;
+        // pages_ は worker スレッドで共有し、reload だけが書き換える
+        mutable pthread_rwlock_t pagesLock_;
+
+        Option<Response> findPage(HttpStatusCode status) const;
+        static Option<std::string> readFile(const std::string &path);
+        static std::string makeDefaultPage(HttpStatusCode status);
     };
 }
 
@@ -0,0 +1,128 @@
+#include "gzip.hpp"
+#include "http/content_coding.hpp"
+#include "utils/logger.hpp"
+#include "utils/string.hpp"
+#include <algorithm>
+#include <cctype>
+#include <strings.h>
+
+namespace {
+    // CGI のヘッダーは大文字小文字がそのままなので、区別せずに探す
+    http::Headers::const_iterator findHeader(const http::Headers &headers, const char *name) {
+        for (http::Headers::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+            if (strcasecmp(it->first.c_str(), name) == 0) {
+                return it;
+            }
+        }
+        return headers.end();
+    }
+
+    void eraseHeader(http::Headers &headers, const char *name) {
+        for (http::Headers::iterator it = headers.begin(); it != headers.end();) {
+            if (strcasecmp(it->first.c_str(), name) == 0) {
+                headers.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // 圧縮すると内容が変わるので、強い ETag は弱くする (Range などで元の内容と混ざらないように)
+    void weakenETag(http::Headers &headers) {
+        const http::Headers::const_iterator etag = findHeader(headers, "ETag");
+        if (etag == headers.end() || utils::startsWith(etag->second, "W/")) {
+            return;
+        }
+        const std::string weak = "W/" + etag->second;
+        eraseHeader(headers, "ETag");
+        headers["ETag"] = weak;
+    }
+
+    void addVary(http::Headers &headers) {
+        const http::Headers::const_iterator vary = findHeader(headers, "Vary");
+        if (vary == headers.end()) {
+            headers["Vary"] = "Accept-Encoding";
+            return;
+        }
+        if (vary->second.find("Accept-Encoding") == std::string::npos && vary->second != "*") {
+            const std::string value = vary->second + ", Accept-Encoding";
+            eraseHeader(headers, "Vary");
+            headers["Vary"] = value;
+        }
+    }
+}
+
+http::Gzip::Gzip(const config::GzipConfig &config) : config_(config) {}
+
+Either<IAction *, http::Response> http::Gzip::intercept(const RequestContext &ctx, IHandler &next) {
+    const Option<std::string> acceptEncoding = ctx.getRequest().getHeader("Accept-Encoding");
+    if (acceptEncoding.isNone() || getAcceptedQuality(acceptEncoding.unwrap(), "gzip") == 0) {
+        return next.serve(ctx);
+    }
+
+    const Either<IAction *, Response> serveRes = next.serve(ctx.withResponseFilter(this));
+    if (serveRes.isLeft()) {
+        // CGI のレスポンスは、作られたときに filter が適用される
+        return serveRes;
+    }
+    return Right(this->filter(serveRes.unwrapRight()));
+}
+
+http::Response http::Gzip::filter(const Response &response) const {
+    if (!this->isCompressible(response)) {
+        return response;
+    }
+
+    Headers headers = response.getHeaders();
+    eraseHeader(headers, "Content-Length");
+    weakenETag(headers);
+    addVary(headers);
+    headers["Content-Encoding"] = "gzip";
+
+    if (response.getBodySource().isSome()) {
+        const SharedPtr<IBodySource> source(
+            new GzipBodySource(response.getBodySource().unwrap(), config_.getLevel(), &stats_)
+        );
+        return Response(response.getStatusCode(), headers, source, response.getHttpVersion());
+    }
+
+    const Option<std::string> compressed = gzipCompress(response.getBody().unwrap(), config_.getLevel(), &stats_);
+    if (compressed.isNone()) {
+        return response;
+    }
+    headers["Content-Length"] = utils::toString(compressed.unwrap().size());
+    return Response(response.getStatusCode(), headers, compressed, response.getHttpVersion());
+}
+
+http::GzipStats::Snapshot http::Gzip::getStats() const {
+    return stats_.get();
+}
+
+bool http::Gzip::isCompressible(const Response &response) const {
+    if (!config_.isEnabled() || isBodylessStatus(response.getStatusCode()) || response.getFileBody().isSome()) {
+        return false;
+    }
+    const Headers &headers = response.getHeaders();
+    // すでに圧縮されているか、Content-Range で元の内容の一部を示している
+    if (findHeader(headers, "Content-Encoding") != headers.end() || findHeader(headers, "Content-Range") != headers.end()) {
+        return false;
+    }
+    const Headers::const_iterator contentType = findHeader(headers, "Content-Type");
+    if (contentType == headers.end() || !this->isCompressibleType(contentType->second)) {
+        return false;
+    }
+
+    if (response.getBodySource().isSome()) {
+        const Option<std::size_t> length = response.getBodySource().unwrap()->getLength();
+        // 長さが分からなければ、短いかどうか分からないので圧縮する
+        return length.isNone() || length.unwrap() >= config_.getMinLength();
+    }
+    return response.getBody().isSome() && response.getBody().unwrap().size() >= config_.getMinLength();
+}
+
+bool http::Gzip::isCompressibleType(const std::string &contentType) const {
+    std::string type = utils::trim(contentType.substr(0, contentType.find(';')));
+    std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+    const std::vector<std::string> &types = config_.getTypes();
+    return std::find(types.begin(), types.end(), type) != types.end();
+}
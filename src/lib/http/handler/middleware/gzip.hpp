@@ -0,0 +1,36 @@
+#ifndef SRC_LIB_HTTP_HANDLER_MIDDLEWARE_GZIP_HPP
+#define SRC_LIB_HTTP_HANDLER_MIDDLEWARE_GZIP_HPP
+
+#include "./middleware.hpp"
+#include "config/config.hpp"
+#include "http/response/gzip.hpp"
+#include "http/response/response_filter.hpp"
+
+namespace http {
+    /**
+     * Accept-Encoding で gzip を受け入れるクライアントへのレスポンスを、gzip で圧縮する
+     * 長さの分かっている body は一度に圧縮し、IBodySource の body は書き込みながら少しずつ圧縮する (chunked で送る)
+     * CGI のレスポンスには、RequestContext で渡した filter として適用される
+     *
+     * ファイルの body は sendfile で送るために圧縮しない (圧縮済みのファイルを用意する。precompressed を参照)
+     * ErrorPage が作るエラーページも圧縮するので、ErrorPage より後に use する
+     */
+    class Gzip : public IMiddleware, public IResponseFilter {
+    public:
+        explicit Gzip(const config::GzipConfig &config);
+        Either<IAction *, Response> intercept(const RequestContext &ctx, IHandler &next);
+        Response filter(const Response &response) const;
+
+        GzipStats::Snapshot getStats() const;
+
+    private:
+        config::GzipConfig config_;
+        // filter は const だが、圧縮した結果は数える
+        mutable GzipStats stats_;
+
+        bool isCompressible(const Response &response) const;
+        bool isCompressibleType(const std::string &contentType) const;
+    };
+}
+
+#endif
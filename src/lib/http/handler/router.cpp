@@ -73,7 +73,8 @@ namespace http {
         }
 
         // on で登録された method のみ許可する
-        const MethodHandlerMap &methodHandlers = handlers_[matchResult.unwrap()];
+        // worker スレッド間で共有されるので、operator[] で map を変更しないように find を使う
+        const MethodHandlerMap &methodHandlers = handlers_.find(matchResult.unwrap())->second;
         const MethodHandlerMap::const_iterator it = methodHandlers.find(req.getMethod());
         if (it == methodHandlers.end()) {
             LOG_DEBUGF(
@@ -2,75 +2,174 @@
 #include "utils/logger.hpp"
 #include "http/response/response_builder.hpp"
 #include <fstream>
-#include <dirent.h>
 #include <cstring>
 #include <sys/stat.h>
 #include "static_file_handler.hpp"
 
+#include "http/content_coding.hpp"
+#include "http/etag.hpp"
 #include "http/mime.hpp"
+#include "http/range.hpp"
+#include "utils/time.hpp"
 
 namespace http {
     StaticFileHandler::StaticFileHandler(const config::LocationContext::DocumentRootConfig &docRootConfig)
-        : docRootConfig_(docRootConfig) {}
+        : docRootConfig_(docRootConfig), cache_(new OpenFileCache(docRootConfig.getOpenFileCache())),
+          listingCache_(new DirectoryListingCache(docRootConfig.getAutoindexCache())) {}
+
+    StaticFileHandler::StaticFileHandler(
+        const config::LocationContext::DocumentRootConfig &docRootConfig, const SharedPtr<OpenFileCache> &cache
+    )
+        : docRootConfig_(docRootConfig), cache_(cache),
+          listingCache_(new DirectoryListingCache(docRootConfig.getAutoindexCache())) {}
+
+    StaticFileHandler::StaticFileHandler(
+        const config::LocationContext::DocumentRootConfig &docRootConfig,
+        const SharedPtr<OpenFileCache> &cache,
+        const SharedPtr<HotContentCache> &hotCache
+    )
+        : docRootConfig_(docRootConfig), cache_(cache), hotCache_(hotCache),
+          listingCache_(new DirectoryListingCache(docRootConfig.getAutoindexCache())) {}
 
     Either<IAction *, Response> StaticFileHandler::serve(const RequestContext &ctx) {
         return Right(this->serveInternal(ctx.getRequest()));
     }
 
-    Result<std::string, HttpStatusCode>
-    StaticFileHandler::makeDirectoryListingHtml(const std::string &root, const std::string &target) {
-        DIR *dir = opendir((root + target).c_str());
-        if (dir == NULL) {
-            LOG_DEBUGF("failed to open directory: %s", (root + target).c_str());
-            return Err(kStatusInternalServerError);
-        }
-        const std::string title = "Index of " + target;
-        std::string res = "<!DOCTYPE html>";
-        res += "<html>";
-        res += "<head><title>" + title + "</title></head>";
-        res += "<body>";
-        res += "<h1>" + title + "</h1>";
-        res += "<hr>";
-        res += "<ul>";
-        const dirent *dp;
-        while ((dp = readdir(dir)) != NULL) {
-            const std::string dName = dp->d_name;
-            if (dName == ".") {
+    // If-Range がなければ true。あれば、その validator が今のファイルと一致するか
+    bool isIfRangeSatisfied(const Request &req, const struct stat &st) {
+        const Option<std::string> ifRange = req.getHeader("If-Range");
+        if (ifRange.isNone()) {
+            return true;
+        }
+        const std::string &validator = ifRange.unwrap();
+        if (utils::startsWith(validator, "\"") || utils::startsWith(validator, "W/")) {
+            return strongETagEquals(validator, makeETag(st));
+        }
+        return validator == utils::Time::formatHttpDate(st.st_mtime);
+    }
+
+    // クライアントのキャッシュがまだ使えるか (If-None-Match があれば If-Modified-Since は見ない)
+    bool isNotModified(const Request &req, const struct stat &st) {
+        const Option<std::string> ifNoneMatch = req.getHeader("If-None-Match");
+        if (ifNoneMatch.isSome()) {
+            return matchesIfNoneMatch(ifNoneMatch.unwrap(), makeETag(st));
+        }
+        const Option<std::string> ifModifiedSince = req.getHeader("If-Modified-Since");
+        if (ifModifiedSince.isNone()) {
+            return false;
+        }
+        const Option<std::time_t> since = utils::Time::parseHttpDate(ifModifiedSince.unwrap());
+        return since.isSome() && st.st_mtime <= since.unwrap();
+    }
+
+    /**
+     * 圧縮済みのファイル (filePath に .br, .gz を付けたもの) のうち、クライアントが受け入れるものを選ぶ
+     * q 値が同じなら br を優先する。元のファイルより古いものは、更新し忘れとみなして使わない
+     */
+    StaticFileHandler::Representation StaticFileHandler::selectRepresentation(
+        const Request &req, const struct stat &st, const std::string &filePath
+    ) const {
+        static const char *const kCodings[][2] = {{"br", ".br"}, {"gzip", ".gz"}};
+
+        Representation selected;
+        selected.path = filePath;
+        selected.st = st;
+        const Option<std::string> acceptEncoding = req.getHeader("Accept-Encoding");
+        if (!docRootConfig_.isPrecompressedEnabled() || req.getMethod() != kMethodGet || acceptEncoding.isNone()) {
+            return selected;
+        }
+
+        QValue best = 0;
+        for (std::size_t i = 0; i < sizeof(kCodings) / sizeof(kCodings[0]); ++i) {
+            const QValue quality = getAcceptedQuality(acceptEncoding.unwrap(), kCodings[i][0]);
+            if (quality <= best) {
                 continue;
             }
-            const std::string dNameLink = dName + (dp->d_type == DT_DIR ? "/" : "");
-            res += "<li>";
-            res += "<a href=\"" + dNameLink + "\">";
-            res += dName;
-            if (dp->d_type == DT_DIR) {
-                res += "/";
+            const std::string path = filePath + kCodings[i][1];
+            const OpenFileCache::LookupResult found = cache_->stat(path);
+            if (found.isErr() || !S_ISREG(found.unwrap().st.st_mode) || found.unwrap().st.st_mtime < st.st_mtime) {
+                continue;
             }
-            res += "</a>";
-            res += "</li>";
-        }
-        closedir(dir);
-        res += "</ul>";
-        res += "<hr>";
-        res += "</body>";
-        res += "</html>";
-        return Ok(res);
+            best = quality;
+            selected.path = path;
+            selected.st = found.unwrap().st;
+            selected.coding = kCodings[i][0];
+        }
+        return selected;
     }
 
-    Response buildFileResponse(const struct stat &st, const std::string &filePath) {
-        if (S_ISREG(st.st_mode)) {
-            return ResponseBuilder().file(filePath).build();
+    // Range ヘッダーがあれば、ファイルの一部だけを 206 で返す
+    Response StaticFileHandler::buildFileResponse(
+        const Request &req, const struct stat &st, const std::string &filePath
+    ) const {
+        if (!S_ISREG(st.st_mode)) {
+            LOG_DEBUGF("not a regular file: %s", filePath.c_str());
+            return ResponseBuilder().status(kStatusForbidden).build();
+        }
+
+        // 以降は、選んだファイルの stat でレスポンスを作る (ETag なども圧縮済みのファイルのもの)
+        const Representation rep = this->selectRepresentation(req, st, filePath);
+        ResponseBuilder builder;
+        if (docRootConfig_.isPrecompressedEnabled()) {
+            // Accept-Encoding によって返すファイルが変わることを、キャッシュに知らせる
+            builder.header("Vary", "Accept-Encoding");
+        }
+
+        if (req.getMethod() == kMethodGet && isNotModified(req, rep.st)) {
+            // ファイルを開かずに、stat の結果だけで返す
+            LOG_DEBUGF("not modified: %s", rep.path.c_str());
+            return builder.notModified(makeETag(rep.st), utils::Time::formatHttpDate(rep.st.st_mtime)).build();
+        }
+
+        const OpenFileCache::LookupResult opened = cache_->open(rep.path);
+        if (opened.isErr()) {
+            LOG_DEBUGF("failed to open file: %s: %s", rep.path.c_str(), std::strerror(opened.unwrapErr()));
+            return ResponseBuilder().status(opened.unwrapErr() == EACCES ? kStatusForbidden : kStatusNotFound).build();
         }
-        LOG_DEBUGF("not a regular file: %s", filePath.c_str());
-        return ResponseBuilder().status(kStatusForbidden).build();
+        const OpenFileCache::File &file = opened.unwrap();
+
+        if (rep.coding.empty()) {
+            builder.file(file.fd, file.st, file.mimeType);
+        } else {
+            // Content-Type は元のファイルのもの
+            LOG_DEBUGF("serve precompressed file: %s", rep.path.c_str());
+            builder.file(file.fd, file.st, getMimeType(filePath)).header("Content-Encoding", rep.coding);
+        }
+        const Option<std::string> range = req.getHeader("Range");
+        if (req.getMethod() != kMethodGet || range.isNone() || !isIfRangeSatisfied(req, file.st)) {
+            const Response response = builder.build();
+            // Accept-Encoding によって変わるレスポンスは、リクエストを見ずに返すキャッシュには入れられない
+            if (req.getMethod() == kMethodGet && hotCache_.get() != NULL && range.isNone() &&
+                !docRootConfig_.isPrecompressedEnabled()) {
+                hotCache_->store(req.getRequestTarget(), filePath, response);
+            }
+            return response;
+        }
+        const Result<std::vector<ByteRange>, HttpStatusCode> ranges =
+            parseRange(range.unwrap(), static_cast<std::size_t>(file.st.st_size));
+        if (ranges.isErr()) {
+            LOG_DEBUGF("range not satisfiable: %s", range.unwrap().c_str());
+            return builder.rangeNotSatisfiable().build();
+        }
+        if (!rep.coding.empty() && ranges.unwrap().size() > 1) {
+            // multipart/byteranges 全体に Content-Encoding が掛かっているように見えてしまうので、Range を無視する
+            return builder.build();
+        }
+        return builder.ranges(ranges.unwrap()).build();
     }
 
-    Response StaticFileHandler::directoryListing(const std::string &root, const std::string &target) {
-        const Result<std::string, HttpStatusCode> result = makeDirectoryListingHtml(root, target);
+    // Accept で JSON を求められたら、機械向けに JSON の一覧を返す
+    Response StaticFileHandler::directoryListing(const Request &req, const std::string &path) const {
+        const Option<std::string> accept = req.getHeader("Accept");
+        const ListingFormat format = accept.isSome() && accept.unwrap().find("application/json") != std::string::npos
+            ? kListingJson
+            : kListingHtml;
+        const Result<Response, int> result = listingCache_->respond(path, req.getRequestTarget(), format);
         if (result.isErr()) {
-            return ResponseBuilder().status(result.unwrapErr()).build();
+            LOG_DEBUGF("failed to open directory: %s: %s", path.c_str(), std::strerror(result.unwrapErr()));
+            return ResponseBuilder().status(kStatusInternalServerError).build();
         }
-        const std::string res = result.unwrap();
-        return ResponseBuilder().html(res).build();
+        return result.unwrap();
     }
 
     Response StaticFileHandler::handleDirectory(const Request &req, const std::string &path) const {
@@ -80,19 +179,20 @@ namespace http {
             return ResponseBuilder().redirect(req.getRequestTarget() + '/').build();
         }
         const std::string indexPath = path + docRootConfig_.getIndex();
-        struct stat indexBuf = {};
-        if (stat(indexPath.c_str(), &indexBuf) != -1) {
-            return buildFileResponse(indexBuf, indexPath);
+        const OpenFileCache::LookupResult index = cache_->stat(indexPath);
+        if (index.isOk()) {
+            return buildFileResponse(req, index.unwrap().st, indexPath);
         }
-        if (errno == ENOENT && docRootConfig_.isAutoindexEnabled()) {
-            return directoryListing(docRootConfig_.getRoot(), req.getRequestTarget());
+        const int error = index.unwrapErr();
+        if (error == ENOENT && docRootConfig_.isAutoindexEnabled()) {
+            return directoryListing(req, path);
         }
 
-        if (errno == ENOENT || errno == EACCES) {
+        if (error == ENOENT || error == EACCES) {
             LOG_DEBUGF("Forbidden file: %s", path.c_str());
             return ResponseBuilder().status(kStatusForbidden).build();
         }
-        LOG_ERRORF("failed to stat file: %s", std::strerror(errno));
+        LOG_ERRORF("failed to stat file: %s", std::strerror(error));
         return ResponseBuilder().status(kStatusInternalServerError).build();
     }
 
@@ -100,24 +200,26 @@ namespace http {
         const std::string path = docRootConfig_.getRoot() + req.getRequestTarget();
         LOG_DEBUGF("request target: %s", req.getRequestTarget().c_str());
 
-        struct stat buf = {};
-        if (stat(path.c_str(), &buf) == -1) {
-            if (errno == ENOENT) {
+        const OpenFileCache::LookupResult found = cache_->stat(path);
+        if (found.isErr()) {
+            const int error = found.unwrapErr();
+            if (error == ENOENT) {
                 LOG_DEBUGF("file does not exist: %s", path.c_str());
                 return ResponseBuilder().status(kStatusNotFound).build();
             }
-            if (errno == EACCES) {
-                LOG_DEBUGF("permission denied: %s", std::strerror(errno));
+            if (error == EACCES) {
+                LOG_DEBUGF("permission denied: %s", std::strerror(error));
                 return ResponseBuilder().status(kStatusForbidden).build();
             }
             LOG_DEBUGF("failed to stat file: %s", path.c_str());
             return ResponseBuilder().status(kStatusInternalServerError).build();
         }
+        const struct stat &buf = found.unwrap().st;
 
         if (S_ISDIR(buf.st_mode)) {
             return handleDirectory(req, path);
         }
 
-        return buildFileResponse(buf, path);
+        return buildFileResponse(req, buf, path);
     }
 }
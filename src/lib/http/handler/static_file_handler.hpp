@@ -3,20 +3,46 @@
 
 #include "handler.hpp"
 #include "config/config.hpp"
+#include "http/directory_listing.hpp"
+#include "http/hot_content_cache.hpp"
+#include "http/open_file_cache.hpp"
+#include "utils/shared_ptr.hpp"
 
 namespace http {
     class StaticFileHandler : public IHandler {
     public:
         explicit StaticFileHandler(const config::LocationContext::DocumentRootConfig &docRootConfig);
+        // CgiHandler などと同じ OpenFileCache を使う
+        StaticFileHandler(
+            const config::LocationContext::DocumentRootConfig &docRootConfig, const SharedPtr<OpenFileCache> &cache
+        );
+        // 返したファイルのレスポンスを hotCache に入れる (ReadRequestHandler が handler を通さずに返せるように)
+        StaticFileHandler(
+            const config::LocationContext::DocumentRootConfig &docRootConfig,
+            const SharedPtr<OpenFileCache> &cache,
+            const SharedPtr<HotContentCache> &hotCache
+        );
         Either<IAction *, Response> serve(const RequestContext &ctx);
 
     private:
+        // クライアントに返すファイル (圧縮済みのファイルを選んだ場合は、元のファイルとは別)
+        struct Representation {
+            std::string path;
+            struct stat st;
+            // Content-Encoding。元のファイルなら空
+            std::string coding;
+        };
+
         config::LocationContext::DocumentRootConfig docRootConfig_;
+        SharedPtr<OpenFileCache> cache_;
+        // NULL ならキャッシュしない
+        SharedPtr<HotContentCache> hotCache_;
+        SharedPtr<DirectoryListingCache> listingCache_;
 
-        static Result<std::string, HttpStatusCode>
-        makeDirectoryListingHtml(const std::string &root, const std::string &target);
-        static Response directoryListing(const std::string &root, const std::string &target);
+        Response directoryListing(const Request &req, const std::string &path) const;
         Response handleDirectory(const Request &req, const std::string &path) const;
+        Response buildFileResponse(const Request &req, const struct stat &st, const std::string &filePath) const;
+        Representation selectRepresentation(const Request &req, const struct stat &st, const std::string &filePath) const;
         Response serveInternal(const Request &req) const;
     };
 }
@@ -0,0 +1,302 @@
+#include "hot_content_cache.hpp"
+#include "http/response/response_serializer.hpp"
+#include "utils/logger.hpp"
+#include "utils/string.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+namespace {
+#if defined(__linux__)
+    // ファイルの内容・メタデータの変更、ファイル・ディレクトリ自体の置き換えや削除
+    const uint32_t kWatchMask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+        IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+#endif
+
+    std::string parentDirectory(const std::string &path) {
+        const std::size_t slash = path.rfind('/');
+        if (slash == std::string::npos) {
+            return ".";
+        }
+        return slash == 0 ? "/" : path.substr(0, slash);
+    }
+
+    bool isSameFile(const struct stat &a, const struct stat &b) {
+        return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size && a.st_mtime == b.st_mtime;
+    }
+}
+
+http::HotContentCache::HotContentCache(const config::HotContentCacheConfig &config, const std::string &root)
+    : config_(config), root_(root), shardKey_() {
+    if (!this->isEnabled()) {
+        // pthread のキーの数には上限があるので、使わない location では作らない
+        return;
+    }
+    const int err = pthread_key_create(&shardKey_, &HotContentCache::deleteShard);
+    if (err != 0) {
+        LOG_ERRORF("failed to create hot content cache: %s", std::strerror(err));
+        throw std::runtime_error("failed to create hot content cache");
+    }
+}
+
+// worker スレッドは先に終了していて、それぞれのキャッシュは deleteShard で解放済み
+http::HotContentCache::~HotContentCache() {
+    if (!this->isEnabled()) {
+        return;
+    }
+    deleteShard(pthread_getspecific(shardKey_));
+    pthread_key_delete(shardKey_);
+}
+
+bool http::HotContentCache::isEnabled() const {
+#if defined(__linux__)
+    return config_.getMaxBytes() > 0;
+#else
+    return false;
+#endif
+}
+
+bool http::HotContentCache::isCacheableSize(const std::size_t size) const {
+    return this->isEnabled() && size <= config_.getMaxFileSize();
+}
+
+const http::HotContentCache::Content *http::HotContentCache::lookup(const std::string &target) {
+    if (!this->isEnabled()) {
+        return NULL;
+    }
+    Shard &shard = this->getShard();
+    this->drainEvents(shard);
+
+    const std::map<std::string, EntryList::iterator>::const_iterator found = shard.index.find(target);
+    if (found == shard.index.end()) {
+        ++shard.stats.misses;
+        return NULL;
+    }
+    // 使ったエントリを先頭に移す
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    ++shard.stats.hits;
+    return &found->second->content;
+}
+
+void http::HotContentCache::store(const std::string &target, const std::string &filePath, const Response &response) {
+    if (!this->isEnabled() || response.getStatusCode() != kStatusOk || response.getFileBody().isNone()) {
+        return;
+    }
+    const FileBody &file = response.getFileBody().unwrap();
+    if (!this->isCacheableSize(file.getLength())) {
+        return;
+    }
+    Shard &shard = this->getShard();
+    if (shard.inotifyFd == -1) {
+        return;
+    }
+
+    // 読む前に監視を始める。読んでいる間の変更は、次の lookup で捨てられる
+    this->watchAncestors(shard, filePath);
+    // OpenFileCache の fd が古いファイルを指しているかもしれないので、今のファイルと同じか確かめる
+    struct stat opened = {};
+    struct stat current = {};
+    if (fstat(file.getFd()->get(), &opened) == -1 || stat(filePath.c_str(), &current) == -1 ||
+        !isSameFile(opened, current)) {
+        return;
+    }
+
+    Entry entry;
+    entry.target = target;
+    entry.filePath = filePath;
+    Headers headers = response.getHeaders();
+    headers["Content-Length"] = utils::toString(file.getLength());
+    entry.content.headerPrefix = ResponseSerializer::serializeHeaderPrefix(response.getStatusCode(), headers);
+    entry.content.body.resize(file.getLength());
+    std::size_t done = 0;
+    while (done < file.getLength()) {
+        const ssize_t bytesRead =
+            pread(file.getFd()->get(), &entry.content.body[done], file.getLength() - done, file.getOffset() + done);
+        if (bytesRead <= 0) {
+            return;
+        }
+        done += bytesRead;
+    }
+    entry.bytes = entry.target.size() + entry.filePath.size() + entry.content.headerPrefix.size() + file.getLength();
+    if (entry.bytes > config_.getMaxBytes()) {
+        return;
+    }
+
+    const std::map<std::string, EntryList::iterator>::iterator old = shard.index.find(target);
+    if (old != shard.index.end()) {
+        erase(shard, old->second);
+    }
+    while (shard.bytes + entry.bytes > config_.getMaxBytes()) {
+        // 最も長く使われていないものを捨てる
+        erase(shard, --shard.entries.end());
+        ++shard.stats.evictions;
+    }
+    shard.entries.push_front(entry);
+    shard.index[target] = shard.entries.begin();
+    shard.fileIndex.insert(std::make_pair(filePath, shard.entries.begin()));
+    shard.bytes += entry.bytes;
+}
+
+http::HotContentCache::Stats http::HotContentCache::getStats() const {
+    if (!this->isEnabled()) {
+        const Stats empty = {0, 0, 0, 0};
+        return empty;
+    }
+    return this->getShard().stats;
+}
+
+std::size_t http::HotContentCache::size() const {
+    return this->isEnabled() ? this->getShard().entries.size() : 0;
+}
+
+std::size_t http::HotContentCache::bytes() const {
+    return this->isEnabled() ? this->getShard().bytes : 0;
+}
+
+http::HotContentCache::Shard &http::HotContentCache::getShard() const {
+    Shard *shard = static_cast<Shard *>(pthread_getspecific(shardKey_));
+    if (shard != NULL) {
+        return *shard;
+    }
+
+    shard = new Shard();
+    shard->inotifyFd = -1;
+    shard->bytes = 0;
+    shard->lastDrained = 0;
+    const Stats stats = {0, 0, 0, 0};
+    shard->stats = stats;
+    pthread_setspecific(shardKey_, shard);
+#if defined(__linux__)
+    shard->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (shard->inotifyFd == -1) {
+        // 変更を知る手段がないので、このスレッドではキャッシュしない
+        LOG_WARNF("failed to initialize inotify: %s", std::strerror(errno));
+        return *shard;
+    }
+    this->watchDirectory(*shard, root_);
+#endif
+    return *shard;
+}
+
+void http::HotContentCache::watchDirectory(Shard &shard, const std::string &dir) const {
+#if defined(__linux__)
+    // 同じディレクトリなら同じ watch descriptor が返る
+    const int wd = inotify_add_watch(shard.inotifyFd, dir.c_str(), kWatchMask);
+    if (wd == -1) {
+        LOG_WARNF("failed to watch %s: %s", dir.c_str(), std::strerror(errno));
+        return;
+    }
+    shard.watches[wd] = dir;
+#else
+    (void)shard;
+    (void)dir;
+#endif
+}
+
+// root からファイルまでの間のディレクトリをすべて監視する
+// 途中のディレクトリが置き換えられると、親ディレクトリにしかイベントが来ないため
+void http::HotContentCache::watchAncestors(Shard &shard, const std::string &filePath) const {
+    std::string root = root_;
+    while (root.size() > 1 && root[root.size() - 1] == '/') {
+        root.erase(root.size() - 1);
+    }
+    const std::string prefix = root == "/" ? root : root + "/";
+    std::string dir = parentDirectory(filePath);
+    while (true) {
+        this->watchDirectory(shard, dir);
+        // root の外には出ない (root 自体は getShard で監視している)
+        if (dir == root || !utils::startsWith(dir, prefix)) {
+            return;
+        }
+        dir = parentDirectory(dir);
+    }
+}
+
+// 溜まっている inotify のイベントを読んで、変更されたファイルのエントリを捨てる
+void http::HotContentCache::drainEvents(Shard &shard) const {
+#if defined(__linux__)
+    const utils::Time::Millis now = utils::Time::getCachedMonotonicMillis();
+    if (shard.inotifyFd == -1 || now == shard.lastDrained) {
+        return;
+    }
+    shard.lastDrained = now;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        const ssize_t len = read(shard.inotifyFd, buf, sizeof(buf));
+        if (len <= 0) {
+            return;
+        }
+        for (ssize_t offset = 0; offset < len;) {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(buf + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // 取りこぼしたので、すべて捨てる
+                while (!shard.entries.empty()) {
+                    erase(shard, shard.entries.begin());
+                    ++shard.stats.invalidations;
+                }
+                continue;
+            }
+            const std::map<int, std::string>::iterator watch = shard.watches.find(event->wd);
+            if (watch == shard.watches.end()) {
+                continue;
+            }
+            if (event->len > 0) {
+                // 名前がファイルかディレクトリかは分からないので、どちらとしても捨てる
+                const std::string path = watch->second + "/" + event->name;
+                invalidate(shard, path, false);
+                invalidate(shard, path, true);
+            } else {
+                // ディレクトリ自体が削除・移動された
+                invalidate(shard, watch->second, true);
+            }
+            if (event->mask & IN_IGNORED) {
+                shard.watches.erase(watch);
+            }
+        }
+    }
+#else
+    (void)shard;
+#endif
+}
+
+void http::HotContentCache::invalidate(Shard &shard, const std::string &path, const bool directory) {
+    const std::string prefix = directory ? path + "/" : path;
+    FileIndex::iterator it = shard.fileIndex.lower_bound(prefix);
+    while (it != shard.fileIndex.end() && (directory ? utils::startsWith(it->first, prefix) : it->first == prefix)) {
+        // erase で今の要素は消えるので、先に進めておく
+        const EntryList::iterator entry = it->second;
+        ++it;
+        LOG_DEBUGF("invalidate hot content cache: %s", entry->target.c_str());
+        erase(shard, entry);
+        ++shard.stats.invalidations;
+    }
+}
+
+void http::HotContentCache::erase(Shard &shard, const EntryList::iterator it) {
+    std::pair<FileIndex::iterator, FileIndex::iterator> range = shard.fileIndex.equal_range(it->filePath);
+    for (; range.first != range.second; ++range.first) {
+        if (range.first->second == it) {
+            shard.fileIndex.erase(range.first);
+            break;
+        }
+    }
+    shard.bytes -= it->bytes;
+    shard.index.erase(it->target);
+    shard.entries.erase(it);
+}
+
+void http::HotContentCache::deleteShard(void *shard) {
+    Shard *s = static_cast<Shard *>(shard);
+    if (s != NULL && s->inotifyFd != -1) {
+        close(s->inotifyFd);
+    }
+    delete s;
+}
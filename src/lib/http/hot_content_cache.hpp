@@ -0,0 +1,96 @@
+#ifndef SRC_LIB_HTTP_HOT_CONTENT_CACHE_HPP
+#define SRC_LIB_HTTP_HOT_CONTENT_CACHE_HPP
+
+#include "config/config.hpp"
+#include "http/response/response.hpp"
+#include "utils/non_copyable.hpp"
+#include "utils/time.hpp"
+#include <list>
+#include <map>
+#include <pthread.h>
+#include <string>
+
+namespace http {
+    /**
+     * 小さいファイルの 200 レスポンスを、ヘッダーと body を組み立てた状態でメモリに持つ
+     * ヒットしたリクエストは handler を通さず、ファイルシステムにも触れずにそのまま書き込みキューに積む
+     *
+     * 使うメモリは maxBytes までで、超えたら最も長く使われていないものから捨てる (LRU)
+     * ファイルの変更は inotify で root とキャッシュしたファイルのディレクトリを監視して知り、そのエントリを捨てる
+     * inotify のイベントは lookup のときに読む (1 ms に 1 回まで)
+     *
+     * handler は worker スレッドで共有されるので、OpenFileCache と同じくキャッシュの中身はスレッドごとに持つ
+     * NOTE: inotify がない環境 (Linux 以外) では何もキャッシュしない
+     */
+    class HotContentCache : public NonCopyable {
+    public:
+        struct Content {
+            // Date と Connection を除いたヘッダー部分 (ResponseSerializer::completeHeader で残りを付ける)
+            std::string headerPrefix;
+            std::string body;
+        };
+
+        struct Stats {
+            std::size_t hits;
+            std::size_t misses;
+            std::size_t evictions;
+            std::size_t invalidations;
+        };
+
+        HotContentCache(const config::HotContentCacheConfig &config, const std::string &root);
+        ~HotContentCache();
+
+        bool isEnabled() const;
+        // キャッシュできる大きさのファイルか
+        bool isCacheableSize(std::size_t size) const;
+
+        // 返したポインタは、このスレッドで次にキャッシュを操作するまで有効
+        const Content *lookup(const std::string &target);
+        // filePath の内容を body にした response を、target に対するレスポンスとしてキャッシュする
+        void store(const std::string &target, const std::string &filePath, const Response &response);
+
+        // 以下はこのスレッドのキャッシュについて
+        Stats getStats() const;
+        std::size_t size() const;
+        std::size_t bytes() const;
+
+    private:
+        struct Entry {
+            std::string target;
+            std::string filePath;
+            Content content;
+            std::size_t bytes;
+        };
+        typedef std::list<Entry> EntryList;
+        // filePath -> エントリ。同じファイルを別の target でキャッシュすることがあるので multimap
+        // 順序付きなので、ディレクトリの下のファイルのエントリは連続する
+        typedef std::multimap<std::string, EntryList::iterator> FileIndex;
+
+        // スレッドごとのキャッシュ。先頭ほど最近使った
+        struct Shard {
+            int inotifyFd;
+            // watch descriptor -> ディレクトリ
+            std::map<int, std::string> watches;
+            EntryList entries;
+            std::map<std::string, EntryList::iterator> index;
+            FileIndex fileIndex;
+            std::size_t bytes;
+            utils::Time::Millis lastDrained;
+            Stats stats;
+        };
+
+        config::HotContentCacheConfig config_;
+        std::string root_;
+        pthread_key_t shardKey_;
+
+        Shard &getShard() const;
+        void watchDirectory(Shard &shard, const std::string &dir) const;
+        void watchAncestors(Shard &shard, const std::string &filePath) const;
+        void drainEvents(Shard &shard) const;
+        static void invalidate(Shard &shard, const std::string &path, bool directory);
+        static void erase(Shard &shard, EntryList::iterator it);
+        static void deleteShard(void *shard);
+    };
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "open_file_cache.hpp"
+#include "http/mime.hpp"
+#include "utils/logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+http::OpenFileCache::OpenFileCache(const config::OpenFileCacheConfig &config) : config_(config), shardKey_() {
+    if (!this->isEnabled()) {
+        // pthread のキーの数には上限があるので、使わない location では作らない
+        return;
+    }
+    const int err = pthread_key_create(&shardKey_, &OpenFileCache::deleteShard);
+    if (err != 0) {
+        LOG_ERRORF("failed to create open file cache: %s", std::strerror(err));
+        throw std::runtime_error("failed to create open file cache");
+    }
+}
+
+// worker スレッドは先に終了していて、それぞれのキャッシュは deleteShard で解放済み
+http::OpenFileCache::~OpenFileCache() {
+    if (!this->isEnabled()) {
+        return;
+    }
+    deleteShard(pthread_getspecific(shardKey_));
+    pthread_key_delete(shardKey_);
+}
+
+http::OpenFileCache::LookupResult http::OpenFileCache::stat(const std::string &path) {
+    return this->lookup(path, false);
+}
+
+http::OpenFileCache::LookupResult http::OpenFileCache::open(const std::string &path) {
+    return this->lookup(path, true);
+}
+
+http::OpenFileCache::Stats http::OpenFileCache::getStats() const {
+    if (!this->isEnabled()) {
+        const Stats empty = {0, 0, 0};
+        return empty;
+    }
+    return this->getShard().stats;
+}
+
+std::size_t http::OpenFileCache::size() const {
+    return this->isEnabled() ? this->getShard().entries.size() : 0;
+}
+
+bool http::OpenFileCache::isEnabled() const {
+    return config_.getMaxEntries() > 0;
+}
+
+http::OpenFileCache::LookupResult http::OpenFileCache::lookup(const std::string &path, const bool open) {
+    if (!this->isEnabled()) {
+        Entry entry = makeEntry(path);
+        refresh(entry, open);
+        return toResult(entry);
+    }
+
+    Shard &shard = this->getShard();
+    const utils::Time::Millis now = utils::Time::getCachedMonotonicMillis();
+    const std::map<std::string, EntryList::iterator>::iterator found = shard.index.find(path);
+    if (found == shard.index.end()) {
+        ++shard.stats.misses;
+        Entry entry = makeEntry(path);
+        refresh(entry, open);
+        if (entry.error != 0 && !this->isCacheable(entry.error)) {
+            return Err(entry.error);
+        }
+        entry.validUntil = now + config_.getValidMs();
+        shard.entries.push_front(entry);
+        shard.index[path] = shard.entries.begin();
+        if (shard.entries.size() > config_.getMaxEntries()) {
+            // 最も長く使われていないものを捨てる
+            shard.index.erase(shard.entries.back().path);
+            shard.entries.pop_back();
+            ++shard.stats.evictions;
+        }
+        return toResult(shard.entries.front());
+    }
+
+    // 使ったエントリを先頭に移す
+    const EntryList::iterator it = found->second;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it);
+    Entry &entry = *it;
+    const bool needsOpen =
+        open && entry.error == 0 && entry.file.fd.get() == NULL && S_ISREG(entry.file.st.st_mode);
+    if (now < entry.validUntil && !needsOpen) {
+        ++shard.stats.hits;
+        return toResult(entry);
+    }
+
+    ++shard.stats.misses;
+    refresh(entry, open);
+    if (entry.error != 0 && !this->isCacheable(entry.error)) {
+        const int error = entry.error;
+        shard.index.erase(found);
+        shard.entries.erase(it);
+        return Err(error);
+    }
+    entry.validUntil = now + config_.getValidMs();
+    return toResult(entry);
+}
+
+http::OpenFileCache::Shard &http::OpenFileCache::getShard() const {
+    Shard *shard = static_cast<Shard *>(pthread_getspecific(shardKey_));
+    if (shard == NULL) {
+        shard = new Shard();
+        shard->stats.hits = 0;
+        shard->stats.misses = 0;
+        shard->stats.evictions = 0;
+        pthread_setspecific(shardKey_, shard);
+    }
+    return *shard;
+}
+
+// ファイルがないことだけをキャッシュする (権限などのエラーは毎回確かめる)
+bool http::OpenFileCache::isCacheable(const int error) const {
+    return config_.isCacheErrorsEnabled() && (error == ENOENT || error == ENOTDIR);
+}
+
+void http::OpenFileCache::deleteShard(void *shard) {
+    delete static_cast<Shard *>(shard);
+}
+
+http::OpenFileCache::Entry http::OpenFileCache::makeEntry(const std::string &path) {
+    Entry entry;
+    entry.path = path;
+    entry.validUntil = 0;
+    entry.error = 0;
+    std::memset(&entry.file.st, 0, sizeof(entry.file.st));
+    entry.file.mimeType = getMimeType(path);
+    return entry;
+}
+
+// stat し直す。前と同じファイルのままなら、開いている fd はそのまま使う
+void http::OpenFileCache::refresh(Entry &entry, const bool open) {
+    struct stat st = {};
+    if (::stat(entry.path.c_str(), &st) == -1) {
+        entry.error = errno;
+        entry.file.fd = SharedPtr<AutoFd>();
+        return;
+    }
+    if (entry.error != 0 || !isSameFile(st, entry.file.st)) {
+        entry.file.fd = SharedPtr<AutoFd>();
+    }
+    entry.error = 0;
+    entry.file.st = st;
+    if (!open || !S_ISREG(st.st_mode) || entry.file.fd.get() != NULL) {
+        return;
+    }
+
+    const int fd = ::open(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        entry.error = errno;
+        return;
+    }
+    entry.file.fd = SharedPtr<AutoFd>(new AutoFd(fd));
+    // stat と open の間に置き換えられたかもしれないので、開いたファイルの情報にする
+    fstat(fd, &entry.file.st);
+}
+
+bool http::OpenFileCache::isSameFile(const struct stat &a, const struct stat &b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size && a.st_mtime == b.st_mtime;
+}
+
+http::OpenFileCache::LookupResult http::OpenFileCache::toResult(const Entry &entry) {
+    if (entry.error != 0) {
+        return Err(entry.error);
+    }
+    return Ok(entry.file);
+}
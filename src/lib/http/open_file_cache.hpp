@@ -0,0 +1,88 @@
+#ifndef SRC_LIB_HTTP_OPEN_FILE_CACHE_HPP
+#define SRC_LIB_HTTP_OPEN_FILE_CACHE_HPP
+
+#include "config/config.hpp"
+#include "utils/auto_fd.hpp"
+#include "utils/non_copyable.hpp"
+#include "utils/shared_ptr.hpp"
+#include "utils/time.hpp"
+#include "utils/types/result.hpp"
+#include <list>
+#include <map>
+#include <pthread.h>
+#include <string>
+#include <sys/stat.h>
+
+namespace http {
+    /**
+     * 静的ファイルの stat の結果、開いた fd と MIME type を、パスごとにキャッシュする (nginx の open_file_cache)
+     * ファイルがないこと (ENOENT, ENOTDIR) もキャッシュできる
+     *
+     * エントリは validMs の間そのまま使い、期限が切れたら stat し直す。同じファイルのままなら fd も使い続ける
+     * エントリの数は maxEntries までで、超えたら最も長く使われていないものから捨てる (LRU)
+     *
+     * handler は worker スレッドで共有されるが、fd の参照カウント (SharedPtr) はスレッドセーフでないので、
+     * キャッシュの中身はスレッドごとに持つ
+     */
+    class OpenFileCache : public NonCopyable {
+    public:
+        struct File {
+            struct stat st;
+            // open で取得した場合のみ (regular file)。それ以外は NULL
+            SharedPtr<AutoFd> fd;
+            std::string mimeType;
+        };
+        // Err は errno
+        typedef Result<File, int> LookupResult;
+
+        struct Stats {
+            std::size_t hits;
+            std::size_t misses;
+            std::size_t evictions;
+        };
+
+        explicit OpenFileCache(const config::OpenFileCacheConfig &config);
+        ~OpenFileCache();
+
+        // path を stat する
+        LookupResult stat(const std::string &path);
+        // path を stat し、regular file なら開く
+        LookupResult open(const std::string &path);
+
+        bool isEnabled() const;
+        // 以下はこのスレッドのキャッシュについて
+        Stats getStats() const;
+        std::size_t size() const;
+
+    private:
+        struct Entry {
+            std::string path;
+            utils::Time::Millis validUntil;
+            // 0 ならファイルがある
+            int error;
+            File file;
+        };
+        typedef std::list<Entry> EntryList;
+
+        // スレッドごとのキャッシュ。先頭ほど最近使った
+        struct Shard {
+            EntryList entries;
+            std::map<std::string, EntryList::iterator> index;
+            Stats stats;
+        };
+
+        config::OpenFileCacheConfig config_;
+        pthread_key_t shardKey_;
+
+        LookupResult lookup(const std::string &path, bool open);
+        Shard &getShard() const;
+        bool isCacheable(int error) const;
+        static void deleteShard(void *shard);
+        static Entry makeEntry(const std::string &path);
+        static void refresh(Entry &entry, bool open);
+        static bool isSameFile(const struct stat &a, const struct stat &b);
+        static LookupResult toResult(const Entry &entry);
+    };
+}
+
+#endif
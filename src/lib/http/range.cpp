@@ -0,0 +1,137 @@
+#include "range.hpp"
+#include "utils/string.hpp"
+#include <cctype>
+#include <limits>
+
+namespace {
+    // 数字以外を含めば None。大きすぎる値は size_t の最大値に丸める
+    Option<std::size_t> parsePosition(const std::string &str) {
+        if (str.empty()) {
+            return None;
+        }
+        std::size_t value = 0;
+        for (std::size_t i = 0; i < str.size(); ++i) {
+            if (!std::isdigit(static_cast<unsigned char>(str[i]))) {
+                return None;
+            }
+            const std::size_t digit = str[i] - '0';
+            if (value > (std::numeric_limits<std::size_t>::max() - digit) / 10) {
+                value = std::numeric_limits<std::size_t>::max();
+            } else {
+                value = value * 10 + digit;
+            }
+        }
+        return Some(value);
+    }
+
+    bool equalsIgnoreCase(const std::string &a, const std::string &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    enum SpecResult { kSpecInvalid, kSpecUnsatisfiable, kSpecSatisfiable };
+
+    // "first-last", "first-", "-suffix" のいずれか
+    SpecResult parseRangeSpec(const std::string &spec, const std::size_t size, http::ByteRange &range) {
+        const std::size_t dash = spec.find('-');
+        if (dash == std::string::npos) {
+            return kSpecInvalid;
+        }
+        const std::string firstStr = spec.substr(0, dash);
+        const std::string lastStr = spec.substr(dash + 1);
+
+        if (firstStr.empty()) {
+            // 末尾の suffix バイト
+            const Option<std::size_t> suffix = parsePosition(lastStr);
+            if (suffix.isNone()) {
+                return kSpecInvalid;
+            }
+            if (suffix.unwrap() == 0 || size == 0) {
+                return kSpecUnsatisfiable;
+            }
+            range.first = suffix.unwrap() >= size ? 0 : size - suffix.unwrap();
+            range.last = size - 1;
+            return kSpecSatisfiable;
+        }
+
+        const Option<std::size_t> first = parsePosition(firstStr);
+        if (first.isNone()) {
+            return kSpecInvalid;
+        }
+        std::size_t last = std::numeric_limits<std::size_t>::max();
+        if (!lastStr.empty()) {
+            const Option<std::size_t> parsed = parsePosition(lastStr);
+            if (parsed.isNone() || parsed.unwrap() < first.unwrap()) {
+                return kSpecInvalid;
+            }
+            last = parsed.unwrap();
+        }
+        if (first.unwrap() >= size) {
+            return kSpecUnsatisfiable;
+        }
+        range.first = first.unwrap();
+        range.last = last >= size ? size - 1 : last;
+        return kSpecSatisfiable;
+    }
+}
+
+std::size_t http::ByteRange::length() const {
+    return last - first + 1;
+}
+
+bool http::ByteRange::operator==(const ByteRange &other) const {
+    return first == other.first && last == other.last;
+}
+
+Result<std::vector<http::ByteRange>, http::HttpStatusCode>
+http::parseRange(const std::string &value, const std::size_t size) {
+    const std::vector<ByteRange> ignore;
+
+    const std::size_t eq = value.find('=');
+    if (eq == std::string::npos || !equalsIgnoreCase(utils::trim(value.substr(0, eq)), "bytes")) {
+        return Ok(ignore);
+    }
+
+    std::vector<ByteRange> ranges;
+    std::size_t specs = 0;
+    std::size_t total = 0;
+    const std::vector<std::string> elements = utils::split(value.substr(eq + 1), ',');
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        const std::string spec = utils::trim(elements[i]);
+        if (spec.empty()) {
+            // リストの空の要素は許される
+            continue;
+        }
+        if (++specs > kMaxByteRanges) {
+            return Ok(ignore);
+        }
+        ByteRange range = {0, 0};
+        const SpecResult result = parseRangeSpec(spec, size, range);
+        if (result == kSpecInvalid) {
+            return Ok(ignore);
+        }
+        if (result == kSpecUnsatisfiable) {
+            continue;
+        }
+        total += range.length();
+        if (total > size) {
+            return Ok(ignore);
+        }
+        ranges.push_back(range);
+    }
+
+    if (specs == 0) {
+        return Ok(ignore);
+    }
+    if (ranges.empty()) {
+        return Err(kStatusRangeNotSatisfiable);
+    }
+    return Ok(ranges);
+}
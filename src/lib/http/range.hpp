@@ -0,0 +1,33 @@
+#ifndef SRC_LIB_HTTP_RANGE_HPP
+#define SRC_LIB_HTTP_RANGE_HPP
+
+#include "status.hpp"
+#include "utils/types/result.hpp"
+#include <string>
+#include <vector>
+
+namespace http {
+    // 0 始まりで、last を含む
+    struct ByteRange {
+        std::size_t first;
+        std::size_t last;
+
+        std::size_t length() const;
+        bool operator==(const ByteRange &other) const;
+    };
+
+    // 1 つのリクエストで受け付ける範囲の数の上限
+    static const std::size_t kMaxByteRanges = 16;
+
+    /**
+     * Range ヘッダー ("bytes=0-99, -100" など) を、大きさ size の representation に対して解釈する
+     * 満たせる範囲がなければ Err(kStatusRangeNotSatisfiable) を返す
+     *
+     * 次の場合は Range を無視する (空の vector を返す) ので、全体を 200 で返す
+     * - 構文が正しくない、または bytes 以外の単位
+     * - 範囲が kMaxByteRanges より多い、または合計が size を超える (重なった範囲で何倍ものデータを送らせない)
+     */
+    Result<std::vector<ByteRange>, HttpStatusCode> parseRange(const std::string &value, std::size_t size);
+}
+
+#endif
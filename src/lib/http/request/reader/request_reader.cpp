@@ -4,31 +4,59 @@
 #include "utils/logger.hpp"
 #include "utils/types/try.hpp"
 
-http::RequestReader::RequestReader(IConfigResolver &resolver) : readCtx_(resolver) {
+http::RequestReader::RequestReader(IConfigResolver &resolver) : readCtx_(resolver), readingRequest_(false) {
     readCtx_.changeState(new ReadingRequestLineState(readCtx_));
 }
 
-http::RequestReader::ReadRequestResult http::RequestReader::readRequest(ReadBuffer &readBuf) const {
+http::RequestReader::ReadRequestResult http::RequestReader::readRequest(ReadBuffer &readBuf) {
     LOG_DEBUG("start RequestReader::readRequest");
 
     const std::size_t bytesLoaded = TRY(readBuf.load());
+    const Option<Request> req = TRY(this->readBufferedRequest(readBuf));
+    if (req.isSome() || bytesLoaded > 0) {
+        // バッファが足りない場合は、リトライすればバッファにデータが追加される可能性がある
+        return Ok(req);
+    }
+
+    // eof なので、リトライしても解決しない
+    if (readBuf.size() == 0 && readCtx_.getRequestLine().empty()) {
+        // 次のリクエストを送らずに閉じた (keep-alive では普通に起こる)
+        LOG_DEBUG("connection closed before request");
+        return Err(error::kUnknown);
+    }
+    LOG_WARN("incomplete request");
+    return Err(error::kUnknown);
+}
+
+http::RequestReader::ReadRequestResult http::RequestReader::readBufferedRequest(ReadBuffer &readBuf) {
     // ReadingBodyState などが state を NULL に遷移させる
+    const std::size_t bufferedBytes = readBuf.size();
     while (readCtx_.getState() != NULL) {
         const IState::HandleStatus status = TRY(readCtx_.handle(readBuf));
         if (status == IState::kSuspend) {
             // バッファが足りない
-            if (bytesLoaded == 0) {
-                // eof なので、リトライしても解決しない
-                LOG_WARN("incomplete request");
-                return Err(error::kUnknown);
-            }
-            // リトライすればバッファにデータが追加される可能性がある
+            readingRequest_ = readingRequest_ || readBuf.size() != bufferedBytes;
             return Ok(None);
         }
     }
 
-    return Ok(Some(TRY(RequestParser::parseRequest(readCtx_.getRequestLine(), readCtx_.getHeaders(), readCtx_.getBody())
-    )));
+    const Result<Request, error::AppError> req =
+        RequestParser::parseRequest(readCtx_.getRequestLine(), readCtx_.getHeaders(), readCtx_.getBody());
+    this->reset();
+    return Ok(Some(TRY(req)));
+}
+
+bool http::RequestReader::isReadingRequest() const {
+    return readingRequest_;
+}
+
+// 次のリクエストを最初から読めるようにする
+void http::RequestReader::reset() {
+    readCtx_.setRequestLine("");
+    readCtx_.setHeaders(RawHeaders());
+    readCtx_.setBody("");
+    readingRequest_ = false;
+    readCtx_.changeState(new ReadingRequestLineState(readCtx_));
 }
 
 http::IConfigResolver::~IConfigResolver() {}
@@ -59,11 +59,22 @@ namespace http {
 
         explicit RequestReader(IConfigResolver &resolver);
 
+        /**
+         * read を高々 1 回行い、リクエストをパースする
+         * リクエストを返した後は、同じ RequestReader で次のリクエストを読める
+         */
         typedef Result<Option<Request>, error::AppError> ReadRequestResult;
-        ReadRequestResult readRequest(ReadBuffer &readBuf) const;
+        ReadRequestResult readRequest(ReadBuffer &readBuf);
+        // read せずに、バッファに残っているバイトだけでパースする (パイプライニングされた次のリクエスト用)
+        ReadRequestResult readBufferedRequest(ReadBuffer &readBuf);
+        // リクエストの途中まで読んでいるか (バッファから消費済みのデータを持っている)
+        bool isReadingRequest() const;
 
     private:
         ReadContext readCtx_;
+        bool readingRequest_;
+
+        void reset();
     };
 }
 
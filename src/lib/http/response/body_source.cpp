@@ -0,0 +1,141 @@
+#include "body_source.hpp"
+#include "utils/string.hpp"
+#include <algorithm>
+#include <unistd.h>
+
+http::IBodySource::~IBodySource() {}
+
+Option<int> http::IBodySource::takeResumableProducer() {
+    return None;
+}
+
+const std::size_t http::RelayBodySource::kHighWatermark;
+const std::size_t http::RelayBodySource::kLowWatermark;
+
+http::RelayBodySource::RelayBodySource(const Option<std::size_t> &length)
+    : length_(length), received_(0), finished_(false), aborted_(false), pausedProducer_(None) {}
+
+Option<std::size_t> http::RelayBodySource::getLength() const {
+    return length_;
+}
+
+http::IBodySource::PullResult http::RelayBodySource::pull(std::string &buf, const std::size_t max) {
+    if (aborted_) {
+        return Err(error::kUnknown);
+    }
+
+    const std::size_t size = std::min(buffer_.size(), max);
+    buf.append(buffer_, 0, size);
+    buffer_.erase(0, size);
+
+    if (!buffer_.empty()) {
+        return Ok(kPullMore);
+    }
+    return Ok(finished_ ? kPullEnd : kPullPending);
+}
+
+Option<int> http::RelayBodySource::takeResumableProducer() {
+    if (pausedProducer_.isNone() || buffer_.size() > kLowWatermark) {
+        return None;
+    }
+    const Option<int> producer = pausedProducer_;
+    pausedProducer_ = None;
+    return producer;
+}
+
+void http::RelayBodySource::append(const char *data, const std::size_t size) {
+    const std::size_t accepted = length_.isSome() ? std::min(size, length_.unwrap() - received_) : size;
+    buffer_.append(data, accepted);
+    received_ += accepted;
+}
+
+void http::RelayBodySource::finish() {
+    if (length_.isSome() && received_ < length_.unwrap()) {
+        // Content-Length 分のデータが届かなかった
+        this->abort();
+        return;
+    }
+    finished_ = true;
+    pausedProducer_ = None;
+}
+
+void http::RelayBodySource::abort() {
+    aborted_ = true;
+    pausedProducer_ = None;
+}
+
+bool http::RelayBodySource::isFinished() const {
+    return finished_;
+}
+
+bool http::RelayBodySource::isFull() const {
+    return buffer_.size() >= kHighWatermark;
+}
+
+void http::RelayBodySource::pauseProducer(const int producerFd) {
+    pausedProducer_ = Some(producerFd);
+}
+
+http::MultipartRangesBodySource::MultipartRangesBodySource(
+    const SharedPtr<AutoFd> &file,
+    const std::vector<ByteRange> &ranges,
+    const std::size_t fileSize,
+    const std::string &contentType,
+    const std::string &boundary
+)
+    : file_(file), length_(0), current_(0), partOffset_(0) {
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        Part part;
+        part.header = "\r\n--" + boundary + "\r\n";
+        part.header += "Content-Type: " + contentType + "\r\n";
+        part.header += utils::format("Content-Range: bytes %zu-%zu/%zu\r\n\r\n", ranges[i].first, ranges[i].last, fileSize);
+        part.offset = static_cast<off_t>(ranges[i].first);
+        part.length = ranges[i].length();
+        parts_.push_back(part);
+    }
+    // 最後の区切り
+    Part closing;
+    closing.header = "\r\n--" + boundary + "--\r\n";
+    closing.offset = 0;
+    closing.length = 0;
+    parts_.push_back(closing);
+
+    for (std::size_t i = 0; i < parts_.size(); ++i) {
+        length_ += parts_[i].header.size() + parts_[i].length;
+    }
+}
+
+Option<std::size_t> http::MultipartRangesBodySource::getLength() const {
+    return Some(length_);
+}
+
+http::IBodySource::PullResult http::MultipartRangesBodySource::pull(std::string &buf, std::size_t max) {
+    while (max > 0 && current_ < parts_.size()) {
+        const Part &part = parts_[current_];
+        if (partOffset_ < part.header.size()) {
+            const std::size_t size = std::min(part.header.size() - partOffset_, max);
+            buf.append(part.header, partOffset_, size);
+            partOffset_ += size;
+            max -= size;
+        } else if (partOffset_ < part.header.size() + part.length) {
+            const std::size_t done = partOffset_ - part.header.size();
+            const std::size_t size = std::min(part.length - done, max);
+            const std::size_t start = buf.size();
+            buf.resize(start + size);
+            const ssize_t bytesRead = pread(file_->get(), &buf[start], size, part.offset + static_cast<off_t>(done));
+            if (bytesRead <= 0) {
+                // ファイルが途中で切り詰められた。Content-Length 分を送れないので、続けられない
+                buf.resize(start);
+                return Err(error::kUnknown);
+            }
+            buf.resize(start + bytesRead);
+            partOffset_ += bytesRead;
+            max -= bytesRead;
+        }
+        if (partOffset_ == part.header.size() + part.length) {
+            ++current_;
+            partOffset_ = 0;
+        }
+    }
+    return Ok(current_ == parts_.size() ? kPullEnd : kPullMore);
+}
@@ -0,0 +1,118 @@
+#ifndef SRC_LIB_HTTP_RESPONSE_BODY_SOURCE_HPP
+#define SRC_LIB_HTTP_RESPONSE_BODY_SOURCE_HPP
+
+#include "http/range.hpp"
+#include "utils/auto_fd.hpp"
+#include "utils/non_copyable.hpp"
+#include "utils/shared_ptr.hpp"
+#include "utils/types/error.hpp"
+#include "utils/types/option.hpp"
+#include "utils/types/result.hpp"
+#include <string>
+#include <vector>
+
+namespace http {
+    /**
+     * 書き込みながら少しずつ取り出す body
+     * 全体をメモリに用意する必要がないので、body の大きさに関係なく最初のバイトを送り始められる
+     *
+     * 長さが分からない場合は、Transfer-Encoding: chunked で送る
+     * NOTE: 最初から長さが分かっていて内容が揃っている body は、std::string (メモリ) か FileBody (ファイル) を使う
+     */
+    class IBodySource : public NonCopyable {
+    public:
+        enum PullStatus {
+            // 続きがある
+            kPullMore,
+            // 今は続きがない。生産者がデータを追加したら、write イベントの監視を再開する
+            kPullPending,
+            // 最後まで取り出した
+            kPullEnd
+        };
+        typedef Result<PullStatus, error::AppError> PullResult;
+
+        virtual ~IBodySource();
+
+        // 全体の長さ (分からなければ None)
+        virtual Option<std::size_t> getLength() const = 0;
+        // 最大 max バイトを buf の末尾に追加する
+        virtual PullResult pull(std::string &buf, std::size_t max) = 0;
+        // pull でバッファに空きができて、読み込みを再開できる生産者の fd
+        virtual Option<int> takeResumableProducer();
+    };
+
+    /**
+     * 別の fd (CGI のソケットなど) から読んだデータを、そのまま body として中継する
+     * 生産者が append したデータを、レスポンスを書き込む側が pull で取り出す
+     *
+     * 溜まっているデータが kHighWatermark を超えたら、生産者は読み込みを止める (pause)
+     * 止めた生産者は、kLowWatermark を下回ったときに takeResumableProducer で返される
+     *
+     * length が分かっている場合、それを超えるデータは捨てる。足りないまま finish したら abort と同じ扱いにする
+     */
+    class RelayBodySource : public IBodySource {
+    public:
+        static const std::size_t kHighWatermark = 256 * 1024;
+        static const std::size_t kLowWatermark = 64 * 1024;
+
+        explicit RelayBodySource(const Option<std::size_t> &length = None);
+
+        Option<std::size_t> getLength() const;
+        PullResult pull(std::string &buf, std::size_t max);
+        Option<int> takeResumableProducer();
+
+        // 以下は生産者が呼ぶ
+        void append(const char *data, std::size_t size);
+        // すべてのデータを append した
+        void finish();
+        // 生産者が途中で終了した。pull はエラーを返し、コネクションは閉じられる
+        void abort();
+        bool isFinished() const;
+        bool isFull() const;
+        // 生産者の fd の read イベントの監視を止めたときに呼ぶ
+        void pauseProducer(int producerFd);
+
+    private:
+        Option<std::size_t> length_;
+        std::string buffer_;
+        std::size_t received_;
+        bool finished_;
+        bool aborted_;
+        Option<int> pausedProducer_;
+    };
+
+    /**
+     * ファイルの複数の範囲を multipart/byteranges の body にする
+     * 各部分のヘッダーだけをメモリに持ち、ファイルの内容は pull のたびに必要な分だけ pread で読む
+     */
+    class MultipartRangesBodySource : public IBodySource {
+    public:
+        MultipartRangesBodySource(
+            const SharedPtr<AutoFd> &file,
+            const std::vector<ByteRange> &ranges,
+            std::size_t fileSize,
+            const std::string &contentType,
+            const std::string &boundary
+        );
+
+        Option<std::size_t> getLength() const;
+        PullResult pull(std::string &buf, std::size_t max);
+
+    private:
+        // header の後に、ファイルの offset から length バイトが続く
+        struct Part {
+            std::string header;
+            off_t offset;
+            std::size_t length;
+        };
+
+        SharedPtr<AutoFd> file_;
+        std::vector<Part> parts_;
+        std::size_t length_;
+        // 取り出し中の part と、その中で取り出し済みのバイト数
+        std::size_t current_;
+        std::size_t partOffset_;
+    };
+}
+
+#endif
@@ -0,0 +1,23 @@
+#include "file_body.hpp"
+
+http::FileBody::FileBody(const int fd, const off_t offset, const std::size_t length)
+    : fd_(new AutoFd(fd)), offset_(offset), length_(length) {}
+
+http::FileBody::FileBody(const SharedPtr<AutoFd> &fd, const off_t offset, const std::size_t length)
+    : fd_(fd), offset_(offset), length_(length) {}
+
+bool http::FileBody::operator==(const FileBody &other) const {
+    return fd_ == other.fd_ && offset_ == other.offset_ && length_ == other.length_;
+}
+
+const SharedPtr<AutoFd> &http::FileBody::getFd() const {
+    return fd_;
+}
+
+off_t http::FileBody::getOffset() const {
+    return offset_;
+}
+
+std::size_t http::FileBody::getLength() const {
+    return length_;
+}
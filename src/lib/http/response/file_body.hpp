@@ -0,0 +1,34 @@
+#ifndef SRC_LIB_HTTP_RESPONSE_FILE_BODY_HPP
+#define SRC_LIB_HTTP_RESPONSE_FILE_BODY_HPP
+
+#include "utils/auto_fd.hpp"
+#include "utils/shared_ptr.hpp"
+#include <sys/types.h>
+
+namespace http {
+    /**
+     * ファイルの offset から length バイトを body にする
+     * 内容はメモリに読み込まず、書き込むときに sendfile で送る
+     * Response はコピーされるので、fd は参照カウントで共有し、最後のコピーが破棄されたときに close する
+     */
+    class FileBody {
+    public:
+        // fd の所有権を受け取る
+        FileBody(int fd, off_t offset, std::size_t length);
+        // 開いているファイルの別の範囲を body にする
+        FileBody(const SharedPtr<AutoFd> &fd, off_t offset, std::size_t length);
+
+        bool operator==(const FileBody &other) const;
+
+        const SharedPtr<AutoFd> &getFd() const;
+        off_t getOffset() const;
+        std::size_t getLength() const;
+
+    private:
+        SharedPtr<AutoFd> fd_;
+        off_t offset_;
+        std::size_t length_;
+    };
+}
+
+#endif
@@ -0,0 +1,183 @@
+#include "gzip.hpp"
+#include "utils/logger.hpp"
+#include "utils/types/try.hpp"
+#include <algorithm>
+#include <ctime>
+
+namespace {
+    // deflate に 1 回で渡す出力バッファの大きさ
+    const std::size_t kOutputChunkSize = 16 * 1024;
+    // gzip 形式にする (deflateInit2 の windowBits に 16 を足す)
+    const int kGzipWindowBits = 15 + 16;
+    const int kMemLevel = 8;
+
+    unsigned long threadCpuMicros() {
+        timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) {
+            return 0;
+        }
+        return static_cast<unsigned long>(ts.tv_sec) * 1000000 + static_cast<unsigned long>(ts.tv_nsec) / 1000;
+    }
+
+    void recordStats(http::GzipStats *stats, const http::GzipEncoder &encoder) {
+        if (stats != NULL) {
+            stats->add(encoder.getBytesIn(), encoder.getBytesOut(), encoder.getCpuMicros());
+        }
+        LOG_DEBUGF(
+            "gzip: %zu -> %zu bytes (%.1f%%), %lu us",
+            encoder.getBytesIn(),
+            encoder.getBytesOut(),
+            encoder.getBytesIn() == 0 ? 0.0 : 100.0 * encoder.getBytesOut() / encoder.getBytesIn(),
+            encoder.getCpuMicros()
+        );
+    }
+}
+
+/* GzipStats */
+http::GzipStats::GzipStats() : responses_(0), bytesIn_(0), bytesOut_(0), cpuMicros_(0) {}
+
+void http::GzipStats::add(const unsigned long bytesIn, const unsigned long bytesOut, const unsigned long cpuMicros) {
+    __sync_fetch_and_add(&responses_, 1);
+    __sync_fetch_and_add(&bytesIn_, bytesIn);
+    __sync_fetch_and_add(&bytesOut_, bytesOut);
+    __sync_fetch_and_add(&cpuMicros_, cpuMicros);
+}
+
+http::GzipStats::Snapshot http::GzipStats::get() const {
+    GzipStats *self = const_cast<GzipStats *>(this);
+    const Snapshot snapshot = {
+        __sync_fetch_and_add(&self->responses_, 0),
+        __sync_fetch_and_add(&self->bytesIn_, 0),
+        __sync_fetch_and_add(&self->bytesOut_, 0),
+        __sync_fetch_and_add(&self->cpuMicros_, 0),
+    };
+    return snapshot;
+}
+
+/* GzipEncoder */
+http::GzipEncoder::GzipEncoder(const int level) : stream_(), valid_(false), finished_(false), cpuMicros_(0) {
+    valid_ = deflateInit2(&stream_, level, Z_DEFLATED, kGzipWindowBits, kMemLevel, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!valid_) {
+        LOG_WARN("failed to initialize gzip encoder");
+    }
+}
+
+http::GzipEncoder::~GzipEncoder() {
+    if (valid_) {
+        deflateEnd(&stream_);
+    }
+}
+
+bool http::GzipEncoder::isValid() const {
+    return valid_;
+}
+
+void http::GzipEncoder::encode(const char *data, const std::size_t size, const int flush, std::string &out) {
+    if (!valid_ || finished_) {
+        return;
+    }
+    const unsigned long start = threadCpuMicros();
+    stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream_.avail_in = static_cast<uInt>(size);
+    // 入力を使い切り、出力バッファに空きが残るまで続ける (残らなければ、まだ出力がある)
+    do {
+        const std::size_t offset = out.size();
+        out.resize(offset + kOutputChunkSize);
+        stream_.next_out = reinterpret_cast<Bytef *>(&out[offset]);
+        stream_.avail_out = static_cast<uInt>(kOutputChunkSize);
+        const int ret = deflate(&stream_, flush);
+        out.resize(offset + kOutputChunkSize - stream_.avail_out);
+        if (ret == Z_STREAM_END) {
+            finished_ = true;
+            break;
+        }
+        if (ret == Z_STREAM_ERROR) {
+            // 引数が正しければ起きない
+            LOG_ERROR("gzip encoder is in an inconsistent state");
+            break;
+        }
+    } while (stream_.avail_out == 0 || stream_.avail_in > 0);
+    cpuMicros_ += threadCpuMicros() - start;
+}
+
+bool http::GzipEncoder::isFinished() const {
+    return finished_;
+}
+
+std::size_t http::GzipEncoder::getBytesIn() const {
+    return stream_.total_in;
+}
+
+std::size_t http::GzipEncoder::getBytesOut() const {
+    return stream_.total_out;
+}
+
+unsigned long http::GzipEncoder::getCpuMicros() const {
+    return cpuMicros_;
+}
+
+/* GzipBodySource */
+http::GzipBodySource::GzipBodySource(const SharedPtr<IBodySource> &source, const int level, GzipStats *stats)
+    : source_(source), encoder_(level), stats_(stats), outputOffset_(0), sourceEnded_(false), unflushed_(false) {}
+
+Option<std::size_t> http::GzipBodySource::getLength() const {
+    return None;
+}
+
+http::IBodySource::PullResult http::GzipBodySource::pull(std::string &buf, const std::size_t max) {
+    if (!encoder_.isValid()) {
+        return Err(error::kUnknown);
+    }
+
+    // max バイト分の出力が溜まるか、元の body を待つことになるまで圧縮する
+    while (output_.size() - outputOffset_ < max && !encoder_.isFinished()) {
+        if (sourceEnded_) {
+            encoder_.encode(NULL, 0, Z_FINISH, output_);
+            recordStats(stats_, encoder_);
+            break;
+        }
+        std::string input;
+        const PullStatus status = TRY(source_->pull(input, max));
+        sourceEnded_ = status == kPullEnd;
+        if (!input.empty()) {
+            encoder_.encode(input.data(), input.size(), Z_NO_FLUSH, output_);
+            unflushed_ = true;
+        }
+        if (status == kPullPending) {
+            if (unflushed_) {
+                // 次の入力がいつ届くか分からないので、ここまでの分をクライアントに届ける
+                encoder_.encode(NULL, 0, Z_SYNC_FLUSH, output_);
+                unflushed_ = false;
+            }
+            break;
+        }
+    }
+
+    const std::size_t size = std::min(max, output_.size() - outputOffset_);
+    buf.append(output_, outputOffset_, size);
+    outputOffset_ += size;
+    if (outputOffset_ == output_.size()) {
+        output_.clear();
+        outputOffset_ = 0;
+    }
+
+    if (encoder_.isFinished() && output_.empty()) {
+        return Ok(kPullEnd);
+    }
+    return Ok(size == 0 ? kPullPending : kPullMore);
+}
+
+Option<int> http::GzipBodySource::takeResumableProducer() {
+    return source_->takeResumableProducer();
+}
+
+Option<std::string> http::gzipCompress(const std::string &data, const int level, GzipStats *stats) {
+    GzipEncoder encoder(level);
+    if (!encoder.isValid()) {
+        return None;
+    }
+    std::string out;
+    encoder.encode(data.data(), data.size(), Z_FINISH, out);
+    recordStats(stats, encoder);
+    return Some(out);
+}
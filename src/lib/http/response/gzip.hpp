@@ -0,0 +1,90 @@
+#ifndef SRC_LIB_HTTP_RESPONSE_GZIP_HPP
+#define SRC_LIB_HTTP_RESPONSE_GZIP_HPP
+
+#include "body_source.hpp"
+#include "utils/non_copyable.hpp"
+#include <string>
+#include <zlib.h>
+
+namespace http {
+    /**
+     * gzip で圧縮したレスポンスの累計 (worker スレッドから更新されるので、atomic に足す)
+     * 圧縮率は bytesOut / bytesIn
+     */
+    class GzipStats : public NonCopyable {
+    public:
+        struct Snapshot {
+            unsigned long responses;
+            unsigned long bytesIn;
+            unsigned long bytesOut;
+            // deflate に使ったスレッドの CPU 時間
+            unsigned long cpuMicros;
+        };
+
+        GzipStats();
+        void add(unsigned long bytesIn, unsigned long bytesOut, unsigned long cpuMicros);
+        Snapshot get() const;
+
+    private:
+        unsigned long responses_;
+        unsigned long bytesIn_;
+        unsigned long bytesOut_;
+        unsigned long cpuMicros_;
+    };
+
+    // zlib の deflate を gzip 形式で使う
+    class GzipEncoder : public NonCopyable {
+    public:
+        explicit GzipEncoder(int level);
+        ~GzipEncoder();
+
+        // deflateInit に失敗した (メモリ不足) 場合は false
+        bool isValid() const;
+        // size バイトを圧縮して out の末尾に追加する。flush は Z_NO_FLUSH, Z_SYNC_FLUSH, Z_FINISH のいずれか
+        void encode(const char *data, std::size_t size, int flush, std::string &out);
+        // Z_FINISH で最後まで出力した
+        bool isFinished() const;
+
+        std::size_t getBytesIn() const;
+        std::size_t getBytesOut() const;
+        unsigned long getCpuMicros() const;
+
+    private:
+        z_stream stream_;
+        bool valid_;
+        bool finished_;
+        unsigned long cpuMicros_;
+    };
+
+    /**
+     * 別の IBodySource から取り出した body を、gzip で圧縮しながら返す
+     * 全体を溜めずに少しずつ圧縮するので、長さは分からない (chunked で送る)
+     *
+     * 元の body が生産者を待っている (CGI の出力が届いていない) 間は、それまでの入力を Z_SYNC_FLUSH で出し切る
+     * 最後まで取り出したら、stats に結果を足す
+     */
+    class GzipBodySource : public IBodySource {
+    public:
+        GzipBodySource(const SharedPtr<IBodySource> &source, int level, GzipStats *stats = NULL);
+
+        Option<std::size_t> getLength() const;
+        PullResult pull(std::string &buf, std::size_t max);
+        Option<int> takeResumableProducer();
+
+    private:
+        SharedPtr<IBodySource> source_;
+        GzipEncoder encoder_;
+        GzipStats *stats_;
+        // 圧縮済みで、まだ取り出されていないデータ
+        std::string output_;
+        std::size_t outputOffset_;
+        bool sourceEnded_;
+        // 前回の flush の後に、出力されていない入力を渡した
+        bool unflushed_;
+    };
+
+    // body 全体を一度に圧縮する (長さの分かっている body 用)。圧縮できなければ None
+    Option<std::string> gzipCompress(const std::string &data, int level, GzipStats *stats = NULL);
+}
+
+#endif
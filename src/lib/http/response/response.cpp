@@ -4,11 +4,26 @@
 http::Response::Response(
     const HttpStatusCode status, const Headers &headers, const Option<std::string> &body, const std::string &httpVersion
 )
-    : status_(status), httpVersion_(httpVersion), headers_(headers), body_(body) {}
+    : status_(status), httpVersion_(httpVersion), headers_(headers), body_(body), fileBody_(None), bodySource_(None) {}
+
+http::Response::Response(
+    const HttpStatusCode status, const Headers &headers, const FileBody &fileBody, const std::string &httpVersion
+)
+    : status_(status), httpVersion_(httpVersion), headers_(headers), body_(None), fileBody_(Some(fileBody)),
+      bodySource_(None) {}
+
+http::Response::Response(
+    const HttpStatusCode status,
+    const Headers &headers,
+    const SharedPtr<IBodySource> &bodySource,
+    const std::string &httpVersion
+)
+    : status_(status), httpVersion_(httpVersion), headers_(headers), body_(None), fileBody_(None),
+      bodySource_(Some(bodySource)) {}
 
 bool http::Response::operator==(const Response &other) const {
     return status_ == other.status_ && httpVersion_ == other.httpVersion_ && headers_ == other.headers_ &&
-        body_ == other.body_;
+        body_ == other.body_ && fileBody_ == other.fileBody_ && bodySource_ == other.bodySource_;
 }
 
 http::HttpStatusCode http::Response::getStatusCode() const {
@@ -27,8 +42,20 @@ const Option<std::string> &http::Response::getBody() const {
     return body_;
 }
 
+const Option<http::FileBody> &http::Response::getFileBody() const {
+    return fileBody_;
+}
+
+const Option<SharedPtr<http::IBodySource> > &http::Response::getBodySource() const {
+    return bodySource_;
+}
+
 // NOTE: 結構無理やり
 std::string http::Response::toString() const {
+    return this->toHeaderString() + body_.unwrapOr("");
+}
+
+std::string http::Response::toHeaderString() const {
     std::vector<std::string> lines;
 
     // status line
@@ -41,10 +68,7 @@ std::string http::Response::toString() const {
 
     // 空行
     lines.push_back("");
+    lines.push_back("");
 
-    // message body
-    lines.push_back(body_.unwrapOr(""));
-
-    const std::string responseMessage = utils::join(lines, "\r\n");
-    return responseMessage;
+    return utils::join(lines, "\r\n");
 }
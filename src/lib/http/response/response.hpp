@@ -3,6 +3,9 @@
 
 #include "../status.hpp"
 #include "http/header.hpp"
+#include "body_source.hpp"
+#include "file_body.hpp"
+#include "utils/shared_ptr.hpp"
 
 namespace http {
     class Response {
@@ -13,20 +16,43 @@ namespace http {
             const Option<std::string> &body = None,
             const std::string &httpVersion = "HTTP/1.1"
         );
+        // body をメモリに読み込まず、ファイルから送る
+        Response(
+            HttpStatusCode status,
+            const Headers &headers,
+            const FileBody &fileBody,
+            const std::string &httpVersion = "HTTP/1.1"
+        );
+        // body を書き込みながら source から取り出す
+        Response(
+            HttpStatusCode status,
+            const Headers &headers,
+            const SharedPtr<IBodySource> &bodySource,
+            const std::string &httpVersion = "HTTP/1.1"
+        );
         bool operator==(const Response &other) const;
 
         HttpStatusCode getStatusCode() const;
         const std::string &getHttpVersion() const;
         const Headers &getHeaders() const;
         const Option<std::string> &getBody() const;
+        // body がファイルの場合は Some (getBody は None になる)
+        const Option<FileBody> &getFileBody() const;
+        // body を少しずつ取り出す場合は Some (getBody, getFileBody は None になる)
+        const Option<SharedPtr<IBodySource> > &getBodySource() const;
 
+        // NOTE: FileBody, IBodySource の内容は含まない
         std::string toString() const;
+        // status line, field lines と空行 (body は含まない)
+        std::string toHeaderString() const;
 
     private:
         HttpStatusCode status_;
         std::string httpVersion_;
         Headers headers_;
         Option<std::string> body_;
+        Option<FileBody> fileBody_;
+        Option<SharedPtr<IBodySource> > bodySource_;
     };
 }
 
@@ -1,16 +1,26 @@
 #include "response_builder.hpp"
 
+#include "http/etag.hpp"
 #include "http/mime.hpp"
 #include "utils/string.hpp"
-#include <fstream>
+#include "utils/time.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace http {
-    ResponseBuilder::ResponseBuilder() : status_(kStatusOk), httpVersion_("HTTP/1.1"), body_(None) {}
+    ResponseBuilder::ResponseBuilder() : status_(kStatusOk), httpVersion_("HTTP/1.1"), body_(None), fileBody_(None), bodySource_(None) {}
 
     ResponseBuilder::~ResponseBuilder() {}
 
     Response ResponseBuilder::build() {
-        if (body_.isNone()) {
+        if (fileBody_.isSome()) {
+            return Response(status_, headers_, fileBody_.unwrap(), httpVersion_);
+        }
+        if (bodySource_.isSome()) {
+            return Response(status_, headers_, bodySource_.unwrap(), httpVersion_);
+        }
+        if (body_.isNone() && !isBodylessStatus(status_)) {
             // 念の為 Content-Length を付ける
             this->header("Content-Length", "0");
         }
@@ -44,20 +54,96 @@ namespace http {
         return this->status(status).header("Location", location);
     }
 
+    // 内容は読み込まず、開いた fd を body にする (書き込むときに sendfile で送る)
     ResponseBuilder &ResponseBuilder::file(const std::string &path, HttpStatusCode status) {
-        std::ifstream ifs(path);
-        if (!ifs.is_open()) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
             return this->status(kStatusNotFound);
         }
+        struct stat st = {};
+        if (fstat(fd, &st) == -1) {
+            close(fd);
+            return this->status(kStatusInternalServerError);
+        }
 
-        std::stringstream ss;
-        ss << ifs.rdbuf();
-        const std::string body = ss.str();
+        return this->file(SharedPtr<AutoFd>(new AutoFd(fd)), st, getMimeType(path), status);
+    }
+
+    // 開いているファイル (OpenFileCache から取り出したものなど) を body にする
+    ResponseBuilder &ResponseBuilder::file(
+        const SharedPtr<AutoFd> &fd, const struct stat &st, const std::string &mime, const HttpStatusCode status
+    ) {
+        const std::size_t size = static_cast<std::size_t>(st.st_size);
+        fileBody_ = Some(FileBody(fd, 0, size));
+        body_ = None;
 
-        const std::string mime = getMimeType(path);
-        return this->body(body, status)
+        return this->status(status)
             .header("Content-Type", utils::format("%s; charset=UTF-8", mime.c_str()))
-            .header("Content-Length", utils::toString(body.size()));
+            .header("Content-Length", utils::toString(size))
+            .header("Last-Modified", utils::Time::formatHttpDate(st.st_mtime))
+            .header("ETag", makeETag(st))
+            .header("Accept-Ranges", "bytes");
+    }
+
+    // body は付けずに、キャッシュの検証に使うヘッダーだけを返す
+    ResponseBuilder &ResponseBuilder::notModified(const std::string &etag, const std::string &lastModified) {
+        fileBody_ = None;
+        bodySource_ = None;
+        body_ = None;
+        headers_.erase("Content-Length");
+        return this->status(kStatusNotModified).header("ETag", etag).header("Last-Modified", lastModified);
+    }
+
+    ResponseBuilder &ResponseBuilder::ranges(const std::vector<ByteRange> &ranges) {
+        if (fileBody_.isNone() || ranges.empty()) {
+            return *this;
+        }
+        const FileBody file = fileBody_.unwrap();
+
+        if (ranges.size() == 1) {
+            // 1 つだけなら、そのままファイルの一部を送る
+            const ByteRange &range = ranges.front();
+            fileBody_ = Some(FileBody(file.getFd(), static_cast<off_t>(range.first), range.length()));
+            return this->status(kStatusPartialContent)
+                .header(
+                    "Content-Range", utils::format("bytes %zu-%zu/%zu", range.first, range.last, file.getLength())
+                )
+                .header("Content-Length", utils::toString(range.length()));
+        }
+
+        // body に現れない区切りにするため、呼ぶたびに変える (スレッドごとに数える)
+        static __thread unsigned long count = 0;
+        const std::string boundary = utils::format("%08lx%08lx", static_cast<unsigned long>(std::time(NULL)), ++count);
+        const std::string contentType = headers_["Content-Type"];
+        const SharedPtr<IBodySource> source(
+            new MultipartRangesBodySource(file.getFd(), ranges, file.getLength(), contentType, boundary)
+        );
+        return this->stream(source, kStatusPartialContent)
+            .header("Content-Type", "multipart/byteranges; boundary=" + boundary);
+    }
+
+    ResponseBuilder &ResponseBuilder::rangeNotSatisfiable() {
+        if (fileBody_.isNone()) {
+            return *this;
+        }
+        const std::size_t size = fileBody_.unwrap().getLength();
+        fileBody_ = None;
+        headers_.erase("Content-Type");
+        return this->status(kStatusRangeNotSatisfiable).header("Content-Range", utils::format("bytes */%zu", size));
+    }
+
+    // 長さが分からなければ Content-Length は付けない (書き込むときに chunked にする)
+    ResponseBuilder &ResponseBuilder::stream(const SharedPtr<IBodySource> &source, const HttpStatusCode status) {
+        bodySource_ = Some(source);
+        fileBody_ = None;
+        body_ = None;
+
+        const Option<std::size_t> length = source->getLength();
+        if (length.isNone()) {
+            headers_.erase("Content-Length");
+            return this->status(status);
+        }
+        return this->status(status).header("Content-Length", utils::toString(length.unwrap()));
     }
 
     ResponseBuilder &ResponseBuilder::body(const std::string &body, const HttpStatusCode status) {
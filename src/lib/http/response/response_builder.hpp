@@ -3,8 +3,10 @@
 
 #include "response.hpp"
 #include "http/header.hpp"
+#include "http/range.hpp"
 #include "http/status.hpp"
 #include "utils/types/option.hpp"
+#include <sys/stat.h>
 
 namespace http {
     // TODO: テスト書く
@@ -23,6 +25,19 @@ namespace http {
         ResponseBuilder &html(const std::string &body, HttpStatusCode status = kStatusOk);
         ResponseBuilder &redirect(const std::string &location, HttpStatusCode status = kStatusFound);
         ResponseBuilder &file(const std::string &path, HttpStatusCode status = kStatusOk);
+        ResponseBuilder &file(
+            const SharedPtr<AutoFd> &fd,
+            const struct stat &st,
+            const std::string &mime,
+            HttpStatusCode status = kStatusOk
+        );
+        // file の後に呼び、ファイルのうち ranges の部分だけを 206 Partial Content で返す
+        ResponseBuilder &ranges(const std::vector<ByteRange> &ranges);
+        // file の後に呼び、416 Range Not Satisfiable を返す
+        ResponseBuilder &rangeNotSatisfiable();
+        // 304 Not Modified (body なし)
+        ResponseBuilder &notModified(const std::string &etag, const std::string &lastModified);
+        ResponseBuilder &stream(const SharedPtr<IBodySource> &source, HttpStatusCode status = kStatusOk);
 
         // 元は乱用できないように private だった。CGI で必要になったので public に変更
         ResponseBuilder &body(const std::string &body, HttpStatusCode status);
@@ -32,6 +47,8 @@ namespace http {
         std::string httpVersion_; // HTTP version は今のところ固定
         Headers headers_;
         Option<std::string> body_;
+        Option<FileBody> fileBody_;
+        Option<SharedPtr<IBodySource> > bodySource_;
     };
 }
 
@@ -0,0 +1,19 @@
+#ifndef SRC_LIB_HTTP_RESPONSE_RESPONSE_FILTER_HPP
+#define SRC_LIB_HTTP_RESPONSE_RESPONSE_FILTER_HPP
+
+#include "response.hpp"
+
+namespace http {
+    /**
+     * handler が作ったレスポンスを、送る前に書き換える (圧縮など)
+     * middleware はレスポンスをその場で書き換えられるが、CGI のレスポンスは Router の外で作られるので、
+     * RequestContext で渡しておき、CGI のレスポンスを作るときに適用する
+     */
+    class IResponseFilter {
+    public:
+        virtual ~IResponseFilter() {}
+        virtual Response filter(const Response &response) const = 0;
+    };
+}
+
+#endif
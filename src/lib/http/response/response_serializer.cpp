@@ -0,0 +1,134 @@
+#include "response_serializer.hpp"
+#include "utils/string.hpp"
+#include "utils/time.hpp"
+#include <pthread.h>
+#include <vector>
+
+namespace {
+    // getDate のスレッドごとの文字列。スレッドの終了時に destructor で解放する
+    pthread_key_t dateKey;
+    pthread_once_t dateKeyOnce = PTHREAD_ONCE_INIT;
+
+    void deleteDate(void *date) {
+        delete static_cast<std::string *>(date);
+    }
+
+    void createDateKey() {
+        pthread_key_create(&dateKey, deleteDate);
+    }
+
+    std::vector<std::string> buildStatusLines(const int min, const int max) {
+        std::vector<std::string> lines(max - min + 1);
+        for (int code = min; code <= max; ++code) {
+            const Option<http::HttpStatusCode> status = http::httpStatusCodeFromInt(code);
+            if (status.isSome()) {
+                lines[code - min] =
+                    utils::format("HTTP/1.1 %d %s\r\n", code, http::getHttpStatusText(status.unwrap()).c_str());
+            }
+        }
+        return lines;
+    }
+}
+
+std::string http::ResponseSerializer::serializeHeader(
+    const HttpStatusCode status, const Headers &headers, const std::string &httpVersion
+) {
+    const bool hasDate = headers.find("Date") != headers.end();
+
+    // 先に長さを求めて、確保を 1 回で済ませる
+    std::size_t size = getStatusLine(status).size() + 2;
+    if (!hasDate) {
+        size += getDate().size() + 8; // "Date: " + CRLF
+    }
+    for (Headers::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+        size += it->first.size() + it->second.size() + 4; // ": " + CRLF
+    }
+
+    std::string out;
+    out.reserve(size);
+    appendStatusLine(out, status, httpVersion);
+    if (!hasDate) {
+        appendField(out, "Date", getDate());
+    }
+    for (Headers::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+        appendField(out, it->first, it->second);
+    }
+    out += "\r\n";
+    return out;
+}
+
+std::string http::ResponseSerializer::serializeHeaderPrefix(const HttpStatusCode status, const Headers &headers) {
+    std::string out;
+    appendStatusLine(out, status, "HTTP/1.1");
+    for (Headers::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+        if (it->first != "Date" && it->first != "Connection") {
+            appendField(out, it->first, it->second);
+        }
+    }
+    return out;
+}
+
+std::string http::ResponseSerializer::completeHeader(const std::string &prefix, const bool keepAlive) {
+    const std::string &date = getDate();
+    std::string out;
+    out.reserve(prefix.size() + date.size() + 40);
+    out += prefix;
+    appendField(out, "Date", date);
+    appendField(out, "Connection", keepAlive ? "keep-alive" : "close");
+    out += "\r\n";
+    return out;
+}
+
+const std::string &http::ResponseSerializer::getStatusLine(const HttpStatusCode status) {
+    // ローカルな static の初期化はスレッドセーフ (worker スレッドから同時に呼ばれても 1 回だけ作られる)
+    static const std::vector<std::string> lines = buildStatusLines(kMinStatusCode, kMaxStatusCode);
+    static const std::string empty;
+
+    const int code = static_cast<int>(status);
+    if (code < kMinStatusCode || code > kMaxStatusCode) {
+        return empty;
+    }
+    return lines[code - kMinStatusCode];
+}
+
+const std::string &http::ResponseSerializer::getDate() {
+    // 秒単位なので、同じ秒の間は前回の文字列を使い回す (worker スレッドから呼ばれるので、スレッドごとに持つ)
+    static __thread std::time_t lastTime = -1;
+    pthread_once(&dateKeyOnce, createDateKey);
+    std::string *lastDate = static_cast<std::string *>(pthread_getspecific(dateKey));
+    if (lastDate == NULL) {
+        // __thread には非 POD を置けないので、pthread_key で持つ
+        lastDate = new std::string();
+        pthread_setspecific(dateKey, lastDate);
+    }
+    const std::time_t nowTime = utils::Time::getCachedCurrentTime();
+    if (nowTime != lastTime) {
+        *lastDate = utils::Time::formatHttpDate(nowTime);
+        lastTime = nowTime;
+    }
+    return *lastDate;
+}
+
+void http::ResponseSerializer::appendStatusLine(
+    std::string &out, const HttpStatusCode status, const std::string &httpVersion
+) {
+    const std::string &line = getStatusLine(status);
+    if (httpVersion == "HTTP/1.1" && !line.empty()) {
+        out += line;
+        return;
+    }
+    // 表にないものだけ組み立てる
+    out += httpVersion;
+    out += ' ';
+    out += utils::toString(static_cast<int>(status));
+    out += ' ';
+    out += getHttpStatusText(status);
+    out += "\r\n";
+}
+
+void http::ResponseSerializer::appendField(std::string &out, const std::string &name, const std::string &value) {
+    out += name;
+    out += ": ";
+    out += value;
+    out += "\r\n";
+}
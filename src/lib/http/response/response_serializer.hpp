@@ -0,0 +1,42 @@
+#ifndef SRC_LIB_HTTP_RESPONSE_RESPONSE_SERIALIZER_HPP
+#define SRC_LIB_HTTP_RESPONSE_RESPONSE_SERIALIZER_HPP
+
+#include "../status.hpp"
+#include "http/header.hpp"
+#include <string>
+
+namespace http {
+    /**
+     * 書き込み用に、レスポンスのヘッダー部分 (status line, field lines と空行) を 1 つのバッファに組み立てる
+     * HTTP/1.1 の status line は事前に組み立てた表から取り、Date は 1 秒ごとに作り直したものを使い回す
+     */
+    class ResponseSerializer {
+    public:
+        // headers に Date がなければ、現在時刻の Date を付ける
+        static std::string serializeHeader(
+            HttpStatusCode status, const Headers &headers, const std::string &httpVersion = "HTTP/1.1"
+        );
+
+        /**
+         * Date と Connection を除いたヘッダー部分 (空行も含まない)
+         * 同じレスポンスを何度も返す場合に、completeHeader で残りを付けて使う
+         */
+        static std::string serializeHeaderPrefix(HttpStatusCode status, const Headers &headers);
+        // serializeHeaderPrefix の結果に、Date, Connection と空行を付ける
+        static std::string completeHeader(const std::string &prefix, bool keepAlive);
+
+        // "HTTP/1.1 200 OK\r\n" の形の status line (未知のステータスコードは空文字列)
+        static const std::string &getStatusLine(HttpStatusCode status);
+        // 現在時刻の IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT")
+        static const std::string &getDate();
+
+    private:
+        static const int kMinStatusCode = 100;
+        static const int kMaxStatusCode = 599;
+
+        static void appendStatusLine(std::string &out, HttpStatusCode status, const std::string &httpVersion);
+        static void appendField(std::string &out, const std::string &name, const std::string &value);
+    };
+}
+
+#endif
@@ -201,4 +201,8 @@ namespace http {
                 return "";
         }
     }
+
+    bool isBodylessStatus(const HttpStatusCode code) {
+        return code < 200 || code == kStatusNoContent || code == kStatusNotModified;
+    }
 }
@@ -82,6 +82,8 @@ namespace http {
     Option<HttpStatusCode> httpStatusCodeFromInt(int code);
     // 入力を型で制約しているので、Option にはしない
     std::string getHttpStatusText(HttpStatusCode code);
+    // body を持たないレスポンスのステータス (1xx, 204, 304)。Content-Length も付けない
+    bool isBodylessStatus(HttpStatusCode code);
 }
 
 #endif
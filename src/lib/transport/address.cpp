@@ -1,9 +1,26 @@
 #include "address.hpp"
 #include "utils/string.hpp"
+#include <arpa/inet.h>
 
-Address::Address(const std::string &ip, const unsigned short port) : ip_(ip), port_(port) {}
+Address::Address(const std::string &ip, const unsigned short port)
+    : hasBinary_(false), binaryIp_(), ip_(ip), ipFormatted_(true), port_(port) {
+    hasBinary_ = inet_pton(AF_INET, ip.c_str(), &binaryIp_) == 1;
+}
+
+Address::Address(const sockaddr_in &addr, const bool formatNow)
+    : hasBinary_(true), binaryIp_(addr.sin_addr), ipFormatted_(false), port_(ntohs(addr.sin_port)) {
+    if (formatNow) {
+        this->getIp();
+    }
+}
 
 const std::string &Address::getIp() const {
+    if (!ipFormatted_) {
+        // inet_ntoa は static な領域を返すので、worker スレッドから使えない
+        char buf[INET_ADDRSTRLEN];
+        ip_ = inet_ntop(AF_INET, &binaryIp_, buf, sizeof(buf)) != NULL ? buf : "";
+        ipFormatted_ = true;
+    }
     return ip_;
 }
 
@@ -11,6 +28,20 @@ unsigned short Address::getPort() const {
     return port_;
 }
 
+bool Address::isWildcard() const {
+    if (hasBinary_) {
+        return binaryIp_.s_addr == htonl(INADDR_ANY);
+    }
+    return ip_ == "0.0.0.0";
+}
+
+bool Address::hasSameIp(const Address &other) const {
+    if (hasBinary_ && other.hasBinary_) {
+        return binaryIp_.s_addr == other.binaryIp_.s_addr;
+    }
+    return this->getIp() == other.getIp();
+}
+
 std::string Address::toString() const {
-    return utils::format("%s:%u", ip_.c_str(), port_);
+    return utils::format("%s:%u", this->getIp().c_str(), port_);
 }
@@ -1,19 +1,34 @@
 #ifndef SRC_LIB_TRANSPORT_ADDRESS_HPP
 #define SRC_LIB_TRANSPORT_ADDRESS_HPP
 
+#include <netinet/in.h>
 #include <string>
 
 class Address {
 public:
     Address(const std::string &ip, unsigned short port);
+    /**
+     * accept などで得たバイナリ形式から作る。IP の文字列は getIp で必要になるまで作らない
+     * NOTE: 遅延して作るのはスレッドセーフでない。worker スレッドで共有するもの (bind したアドレス) は formatNow を true にする
+     */
+    explicit Address(const sockaddr_in &addr, bool formatNow = false);
 
     const std::string &getIp() const;
     unsigned short getPort() const;
+    // INADDR_ANY (0.0.0.0) か
+    bool isWildcard() const;
+    // 同じ IP か。どちらもバイナリ形式を持っていれば、文字列にせずに比べる
+    bool hasSameIp(const Address &other) const;
 
     std::string toString() const;
 
 private:
-    std::string ip_;
+    // 文字列から作った場合は、IPv4 として解釈できたときのみ true
+    bool hasBinary_;
+    in_addr binaryIp_;
+    // 遅延して作るので mutable
+    mutable std::string ip_;
+    mutable bool ipFormatted_;
     unsigned short port_{};
 };
 
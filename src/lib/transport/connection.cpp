@@ -4,7 +4,8 @@
 
 Connection::Connection(const int fd, const Address &localAddress, const Address &foreignAddress)
     : clientFd_(fd), localAddress_(localAddress), foreignAddress_(foreignAddress), fdReader_(clientFd_),
-      buffer_(fdReader_), lastActivityTime_(utils::Time::getCurrentTime()) {}
+      buffer_(fdReader_), lastActivityTime_(utils::Time::getCachedMonotonicMillis()), remainingRequests_(0),
+      keepAlive_(false), chunkedAccepted_(false), idle_(false) {}
 
 Connection::~Connection() {
     LOG_DEBUG("Connection: destruct");
@@ -26,10 +27,47 @@ ReadBuffer &Connection::getReadBuffer() {
     return buffer_;
 }
 
-std::time_t Connection::getLastActivityTime() const {
+ResponseQueue &Connection::getResponseQueue() {
+    return responses_;
+}
+
+utils::Time::Millis Connection::getLastActivityTime() const {
     return lastActivityTime_;
 }
 
 void Connection::updateActivity() {
-    lastActivityTime_ = utils::Time::getCurrentTime();
+    lastActivityTime_ = utils::Time::getCachedMonotonicMillis();
+}
+
+void Connection::setRemainingRequests(const std::size_t remainingRequests) {
+    remainingRequests_ = remainingRequests;
+}
+
+void Connection::beginRequest(const bool keepAliveRequested, const bool chunkedAccepted) {
+    if (remainingRequests_ > 0) {
+        --remainingRequests_;
+    }
+    keepAlive_ = keepAliveRequested && remainingRequests_ > 0;
+    chunkedAccepted_ = chunkedAccepted;
+    idle_ = false;
+}
+
+bool Connection::isKeepAlive() const {
+    return keepAlive_;
+}
+
+bool Connection::isChunkedAccepted() const {
+    return chunkedAccepted_;
+}
+
+void Connection::disableKeepAlive() {
+    keepAlive_ = false;
+}
+
+bool Connection::isIdle() const {
+    return idle_;
+}
+
+void Connection::setIdle(const bool idle) {
+    idle_ = idle;
 }
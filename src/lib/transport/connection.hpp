@@ -2,10 +2,11 @@
 #define SRC_LIB_CONNECTION_HPP
 
 #include "address.hpp"
+#include "response_queue.hpp"
 #include "utils/auto_fd.hpp"
 #include "utils/io/read_buffer.hpp"
 #include "utils/io/reader.hpp"
-#include <ctime>
+#include "utils/time.hpp"
 
 // クライアントソケットの抽象
 class Connection {
@@ -17,16 +18,42 @@ public:
     const Address &getLocalAddress() const;
     const Address &getForeignAddress() const;
     ReadBuffer &getReadBuffer();
-    std::time_t getLastActivityTime() const;
+    // 書き込み待ちのレスポンス。パイプライニングされたリクエストのレスポンスは、リクエストの順に並ぶ
+    ResponseQueue &getResponseQueue();
+    // 単調増加する時刻 (utils::Time::getCachedMonotonicMillis)
+    utils::Time::Millis getLastActivityTime() const;
     void updateActivity();
 
+    /**
+     * keep-alive の状態
+     * 1 つのコネクションで受け付けるリクエストの残り回数は、accept 時に設定する (0 なら keep-alive しない)
+     */
+    void setRemainingRequests(std::size_t remainingRequests);
+    /**
+     * リクエストを受け取ったときに呼ぶ。レスポンスの後もコネクションを使い続けるかが決まる
+     * chunkedAccepted はクライアントが Transfer-Encoding: chunked を受け取れるか (HTTP/1.1 以降)
+     */
+    void beginRequest(bool keepAliveRequested, bool chunkedAccepted);
+    bool isKeepAlive() const;
+    bool isChunkedAccepted() const;
+    // 408 など、リクエストを最後まで読まずにレスポンスを返す場合に呼ぶ
+    void disableKeepAlive();
+    // レスポンスを送り終えて、次のリクエストのデータがまだ届いていない
+    bool isIdle() const;
+    void setIdle(bool idle);
+
 private:
     AutoFd clientFd_;
     Address localAddress_;
     Address foreignAddress_;
     io::FdReader fdReader_; // ReadBuffer に渡す IReader & の参照先として必要
     ReadBuffer buffer_;
-    std::time_t lastActivityTime_;
+    ResponseQueue responses_;
+    utils::Time::Millis lastActivityTime_;
+    std::size_t remainingRequests_;
+    bool keepAlive_;
+    bool chunkedAccepted_;
+    bool idle_;
 };
 
 #endif
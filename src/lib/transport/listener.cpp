@@ -29,37 +29,60 @@ const Address &Listener::getBindAddress() const {
     return bindAddress_;
 }
 
-Listener::AcceptConnectionResult Listener::acceptConnection() const {
-    sockaddr_in sockAddr = {};
+// accept した fd を non-blocking, close-on-exec にして返す
+static int acceptNonBlocking(const int serverFd, sockaddr_in &sockAddr) {
     socklen_t sockAddrLen = sizeof(sockAddr);
-    AutoFd fd(accept(serverFd_, reinterpret_cast<sockaddr *>(&sockAddr), &sockAddrLen));
+#if defined(__linux__)
+    // accept4 なら 1 回のシステムコールでフラグまで設定できる
+    return accept4(serverFd, reinterpret_cast<sockaddr *>(&sockAddr), &sockAddrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    AutoFd fd(accept(serverFd, reinterpret_cast<sockaddr *>(&sockAddr), &sockAddrLen));
     if (fd == -1) {
-        LOG_WARNF("failed to accept connection: %s", std::strerror(errno));
-        return Err<std::string>("failed to accept connection");
+        return -1;
     }
-    const Address foreignAddress(inet_ntoa(sockAddr.sin_addr), ntohs(sockAddr.sin_port));
+    if (utils::setNonBlocking(fd).isErr() || utils::setCloseOnExec(fd).isErr()) {
+        LOG_ERROR("failed to set non-blocking or close-on-exec fd");
+        return -1;
+    }
+    return fd.release();
+#endif
+}
 
-    if (utils::setNonBlocking(fd).isErr()) {
-        LOG_ERROR("failed to set non-blocking fd");
-        return Err<std::string>("failed to set non-blocking fd");
+Listener::AcceptConnectionResult Listener::acceptConnection() const {
+    sockaddr_in sockAddr = {};
+    int acceptedFd = acceptNonBlocking(serverFd_, sockAddr);
+    // accept 前に接続が切れた、またはシグナルで中断された場合は、キューに残っている次の接続を accept する
+    while (acceptedFd == -1 && (errno == ECONNABORTED || errno == EINTR)) {
+        acceptedFd = acceptNonBlocking(serverFd_, sockAddr);
     }
-    if (utils::setCloseOnExec(fd).isErr()) {
-        LOG_ERROR("failed to set close-on-exec fd");
-        return Err<std::string>("failed to set close-on-exec fd");
+    AutoFd fd(acceptedFd);
+    if (fd == -1) {
+        // 接続待ちのキューが空になった
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return Ok(None);
+        }
+        LOG_WARNF("failed to accept connection: %s", std::strerror(errno));
+        return Err<std::string>("failed to accept connection");
     }
+    // 文字列への変換はログや CGI で必要になるまで遅延する
+    const Address foreignAddress(sockAddr);
 
     LOG_INFOF("connection established from %s (fd: %d)", foreignAddress.toString().c_str(), fd.get());
 
-    // local address を取得
+    // 特定のアドレスに bind しているなら local address は自明なので、getsockname しない
+    if (!bindAddress_.isWildcard()) {
+        return Ok(Some(new Connection(fd.release(), bindAddress_, foreignAddress)));
+    }
+
     sockaddr_in localAddr = {};
     socklen_t localAddrLen = sizeof(localAddr);
     if (getsockname(fd, reinterpret_cast<sockaddr *>(&localAddr), &localAddrLen) == -1) {
         LOG_ERRORF("failed to get local address: %s", std::strerror(errno));
         return Err<std::string>("failed to get local address");
     }
-    const Address localAddress(inet_ntoa(localAddr.sin_addr), ntohs(localAddr.sin_port));
+    const Address localAddress(localAddr);
 
-    return Ok(new Connection(fd.release(), localAddress, foreignAddress));
+    return Ok(Some(new Connection(fd.release(), localAddress, foreignAddress)));
 }
 
 Result<addrinfo *, std::string> resolveAddress(const std::string &host, const std::string &port) {
@@ -106,8 +129,9 @@ Result<FdAddressPair, std::string> tryCreateAndBindSocket(addrinfo *addrList) {
 
         // socket(), bind() に成功
         // socket が close されないように、release で所有権を渡す
-        sockaddr_in *addr = reinterpret_cast<sockaddr_in *>(listNode->ai_addr);
-        return Ok(std::make_pair(sFd.release(), Address(inet_ntoa(addr->sin_addr), ntohs(addr->sin_port))));
+        const sockaddr_in *addr = reinterpret_cast<sockaddr_in *>(listNode->ai_addr);
+        // worker スレッドで共有されるので、先に文字列にしておく
+        return Ok(std::make_pair(sFd.release(), Address(*addr, true)));
     }
 
     // すべての候補で bind に失敗
@@ -6,6 +6,7 @@
 #include "utils/auto_fd.hpp"
 #include "connection.hpp"
 #include "address.hpp"
+#include "utils/types/option.hpp"
 #include "utils/types/result.hpp"
 
 // サーバーソケットの抽象
@@ -17,7 +18,8 @@ public:
     int getFd() const;
     const Address &getBindAddress() const;
 
-    typedef Result<Connection *, std::string> AcceptConnectionResult;
+    // accept 待ちの接続がなければ None
+    typedef Result<Option<Connection *>, std::string> AcceptConnectionResult;
     AcceptConnectionResult acceptConnection() const;
 
 private:
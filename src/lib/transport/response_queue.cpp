@@ -0,0 +1,253 @@
+#include "response_queue.hpp"
+#include "utils/string.hpp"
+#include "utils/types/try.hpp"
+#include <algorithm>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+const std::size_t ResponseQueue::kHighWatermark;
+const std::size_t ResponseQueue::kLowWatermark;
+const std::size_t ResponseQueue::kSendfileChunkSize;
+const std::size_t ResponseQueue::kStreamChunkSize;
+
+ResponseQueue::ResponseQueue()
+    : offset_(0), responses_(0), bytes_(0), streams_(0), waitingForBody_(false), resumableProducer_(None) {}
+
+void ResponseQueue::push(const std::string &header, const std::string &body) {
+    if (header.empty() && body.empty()) {
+        return;
+    }
+    if (body.empty()) {
+        this->pushSegment(makeSegment(header, true));
+    } else {
+        this->pushSegment(makeSegment(header, false));
+        this->pushSegment(makeSegment(body, true));
+    }
+    ++responses_;
+}
+
+void ResponseQueue::pushFile(
+    const std::string &header, const SharedPtr<AutoFd> &file, const off_t offset, const std::size_t length
+) {
+    if (length == 0) {
+        this->push(header);
+        return;
+    }
+    this->pushSegment(makeSegment(header, false));
+    Segment segment = makeSegment("", true);
+    segment.file = file;
+    segment.fileOffset = offset;
+    segment.length = length;
+    this->pushSegment(segment);
+    ++responses_;
+}
+
+void ResponseQueue::pushStream(
+    const std::string &header, const SharedPtr<http::IBodySource> &source, const bool chunked
+) {
+    this->pushSegment(makeSegment(header, false));
+    Segment segment = makeSegment("", true);
+    segment.source = source;
+    segment.chunked = chunked;
+    this->pushSegment(segment);
+    ++streams_;
+    ++responses_;
+}
+
+std::size_t ResponseQueue::size() const {
+    return responses_;
+}
+
+std::size_t ResponseQueue::bytes() const {
+    return bytes_;
+}
+
+bool ResponseQueue::empty() const {
+    return segments_.empty();
+}
+
+bool ResponseQueue::isAboveHighWatermark() const {
+    return bytes_ >= kHighWatermark;
+}
+
+bool ResponseQueue::isBelowLowWatermark() const {
+    return bytes_ <= kLowWatermark;
+}
+
+bool ResponseQueue::isStreaming() const {
+    return streams_ > 0;
+}
+
+bool ResponseQueue::isWaitingForBody() const {
+    return waitingForBody_;
+}
+
+Option<int> ResponseQueue::takeResumableProducer() {
+    const Option<int> producer = resumableProducer_;
+    resumableProducer_ = None;
+    return producer;
+}
+
+ResponseQueue::FlushResult ResponseQueue::flush(const int fd) {
+    waitingForBody_ = false;
+    bool first = true;
+    while (!segments_.empty()) {
+        if (segments_.front().source.get() != NULL) {
+            const bool pulled = TRY(this->pullStreamSegment());
+            if (!pulled) {
+                // 生産者がデータを追加するまで待つ
+                waitingForBody_ = true;
+                return Ok(false);
+            }
+            continue;
+        }
+
+        bool partial = false;
+        const Result<std::size_t, error::AppError> result = segments_.front().file.get() == NULL
+            ? this->writeMemorySegments(fd, partial)
+            : this->writeFileSegment(fd, partial);
+        if (result.isErr()) {
+            // 前の呼び出しで送信バッファを使い切った可能性があるので、2 回目以降の失敗は次の write イベントで判断する
+            if (!first && result.unwrapErr() == error::kIOUnknown) {
+                return Ok(false);
+            }
+            return Err(result.unwrapErr());
+        }
+        first = false;
+        this->consume(result.unwrap());
+        if (partial) {
+            // 送信バッファがいっぱい
+            return Ok(false);
+        }
+    }
+    return Ok(true);
+}
+
+void ResponseQueue::pushSegment(const Segment &segment) {
+    segments_.push_back(segment);
+    bytes_ += segment.length;
+}
+
+ResponseQueue::Segment ResponseQueue::makeSegment(const std::string &data, const bool last) {
+    Segment segment;
+    segment.data = data;
+    segment.fileOffset = 0;
+    segment.chunked = false;
+    segment.length = data.size();
+    segment.last = last;
+    return segment;
+}
+
+// 先頭から、ファイルのセグメントの手前までを writev で書き込む
+Result<std::size_t, error::AppError> ResponseQueue::writeMemorySegments(const int fd, bool &partial) {
+    struct iovec iov[kMaxIovecs];
+    std::size_t iovcnt = 0;
+    std::size_t bytesToWrite = 0;
+    for (std::deque<Segment>::iterator it = segments_.begin();
+         it != segments_.end() && it->file.get() == NULL && it->source.get() == NULL && iovcnt < kMaxIovecs;
+         ++it) {
+        // 書き込み済みの部分は飛ばす
+        const std::size_t skip = iovcnt == 0 ? offset_ : 0;
+        iov[iovcnt].iov_base = const_cast<char *>(it->data.data() + skip);
+        iov[iovcnt].iov_len = it->data.size() - skip;
+        bytesToWrite += iov[iovcnt].iov_len;
+        ++iovcnt;
+    }
+
+    const ssize_t bytesWritten = writev(fd, iov, static_cast<int>(iovcnt));
+    if (bytesWritten == -1) {
+        // EAGAIN とそれ以外の区別は epoll のエラーイベントで行う
+        return Err(error::kIOUnknown);
+    }
+    partial = static_cast<std::size_t>(bytesWritten) < bytesToWrite;
+    return Ok(static_cast<std::size_t>(bytesWritten));
+}
+
+// 先頭のファイルのセグメントを、カーネル内でコピーして送る
+Result<std::size_t, error::AppError> ResponseQueue::writeFileSegment(const int fd, bool &partial) {
+    const Segment &segment = segments_.front();
+    const std::size_t bytesToWrite = std::min(segment.length - offset_, kSendfileChunkSize);
+    off_t offset = segment.fileOffset + static_cast<off_t>(offset_);
+
+#if defined(__linux__)
+    const ssize_t bytesWritten = sendfile(fd, segment.file->get(), &offset, bytesToWrite);
+#else
+    // sendfile の引数が Linux と異なるので、小さいバッファを経由する
+    char buf[64 * 1024];
+    const ssize_t bytesRead = pread(segment.file->get(), buf, std::min(bytesToWrite, sizeof(buf)), offset);
+    const ssize_t bytesWritten = bytesRead <= 0 ? bytesRead : write(fd, buf, bytesRead);
+#endif
+    if (bytesWritten == -1) {
+        return Err(error::kIOUnknown);
+    }
+    if (bytesWritten == 0) {
+        // ファイルが途中で切り詰められた。Content-Length 分を送れないので、続けられない
+        return Err(error::kUnknown);
+    }
+    // chunk の途中で止まった場合のみ、送信バッファがいっぱい
+    partial = static_cast<std::size_t>(bytesWritten) < bytesToWrite;
+    return Ok(static_cast<std::size_t>(bytesWritten));
+}
+
+/**
+ * 先頭の IBodySource から取り出したデータを、メモリのセグメントとしてその前に置く
+ * 何も取り出せなかった (生産者を待つ) 場合は false を返す
+ */
+Result<bool, error::AppError> ResponseQueue::pullStreamSegment() {
+    const Segment stream = segments_.front();
+    std::string data;
+    const http::IBodySource::PullStatus status = TRY(stream.source->pull(data, kStreamChunkSize));
+    const Option<int> producer = stream.source->takeResumableProducer();
+    if (producer.isSome()) {
+        resumableProducer_ = producer;
+    }
+    if (status == http::IBodySource::kPullPending && data.empty()) {
+        return Ok(false);
+    }
+
+    std::string framed = stream.chunked && !data.empty()
+        ? utils::format("%zx\r\n", data.size()) + data + "\r\n"
+        : data;
+    if (status != http::IBodySource::kPullEnd) {
+        segments_.push_front(makeSegment(framed, false));
+        bytes_ += framed.size();
+        return Ok(true);
+    }
+
+    // 最後の chunk
+    if (stream.chunked) {
+        framed += "0\r\n\r\n";
+    }
+    segments_.pop_front();
+    --streams_;
+    if (framed.empty()) {
+        --responses_;
+    } else {
+        segments_.push_front(makeSegment(framed, true));
+        bytes_ += framed.size();
+    }
+    return Ok(true);
+}
+
+// 書き込み終わったセグメントを取り除く
+void ResponseQueue::consume(const std::size_t bytesWritten) {
+    bytes_ -= bytesWritten;
+    std::size_t remaining = bytesWritten;
+    while (remaining > 0) {
+        const std::size_t rest = segments_.front().length - offset_;
+        if (remaining < rest) {
+            offset_ += remaining;
+            return;
+        }
+        remaining -= rest;
+        if (segments_.front().last) {
+            --responses_;
+        }
+        segments_.pop_front();
+        offset_ = 0;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef SRC_LIB_TRANSPORT_RESPONSE_QUEUE_HPP
+#define SRC_LIB_TRANSPORT_RESPONSE_QUEUE_HPP
+
+#include "http/response/body_source.hpp"
+#include "utils/auto_fd.hpp"
+#include "utils/shared_ptr.hpp"
+#include "utils/types/error.hpp"
+#include "utils/types/result.hpp"
+#include <deque>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * コネクションに書き込む前のレスポンスを、届いた順に保持する
+ * ヘッダーと body は連結せずに別のセグメントとして持ち、writev でまとめて書き込む
+ * ファイルの body は fd のまま持ち、sendfile で送る (ユーザー空間にコピーしない)
+ * IBodySource の body は、先頭まで書き込みが進んだときに少しずつ取り出す
+ *
+ * 書き込み待ちのバイト数が high watermark を超えたら、新しいリクエストの処理を止める (backpressure)
+ * 止めた後は、low watermark を下回るまで再開しない
+ */
+class ResponseQueue {
+public:
+    static const std::size_t kHighWatermark = 256 * 1024;
+    static const std::size_t kLowWatermark = 64 * 1024;
+
+    ResponseQueue();
+
+    // header (status line からヘッダーの終わりの空行まで) と body を 1 つのレスポンスとして積む
+    void push(const std::string &header, const std::string &body = "");
+    // body としてファイルの offset から length バイトを送る
+    void pushFile(const std::string &header, const SharedPtr<AutoFd> &file, off_t offset, std::size_t length);
+    // body を source から取り出しながら送る。chunked なら chunk に区切って送る
+    void pushStream(const std::string &header, const SharedPtr<http::IBodySource> &source, bool chunked);
+    // 書き込みが終わっていないレスポンスの数
+    std::size_t size() const;
+    // 書き込みが終わっていないバイト数
+    std::size_t bytes() const;
+    bool empty() const;
+    bool isAboveHighWatermark() const;
+    bool isBelowLowWatermark() const;
+    // IBodySource の body が残っている
+    bool isStreaming() const;
+    // 直前の flush が、IBodySource のデータが届くのを待って止まった
+    bool isWaitingForBody() const;
+    // flush で IBodySource から取り出したことで、読み込みを再開できるようになった生産者の fd
+    Option<int> takeResumableProducer();
+
+    /**
+     * 溜まっているレスポンスを fd に書き込む
+     * すべて書き込めたら true、送信バッファがいっぱいで残っていれば false を返す
+     */
+    typedef Result<bool, error::AppError> FlushResult;
+    FlushResult flush(int fd);
+
+private:
+    // 1 回の writev に渡す iovec の数の上限 (IOV_MAX より十分小さくしておく)
+    static const std::size_t kMaxIovecs = 64;
+    // 1 回の sendfile で送る最大のバイト数
+    static const std::size_t kSendfileChunkSize = 1024 * 1024;
+    // IBodySource から 1 回に取り出す最大のバイト数 (chunked なら chunk の大きさ)
+    static const std::size_t kStreamChunkSize = 64 * 1024;
+
+    struct Segment {
+        std::string data;
+        // NULL でなければ、data ではなくファイルの fileOffset から length バイトを送る
+        SharedPtr<AutoFd> file;
+        off_t fileOffset;
+        // NULL でなければ、書き込む直前に取り出す (length は 0)
+        SharedPtr<http::IBodySource> source;
+        bool chunked;
+        std::size_t length;
+        // レスポンスの最後のセグメントか
+        bool last;
+    };
+
+    std::deque<Segment> segments_;
+    // 先頭のセグメントのうち、書き込み済みのバイト数
+    std::size_t offset_;
+    std::size_t responses_;
+    std::size_t bytes_;
+    std::size_t streams_;
+    bool waitingForBody_;
+    Option<int> resumableProducer_;
+
+    void pushSegment(const Segment &segment);
+    static Segment makeSegment(const std::string &data, bool last);
+    Result<std::size_t, error::AppError> writeMemorySegments(int fd, bool &partial);
+    Result<std::size_t, error::AppError> writeFileSegment(int fd, bool &partial);
+    Result<bool, error::AppError> pullStreamSegment();
+    void consume(std::size_t bytesWritten);
+};
+
+#endif
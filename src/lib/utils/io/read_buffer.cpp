@@ -1,25 +1,39 @@
 #include "read_buffer.hpp"
-#include "utils/string.hpp"
 #include "utils/types/try.hpp"
+#include <algorithm>
+#include <cstring>
 
-ReadBuffer::ReadBuffer(io::IReader &reader) : reader_(reader) {}
+const std::size_t ReadBuffer::kLoadSize;
+const std::size_t ReadBuffer::kMaxRetainedSize;
+
+ReadBuffer::ReadBuffer(io::IReader &reader) : reader_(reader), begin_(0), end_(0), scanned_(0) {}
 
 std::string ReadBuffer::consume(const std::size_t nbyte) {
-    const std::size_t bytesToConsume = std::min(nbyte, buf_.size());
-    const std::string consumed(buf_.data(), bytesToConsume);
-    buf_.erase(buf_.begin(), buf_.begin() + static_cast<long>(bytesToConsume));
+    const std::size_t bytesToConsume = std::min(nbyte, this->size());
+    const std::string consumed(this->data(), bytesToConsume);
+    this->onConsumed(bytesToConsume);
     return consumed;
 }
 
-// ReSharper disable once CppPassValueParameterByConstReference
-Option<std::string> wrapString(const std::string s) { // NOLINT(*-unnecessary-value-param)
-    return Some(s);
-}
-
 Option<std::string> ReadBuffer::consumeUntil(const std::string &delimiter) {
-    const char *found = TRY(utils::strnstr(buf_.data(), delimiter.c_str(), buf_.size()));
-    const char *delimEnd = found + delimiter.size();
-    const std::size_t bytesToConsume = delimEnd - buf_.data();
+    if (delimiter.empty()) {
+        return Some(std::string());
+    }
+    if (delimiter != lastDelimiter_) {
+        lastDelimiter_ = delimiter;
+        scanned_ = 0;
+    }
+
+    const char *first = this->data();
+    const char *last = first + this->size();
+    const char *found = std::search(first + scanned_, last, delimiter.begin(), delimiter.end());
+    if (found == last) {
+        // 末尾の delimiter.size() - 1 バイトは、続きのデータと合わせて delimiter になるかもしれない
+        const std::size_t size = this->size();
+        scanned_ = size < delimiter.size() ? 0 : size - (delimiter.size() - 1);
+        return None;
+    }
+    const std::size_t bytesToConsume = found + delimiter.size() - first;
     return Some(this->consume(bytesToConsume));
 }
 
@@ -28,12 +42,53 @@ ReadBuffer::LoadResult ReadBuffer::load() {
         return Ok(0ul);
     }
 
-    char tmp[ReadBuffer::kLoadSize];
-    const std::size_t bytesRead = TRY(reader_.read(tmp, ReadBuffer::kLoadSize));
-    buf_.insert(buf_.begin(), tmp, tmp + bytesRead);
+    this->reserveSpace();
+    const std::size_t bytesRead = TRY(reader_.read(&buf_[end_], buf_.size() - end_));
+    end_ += bytesRead;
     return Ok(bytesRead);
 }
 
 std::size_t ReadBuffer::size() const {
-    return buf_.size();
+    return end_ - begin_;
+}
+
+const char *ReadBuffer::data() const {
+    return buf_.empty() ? NULL : &buf_[begin_];
+}
+
+// end_ の後に kLoadSize 以上の空きを作る
+void ReadBuffer::reserveSpace() {
+    if (buf_.size() - end_ >= kLoadSize) {
+        return;
+    }
+    const std::size_t size = this->size();
+    if (begin_ >= size && buf_.size() - size >= kLoadSize) {
+        // 消費済みの部分を再利用する。コピーするのは前に詰めてから消費したバイト数以下なので、償却で O(1)
+        std::memmove(&buf_[0], &buf_[begin_], size);
+        begin_ = 0;
+        end_ = size;
+        return;
+    }
+    // 足りなければ 2 倍に広げる (未消費の部分だけをコピーする)
+    std::vector<char> grown(std::max(buf_.size() * 2, size + kLoadSize));
+    if (size > 0) {
+        std::memcpy(&grown[0], &buf_[begin_], size);
+    }
+    buf_.swap(grown);
+    begin_ = 0;
+    end_ = size;
+}
+
+void ReadBuffer::onConsumed(const std::size_t nbyte) {
+    begin_ += nbyte;
+    scanned_ = nbyte < scanned_ ? scanned_ - nbyte : 0;
+    if (begin_ != end_) {
+        return;
+    }
+    // 空になったら、次の load は先頭から書き込む
+    begin_ = 0;
+    end_ = 0;
+    if (buf_.size() > kMaxRetainedSize) {
+        std::vector<char>().swap(buf_);
+    }
 }
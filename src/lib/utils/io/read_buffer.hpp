@@ -5,6 +5,14 @@
 #include "../types/result.hpp"
 #include <vector>
 
+/**
+ * reader から読んだデータを、消費されるまで保持する
+ * 未消費のデータは buf_ の [begin_, end_) にあり、消費は begin_ を進めるだけ (前に詰めない)
+ * load は buf_ の空き (end_ 以降) に直接 read し、空きが足りないときだけ前に詰めるか広げる
+ *
+ * consumeUntil で delimiter が見つからなかった場合は、探し終えた位置を覚えておき、次は続きから探す
+ * そのため、1 行が何回かに分けて届いても、パースにかかる時間は受け取ったバイト数に比例する
+ */
 // utils/io にあるべきかは微妙
 class ReadBuffer {
 public:
@@ -25,11 +33,25 @@ public:
     LoadResult load();
     // 未読み取りのバイト数を返す
     std::size_t size() const;
+    // 未読み取りのデータの先頭 (size() バイトが連続している)。次の consume, load までのみ有効
+    const char *data() const;
 
 private:
+    // 1 回の load で最低限確保する空き
     static const std::size_t kLoadSize = 4096;
+    // 空になったときに、これより大きいバッファは解放する (大きい body を読んだコネクションがメモリを持ち続けないように)
+    static const std::size_t kMaxRetainedSize = 64 * 1024;
+
     io::IReader &reader_;
     std::vector<char> buf_;
+    std::size_t begin_;
+    std::size_t end_;
+    // begin_ から、この長さまでは lastDelimiter_ が始まらないことを確認済み
+    std::size_t scanned_;
+    std::string lastDelimiter_;
+
+    void reserveSpace();
+    void onConsumed(std::size_t nbyte);
 };
 
 #endif
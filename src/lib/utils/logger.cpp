@@ -1,4 +1,5 @@
 #include "logger.hpp"
+#include "time.hpp"
 #include <iostream>
 #include <ctime>
 
@@ -13,8 +14,12 @@ void Logger::setLevel(const LogLevel level) {
     this->logLevel_ = level;
 }
 
+bool Logger::isEnabled(const LogLevel level) const {
+    return level >= this->logLevel_;
+}
+
 void Logger::log(const LogLevel level, const std::string &message) const {
-    if (level < this->logLevel_) {
+    if (!this->isEnabled(level)) {
         return;
     }
 
@@ -43,12 +48,19 @@ std::string Logger::levelToString(const LogLevel level) {
 }
 
 std::string Logger::getTimestamp() {
-    const std::time_t nowTime = std::time(NULL);
-    const tm *nowLocal = std::localtime(&nowTime);
+    // 表示は秒単位なので、同じ秒の間は前回の文字列を使い回す (worker スレッドから呼ばれるので、スレッドごとに持つ)
+    static __thread std::time_t lastTime = -1;
+    static __thread char lastTimestamp[32];
 
-    char buffer[32];
-    std::strftime(buffer, sizeof(buffer), "%Y/%m/%d %H:%M:%S%z", nowLocal);
-    return std::string(buffer);
+    const std::time_t nowTime = utils::Time::getCachedCurrentTime();
+    if (nowTime != lastTime) {
+        // static な領域を使う localtime ではなく localtime_r を使う
+        tm nowLocal;
+        localtime_r(&nowTime, &nowLocal);
+        std::strftime(lastTimestamp, sizeof(lastTimestamp), "%Y/%m/%d %H:%M:%S%z", &nowLocal);
+        lastTime = nowTime;
+    }
+    return std::string(lastTimestamp);
 }
 
 std::string Logger::colorize(const std::string &text, const LogColor color) {
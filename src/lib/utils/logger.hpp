@@ -12,10 +12,16 @@
 #define LOG_WARN(msg) ::Logger::instance().log(::Logger::kWarn, msg)
 #define LOG_ERROR(msg) ::Logger::instance().log(::Logger::kError, msg)
 
-#define LOG_DEBUGF(...) ::Logger::instance().log(::Logger::kDebug, utils::format(__VA_ARGS__))
-#define LOG_INFOF(...) ::Logger::instance().log(::Logger::kInfo, utils::format(__VA_ARGS__))
-#define LOG_WARNF(...) ::Logger::instance().log(::Logger::kWarn, utils::format(__VA_ARGS__))
-#define LOG_ERRORF(...) ::Logger::instance().log(::Logger::kError, utils::format(__VA_ARGS__))
+// 出力しないレベルのときは、引数の評価 (Address の文字列化など) とフォーマットを省く
+#define LOG_WITH_FORMAT(level, ...)                                                                                    \
+    if (!::Logger::instance().isEnabled(level)) {                                                                      \
+    } else                                                                                                             \
+        ::Logger::instance().log(level, utils::format(__VA_ARGS__))
+
+#define LOG_DEBUGF(...) LOG_WITH_FORMAT(::Logger::kDebug, __VA_ARGS__)
+#define LOG_INFOF(...) LOG_WITH_FORMAT(::Logger::kInfo, __VA_ARGS__)
+#define LOG_WARNF(...) LOG_WITH_FORMAT(::Logger::kWarn, __VA_ARGS__)
+#define LOG_ERRORF(...) LOG_WITH_FORMAT(::Logger::kError, __VA_ARGS__)
 
 class Logger {
 public:
@@ -23,6 +29,7 @@ public:
 
     static Logger &instance();
     void setLevel(LogLevel level);
+    bool isEnabled(LogLevel level) const;
     void log(LogLevel level, const std::string &message) const;
 
 private:
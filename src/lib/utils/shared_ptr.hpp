@@ -0,0 +1,88 @@
+#ifndef SRC_LIB_UTILS_SHARED_PTR_HPP
+#define SRC_LIB_UTILS_SHARED_PTR_HPP
+
+#include <cstddef>
+
+/**
+ * std::shared_ptr のような参照カウント付きのポインタ
+ * NOTE: カウントはアトミックではない。1 つのイベントループ (スレッド) の中でのみ共有すること
+ */
+template <typename T>
+class SharedPtr {
+public:
+    explicit SharedPtr(T *ptr = NULL) : ptr_(ptr), count_(ptr == NULL ? NULL : new std::size_t(1)) {}
+
+    SharedPtr(const SharedPtr &other) : ptr_(other.ptr_), count_(other.count_) {
+        if (count_ != NULL) {
+            ++*count_;
+        }
+    }
+
+    // 派生クラスのポインタから、基底クラスのポインタへの変換
+    template <typename U>
+    SharedPtr(const SharedPtr<U> &other) : ptr_(other.ptr_), count_(other.count_) { // NOLINT(google-explicit-constructor)
+        if (count_ != NULL) {
+            ++*count_;
+        }
+    }
+
+    ~SharedPtr() {
+        this->release();
+    }
+
+    SharedPtr &operator=(const SharedPtr &other) {
+        if (this != &other) {
+            // other が this を参照している場合に備えて、先にカウントを増やす
+            if (other.count_ != NULL) {
+                ++*other.count_;
+            }
+            this->release();
+            ptr_ = other.ptr_;
+            count_ = other.count_;
+        }
+        return *this;
+    }
+
+    T *get() const {
+        return ptr_;
+    }
+
+    T &operator*() const {
+        return *ptr_;
+    }
+
+    T *operator->() const {
+        return ptr_;
+    }
+
+    bool operator==(const SharedPtr &other) const {
+        return ptr_ == other.ptr_;
+    }
+
+    bool operator!=(const SharedPtr &other) const {
+        return ptr_ != other.ptr_;
+    }
+
+    // 同じリソースを共有している SharedPtr の数
+    std::size_t useCount() const {
+        return count_ == NULL ? 0 : *count_;
+    }
+
+private:
+    template <typename U>
+    friend class SharedPtr;
+
+    T *ptr_;
+    std::size_t *count_;
+
+    void release() {
+        if (count_ != NULL && --*count_ == 0) {
+            delete ptr_;
+            delete count_;
+        }
+        ptr_ = NULL;
+        count_ = NULL;
+    }
+};
+
+#endif
@@ -2,6 +2,11 @@
 
 namespace utils {
 
+    // イベントループはスレッドごとに動くので、キャッシュもスレッドごとに持つ
+    static __thread bool cachedClockEnabled = false;
+    static __thread Time::Millis cachedMonotonicMillis = 0;
+    static __thread std::time_t cachedCurrentTime = 0;
+
     std::time_t Time::getCurrentTime() {
         return std::time(NULL);
     }
@@ -10,4 +15,59 @@ namespace utils {
         return std::difftime(end, start);
     }
 
+    Time::Millis Time::getMonotonicMillis() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<Millis>(ts.tv_sec) * 1000 + static_cast<Millis>(ts.tv_nsec) / 1000000;
+    }
+
+    std::string Time::formatHttpDate(const std::time_t time) {
+        tm gmt;
+        gmtime_r(&time, &gmt);
+        char buf[32];
+        // %a, %b はロケールに依存するが、setlocale していないので "C" ロケールの英語表記になる
+        const std::size_t len = std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+        return std::string(buf, len);
+    }
+
+    Option<std::time_t> Time::parseHttpDate(const std::string &date) {
+        tm gmt = {};
+        const char *end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+        if (end == NULL || *end != '\0') {
+            return None;
+        }
+        return Some(timegm(&gmt));
+    }
+
+    void Time::updateCachedClock() {
+        cachedMonotonicMillis = readCoarseMonotonicMillis();
+        cachedCurrentTime = getCurrentTime();
+        cachedClockEnabled = true;
+    }
+
+    Time::Millis Time::getCachedMonotonicMillis() {
+        if (!cachedClockEnabled) {
+            return readCoarseMonotonicMillis();
+        }
+        return cachedMonotonicMillis;
+    }
+
+    std::time_t Time::getCachedCurrentTime() {
+        if (!cachedClockEnabled) {
+            return getCurrentTime();
+        }
+        return cachedCurrentTime;
+    }
+
+    Time::Millis Time::readCoarseMonotonicMillis() {
+#if defined(CLOCK_MONOTONIC_COARSE)
+        // vDSO で読めて、CLOCK_MONOTONIC より安い
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return static_cast<Millis>(ts.tv_sec) * 1000 + static_cast<Millis>(ts.tv_nsec) / 1000000;
+#else
+        return getMonotonicMillis();
+#endif
+    }
+
 }
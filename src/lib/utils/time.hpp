@@ -1,14 +1,40 @@
 #ifndef TIME_HPP
 #define TIME_HPP
 
+#include "types/option.hpp"
 #include <ctime>
+#include <string>
+#include <stdint.h>
 
 namespace utils {
 
     class Time {
     public:
+        // ミリ秒単位の時刻・時間
+        typedef uint64_t Millis;
+
         static std::time_t getCurrentTime();
         static double diffTimeSeconds(std::time_t end, std::time_t start);
+        // 単調増加する時刻 (CLOCK_MONOTONIC)。時刻の変更の影響を受けないので、タイムアウトの計算に使う
+        static Millis getMonotonicMillis();
+        // HTTP の日付の形式 (IMF-fixdate, "Sun, 06 Nov 1994 08:49:37 GMT")
+        static std::string formatHttpDate(std::time_t time);
+        // IMF-fixdate を解釈する (それ以外の形式は None)
+        static Option<std::time_t> parseHttpDate(const std::string &date);
+
+        /**
+         * スレッドごとにキャッシュした時刻
+         * イベントループが waitEvents から戻るたびに updateCachedClock で更新するので、ループ内では何度呼んでもシステムコールは起きない
+         * updateCachedClock を呼んでいないスレッドでは、毎回時刻を取得する
+         */
+        static void updateCachedClock();
+        // 単調増加する時刻。粗い時計 (CLOCK_MONOTONIC_COARSE) を使うので、数 ms の誤差がある
+        static Millis getCachedMonotonicMillis();
+        // ログの表示などに使う現在時刻
+        static std::time_t getCachedCurrentTime();
+
+    private:
+        static Millis readCoarseMonotonicMillis();
     };
 
 }
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include "event/action_queue.hpp"
+#include "event/event_handler.hpp"
+#include <cstdlib>
+#include <new>
+
+// このテストの実行ファイル内の operator new の呼び出し回数
+static std::size_t gAllocationCount = 0;
+
+void *operator new(const std::size_t size) {
+    ++gAllocationCount;
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    class DummyHandler : public IEventHandler {
+    public:
+        explicit DummyHandler(bool &deleted) : deleted_(deleted) {}
+        ~DummyHandler() override {
+            deleted_ = true;
+        }
+        InvokeResult invoke(const Context &, ActionQueue &) override {
+            return Ok();
+        }
+
+    private:
+        bool &deleted_;
+    };
+
+    // WriteResponseHandler が書き終わったときに積む処理と同じもの
+    void pushCloseConnection(ActionQueue &actions, const int fd) {
+        actions.unregisterEvent(Event(fd, Event::kRead | Event::kWrite));
+        actions.unregisterEventHandler(fd, Event::kRead);
+        actions.unregisterEventHandler(fd, Event::kWrite);
+        actions.removeConnection(fd);
+    }
+}
+
+TEST(ActionQueueTest, KeepsOrder) {
+    ActionQueue actions;
+    actions.registerEvent(Event(4, Event::kWrite));
+    actions.unregisterEventHandler(4, Event::kRead);
+    actions.removeConnection(5);
+
+    ASSERT_EQ(actions.size(), 3);
+    EXPECT_EQ(actions[0].kind, ActionQueue::Command::kRegisterEvent);
+    EXPECT_EQ(actions[0].fd, 4);
+    EXPECT_EQ(actions[0].eventFlags, Event::kWrite);
+    EXPECT_EQ(actions[1].kind, ActionQueue::Command::kUnregisterEventHandler);
+    EXPECT_EQ(actions[1].eventFlags, Event::kRead);
+    EXPECT_EQ(actions[2].kind, ActionQueue::Command::kRemoveConnection);
+    EXPECT_EQ(actions[2].fd, 5);
+
+    actions.clear();
+    EXPECT_TRUE(actions.empty());
+}
+
+// 実行されなかったコマンドが持つ handler は解放される
+TEST(ActionQueueTest, DiscardDeletesOwnedObjects) {
+    bool deleted = false;
+    {
+        ActionQueue actions;
+        actions.registerEventHandler(4, Event::kWrite, new DummyHandler(deleted));
+        actions.discard();
+        EXPECT_TRUE(deleted);
+        EXPECT_TRUE(actions.empty());
+    }
+
+    deleted = false;
+    {
+        ActionQueue actions;
+        actions.registerEventHandler(4, Event::kWrite, new DummyHandler(deleted));
+    }
+    EXPECT_TRUE(deleted);
+}
+
+// イベントごとに積んで clear するのを繰り返しても、コマンドのためのヒープ確保は起きない
+TEST(ActionQueueTest, SteadyStateDoesNotAllocate) {
+    const int kIterations = 100000;
+    ActionQueue actions;
+
+    const std::size_t before = gAllocationCount;
+    for (int i = 0; i < kIterations; i++) {
+        actions.registerEvent(Event(i & 1023, Event::kWrite));
+        actions.unregisterEventHandler(i & 1023, Event::kRead);
+        pushCloseConnection(actions, i & 1023);
+        actions.clear();
+    }
+    EXPECT_EQ(gAllocationCount - before, 0);
+}
@@ -0,0 +1,42 @@
+#include <gtest/gtest.h>
+#include "transport/address.hpp"
+#include <arpa/inet.h>
+
+static sockaddr_in makeSockAddr(const char *ip, const unsigned short port) {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+TEST(AddressTest, FromSockAddr) {
+    const Address addr(makeSockAddr("192.168.0.1", 8080));
+    EXPECT_EQ(addr.getIp(), "192.168.0.1");
+    EXPECT_EQ(addr.getPort(), 8080);
+    EXPECT_EQ(addr.toString(), "192.168.0.1:8080");
+}
+
+// 文字列化する前にコピーしても、コピー先で文字列化できる
+TEST(AddressTest, CopyBeforeFormat) {
+    const Address addr(makeSockAddr("10.0.0.2", 80));
+    const Address copied(addr); // NOLINT(*-unnecessary-copy-initialization)
+    EXPECT_EQ(copied.getIp(), "10.0.0.2");
+    EXPECT_EQ(addr.getIp(), "10.0.0.2");
+}
+
+TEST(AddressTest, IsWildcard) {
+    EXPECT_TRUE(Address(makeSockAddr("0.0.0.0", 80)).isWildcard());
+    EXPECT_FALSE(Address(makeSockAddr("127.0.0.1", 80)).isWildcard());
+    EXPECT_TRUE(Address("0.0.0.0", 80).isWildcard());
+    EXPECT_FALSE(Address("127.0.0.1", 80).isWildcard());
+}
+
+TEST(AddressTest, HasSameIp) {
+    const Address bound(makeSockAddr("127.0.0.1", 8080), true);
+    EXPECT_TRUE(bound.hasSameIp(Address(makeSockAddr("127.0.0.1", 12345))));
+    EXPECT_FALSE(bound.hasSameIp(Address(makeSockAddr("127.0.0.2", 8080))));
+    // 文字列から作ったものとも比べられる
+    EXPECT_TRUE(bound.hasSameIp(Address("127.0.0.1", 8080)));
+    EXPECT_FALSE(Address("127.0.0.1", 80).hasSameIp(Address("10.0.0.1", 80)));
+}
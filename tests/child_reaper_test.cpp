@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "core/child_reaper.hpp"
+#include "utils/logger.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+
+class ChildReaperTest : public testing::Test {
+protected:
+    void SetUp() override {
+        SET_LOG_LEVEL(Logger::kError);
+    }
+
+    static pid_t spawn(const int exitStatus) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            _exit(exitStatus);
+        }
+        return pid;
+    }
+
+    // 子プロセスが終了するまで待つ (回収はしない)
+    static void waitExit(const pid_t pid) {
+        siginfo_t info;
+        waitid(P_PID, pid, &info, WEXITED | WNOWAIT);
+    }
+};
+
+TEST_F(ChildReaperTest, ReapTrackedChild) {
+    ChildReaper reaper;
+    const pid_t pid = spawn(3);
+    ASSERT_GT(pid, 0);
+    reaper.track(pid);
+    waitExit(pid);
+
+    const std::vector<ChildReaper::ReapedProcess> result = reaper.onSignalEvent();
+    ASSERT_EQ(result.size(), 1);
+    EXPECT_EQ(result[0].pid, pid);
+    EXPECT_EQ(result[0].status, 3);
+
+    // 2 回目は何も回収しない
+    EXPECT_TRUE(reaper.onSignalEvent().empty());
+}
+
+// 他のイベントループの子プロセスは回収しない
+TEST_F(ChildReaperTest, IgnoreUntrackedChild) {
+    ChildReaper reaper;
+    const pid_t pid = spawn(0);
+    ASSERT_GT(pid, 0);
+    waitExit(pid);
+
+    EXPECT_TRUE(reaper.onSignalEvent().empty());
+
+    // まだ回収されていない
+    int status = 0;
+    EXPECT_EQ(waitpid(pid, &status, WNOHANG), pid);
+}
+
+// 複数のインスタンスがあっても、すべての self-pipe に通知される
+TEST_F(ChildReaperTest, NotifyAllInstances) {
+    ChildReaper reaper1;
+    ChildReaper reaper2;
+    const pid_t pid = spawn(0);
+    ASSERT_GT(pid, 0);
+    reaper1.track(pid);
+    waitExit(pid);
+
+    char c;
+    EXPECT_EQ(read(reaper1.getReadFd(), &c, 1), 1);
+    EXPECT_EQ(read(reaper2.getReadFd(), &c, 1), 1);
+    EXPECT_EQ(reaper1.onSignalEvent().size(), 1);
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "config/config.hpp"
+#include "config/toml/parser.hpp"
+#include "utils/logger.hpp"
+#include <stdexcept>
+
+using namespace config;
+
+class MainContextTest : public testing::Test {
+protected:
+    void SetUp() override {
+        SET_LOG_LEVEL(Logger::kError);
+    }
+
+    static MainContext parse(const std::string &text) {
+        return MainContext::fromToml(toml::TomlParser(toml::Tokenizer(text).tokenize().unwrap()).parse().unwrap());
+    }
+};
+
+TEST_F(MainContextTest, KeepAliveDefaults) {
+    const MainContext ctx = parse("");
+    EXPECT_EQ(ctx.getKeepAliveTimeoutMs(), 15000u);
+    EXPECT_EQ(ctx.getKeepAliveRequests(), 100u);
+}
+
+TEST_F(MainContextTest, KeepAliveValues) {
+    const MainContext ctx = parse("keepalive_timeout_ms = 3000\nkeepalive_requests = 5\n");
+    EXPECT_EQ(ctx.getKeepAliveTimeoutMs(), 3000u);
+    EXPECT_EQ(ctx.getKeepAliveRequests(), 5u);
+}
+
+// 0 は keep-alive しない
+TEST_F(MainContextTest, KeepAliveRequestsZero) {
+    EXPECT_EQ(parse("keepalive_requests = 0\n").getKeepAliveRequests(), 0u);
+    EXPECT_EQ(parse("keepalive_requests = 1000000\n").getKeepAliveRequests(), 1000000u);
+}
+
+TEST_F(MainContextTest, KeepAliveRequestsOutOfRange) {
+    EXPECT_THROW(parse("keepalive_requests = -1\n"), std::runtime_error);
+    EXPECT_THROW(parse("keepalive_requests = 1000001\n"), std::runtime_error);
+}
+
+TEST_F(MainContextTest, KeepAliveTimeoutOutOfRange) {
+    EXPECT_EQ(parse("keepalive_timeout_ms = 1\n").getKeepAliveTimeoutMs(), 1u);
+    EXPECT_EQ(parse("keepalive_timeout_ms = 86400000\n").getKeepAliveTimeoutMs(), 86400000u);
+    EXPECT_THROW(parse("keepalive_timeout_ms = 0\n"), std::runtime_error);
+    EXPECT_THROW(parse("keepalive_timeout_ms = -1\n"), std::runtime_error);
+    EXPECT_THROW(parse("keepalive_timeout_ms = 86400001\n"), std::runtime_error);
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "transport/connection.hpp"
+#include <unistd.h>
+
+class ConnectionTest : public testing::Test {
+protected:
+    std::unique_ptr<Connection> conn_;
+
+    void SetUp() override {
+        int fds[2];
+        ASSERT_EQ(pipe(fds), 0);
+        close(fds[1]);
+        // fd は Connection が閉じる
+        conn_ = std::make_unique<Connection>(fds[0], Address("127.0.0.1", 8080), Address("127.0.0.1", 50000));
+    }
+};
+
+// accept 時に設定した回数だけリクエストを受け付け、最後のリクエストの後は閉じる
+TEST_F(ConnectionTest, BeginRequestCountsDownRemainingRequests) {
+    conn_->setRemainingRequests(3);
+
+    conn_->beginRequest(true, true);
+    EXPECT_TRUE(conn_->isKeepAlive());
+    conn_->beginRequest(true, true);
+    EXPECT_TRUE(conn_->isKeepAlive());
+    conn_->beginRequest(true, true);
+    EXPECT_FALSE(conn_->isKeepAlive());
+    conn_->beginRequest(true, true);
+    EXPECT_FALSE(conn_->isKeepAlive());
+}
+
+TEST_F(ConnectionTest, KeepAliveDisabledByConfig) {
+    conn_->setRemainingRequests(0);
+    conn_->beginRequest(true, true);
+    EXPECT_FALSE(conn_->isKeepAlive());
+}
+
+TEST_F(ConnectionTest, KeepAliveNotRequested) {
+    conn_->setRemainingRequests(10);
+    conn_->beginRequest(false, false);
+    EXPECT_FALSE(conn_->isKeepAlive());
+    EXPECT_FALSE(conn_->isChunkedAccepted());
+
+    // 要求されなかったリクエストも回数に数える
+    conn_->setRemainingRequests(2);
+    conn_->beginRequest(false, true);
+    conn_->beginRequest(true, true);
+    EXPECT_FALSE(conn_->isKeepAlive());
+}
+
+TEST_F(ConnectionTest, BeginRequestClearsIdle) {
+    conn_->setRemainingRequests(10);
+    conn_->setIdle(true);
+    conn_->beginRequest(true, true);
+    EXPECT_FALSE(conn_->isIdle());
+
+    conn_->disableKeepAlive();
+    EXPECT_FALSE(conn_->isKeepAlive());
+}
@@ -0,0 +1,40 @@
+#include "http/content_coding.hpp"
+#include <gtest/gtest.h>
+
+TEST(ContentCoding, Listed) {
+    EXPECT_EQ(http::getAcceptedQuality("gzip, deflate, br", "gzip"), 1000);
+    EXPECT_EQ(http::getAcceptedQuality("gzip, deflate, br", "br"), 1000);
+    EXPECT_EQ(http::getAcceptedQuality("gzip, deflate", "br"), 0);
+    EXPECT_EQ(http::getAcceptedQuality("", "gzip"), 0);
+    // 大文字小文字は区別しない
+    EXPECT_EQ(http::getAcceptedQuality("GZIP", "gzip"), 1000);
+    EXPECT_EQ(http::getAcceptedQuality("x-gzip", "gzip"), 1000);
+}
+
+TEST(ContentCoding, QValue) {
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=0.5, br;q=0.8", "gzip"), 500);
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=0.5, br;q=0.8", "br"), 800);
+    EXPECT_EQ(http::getAcceptedQuality("gzip ; q=0.125", "gzip"), 125);
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=1.000", "gzip"), 1000);
+    // q=0 は受け入れない
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=0, br", "gzip"), 0);
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=0.0", "gzip"), 0);
+}
+
+TEST(ContentCoding, Wildcard) {
+    EXPECT_EQ(http::getAcceptedQuality("*", "br"), 1000);
+    EXPECT_EQ(http::getAcceptedQuality("*;q=0.3", "br"), 300);
+    // 明示されたものが優先
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=0, *", "gzip"), 0);
+    EXPECT_EQ(http::getAcceptedQuality("*;q=0, br", "br"), 1000);
+}
+
+// 不正な q 値の要素は無視する
+TEST(ContentCoding, InvalidQValue) {
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=2", "gzip"), 0);
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=1.5", "gzip"), 0);
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=abc", "gzip"), 0);
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=0.1234", "gzip"), 0);
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=", "gzip"), 0);
+    EXPECT_EQ(http::getAcceptedQuality("gzip;q=x, *;q=0.5", "gzip"), 500);
+}
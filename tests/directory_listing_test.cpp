@@ -0,0 +1,231 @@
+#include "http/directory_listing.hpp"
+#include "utils/string.hpp"
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+class DirectoryListingTest : public testing::Test {
+protected:
+    std::string dir_;
+    std::vector<std::string> files_;
+
+    void SetUp() override {
+        char dir[] = "/tmp/directory_listing_test_XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        dir_ = dir;
+    }
+
+    void TearDown() override {
+        for (std::size_t i = 0; i < files_.size(); ++i) {
+            unlink((dir_ + "/" + files_[i]).c_str());
+        }
+        rmdir((dir_ + "/sub").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    void createFile(const std::string &name) {
+        const int fd = ::open((dir_ + "/" + name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_NE(fd, -1);
+        close(fd);
+        files_.push_back(name);
+    }
+
+    // mtime が古くないとキャッシュされないので、過去の時刻にする
+    void setMtime(const time_t mtime) const {
+        struct timeval times[2] = {};
+        times[0].tv_sec = mtime;
+        times[1].tv_sec = mtime;
+        ASSERT_EQ(utimes(dir_.c_str(), times), 0);
+    }
+
+    static std::string pullAll(http::IBodySource &source, const std::size_t max) {
+        std::string body;
+        while (true) {
+            const http::IBodySource::PullResult result = source.pull(body, max);
+            if (result.isErr() || result.unwrap() == http::IBodySource::kPullEnd) {
+                return body;
+            }
+        }
+    }
+};
+
+TEST_F(DirectoryListingTest, ReadDirectorySorted) {
+    createFile("b.txt");
+    createFile("a.txt");
+    ASSERT_EQ(mkdir((dir_ + "/sub").c_str(), 0755), 0);
+
+    const Result<http::DirectoryEntries, int> result = http::readDirectory(dir_);
+    ASSERT_TRUE(result.isOk());
+    const http::DirectoryEntries &entries = result.unwrap();
+    ASSERT_EQ(entries.size(), 4u);
+    EXPECT_EQ(entries[0].name, "..");
+    EXPECT_TRUE(entries[0].isDirectory);
+    EXPECT_EQ(entries[1].name, "a.txt");
+    EXPECT_FALSE(entries[1].isDirectory);
+    EXPECT_EQ(entries[2].name, "b.txt");
+    EXPECT_EQ(entries[3].name, "sub");
+    EXPECT_TRUE(entries[3].isDirectory);
+}
+
+TEST_F(DirectoryListingTest, ReadDirectoryNotFound) {
+    const Result<http::DirectoryEntries, int> result = http::readDirectory(dir_ + "/none");
+    ASSERT_TRUE(result.isErr());
+    EXPECT_EQ(result.unwrapErr(), ENOENT);
+}
+
+TEST_F(DirectoryListingTest, RenderHtml) {
+    http::DirectoryEntries entries;
+    const http::DirectoryEntry parent = {"..", true};
+    const http::DirectoryEntry sub = {"sub", true};
+    const http::DirectoryEntry file = {"a b<c>.txt", false};
+    entries.push_back(parent);
+    entries.push_back(file);
+    entries.push_back(sub);
+
+    EXPECT_EQ(
+        http::renderDirectoryListing(entries, "/<x>/", http::kListingHtml),
+        "<!DOCTYPE html><html><head><title>Index of /&lt;x&gt;/</title></head><body>"
+        "<h1>Index of /&lt;x&gt;/</h1><hr><ul>"
+        "<li><a href=\"../\">../</a></li>"
+        "<li><a href=\"a%20b%3Cc%3E.txt\">a b&lt;c&gt;.txt</a></li>"
+        "<li><a href=\"sub/\">sub/</a></li>"
+        "</ul><hr></body></html>"
+    );
+}
+
+TEST_F(DirectoryListingTest, RenderJson) {
+    http::DirectoryEntries entries;
+    const http::DirectoryEntry parent = {"..", true};
+    const http::DirectoryEntry file = {"a\"b.txt", false};
+    const http::DirectoryEntry sub = {"sub", true};
+    entries.push_back(parent);
+    entries.push_back(file);
+    entries.push_back(sub);
+
+    EXPECT_EQ(
+        http::renderDirectoryListing(entries, "/", http::kListingJson),
+        "[{\"name\":\"a\\\"b.txt\",\"type\":\"file\"},{\"name\":\"sub\",\"type\":\"directory\"}]"
+    );
+    EXPECT_EQ(http::renderDirectoryListing(http::DirectoryEntries(1, parent), "/", http::kListingJson), "[]");
+}
+
+TEST_F(DirectoryListingTest, BodySourceMatchesRender) {
+    http::DirectoryEntries entries;
+    const http::DirectoryEntry parent = {"..", true};
+    entries.push_back(parent);
+    for (int i = 0; i < 100; ++i) {
+        const http::DirectoryEntry entry = {utils::format("file%03d", i), i % 10 == 0};
+        entries.push_back(entry);
+    }
+    const SharedPtr<const http::DirectoryEntries> shared(new http::DirectoryEntries(entries));
+
+    http::DirectoryListingBodySource html(shared, "/dir/", http::kListingHtml);
+    EXPECT_TRUE(html.getLength().isNone());
+    EXPECT_EQ(pullAll(html, 100), http::renderDirectoryListing(entries, "/dir/", http::kListingHtml));
+
+    http::DirectoryListingBodySource json(shared, "/dir/", http::kListingJson);
+    EXPECT_EQ(pullAll(json, 7), http::renderDirectoryListing(entries, "/dir/", http::kListingJson));
+}
+
+TEST_F(DirectoryListingTest, CacheValidatedByMtime) {
+    createFile("a.txt");
+    setMtime(1000000000);
+    http::DirectoryListingCache cache(16);
+
+    const Result<http::Response, int> first = cache.respond(dir_, "/", http::kListingJson);
+    ASSERT_TRUE(first.isOk());
+    EXPECT_EQ(first.unwrap().getBody().unwrap(), "[{\"name\":\"a.txt\",\"type\":\"file\"}]");
+    EXPECT_EQ(first.unwrap().getHeaders().at("Content-Type"), "application/json");
+    EXPECT_EQ(first.unwrap().getHeaders().at("Vary"), "Accept");
+
+    const Result<http::Response, int> second = cache.respond(dir_, "/", http::kListingJson);
+    ASSERT_TRUE(second.isOk());
+    EXPECT_EQ(second.unwrap().getBody(), first.unwrap().getBody());
+    EXPECT_EQ(cache.getStats().hits, 1u);
+    EXPECT_EQ(cache.getStats().misses, 1u);
+    EXPECT_EQ(cache.size(), 1u);
+
+    // ディレクトリが変更されたら読み直す
+    createFile("b.txt");
+    setMtime(1000000001);
+    const Result<http::Response, int> third = cache.respond(dir_, "/", http::kListingJson);
+    ASSERT_TRUE(third.isOk());
+    EXPECT_EQ(
+        third.unwrap().getBody().unwrap(),
+        "[{\"name\":\"a.txt\",\"type\":\"file\"},{\"name\":\"b.txt\",\"type\":\"file\"}]"
+    );
+    EXPECT_EQ(cache.getStats().misses, 2u);
+
+    // HTML は target ごとにタイトルが変わる
+    const Result<http::Response, int> html = cache.respond(dir_, "/x/", http::kListingHtml);
+    ASSERT_TRUE(html.isOk());
+    EXPECT_NE(html.unwrap().getBody().unwrap().find("<title>Index of /x/</title>"), std::string::npos);
+    const Result<http::Response, int> other = cache.respond(dir_, "/y/", http::kListingHtml);
+    ASSERT_TRUE(other.isOk());
+    EXPECT_NE(other.unwrap().getBody().unwrap().find("<title>Index of /y/</title>"), std::string::npos);
+    EXPECT_EQ(cache.getStats().hits, 3u);
+}
+
+TEST_F(DirectoryListingTest, RecentlyModifiedIsNotCached) {
+    createFile("a.txt");
+    http::DirectoryListingCache cache(16);
+
+    ASSERT_TRUE(cache.respond(dir_, "/", http::kListingHtml).isOk());
+    EXPECT_EQ(cache.size(), 0u);
+    // 同じ秒のうちに変更されても、次のリクエストで気づく
+    createFile("b.txt");
+    const Result<http::Response, int> result = cache.respond(dir_, "/", http::kListingHtml);
+    ASSERT_TRUE(result.isOk());
+    EXPECT_NE(result.unwrap().getBody().unwrap().find("b.txt"), std::string::npos);
+    EXPECT_EQ(cache.getStats().hits, 0u);
+}
+
+TEST_F(DirectoryListingTest, CacheEviction) {
+    ASSERT_EQ(mkdir((dir_ + "/sub").c_str(), 0755), 0);
+    struct timeval times[2] = {};
+    times[0].tv_sec = 1000000000;
+    times[1].tv_sec = 1000000000;
+    ASSERT_EQ(utimes((dir_ + "/sub").c_str(), times), 0);
+    setMtime(1000000000);
+    http::DirectoryListingCache cache(1);
+
+    ASSERT_TRUE(cache.respond(dir_, "/", http::kListingHtml).isOk());
+    ASSERT_TRUE(cache.respond(dir_ + "/sub", "/sub/", http::kListingHtml).isOk());
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+}
+
+TEST_F(DirectoryListingTest, LargeDirectoryIsStreamed) {
+    for (std::size_t i = 0; i < http::DirectoryListingCache::kStreamThreshold + 1; ++i) {
+        createFile(utils::format("f%05zu", i));
+    }
+    setMtime(1000000000);
+    http::DirectoryListingCache cache(16);
+
+    for (int i = 0; i < 2; ++i) {
+        const Result<http::Response, int> result = cache.respond(dir_, "/", http::kListingHtml);
+        ASSERT_TRUE(result.isOk());
+        const http::Response &res = result.unwrap();
+        ASSERT_TRUE(res.getBodySource().isSome());
+        EXPECT_EQ(res.getHeaders().count("Content-Length"), 0u);
+        const std::string body = pullAll(*res.getBodySource().unwrap(), 64 * 1024);
+        EXPECT_EQ(body.find("<!DOCTYPE html>"), 0u);
+        EXPECT_NE(body.find("<li><a href=\"f01000\">f01000</a></li></ul><hr></body></html>"), std::string::npos);
+    }
+    EXPECT_EQ(cache.getStats().hits, 1u);
+}
+
+TEST_F(DirectoryListingTest, Disabled) {
+    createFile("a.txt");
+    setMtime(1000000000);
+    http::DirectoryListingCache cache(0);
+
+    EXPECT_FALSE(cache.isEnabled());
+    const Result<http::Response, int> result = cache.respond(dir_, "/", http::kListingJson);
+    ASSERT_TRUE(result.isOk());
+    EXPECT_EQ(result.unwrap().getBody().unwrap(), "[{\"name\":\"a.txt\",\"type\":\"file\"}]");
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_TRUE(cache.respond(dir_ + "/none", "/none/", http::kListingJson).isErr());
+}
@@ -0,0 +1,120 @@
+#include "http/handler/middleware/error_page.hpp"
+#include "http/response/response_builder.hpp"
+#include "transport/connection.hpp"
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    // 決まったレスポンスを返す handler
+    class StubHandler : public http::IHandler {
+    public:
+        explicit StubHandler(const http::Response &res) : res_(res) {}
+
+        Either<IAction *, http::Response> serve(const http::RequestContext &) {
+            return Right(res_);
+        }
+
+    private:
+        http::Response res_;
+    };
+}
+
+class ErrorPageTest : public testing::Test {
+protected:
+    std::string path_;
+    Connection *conn_ = nullptr;
+
+    void SetUp() override {
+        char path[] = "/tmp/error_page_test_XXXXXX";
+        const int fd = mkstemp(path);
+        ASSERT_NE(fd, -1);
+        close(fd);
+        path_ = path;
+        conn_ = new Connection(::open("/dev/null", O_RDONLY), Address("127.0.0.1", 8080), Address("127.0.0.1", 12345));
+    }
+
+    void TearDown() override {
+        delete conn_;
+        unlink(path_.c_str());
+    }
+
+    void writeFile(const std::string &content) const {
+        const int fd = ::open(path_.c_str(), O_WRONLY | O_TRUNC);
+        ASSERT_EQ(write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+        close(fd);
+    }
+
+    http::Response intercept(http::ErrorPage &errorPage, const http::Response &res) const {
+        StubHandler handler(res);
+        const http::Request req(http::kMethodGet, "/");
+        const http::RequestContext ctx(req, *conn_);
+        return errorPage.intercept(ctx, handler).unwrapRight();
+    }
+};
+
+TEST_F(ErrorPageTest, CustomPageIsPreloaded) {
+    writeFile("not found");
+    config::ServerContext::ErrorPageMap pages;
+    pages[http::kStatusNotFound] = path_;
+    http::ErrorPage errorPage(pages);
+
+    // 作成後にファイルが変わっても、読み込んだページを返す
+    writeFile("changed");
+    const http::Response res = intercept(errorPage, http::ResponseBuilder().status(http::kStatusNotFound).build());
+    EXPECT_EQ(res.getStatusCode(), http::kStatusNotFound);
+    EXPECT_EQ(res.getBody().unwrap(), "not found");
+    EXPECT_EQ(res.getHeaders().at("Content-Length"), "9");
+    EXPECT_EQ(res.getHeaders().at("Content-Type"), "text/html; charset=UTF-8");
+
+    // reload で読み直す
+    errorPage.reload();
+    EXPECT_EQ(
+        intercept(errorPage, http::ResponseBuilder().status(http::kStatusNotFound).build()).getBody().unwrap(),
+        "changed"
+    );
+
+    // 読めなくなったら、前のページを使い続ける
+    unlink(path_.c_str());
+    errorPage.reload();
+    EXPECT_EQ(
+        intercept(errorPage, http::ResponseBuilder().status(http::kStatusNotFound).build()).getBody().unwrap(),
+        "changed"
+    );
+}
+
+TEST_F(ErrorPageTest, DefaultPage) {
+    http::ErrorPage errorPage((config::ServerContext::ErrorPageMap()));
+    const http::Response res =
+        intercept(errorPage, http::ResponseBuilder().status(http::kStatusInternalServerError).build());
+    EXPECT_EQ(res.getStatusCode(), http::kStatusInternalServerError);
+    EXPECT_NE(res.getBody().unwrap().find("<h1>500 Internal Server Error</h1>"), std::string::npos);
+}
+
+TEST_F(ErrorPageTest, MissingFileFallsBackToDefault) {
+    config::ServerContext::ErrorPageMap pages;
+    pages[http::kStatusNotFound] = path_ + ".none";
+    http::ErrorPage errorPage(pages);
+    const http::Response res = intercept(errorPage, http::ResponseBuilder().status(http::kStatusNotFound).build());
+    EXPECT_NE(res.getBody().unwrap().find("<h1>404 Not Found</h1>"), std::string::npos);
+}
+
+TEST_F(ErrorPageTest, KeepsContentRange) {
+    http::ErrorPage errorPage((config::ServerContext::ErrorPageMap()));
+    const http::Response res = intercept(
+        errorPage,
+        http::ResponseBuilder()
+            .status(http::kStatusRangeNotSatisfiable)
+            .header("Content-Range", "bytes */100")
+            .build()
+    );
+    EXPECT_EQ(res.getStatusCode(), http::kStatusRangeNotSatisfiable);
+    EXPECT_EQ(res.getHeaders().at("Content-Range"), "bytes */100");
+    EXPECT_NE(res.getBody().unwrap().find("416 Range Not Satisfiable"), std::string::npos);
+}
+
+TEST_F(ErrorPageTest, NotErrorIsUnchanged) {
+    http::ErrorPage errorPage((config::ServerContext::ErrorPageMap()));
+    const http::Response ok = http::ResponseBuilder().text("hello").build();
+    EXPECT_EQ(intercept(errorPage, ok), ok);
+}
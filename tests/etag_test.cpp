@@ -0,0 +1,34 @@
+#include "http/etag.hpp"
+#include "utils/time.hpp"
+#include <gtest/gtest.h>
+
+TEST(ETag, MakeFromStat) {
+    struct stat st = {};
+    st.st_mtime = 0x5f;
+    st.st_size = 0x1a;
+    st.st_ino = 0x2b;
+    EXPECT_EQ(http::makeETag(st), "\"5f-1a-2b\"");
+}
+
+TEST(ETag, MatchesIfNoneMatch) {
+    EXPECT_TRUE(http::matchesIfNoneMatch("\"a\"", "\"a\""));
+    EXPECT_TRUE(http::matchesIfNoneMatch("\"x\", \"a\"", "\"a\""));
+    EXPECT_TRUE(http::matchesIfNoneMatch("*", "\"a\""));
+    // If-None-Match は弱い比較
+    EXPECT_TRUE(http::matchesIfNoneMatch("W/\"a\"", "\"a\""));
+    EXPECT_FALSE(http::matchesIfNoneMatch("\"b\"", "\"a\""));
+    EXPECT_FALSE(http::matchesIfNoneMatch("", "\"a\""));
+}
+
+TEST(ETag, StrongETagEquals) {
+    EXPECT_TRUE(http::strongETagEquals("\"a\"", "\"a\""));
+    EXPECT_FALSE(http::strongETagEquals("W/\"a\"", "\"a\""));
+    EXPECT_FALSE(http::strongETagEquals("\"a\"", "\"b\""));
+}
+
+TEST(HttpDate, FormatAndParse) {
+    EXPECT_EQ(utils::Time::formatHttpDate(784111777), "Sun, 06 Nov 1994 08:49:37 GMT");
+    EXPECT_EQ(utils::Time::parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT").unwrap(), 784111777);
+    EXPECT_TRUE(utils::Time::parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT").isNone());
+    EXPECT_TRUE(utils::Time::parseHttpDate("").isNone());
+}
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include "event/event_notifier.hpp"
+#include "event/io_uring_event_notifier.hpp"
+#include "utils/logger.hpp"
+#include <set>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class EventNotifierTest : public testing::TestWithParam<std::string> {
+protected:
+    std::unique_ptr<IEventNotifier> notifier_;
+    int pipeFds_[2] = {-1, -1};
+
+    void SetUp() override {
+        SET_LOG_LEVEL(Logger::kError);
+        if (GetParam() == "epoll") {
+            notifier_ = std::make_unique<EpollEventNotifier>();
+        } else if (GetParam() == "io_uring") {
+            Result<IoUringEventNotifier *, error::AppError> result = IoUringEventNotifier::create();
+            if (result.isErr()) {
+                GTEST_SKIP() << "io_uring is not available";
+            }
+            notifier_.reset(result.unwrap());
+        } else {
+            notifier_ = std::make_unique<PollEventNotifier>();
+        }
+        ASSERT_EQ(pipe(pipeFds_), 0);
+    }
+
+    void TearDown() override {
+        close(pipeFds_[0]);
+        close(pipeFds_[1]);
+    }
+
+    std::vector<Event> wait() const {
+        std::vector<Event> events;
+        EXPECT_TRUE(notifier_->waitEvents(events, 0).isOk());
+        return events;
+    }
+};
+
+TEST_P(EventNotifierTest, NoEventWhenNotReady) {
+    notifier_->registerEvent(Event(pipeFds_[0], Event::kRead));
+    EXPECT_TRUE(wait().empty());
+}
+
+TEST_P(EventNotifierTest, ReadEvent) {
+    notifier_->registerEvent(Event(pipeFds_[0], Event::kRead));
+    ASSERT_EQ(write(pipeFds_[1], "a", 1), 1);
+
+    const std::vector<Event> events = wait();
+    ASSERT_EQ(events.size(), 1);
+    EXPECT_EQ(events[0].getFd(), pipeFds_[0]);
+    EXPECT_TRUE(events[0].getTypeFlags() & Event::kRead);
+}
+
+TEST_P(EventNotifierTest, WriteEvent) {
+    notifier_->registerEvent(Event(pipeFds_[1], Event::kWrite));
+
+    const std::vector<Event> events = wait();
+    ASSERT_EQ(events.size(), 1);
+    EXPECT_EQ(events[0].getFd(), pipeFds_[1]);
+    EXPECT_EQ(events[0].getTypeFlags(), Event::kWrite);
+}
+
+// 読み込みのみ登録した場合、書き込み可能でも通知されない
+TEST_P(EventNotifierTest, OnlyRegisteredInterest) {
+    int sv[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    notifier_->registerEvent(Event(sv[0], Event::kRead));
+    EXPECT_TRUE(wait().empty());
+
+    notifier_->registerEvent(Event(sv[0], Event::kRead | Event::kWrite));
+    ASSERT_EQ(wait().size(), 1);
+
+    notifier_->unregisterEvent(Event(sv[0], Event::kWrite));
+    EXPECT_TRUE(wait().empty());
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
+// registerEvent は上書きする
+TEST_P(EventNotifierTest, RegisterOverwrites) {
+    int sv[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    notifier_->registerEvent(Event(sv[0], Event::kWrite));
+    ASSERT_EQ(wait().size(), 1);
+
+    notifier_->registerEvent(Event(sv[0], Event::kRead));
+    EXPECT_TRUE(wait().empty());
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
+TEST_P(EventNotifierTest, Unregister) {
+    notifier_->registerEvent(Event(pipeFds_[0], Event::kRead));
+    ASSERT_EQ(write(pipeFds_[1], "a", 1), 1);
+    notifier_->unregisterEvent(Event(pipeFds_[0], Event::kRead));
+    EXPECT_TRUE(wait().empty());
+}
+
+// close 済みの fd と同じ番号が再利用されても登録できる
+TEST_P(EventNotifierTest, ReuseClosedFd) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    notifier_->registerEvent(Event(fds[0], Event::kRead));
+    close(fds[0]);
+    close(fds[1]);
+
+    ASSERT_EQ(pipe(fds), 0);
+    notifier_->registerEvent(Event(fds[0], Event::kRead));
+    ASSERT_EQ(write(fds[1], "a", 1), 1);
+
+    const std::vector<Event> events = wait();
+    ASSERT_EQ(events.size(), 1);
+    EXPECT_EQ(events[0].getFd(), fds[0]);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 待機中の fd を unregister してから close し、同じ番号が再利用されても登録できる
+TEST_P(EventNotifierTest, ReuseClosedFdAfterWait) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    notifier_->registerEvent(Event(fds[0], Event::kRead));
+    EXPECT_TRUE(wait().empty());
+    notifier_->unregisterEvent(Event(fds[0], Event::kRead));
+    close(fds[0]);
+    close(fds[1]);
+
+    ASSERT_EQ(pipe(fds), 0);
+    notifier_->registerEvent(Event(fds[0], Event::kRead));
+    ASSERT_EQ(write(fds[1], "a", 1), 1);
+
+    const std::vector<Event> events = wait();
+    ASSERT_EQ(events.size(), 1);
+    EXPECT_EQ(events[0].getFd(), fds[0]);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 同じ interest で登録し直しても、届いているイベントは通知される
+TEST_P(EventNotifierTest, RegisterSameInterestAgain) {
+    notifier_->registerEvent(Event(pipeFds_[0], Event::kRead));
+    EXPECT_TRUE(wait().empty());
+    notifier_->registerEvent(Event(pipeFds_[0], Event::kRead));
+    ASSERT_EQ(write(pipeFds_[1], "a", 1), 1);
+
+    ASSERT_EQ(wait().size(), 1);
+    notifier_->registerEvent(Event(pipeFds_[0], Event::kRead));
+    ASSERT_EQ(wait().size(), 1);
+}
+
+// 途中の fd を削除しても、残りの fd のイベントは届く
+TEST_P(EventNotifierTest, RemoveMiddleSlot) {
+    int fds[3][2];
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(pipe(fds[i]), 0);
+        notifier_->registerEvent(Event(fds[i][0], Event::kRead));
+        ASSERT_EQ(write(fds[i][1], "a", 1), 1);
+    }
+    notifier_->unregisterEvent(Event(fds[1][0], Event::kRead));
+
+    const std::vector<Event> events = wait();
+    ASSERT_EQ(events.size(), 2);
+    std::set<int> readyFds;
+    for (std::size_t i = 0; i < events.size(); i++) {
+        readyFds.insert(events[i].getFd());
+    }
+    EXPECT_EQ(readyFds, std::set<int>({fds[0][0], fds[2][0]}));
+
+    for (int i = 0; i < 3; i++) {
+        close(fds[i][0]);
+        close(fds[i][1]);
+    }
+}
+
+// 結果のバッファは clear されてから使われる
+TEST_P(EventNotifierTest, EventsAreCleared) {
+    std::vector<Event> events(3, Event(42, Event::kRead));
+    ASSERT_TRUE(notifier_->waitEvents(events, 0).isOk());
+    EXPECT_TRUE(events.empty());
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, EventNotifierTest, testing::Values("poll", "epoll", "io_uring"));
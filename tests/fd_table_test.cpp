@@ -0,0 +1,32 @@
+#include <gtest/gtest.h>
+#include "core/fd_table.hpp"
+
+TEST(FdTableTest, EmptySlot) {
+    FdTable table;
+    const FdTable::Slot &slot = table.at(3);
+    EXPECT_EQ(slot.conn, nullptr);
+    EXPECT_EQ(slot.readHandler, nullptr);
+    EXPECT_EQ(slot.writeHandler, nullptr);
+    EXPECT_EQ(slot.requestTimer, TimerWheel::kInvalidTimerId);
+}
+
+TEST(FdTableTest, FindOutOfRange) {
+    FdTable table;
+    EXPECT_EQ(table.find(-1), nullptr);
+    EXPECT_EQ(table.find(static_cast<int>(table.size())), nullptr);
+    EXPECT_NE(table.find(0), nullptr);
+}
+
+// 範囲外の fd で at を呼ぶと伸びて、既存のスロットの値は保たれる
+TEST(FdTableTest, GrowKeepsSlots) {
+    FdTable table;
+    table.at(5).requestTimer = 42;
+
+    const int bigFd = static_cast<int>(table.size()) * 3 + 1;
+    table.at(bigFd).requestTimer = 7;
+    EXPECT_GT(table.size(), static_cast<std::size_t>(bigFd));
+    EXPECT_EQ(table.at(5).requestTimer, 42);
+    ASSERT_NE(table.find(bigFd), nullptr);
+    EXPECT_EQ(table.find(bigFd)->requestTimer, 7);
+    EXPECT_EQ(table.find(bigFd - 1)->requestTimer, TimerWheel::kInvalidTimerId);
+}
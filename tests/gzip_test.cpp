@@ -0,0 +1,133 @@
+#include "http/handler/middleware/gzip.hpp"
+#include "http/response/gzip.hpp"
+#include "http/response/response_builder.hpp"
+#include <gtest/gtest.h>
+#include "utils/string.hpp"
+#include <zlib.h>
+
+namespace {
+    // gzip 形式の data を展開する (途中までのデータでも、展開できた分を返す)
+    std::string gunzip(const std::string &data) {
+        z_stream stream = {};
+        inflateInit2(&stream, 15 + 16);
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        std::string out;
+        char buf[4096];
+        int ret = Z_OK;
+        do {
+            stream.next_out = reinterpret_cast<Bytef *>(buf);
+            stream.avail_out = sizeof(buf);
+            ret = inflate(&stream, Z_SYNC_FLUSH);
+            out.append(buf, sizeof(buf) - stream.avail_out);
+        } while (ret == Z_OK && stream.avail_out == 0);
+        inflateEnd(&stream);
+        return out;
+    }
+
+    std::string makeText(const std::size_t size) {
+        std::string text;
+        while (text.size() < size) {
+            text += "<li>hello, world</li>\n";
+        }
+        return text.substr(0, size);
+    }
+
+    config::GzipConfig enabled() {
+        return config::GzipConfig(true, 6, 100);
+    }
+}
+
+TEST(Gzip, Compress) {
+    const std::string text = makeText(10000);
+    http::GzipStats stats;
+    const Option<std::string> compressed = http::gzipCompress(text, 6, &stats);
+    ASSERT_TRUE(compressed.isSome());
+    EXPECT_LT(compressed.unwrap().size(), text.size());
+    EXPECT_EQ(gunzip(compressed.unwrap()), text);
+
+    EXPECT_EQ(stats.get().responses, 1u);
+    EXPECT_EQ(stats.get().bytesIn, text.size());
+    EXPECT_EQ(stats.get().bytesOut, compressed.unwrap().size());
+}
+
+// 元の body が届いた分だけ、少しずつ圧縮して返す
+TEST(Gzip, BodySource) {
+    const SharedPtr<http::RelayBodySource> relay(new http::RelayBodySource());
+    http::GzipBodySource source(relay, 6);
+    EXPECT_TRUE(source.getLength().isNone());
+
+    std::string out;
+    EXPECT_EQ(source.pull(out, 1024).unwrap(), http::IBodySource::kPullPending);
+    EXPECT_TRUE(out.empty());
+
+    const std::string first = makeText(5000);
+    relay->append(first.data(), first.size());
+    while (source.pull(out, 1024).unwrap() == http::IBodySource::kPullMore) {
+    }
+    // 続きが届く前でも、ここまでの分は展開できる
+    EXPECT_EQ(gunzip(out), first);
+
+    const std::string second = makeText(300000);
+    relay->append(second.data(), second.size());
+    relay->finish();
+    http::IBodySource::PullStatus status = http::IBodySource::kPullMore;
+    while (status != http::IBodySource::kPullEnd) {
+        const std::size_t before = out.size();
+        status = source.pull(out, 1024).unwrap();
+        ASSERT_NE(status, http::IBodySource::kPullPending);
+        EXPECT_LE(out.size() - before, 1024u);
+    }
+    EXPECT_EQ(gunzip(out), first + second);
+}
+
+TEST(GzipMiddleware, CompressBody) {
+    const http::Gzip gzip(enabled());
+    const std::string text = makeText(1000);
+    const http::Response res = gzip.filter(http::ResponseBuilder().html(text).header("ETag", "\"a\"").build());
+
+    EXPECT_EQ(res.getHeaders().at("Content-Encoding"), "gzip");
+    EXPECT_EQ(res.getHeaders().at("Vary"), "Accept-Encoding");
+    EXPECT_EQ(res.getHeaders().at("ETag"), "W/\"a\"");
+    ASSERT_TRUE(res.getBody().isSome());
+    EXPECT_EQ(res.getHeaders().at("Content-Length"), utils::toString(res.getBody().unwrap().size()));
+    EXPECT_EQ(gunzip(res.getBody().unwrap()), text);
+    EXPECT_EQ(gzip.getStats().responses, 1u);
+}
+
+TEST(GzipMiddleware, CompressStream) {
+    const http::Gzip gzip(enabled());
+    const SharedPtr<http::RelayBodySource> relay(new http::RelayBodySource());
+    const http::Response res = gzip.filter(
+        http::ResponseBuilder().header("Content-type", "text/html").header("Vary", "Cookie").stream(relay).build()
+    );
+
+    EXPECT_EQ(res.getHeaders().at("Content-Encoding"), "gzip");
+    EXPECT_EQ(res.getHeaders().at("Vary"), "Cookie, Accept-Encoding");
+    EXPECT_EQ(res.getHeaders().count("Content-Length"), 0u);
+    ASSERT_TRUE(res.getBodySource().isSome());
+    EXPECT_TRUE(res.getBodySource().unwrap()->getLength().isNone());
+}
+
+TEST(GzipMiddleware, Skip) {
+    const http::Gzip gzip(enabled());
+    const std::string text = makeText(1000);
+
+    // 短い
+    const http::Response small = http::ResponseBuilder().html(makeText(10)).build();
+    EXPECT_EQ(gzip.filter(small), small);
+    // 対象の Content-Type ではない
+    const http::Response image =
+        http::ResponseBuilder().header("Content-Type", "image/png").body(text, http::kStatusOk).build();
+    EXPECT_EQ(gzip.filter(image), image);
+    // すでに圧縮されている
+    const http::Response encoded = http::ResponseBuilder().html(text).header("Content-Encoding", "br").build();
+    EXPECT_EQ(gzip.filter(encoded), encoded);
+    // body がない
+    const http::Response notModified = http::ResponseBuilder().notModified("\"a\"", "").build();
+    EXPECT_EQ(gzip.filter(notModified), notModified);
+    // 無効
+    const http::Gzip disabled((config::GzipConfig()));
+    const http::Response html = http::ResponseBuilder().html(text).build();
+    EXPECT_EQ(disabled.filter(html), html);
+}
@@ -0,0 +1,224 @@
+#include "http/hot_content_cache.hpp"
+#include "http/response/response_builder.hpp"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+class HotContentCacheTest : public testing::Test {
+protected:
+    std::string dir_;
+
+    void SetUp() override {
+        char dir[] = "/tmp/hot_content_cache_test_XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        dir_ = dir;
+    }
+
+    void TearDown() override {
+        unlink((dir_ + "/a.html").c_str());
+        unlink((dir_ + "/b.html").c_str());
+        unlink((dir_ + "/c.html").c_str());
+        unlink((dir_ + "/sub/d.html").c_str());
+        rmdir((dir_ + "/sub").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    void writeFile(const std::string &name, const std::string &content) const {
+        const int fd = ::open((dir_ + "/" + name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_EQ(write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+        close(fd);
+    }
+
+    void store(http::HotContentCache &cache, const std::string &name) const {
+        const std::string path = dir_ + "/" + name;
+        cache.store("/" + name, path, http::ResponseBuilder().file(path).build());
+    }
+
+    // inotify のイベントは 1 ms に 1 回しか読まないので、時刻が進むのを待つ
+    static void waitForEvents() {
+        usleep(20 * 1000);
+    }
+};
+
+TEST_F(HotContentCacheTest, StoreAndLookup) {
+    writeFile("a.html", "hello");
+    http::HotContentCache cache(config::HotContentCacheConfig(1024 * 1024), dir_);
+
+    EXPECT_EQ(cache.lookup("/a.html"), nullptr);
+    store(cache, "a.html");
+    const http::HotContentCache::Content *content = cache.lookup("/a.html");
+    ASSERT_NE(content, nullptr);
+    EXPECT_EQ(content->body, "hello");
+    EXPECT_EQ(content->headerPrefix.find("HTTP/1.1 200 OK\r\n"), 0u);
+    EXPECT_NE(content->headerPrefix.find("Content-Length: 5\r\n"), std::string::npos);
+    EXPECT_NE(content->headerPrefix.find("Content-Type: text/html"), std::string::npos);
+    // Date と Connection は送るときに付ける
+    EXPECT_EQ(content->headerPrefix.find("Date:"), std::string::npos);
+    EXPECT_EQ(content->headerPrefix.find("Connection:"), std::string::npos);
+
+    EXPECT_EQ(cache.getStats().hits, 1u);
+    EXPECT_EQ(cache.getStats().misses, 1u);
+}
+
+TEST_F(HotContentCacheTest, Disabled) {
+    writeFile("a.html", "hello");
+    http::HotContentCache cache(config::HotContentCacheConfig(0), dir_);
+
+    EXPECT_FALSE(cache.isEnabled());
+    store(cache, "a.html");
+    EXPECT_EQ(cache.lookup("/a.html"), nullptr);
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST_F(HotContentCacheTest, SkipLargeFileAndNonOkResponse) {
+    writeFile("a.html", std::string(100, 'a'));
+    writeFile("b.html", "hello");
+    http::HotContentCache cache(config::HotContentCacheConfig(1024 * 1024, 10), dir_);
+
+    store(cache, "a.html");
+    EXPECT_EQ(cache.lookup("/a.html"), nullptr);
+
+    const std::string path = dir_ + "/b.html";
+    cache.store("/b.html", path, http::ResponseBuilder().file(path, http::kStatusNotFound).build());
+    EXPECT_EQ(cache.lookup("/b.html"), nullptr);
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+// 予算を超えたら、最も長く使われていないものから捨てる
+TEST_F(HotContentCacheTest, EvictLeastRecentlyUsed) {
+    writeFile("a.html", std::string(400, 'a'));
+    writeFile("b.html", std::string(400, 'b'));
+    writeFile("c.html", std::string(400, 'c'));
+    http::HotContentCache cache(config::HotContentCacheConfig(1500), dir_);
+
+    store(cache, "a.html");
+    store(cache, "b.html");
+    ASSERT_NE(cache.lookup("/a.html"), nullptr);
+    store(cache, "c.html");
+
+    EXPECT_NE(cache.lookup("/a.html"), nullptr);
+    EXPECT_EQ(cache.lookup("/b.html"), nullptr);
+    EXPECT_NE(cache.lookup("/c.html"), nullptr);
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+    EXPECT_LE(cache.bytes(), 1500u);
+}
+
+#if defined(__linux__)
+TEST_F(HotContentCacheTest, InvalidateOnModify) {
+    writeFile("a.html", "hello");
+    writeFile("b.html", "world");
+    http::HotContentCache cache(config::HotContentCacheConfig(1024 * 1024), dir_);
+    store(cache, "a.html");
+    store(cache, "b.html");
+
+    writeFile("a.html", "changed");
+    waitForEvents();
+    EXPECT_EQ(cache.lookup("/a.html"), nullptr);
+    EXPECT_NE(cache.lookup("/b.html"), nullptr);
+    EXPECT_GE(cache.getStats().invalidations, 1u);
+
+    // 入れ直せば新しい内容になる
+    store(cache, "a.html");
+    ASSERT_NE(cache.lookup("/a.html"), nullptr);
+    EXPECT_EQ(cache.lookup("/a.html")->body, "changed");
+}
+
+TEST_F(HotContentCacheTest, InvalidateOnRemoveAndRename) {
+    writeFile("a.html", "hello");
+    writeFile("b.html", "world");
+    http::HotContentCache cache(config::HotContentCacheConfig(1024 * 1024), dir_);
+    store(cache, "a.html");
+    store(cache, "b.html");
+
+    unlink((dir_ + "/a.html").c_str());
+    writeFile("c.html", "new");
+    std::rename((dir_ + "/c.html").c_str(), (dir_ + "/b.html").c_str());
+    waitForEvents();
+    EXPECT_EQ(cache.lookup("/a.html"), nullptr);
+    EXPECT_EQ(cache.lookup("/b.html"), nullptr);
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+// root の下のディレクトリにあるファイルも監視する
+TEST_F(HotContentCacheTest, InvalidateInSubdirectory) {
+    ASSERT_EQ(mkdir((dir_ + "/sub").c_str(), 0755), 0);
+    writeFile("sub/d.html", "hello");
+    http::HotContentCache cache(config::HotContentCacheConfig(1024 * 1024), dir_);
+    store(cache, "sub/d.html");
+    ASSERT_NE(cache.lookup("/sub/d.html"), nullptr);
+
+    writeFile("sub/d.html", "changed");
+    waitForEvents();
+    EXPECT_EQ(cache.lookup("/sub/d.html"), nullptr);
+}
+
+// ディレクトリごと移動されたら、その下のエントリを捨てる
+TEST_F(HotContentCacheTest, InvalidateOnDirectoryMove) {
+    ASSERT_EQ(mkdir((dir_ + "/sub").c_str(), 0755), 0);
+    writeFile("sub/d.html", "hello");
+    writeFile("subd.html", "world");
+    http::HotContentCache cache(config::HotContentCacheConfig(1024 * 1024), dir_);
+    store(cache, "sub/d.html");
+    store(cache, "subd.html");
+
+    ASSERT_EQ(std::rename((dir_ + "/sub").c_str(), (dir_ + "/moved").c_str()), 0);
+    waitForEvents();
+    EXPECT_EQ(cache.lookup("/sub/d.html"), nullptr);
+    EXPECT_NE(cache.lookup("/subd.html"), nullptr);
+
+    std::rename((dir_ + "/moved").c_str(), (dir_ + "/sub").c_str());
+    unlink((dir_ + "/subd.html").c_str());
+}
+
+// 途中のディレクトリが置き換えられたら、その下のエントリを捨てる
+TEST_F(HotContentCacheTest, InvalidateOnAncestorDirectoryReplace) {
+    ASSERT_EQ(mkdir((dir_ + "/sub").c_str(), 0755), 0);
+    ASSERT_EQ(mkdir((dir_ + "/sub/a").c_str(), 0755), 0);
+    ASSERT_EQ(mkdir((dir_ + "/sub/a/b").c_str(), 0755), 0);
+    writeFile("sub/a/b/c.html", "old");
+    http::HotContentCache cache(config::HotContentCacheConfig(1024 * 1024), dir_);
+    store(cache, "sub/a/b/c.html");
+    ASSERT_NE(cache.lookup("/sub/a/b/c.html"), nullptr);
+
+    // root の直下ではないディレクトリを移動して、同じパスに作り直す
+    ASSERT_EQ(std::rename((dir_ + "/sub/a").c_str(), (dir_ + "/sub/old").c_str()), 0);
+    ASSERT_EQ(mkdir((dir_ + "/sub/a").c_str(), 0755), 0);
+    ASSERT_EQ(mkdir((dir_ + "/sub/a/b").c_str(), 0755), 0);
+    writeFile("sub/a/b/c.html", "new");
+    waitForEvents();
+    EXPECT_EQ(cache.lookup("/sub/a/b/c.html"), nullptr);
+
+    store(cache, "sub/a/b/c.html");
+    ASSERT_NE(cache.lookup("/sub/a/b/c.html"), nullptr);
+    EXPECT_EQ(cache.lookup("/sub/a/b/c.html")->body, "new");
+
+    const char *const paths[] = {"/sub/a/b/c.html", "/sub/old/b/c.html"};
+    for (std::size_t i = 0; i < 2; ++i) {
+        unlink((dir_ + paths[i]).c_str());
+    }
+    const char *const dirs[] = {"/sub/a/b", "/sub/a", "/sub/old/b", "/sub/old"};
+    for (std::size_t i = 0; i < 4; ++i) {
+        rmdir((dir_ + dirs[i]).c_str());
+    }
+}
+
+// 同じファイルを別の target でキャッシュしていても、すべて捨てる
+TEST_F(HotContentCacheTest, InvalidateAllTargetsOfSameFile) {
+    writeFile("a.html", "hello");
+    writeFile("b.html", "world");
+    http::HotContentCache cache(config::HotContentCacheConfig(1024 * 1024), dir_);
+    const std::string path = dir_ + "/a.html";
+    cache.store("/", path, http::ResponseBuilder().file(path).build());
+    store(cache, "a.html");
+    store(cache, "b.html");
+    ASSERT_EQ(cache.size(), 3u);
+
+    writeFile("a.html", "changed");
+    waitForEvents();
+    EXPECT_EQ(cache.lookup("/"), nullptr);
+    EXPECT_EQ(cache.lookup("/a.html"), nullptr);
+    EXPECT_NE(cache.lookup("/b.html"), nullptr);
+    EXPECT_EQ(cache.size(), 1u);
+}
+#endif
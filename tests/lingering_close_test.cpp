@@ -0,0 +1,197 @@
+#include "config/config.hpp"
+#include "config/toml/parser.hpp"
+#include "core/event_loop.hpp"
+#include "core/virtual_server.hpp"
+#include "transport/listener.hpp"
+#include "utils/logger.hpp"
+#include "utils/string.hpp"
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * keep-alive しないコネクションで、レスポンスを送り終えた後にクライアントのデータが届いても
+ * RST でレスポンスの末尾が失われないこと (lingering close)
+ * EventLoop は終わらないので、子プロセスで動かして最後に kill する
+ */
+class LingeringCloseTest : public testing::Test {
+protected:
+    static const std::size_t kFileSize = 200 * 1024;
+
+    std::string dir_;
+    uint16_t port_;
+    pid_t child_;
+
+    void SetUp() override {
+        SET_LOG_LEVEL(Logger::kError);
+        char dir[] = "/tmp/lingering_close_test_XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        dir_ = dir;
+        const std::string body(kFileSize, 'a');
+        const int fd = ::open((dir_ + "/big.txt").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_EQ(write(fd, body.data(), body.size()), static_cast<ssize_t>(body.size()));
+        close(fd);
+
+        port_ = findFreePort();
+        ASSERT_NE(port_, 0);
+        child_ = -1;
+    }
+
+    void TearDown() override {
+        if (child_ > 0) {
+            kill(child_, SIGKILL);
+            waitpid(child_, NULL, 0);
+        }
+        unlink((dir_ + "/big.txt").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    static toml::Table parseToml(const std::string &text) {
+        return toml::TomlParser(toml::Tokenizer(text).tokenize().unwrap()).parse().unwrap();
+    }
+
+    static uint16_t findFreePort() {
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        uint16_t port = 0;
+        if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0 &&
+            getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) == 0) {
+            port = ntohs(addr.sin_port);
+        }
+        close(fd);
+        return port;
+    }
+
+    void startServer(const std::string &mainToml, const std::string &serverToml = "") {
+        const config::MainContext mainConfig = config::MainContext::fromToml(parseToml(mainToml));
+        const config::ServerContext serverConfig = config::ServerContext::fromToml(parseToml(utils::format(
+            "host = '127.0.0.1'\nport = %u\n%s"
+            "[[location]]\npath = '/'\nroot = '%s'\nallowed_methods = ['GET', 'POST']\n",
+            port_,
+            serverToml.c_str(),
+            dir_.c_str()
+        )));
+
+        child_ = fork();
+        ASSERT_NE(child_, -1);
+        if (child_ == 0) {
+            Listener listener("127.0.0.1", utils::toString(port_));
+            VirtualServer vs(serverConfig, listener.getBindAddress());
+            // EventLoop は VirtualServerList を参照で持つ
+            const std::vector<Listener *> listeners(1, &listener);
+            const EventLoop::VirtualServerList virtualServers(1, &vs);
+            EventLoop loop(mainConfig, listeners, virtualServers);
+            loop.run();
+            _exit(1);
+        }
+    }
+
+    int connectToServer() const {
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port_);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        // 子プロセスが listen するまで待つ
+        for (int i = 0; i < 100; ++i) {
+            if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+                return fd;
+            }
+            usleep(10 * 1000);
+        }
+        close(fd);
+        return -1;
+    }
+
+    static bool sendAll(const int fd, const std::string &data) {
+        return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+    }
+
+    // 最初の 1 byte が届いたら later を送り、EOF まで読む。ECONNRESET なら readErrno に入れる
+    static std::string readAfterSending(const int fd, const std::string &later, int &readErrno) {
+        std::string received;
+        bool sent = false;
+        readErrno = 0;
+        while (true) {
+            char buf[4096];
+            const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n == 0) {
+                return received;
+            }
+            if (n == -1) {
+                readErrno = errno;
+                return received;
+            }
+            received.append(buf, n);
+            if (!sent) {
+                sent = sendAll(fd, later);
+            }
+        }
+    }
+
+    static std::size_t contentLength(const std::string &response) {
+        const std::size_t headerEnd = response.find("\r\n\r\n");
+        return headerEnd == std::string::npos ? 0 : response.size() - headerEnd - 4;
+    }
+};
+
+const std::size_t LingeringCloseTest::kFileSize;
+
+// keepalive_requests の上限に達したコネクションに、後から次のリクエストが届く
+TEST_F(LingeringCloseTest, LatePipelinedRequestAfterKeepAliveLimit) {
+    startServer("keepalive_requests = 1\n");
+    const int fd = connectToServer();
+    ASSERT_NE(fd, -1);
+
+    ASSERT_TRUE(sendAll(fd, "GET /big.txt HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+    int readErrno = 0;
+    const std::string response =
+        readAfterSending(fd, "GET /big.txt HTTP/1.1\r\nHost: localhost\r\n\r\n", readErrno);
+    close(fd);
+
+    EXPECT_EQ(readErrno, 0);
+    EXPECT_EQ(response.find("HTTP/1.1 200 OK\r\n"), 0u);
+    EXPECT_NE(response.find("Connection: close\r\n"), std::string::npos);
+    EXPECT_EQ(contentLength(response), kFileSize);
+}
+
+// Connection: close のリクエストの後に、クライアントが続けてデータを送る
+TEST_F(LingeringCloseTest, DataAfterConnectionClose) {
+    startServer("");
+    const int fd = connectToServer();
+    ASSERT_NE(fd, -1);
+
+    ASSERT_TRUE(sendAll(fd, "GET /big.txt HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"));
+    int readErrno = 0;
+    const std::string response = readAfterSending(fd, std::string(1024, 'x'), readErrno);
+    close(fd);
+
+    EXPECT_EQ(readErrno, 0);
+    EXPECT_EQ(contentLength(response), kFileSize);
+}
+
+// body を読み切らずに 413 を返しても、クライアントが送り続けている body で RST にならない
+TEST_F(LingeringCloseTest, PayloadTooLarge) {
+    startServer("", "client_max_body_size = 1024\n");
+    const int fd = connectToServer();
+    ASSERT_NE(fd, -1);
+
+    ASSERT_TRUE(sendAll(fd, "POST /big.txt HTTP/1.1\r\nHost: localhost\r\nContent-Length: 1048576\r\n\r\n"));
+    ASSERT_TRUE(sendAll(fd, std::string(64 * 1024, 'x')));
+    int readErrno = 0;
+    const std::string response = readAfterSending(fd, std::string(64 * 1024, 'x'), readErrno);
+    close(fd);
+
+    EXPECT_EQ(readErrno, 0);
+    EXPECT_EQ(response.find("HTTP/1.1 413 Payload Too Large\r\n"), 0u);
+    EXPECT_NE(response.find("Connection: close\r\n"), std::string::npos);
+}
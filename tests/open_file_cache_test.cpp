@@ -0,0 +1,127 @@
+#include "http/open_file_cache.hpp"
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+class OpenFileCacheTest : public testing::Test {
+protected:
+    std::string dir_;
+
+    void SetUp() override {
+        char dir[] = "/tmp/open_file_cache_test_XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        dir_ = dir;
+    }
+
+    void TearDown() override {
+        unlink((dir_ + "/a.html").c_str());
+        unlink((dir_ + "/b.html").c_str());
+        unlink((dir_ + "/c.html").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    void writeFile(const std::string &name, const std::string &content) const {
+        const int fd = ::open((dir_ + "/" + name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_EQ(write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+        close(fd);
+    }
+
+    static config::OpenFileCacheConfig enabled(const std::size_t maxEntries = 10) {
+        return config::OpenFileCacheConfig(maxEntries, 60000, true);
+    }
+};
+
+TEST_F(OpenFileCacheTest, HitAfterMiss) {
+    writeFile("a.html", "hello");
+    http::OpenFileCache cache(enabled());
+
+    const http::OpenFileCache::LookupResult first = cache.open(dir_ + "/a.html");
+    ASSERT_TRUE(first.isOk());
+    EXPECT_EQ(first.unwrap().st.st_size, 5);
+    EXPECT_EQ(first.unwrap().mimeType, "text/html");
+    ASSERT_NE(first.unwrap().fd.get(), nullptr);
+
+    const http::OpenFileCache::LookupResult second = cache.open(dir_ + "/a.html");
+    ASSERT_TRUE(second.isOk());
+    // 同じ fd を使い回す
+    EXPECT_EQ(second.unwrap().fd, first.unwrap().fd);
+    EXPECT_EQ(cache.getStats().hits, 1u);
+    EXPECT_EQ(cache.getStats().misses, 1u);
+}
+
+// stat で作ったエントリは、open のときに開く
+TEST_F(OpenFileCacheTest, OpenAfterStat) {
+    writeFile("a.html", "hello");
+    http::OpenFileCache cache(enabled());
+
+    ASSERT_TRUE(cache.stat(dir_ + "/a.html").isOk());
+    EXPECT_EQ(cache.stat(dir_ + "/a.html").unwrap().fd.get(), nullptr);
+    const http::OpenFileCache::LookupResult opened = cache.open(dir_ + "/a.html");
+    ASSERT_TRUE(opened.isOk());
+    EXPECT_NE(opened.unwrap().fd.get(), nullptr);
+    EXPECT_EQ(cache.size(), 1u);
+}
+
+TEST_F(OpenFileCacheTest, NegativeLookup) {
+    http::OpenFileCache cache(enabled());
+    EXPECT_EQ(cache.stat(dir_ + "/none.html").unwrapErr(), ENOENT);
+    EXPECT_EQ(cache.stat(dir_ + "/none.html").unwrapErr(), ENOENT);
+    EXPECT_EQ(cache.getStats().hits, 1u);
+
+    // エラーをキャッシュしない設定
+    http::OpenFileCache noErrors(config::OpenFileCacheConfig(10, 60000, false));
+    EXPECT_EQ(noErrors.stat(dir_ + "/none.html").unwrapErr(), ENOENT);
+    EXPECT_EQ(noErrors.stat(dir_ + "/none.html").unwrapErr(), ENOENT);
+    EXPECT_EQ(noErrors.getStats().hits, 0u);
+    EXPECT_EQ(noErrors.size(), 0u);
+}
+
+TEST_F(OpenFileCacheTest, EvictLeastRecentlyUsed) {
+    writeFile("a.html", "a");
+    writeFile("b.html", "b");
+    writeFile("c.html", "c");
+    http::OpenFileCache cache(enabled(2));
+
+    cache.stat(dir_ + "/a.html");
+    cache.stat(dir_ + "/b.html");
+    cache.stat(dir_ + "/a.html");
+    cache.stat(dir_ + "/c.html"); // b が捨てられる
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+
+    cache.stat(dir_ + "/a.html");
+    EXPECT_EQ(cache.getStats().hits, 2u);
+    cache.stat(dir_ + "/b.html");
+    EXPECT_EQ(cache.getStats().hits, 2u);
+}
+
+// 期限が切れたら確かめ直す
+TEST_F(OpenFileCacheTest, Revalidate) {
+    writeFile("a.html", "hello");
+    http::OpenFileCache cache(config::OpenFileCacheConfig(10, 1, true));
+
+    const SharedPtr<AutoFd> fd = cache.open(dir_ + "/a.html").unwrap().fd;
+    usleep(20 * 1000);
+    // 変わっていなければ fd を使い続ける
+    EXPECT_EQ(cache.open(dir_ + "/a.html").unwrap().fd, fd);
+
+    usleep(20 * 1000);
+    writeFile("a.html", "hello, world");
+    const http::OpenFileCache::LookupResult changed = cache.open(dir_ + "/a.html");
+    EXPECT_EQ(changed.unwrap().st.st_size, 12);
+
+    usleep(20 * 1000);
+    unlink((dir_ + "/a.html").c_str());
+    EXPECT_EQ(cache.open(dir_ + "/a.html").unwrapErr(), ENOENT);
+}
+
+TEST_F(OpenFileCacheTest, Disabled) {
+    writeFile("a.html", "hello");
+    http::OpenFileCache cache((config::OpenFileCacheConfig()));
+    EXPECT_FALSE(cache.isEnabled());
+    EXPECT_TRUE(cache.open(dir_ + "/a.html").isOk());
+    EXPECT_TRUE(cache.open(dir_ + "/a.html").isOk());
+    EXPECT_EQ(cache.size(), 0u);
+    EXPECT_EQ(cache.getStats().hits, 0u);
+}
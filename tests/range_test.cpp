@@ -0,0 +1,117 @@
+#include "http/range.hpp"
+#include "http/response/body_source.hpp"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    http::ByteRange range(const std::size_t first, const std::size_t last) {
+        const http::ByteRange r = {first, last};
+        return r;
+    }
+
+    std::vector<http::ByteRange> parse(const std::string &value, const std::size_t size) {
+        const Result<std::vector<http::ByteRange>, http::HttpStatusCode> result = http::parseRange(value, size);
+        EXPECT_TRUE(result.isOk());
+        return result.isOk() ? result.unwrap() : std::vector<http::ByteRange>();
+    }
+}
+
+TEST(ParseRange, Single) {
+    EXPECT_EQ(parse("bytes=0-99", 1000), std::vector<http::ByteRange>({range(0, 99)}));
+    EXPECT_EQ(parse("bytes=500-", 1000), std::vector<http::ByteRange>({range(500, 999)}));
+    EXPECT_EQ(parse("bytes=-100", 1000), std::vector<http::ByteRange>({range(900, 999)}));
+}
+
+// 末尾を超える範囲は、ファイルの大きさに切り詰める
+TEST(ParseRange, Clamp) {
+    EXPECT_EQ(parse("bytes=900-2000", 1000), std::vector<http::ByteRange>({range(900, 999)}));
+    EXPECT_EQ(parse("bytes=-2000", 1000), std::vector<http::ByteRange>({range(0, 999)}));
+    EXPECT_EQ(parse("bytes=0-99999999999999999999999", 1000), std::vector<http::ByteRange>({range(0, 999)}));
+}
+
+TEST(ParseRange, Multiple) {
+    EXPECT_EQ(
+        parse("bytes=0-9, 20-29,,-5", 100), std::vector<http::ByteRange>({range(0, 9), range(20, 29), range(95, 99)})
+    );
+    // 満たせないものは除く
+    EXPECT_EQ(parse("bytes=0-9, 200-299", 100), std::vector<http::ByteRange>({range(0, 9)}));
+}
+
+TEST(ParseRange, NotSatisfiable) {
+    EXPECT_EQ(http::parseRange("bytes=1000-", 1000).unwrapErr(), http::kStatusRangeNotSatisfiable);
+    EXPECT_EQ(http::parseRange("bytes=-0", 1000).unwrapErr(), http::kStatusRangeNotSatisfiable);
+    EXPECT_EQ(http::parseRange("bytes=0-", 0).unwrapErr(), http::kStatusRangeNotSatisfiable);
+}
+
+// 解釈できない Range は無視する
+TEST(ParseRange, Ignore) {
+    EXPECT_TRUE(parse("bytes=", 1000).empty());
+    EXPECT_TRUE(parse("items=0-9", 1000).empty());
+    EXPECT_TRUE(parse("bytes=9-0", 1000).empty());
+    EXPECT_TRUE(parse("bytes=a-9", 1000).empty());
+    EXPECT_TRUE(parse("bytes=0-9,x", 1000).empty());
+    // 重なった範囲で全体より多く送らせない
+    EXPECT_TRUE(parse("bytes=0-,0-", 1000).empty());
+    EXPECT_TRUE(parse("bytes=0-0,1-1,2-2,3-3,4-4,5-5,6-6,7-7,8-8,9-9,10-10,11-11,12-12,13-13,14-14,15-15,16-16", 1000)
+                    .empty());
+}
+
+TEST(ParseRange, CaseInsensitiveUnit) {
+    EXPECT_EQ(parse("Bytes=0-0", 10), std::vector<http::ByteRange>({range(0, 0)}));
+}
+
+class MultipartRangesBodySourceTest : public testing::Test {
+protected:
+    std::string path_;
+
+    void SetUp() override {
+        char path[] = "/tmp/range_test_XXXXXX";
+        const int fd = mkstemp(path);
+        ASSERT_NE(fd, -1);
+        ASSERT_EQ(write(fd, "0123456789", 10), 10);
+        close(fd);
+        path_ = path;
+    }
+
+    void TearDown() override {
+        unlink(path_.c_str());
+    }
+
+    SharedPtr<AutoFd> openFile() const {
+        return SharedPtr<AutoFd>(new AutoFd(open(path_.c_str(), O_RDONLY)));
+    }
+};
+
+TEST_F(MultipartRangesBodySourceTest, Pull) {
+    http::MultipartRangesBodySource source(openFile(), {range(0, 1), range(7, 9)}, 10, "text/plain", "BOUNDARY");
+    const std::string expected = "\r\n--BOUNDARY\r\n"
+                                 "Content-Type: text/plain\r\n"
+                                 "Content-Range: bytes 0-1/10\r\n"
+                                 "\r\n"
+                                 "01"
+                                 "\r\n--BOUNDARY\r\n"
+                                 "Content-Type: text/plain\r\n"
+                                 "Content-Range: bytes 7-9/10\r\n"
+                                 "\r\n"
+                                 "789"
+                                 "\r\n--BOUNDARY--\r\n";
+    EXPECT_EQ(source.getLength().unwrap(), expected.size());
+
+    // 小さく区切って取り出しても同じになる
+    std::string body;
+    http::IBodySource::PullStatus status = http::IBodySource::kPullMore;
+    while (status != http::IBodySource::kPullEnd) {
+        status = source.pull(body, 7).unwrap();
+    }
+    EXPECT_EQ(body, expected);
+}
+
+// 途中でファイルが切り詰められたらエラー
+TEST_F(MultipartRangesBodySourceTest, TruncatedFile) {
+    http::MultipartRangesBodySource source(openFile(), {range(0, 1), range(7, 9)}, 10, "text/plain", "BOUNDARY");
+    ASSERT_EQ(truncate(path_.c_str(), 5), 0);
+    std::string body;
+    EXPECT_TRUE(source.pull(body, 1024).isErr());
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include "./utils/reader.hpp"
 #include "utils/io/read_buffer.hpp"
+#include "utils/string.hpp"
 
 void loadAll(ReadBuffer &buffer) {
     while (true) {
@@ -125,3 +126,111 @@ TEST(ByteBufferTest, PartialConsumeOfDelimiterSequence) {
     // バッファが空になっていることを確認
     EXPECT_EQ(buffer.size(), 0);
 }
+
+// 複数回の load で読んだデータが、読んだ順に並ぶ
+TEST(ByteBufferTest, LoadAppendsInOrder) {
+    std::string testData;
+    for (int i = 0; i < 2000; i++) {
+        testData += static_cast<char>('a' + i % 26);
+        testData += "|";
+    }
+    StringReader reader(testData);
+    ReadBuffer buffer(reader);
+
+    loadAll(buffer);
+    EXPECT_EQ(buffer.size(), testData.size());
+    EXPECT_EQ(buffer.consume(testData.size()), testData);
+}
+
+// delimiter が何回かに分けて届いても見つかる
+TEST(ByteBufferTest, ConsumeUntilDelimiterSplitAcrossLoads) {
+    const std::string testData = "GET / HTTP/1.1\r\nHost: a\r\n\r\n";
+    StringReader stringReader(testData);
+    WouldBlockReader2 reader(stringReader);
+    ReadBuffer buffer(reader);
+
+    std::vector<std::string> lines;
+    while (lines.size() < 3) {
+        const Option<std::string> line = buffer.consumeUntil("\r\n");
+        if (line.isSome()) {
+            lines.push_back(line.unwrap());
+            continue;
+        }
+        const ReadBuffer::LoadResult loaded = buffer.load();
+        if (loaded.isOk() && loaded.unwrap() == 0) {
+            break;
+        }
+    }
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[0], "GET / HTTP/1.1\r\n");
+    EXPECT_EQ(lines[1], "Host: a\r\n");
+    EXPECT_EQ(lines[2], "\r\n");
+    EXPECT_EQ(buffer.size(), 0u);
+}
+
+// 1 バイトずつ届く場合も、"\r" と "\n" の間で区切られた delimiter を見つける
+TEST(ByteBufferTest, ConsumeUntilDelimiterByteByByte) {
+    class ByteReader : public io::IReader {
+    public:
+        explicit ByteReader(const std::string &data) : data_(data), pos_(0) {}
+        ReadResult read(char *buf, std::size_t) override {
+            if (pos_ == data_.size()) {
+                return Ok(0ul);
+            }
+            buf[0] = data_[pos_++];
+            return Ok(1ul);
+        }
+        bool eof() override {
+            return pos_ == data_.size();
+        }
+
+    private:
+        std::string data_;
+        std::size_t pos_;
+    };
+
+    ByteReader reader("abc\r\ndef\r\n");
+    ReadBuffer buffer(reader);
+    std::vector<std::string> lines;
+    while (buffer.load().unwrap() > 0) {
+        const Option<std::string> line = buffer.consumeUntil("\r\n");
+        if (line.isSome()) {
+            lines.push_back(line.unwrap());
+        }
+    }
+    ASSERT_EQ(lines.size(), 2u);
+    EXPECT_EQ(lines[0], "abc\r\n");
+    EXPECT_EQ(lines[1], "def\r\n");
+}
+
+// 消費と load を繰り返しても、データの順序が保たれる (前に詰める場合と広げる場合)
+TEST(ByteBufferTest, InterleavedConsumeAndLoad) {
+    std::string testData;
+    for (int i = 0; i < 20000; i++) {
+        testData += utils::format("line %d\r\n", i);
+    }
+    StringReader reader(testData);
+    ReadBuffer buffer(reader);
+
+    std::string consumed;
+    while (buffer.load().unwrap() > 0) {
+        // 一部だけ消費して、未消費のデータを残す
+        const Option<std::string> line = buffer.consumeUntil("\r\n");
+        if (line.isSome()) {
+            consumed += line.unwrap();
+        }
+        EXPECT_EQ(std::string(buffer.data(), buffer.size()), testData.substr(consumed.size(), buffer.size()));
+    }
+    consumed += buffer.consume(buffer.size());
+    EXPECT_EQ(consumed, testData);
+}
+
+TEST(ByteBufferTest, DataView) {
+    const std::string testData = "Hello, World!";
+    StringReader reader(testData);
+    ReadBuffer buffer(reader);
+
+    loadAll(buffer);
+    buffer.consume(7);
+    EXPECT_EQ(std::string(buffer.data(), buffer.size()), "World!");
+}
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+#include "core/handler/read_request_handler.hpp"
+
+using namespace http;
+
+namespace {
+    Request makeRequest(const std::string &httpVersion, const Option<std::string> &connection) {
+        Headers headers;
+        if (connection.isSome()) {
+            headers["Connection"] = connection.unwrap();
+        }
+        return Request(kMethodGet, "/", httpVersion, headers);
+    }
+}
+
+TEST(IsKeepAliveRequested, Http11DefaultsToKeepAlive) {
+    EXPECT_TRUE(ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.1", None)));
+    EXPECT_TRUE(ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.1", Some(std::string("keep-alive")))));
+    EXPECT_FALSE(ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.1", Some(std::string("close")))));
+}
+
+TEST(IsKeepAliveRequested, Http10RequiresKeepAlive) {
+    EXPECT_FALSE(ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.0", None)));
+    EXPECT_TRUE(ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.0", Some(std::string("keep-alive")))));
+    EXPECT_FALSE(ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.0", Some(std::string("close")))));
+}
+
+// Connection はカンマ区切りのトークンのリストで、大文字小文字は区別しない
+TEST(IsKeepAliveRequested, ConnectionTokenList) {
+    EXPECT_FALSE(
+        ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.1", Some(std::string("Upgrade, Close"))))
+    );
+    EXPECT_TRUE(
+        ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.0", Some(std::string("TE ,  Keep-Alive "))))
+    );
+    // close があれば keep-alive より優先する
+    EXPECT_FALSE(
+        ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.0", Some(std::string("keep-alive, close"))))
+    );
+    // トークンの一部に含まれているだけなら無視する
+    EXPECT_TRUE(ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.1", Some(std::string("closed")))));
+    EXPECT_FALSE(ReadRequestHandler::isKeepAliveRequested(makeRequest("HTTP/1.0", Some(std::string("keep-alive2")))));
+}
@@ -139,6 +139,46 @@ TEST_F(RequestReaderTest, PostWouldBlock) {
     EXPECT_EQ(result.unwrap().unwrap(), expected);
 }
 
+// パイプライニングで 1 回の read に複数のリクエストが含まれる
+TEST_F(RequestReaderTest, Pipelined) {
+    const std::string request = "GET /a HTTP/1.1\r\n"
+                                "Host: example.com\r\n\r\n"
+                                "POST /b HTTP/1.1\r\n"
+                                "Content-Length: 5\r\n"
+                                "Host: example.com\r\n"
+                                "\r\n"
+                                "hello"
+                                "GET /c HTTP/1.1\r\n";
+    StringReader reader(request);
+    ReadBuffer readBuf(reader);
+
+    const auto first = reqReader_->readRequest(readBuf);
+    ASSERT_TRUE(first.isOk());
+    ASSERT_TRUE(first.unwrap().isSome());
+    EXPECT_EQ(first.unwrap().unwrap().getRequestTarget(), "/a");
+
+    // 残りのリクエストは read せずにバッファからパースできる
+    const auto second = reqReader_->readBufferedRequest(readBuf);
+    ASSERT_TRUE(second.isOk());
+    ASSERT_TRUE(second.unwrap().isSome());
+    const Request expected = Request(
+        kMethodPost,
+        "/b",
+        "HTTP/1.1",
+        {
+            std::make_pair("Content-Length", "5"),
+            std::make_pair("Host", "example.com"),
+        },
+        "hello"
+    );
+    EXPECT_EQ(second.unwrap().unwrap(), expected);
+
+    // 途中までしか届いていない
+    const auto third = reqReader_->readBufferedRequest(readBuf);
+    ASSERT_TRUE(third.isOk());
+    EXPECT_TRUE(third.unwrap().isNone());
+}
+
 class ChunkedEncodingTest : public testing::Test {
 public:
     ChunkedEncodingTest() {
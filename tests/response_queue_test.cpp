@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+#include "transport/response_queue.hpp"
+#include "http/response/body_source.hpp"
+#include "utils/fd.hpp"
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class ResponseQueueTest : public testing::Test {
+protected:
+    int fds_[2];
+
+    void SetUp() override {
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+        utils::setNonBlocking(fds_[0]);
+    }
+
+    void TearDown() override {
+        close(fds_[0]);
+        close(fds_[1]);
+    }
+
+    // 相手側に届いたデータをすべて読む
+    std::string readAll() const {
+        std::string result;
+        char buf[4096];
+        while (true) {
+            const ssize_t n = recv(fds_[1], buf, sizeof(buf), MSG_DONTWAIT);
+            if (n <= 0) {
+                break;
+            }
+            result.append(buf, n);
+        }
+        return result;
+    }
+};
+
+TEST_F(ResponseQueueTest, FlushInOrder) {
+    ResponseQueue queue;
+    queue.push("first\n");
+    queue.push("second\n");
+    queue.push("third\n");
+    EXPECT_EQ(queue.size(), 3);
+
+    const ResponseQueue::FlushResult result = queue.flush(fds_[0]);
+    ASSERT_TRUE(result.isOk());
+    EXPECT_TRUE(result.unwrap());
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(readAll(), "first\nsecond\nthird\n");
+}
+
+TEST_F(ResponseQueueTest, EmptyMessageIsIgnored) {
+    ResponseQueue queue;
+    queue.push("");
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(queue.flush(fds_[0]).unwrap());
+}
+
+// ヘッダーと body は別々に積んでも、1 つのレスポンスとして数える
+TEST_F(ResponseQueueTest, HeaderAndBody) {
+    ResponseQueue queue;
+    queue.push("HTTP/1.1 200 OK\r\n\r\n", "body");
+    queue.push("HTTP/1.1 204 No Content\r\n\r\n");
+    EXPECT_EQ(queue.size(), 2);
+    EXPECT_EQ(queue.bytes(), 19 + 4 + 27);
+
+    ASSERT_TRUE(queue.flush(fds_[0]).unwrap());
+    EXPECT_EQ(queue.size(), 0);
+    EXPECT_EQ(queue.bytes(), 0);
+    EXPECT_EQ(readAll(), "HTTP/1.1 200 OK\r\n\r\nbodyHTTP/1.1 204 No Content\r\n\r\n");
+}
+
+TEST_F(ResponseQueueTest, Watermark) {
+    ResponseQueue queue;
+    EXPECT_FALSE(queue.isAboveHighWatermark());
+    EXPECT_TRUE(queue.isBelowLowWatermark());
+
+    queue.push("header", std::string(ResponseQueue::kHighWatermark, 'x'));
+    EXPECT_TRUE(queue.isAboveHighWatermark());
+    EXPECT_FALSE(queue.isBelowLowWatermark());
+
+    // 書き込みが進むと、low watermark を下回る
+    bool belowLow = false;
+    for (int i = 0; i < 10000 && !belowLow; i++) {
+        queue.flush(fds_[0]);
+        readAll();
+        belowLow = queue.isBelowLowWatermark();
+    }
+    EXPECT_TRUE(belowLow);
+}
+
+// 1 回の writev の iovec の上限より多く溜まっていても、すべて書き込む
+TEST_F(ResponseQueueTest, ManyMessages) {
+    ResponseQueue queue;
+    std::string expected;
+    for (int i = 0; i < 200; i++) {
+        const std::string message = "message " + std::to_string(i) + "\n";
+        queue.push(message);
+        expected += message;
+    }
+
+    ASSERT_TRUE(queue.flush(fds_[0]).unwrap());
+    EXPECT_EQ(readAll(), expected);
+}
+
+// 送信バッファがいっぱいになったら、途中から書き込みを再開できる
+TEST_F(ResponseQueueTest, ResumePartialWrite) {
+    ResponseQueue queue;
+    const std::string large(1024 * 1024, 'x');
+    queue.push("header", large);
+    queue.push("tail");
+
+    std::string received;
+    bool flushed = false;
+    for (int i = 0; i < 10000 && !flushed; i++) {
+        const ResponseQueue::FlushResult result = queue.flush(fds_[0]);
+        flushed = result.isOk() && result.unwrap();
+        received += readAll();
+    }
+    ASSERT_TRUE(flushed);
+    received += readAll();
+    EXPECT_EQ(received, "header" + large + "tail");
+}
+
+class ResponseQueueFileTest : public ResponseQueueTest {
+protected:
+    std::string path_;
+
+    void SetUp() override {
+        ResponseQueueTest::SetUp();
+        char path[] = "/tmp/response_queue_test_XXXXXX";
+        const int fd = mkstemp(path);
+        ASSERT_NE(fd, -1);
+        close(fd);
+        path_ = path;
+    }
+
+    void TearDown() override {
+        unlink(path_.c_str());
+        ResponseQueueTest::TearDown();
+    }
+
+    void writeFile(const std::string &content) const {
+        const int fd = open(path_.c_str(), O_WRONLY | O_TRUNC);
+        ASSERT_EQ(write(fd, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+        close(fd);
+    }
+
+    SharedPtr<AutoFd> openFile() const {
+        return SharedPtr<AutoFd>(new AutoFd(open(path_.c_str(), O_RDONLY)));
+    }
+};
+
+// ファイルの一部を body として送る
+TEST_F(ResponseQueueFileTest, FileRegion) {
+    writeFile("0123456789");
+    ResponseQueue queue;
+    queue.push("first\n");
+    queue.pushFile("header\n", openFile(), 2, 5);
+    queue.push("last\n");
+    EXPECT_EQ(queue.size(), 3);
+    EXPECT_EQ(queue.bytes(), 6 + 7 + 5 + 5);
+
+    ASSERT_TRUE(queue.flush(fds_[0]).unwrap());
+    EXPECT_EQ(queue.size(), 0);
+    EXPECT_EQ(queue.bytes(), 0);
+    EXPECT_EQ(readAll(), "first\nheader\n23456last\n");
+}
+
+// 送信バッファより大きいファイルも、途中から再開して送る
+TEST_F(ResponseQueueFileTest, ResumePartialWrite) {
+    std::string content;
+    for (int i = 0; i < 3 * 1024 * 1024; i++) {
+        content += static_cast<char>('a' + i % 26);
+    }
+    writeFile(content);
+    ResponseQueue queue;
+    queue.pushFile("header", openFile(), 0, content.size());
+    queue.push("tail");
+
+    std::string received;
+    bool flushed = false;
+    for (int i = 0; i < 100000 && !flushed; i++) {
+        const ResponseQueue::FlushResult result = queue.flush(fds_[0]);
+        ASSERT_TRUE(result.isOk());
+        flushed = result.unwrap();
+        received += readAll();
+    }
+    ASSERT_TRUE(flushed);
+    received += readAll();
+    EXPECT_EQ(received, "header" + content + "tail");
+}
+
+// 送る前にファイルが切り詰められたら、エラーにする
+TEST_F(ResponseQueueFileTest, TruncatedFile) {
+    writeFile("0123456789");
+    ResponseQueue queue;
+    queue.pushFile("header", openFile(), 0, 10);
+    writeFile("");
+
+    EXPECT_TRUE(queue.flush(fds_[0]).isErr());
+}
+
+namespace {
+    // 呼ばれるたびに 1 つずつ返す body
+    class CountingSource : public http::IBodySource {
+    public:
+        explicit CountingSource(const int count) : count_(count), current_(0) {}
+
+        Option<std::size_t> getLength() const {
+            return None;
+        }
+
+        PullResult pull(std::string &buf, std::size_t) {
+            buf += std::to_string(current_++);
+            return Ok(current_ < count_ ? kPullMore : kPullEnd);
+        }
+
+    private:
+        int count_;
+        int current_;
+    };
+}
+
+// 長さが分からない body は chunk に区切って送る
+TEST_F(ResponseQueueTest, ChunkedStream) {
+    ResponseQueue queue;
+    queue.pushStream("header\n", SharedPtr<http::IBodySource>(new CountingSource(3)), true);
+    queue.push("tail");
+    EXPECT_EQ(queue.size(), 2);
+    EXPECT_TRUE(queue.isStreaming());
+
+    ASSERT_TRUE(queue.flush(fds_[0]).unwrap());
+    EXPECT_EQ(queue.size(), 0);
+    EXPECT_FALSE(queue.isStreaming());
+    EXPECT_EQ(readAll(), "header\n1\r\n0\r\n1\r\n1\r\n1\r\n2\r\n0\r\n\r\ntail");
+}
+
+// 生産者を待っている間は書き込みを止め、データが追加されたら続きから送る
+TEST_F(ResponseQueueTest, RelayStream) {
+    const SharedPtr<http::RelayBodySource> relay(new http::RelayBodySource(Some<std::size_t>(10)));
+    ResponseQueue queue;
+    queue.pushStream("header\n", relay, false);
+
+    relay->append("01234", 5);
+    EXPECT_FALSE(queue.flush(fds_[0]).unwrap());
+    EXPECT_TRUE(queue.isWaitingForBody());
+    EXPECT_EQ(readAll(), "header\n01234");
+
+    // 長さを超えた分は捨てる
+    relay->append("56789abc", 8);
+    relay->finish();
+    EXPECT_TRUE(queue.flush(fds_[0]).unwrap());
+    EXPECT_FALSE(queue.isWaitingForBody());
+    EXPECT_EQ(queue.size(), 0);
+    EXPECT_EQ(readAll(), "56789");
+}
+
+// 生産者が途中で終了したら、エラーにする
+TEST_F(ResponseQueueTest, AbortedStream) {
+    const SharedPtr<http::RelayBodySource> relay(new http::RelayBodySource());
+    ResponseQueue queue;
+    queue.pushStream("header\n", relay, true);
+
+    relay->append("data", 4);
+    relay->abort();
+    EXPECT_TRUE(queue.flush(fds_[0]).isErr());
+}
+
+// バッファに空きができたら、止めていた生産者を返す
+TEST_F(ResponseQueueTest, ResumableProducer) {
+    const SharedPtr<http::RelayBodySource> relay(new http::RelayBodySource());
+    ResponseQueue queue;
+    queue.pushStream("header\n", relay, true);
+
+    const std::string data(http::RelayBodySource::kHighWatermark, 'x');
+    relay->append(data.data(), data.size());
+    ASSERT_TRUE(relay->isFull());
+    relay->pauseProducer(42);
+
+    Option<int> producer = None;
+    for (int i = 0; i < 10000 && producer.isNone(); i++) {
+        queue.flush(fds_[0]);
+        readAll();
+        producer = queue.takeResumableProducer();
+    }
+    EXPECT_EQ(producer, Some(42));
+    EXPECT_EQ(queue.takeResumableProducer(), None);
+}
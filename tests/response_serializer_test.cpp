@@ -0,0 +1,62 @@
+#include "http/response/response.hpp"
+#include "http/response/response_serializer.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+    http::Headers makeHeaders() {
+        return http::Headers({
+            std::make_pair("Connection", "keep-alive"),
+            std::make_pair("Content-Length", "5"),
+            std::make_pair("Content-Type", "text/plain"),
+        });
+    }
+}
+
+TEST(ResponseSerializer, StatusLine) {
+    EXPECT_EQ(http::ResponseSerializer::getStatusLine(http::kStatusOk), "HTTP/1.1 200 OK\r\n");
+    EXPECT_EQ(http::ResponseSerializer::getStatusLine(http::kStatusNotFound), "HTTP/1.1 404 Not Found\r\n");
+    EXPECT_EQ(
+        http::ResponseSerializer::getStatusLine(http::kStatusGatewayTimeout), "HTTP/1.1 504 Gateway Timeout\r\n"
+    );
+    EXPECT_EQ(http::ResponseSerializer::getStatusLine(static_cast<http::HttpStatusCode>(299)), "");
+}
+
+TEST(ResponseSerializer, Date) {
+    const std::string &date = http::ResponseSerializer::getDate();
+    // "Sun, 06 Nov 1994 08:49:37 GMT"
+    ASSERT_EQ(date.size(), 29u);
+    EXPECT_EQ(date.substr(3, 2), ", ");
+    EXPECT_EQ(date.substr(25), " GMT");
+}
+
+// Date 以外は Response::toHeaderString と同じになる
+TEST(ResponseSerializer, SameAsToHeaderString) {
+    http::Headers headers = makeHeaders();
+    headers["Date"] = "Sun, 06 Nov 1994 08:49:37 GMT";
+    const http::Response response(http::kStatusOk, headers);
+    EXPECT_EQ(http::ResponseSerializer::serializeHeader(http::kStatusOk, headers), response.toHeaderString());
+}
+
+TEST(ResponseSerializer, AddDate) {
+    const std::string header = http::ResponseSerializer::serializeHeader(http::kStatusNotFound, makeHeaders());
+    const std::string expected = "HTTP/1.1 404 Not Found\r\n"
+                                 "Date: "
+        + http::ResponseSerializer::getDate()
+        + "\r\n"
+          "Connection: keep-alive\r\n"
+          "Content-Length: 5\r\n"
+          "Content-Type: text/plain\r\n"
+          "\r\n";
+    EXPECT_EQ(header, expected);
+}
+
+TEST(ResponseSerializer, OtherHttpVersion) {
+    http::Headers headers;
+    headers["Date"] = "Sun, 06 Nov 1994 08:49:37 GMT";
+    EXPECT_EQ(
+        http::ResponseSerializer::serializeHeader(http::kStatusOk, headers, "HTTP/1.0"),
+        "HTTP/1.0 200 OK\r\n"
+        "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+        "\r\n"
+    );
+}
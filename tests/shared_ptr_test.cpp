@@ -0,0 +1,57 @@
+#include "utils/shared_ptr.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+    // 破棄された回数を数える
+    class Counted {
+    public:
+        explicit Counted(int &destroyed) : destroyed_(destroyed) {}
+        ~Counted() {
+            ++destroyed_;
+        }
+
+    private:
+        int &destroyed_;
+    };
+}
+
+TEST(SharedPtrTest, Null) {
+    const SharedPtr<int> ptr;
+    EXPECT_EQ(ptr.get(), nullptr);
+    EXPECT_EQ(ptr.useCount(), 0);
+}
+
+TEST(SharedPtrTest, DeleteWhenLastCopyDestroyed) {
+    int destroyed = 0;
+    {
+        const SharedPtr<Counted> ptr(new Counted(destroyed));
+        EXPECT_EQ(ptr.useCount(), 1);
+        {
+            const SharedPtr<Counted> copy(ptr); // NOLINT(*-unnecessary-copy-initialization)
+            EXPECT_EQ(ptr.useCount(), 2);
+            EXPECT_EQ(copy, ptr);
+        }
+        // コピーが破棄されても、まだ参照されている
+        EXPECT_EQ(destroyed, 0);
+        EXPECT_EQ(ptr.useCount(), 1);
+    }
+    EXPECT_EQ(destroyed, 1);
+}
+
+TEST(SharedPtrTest, Assign) {
+    int destroyedA = 0;
+    int destroyedB = 0;
+    SharedPtr<Counted> a(new Counted(destroyedA));
+    SharedPtr<Counted> b(new Counted(destroyedB));
+
+    // 代入すると、元々参照していたものは解放される
+    a = b;
+    EXPECT_EQ(destroyedA, 1);
+    EXPECT_EQ(destroyedB, 0);
+    EXPECT_EQ(b.useCount(), 2);
+
+    // 自己代入しても解放されない
+    a = a;
+    EXPECT_EQ(destroyedB, 0);
+    EXPECT_EQ(a.useCount(), 2);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "core/timer_wheel.hpp"
+
+class TimerWheelTest : public testing::Test {
+protected:
+    static const utils::Time::Millis kStart = 1000000;
+    TimerWheel wheel_{kStart};
+
+    // now まで進めて、期限切れになった key を返す
+    std::vector<int> advance(const utils::Time::Millis now) {
+        std::vector<TimerWheel::Expired> expired;
+        wheel_.advance(now, expired);
+        std::vector<int> keys;
+        for (std::size_t i = 0; i < expired.size(); i++) {
+            keys.push_back(expired[i].key);
+        }
+        return keys;
+    }
+
+    // 期限切れになるまで nextDeadline の時刻で advance を繰り返し、期限切れになった時刻を返す
+    utils::Time::Millis runUntilExpired() {
+        while (wheel_.nextDeadline().isSome()) {
+            const utils::Time::Millis next = wheel_.nextDeadline().unwrap();
+            if (!advance(next).empty()) {
+                return next;
+            }
+        }
+        return 0;
+    }
+};
+
+TEST_F(TimerWheelTest, ExpireAtDeadline) {
+    wheel_.schedule(kStart + 10, 0, 1);
+    EXPECT_TRUE(advance(kStart + 9).empty());
+    EXPECT_EQ(advance(kStart + 10), std::vector<int>({1}));
+    EXPECT_EQ(wheel_.size(), 0);
+    EXPECT_TRUE(wheel_.nextDeadline().isNone());
+}
+
+TEST_F(TimerWheelTest, PastDeadlineExpiresOnNextTick) {
+    wheel_.schedule(kStart - 100, 0, 1);
+    EXPECT_EQ(advance(kStart + 1), std::vector<int>({1}));
+}
+
+TEST_F(TimerWheelTest, KindAndKey) {
+    wheel_.schedule(kStart + 1, 7, 42);
+    std::vector<TimerWheel::Expired> expired;
+    wheel_.advance(kStart + 1, expired);
+    ASSERT_EQ(expired.size(), 1);
+    EXPECT_EQ(expired[0].kind, 7);
+    EXPECT_EQ(expired[0].key, 42);
+}
+
+TEST_F(TimerWheelTest, Cancel) {
+    const TimerWheel::TimerId id = wheel_.schedule(kStart + 10, 0, 1);
+    wheel_.schedule(kStart + 10, 0, 2);
+    wheel_.cancel(id);
+    EXPECT_EQ(wheel_.size(), 1);
+    EXPECT_EQ(advance(kStart + 10), std::vector<int>({2}));
+}
+
+// 期限切れ・cancel 済みの id を cancel しても、再利用されたノードには影響しない
+TEST_F(TimerWheelTest, CancelStaleId) {
+    const TimerWheel::TimerId id = wheel_.schedule(kStart + 1, 0, 1);
+    advance(kStart + 1);
+    wheel_.schedule(kStart + 10, 0, 2);
+    wheel_.cancel(id);
+    wheel_.cancel(TimerWheel::kInvalidTimerId);
+    EXPECT_EQ(wheel_.size(), 1);
+    EXPECT_EQ(advance(kStart + 10), std::vector<int>({2}));
+}
+
+// 上位の階層に入ったタイマーも、正確な時刻に期限切れになる
+TEST_F(TimerWheelTest, ExactAcrossLevels) {
+    const utils::Time::Millis delays[] = {1, 63, 64, 65, 4095, 4096, 5000, 262143, 262144, 300000};
+    for (std::size_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        TimerWheel wheel(kStart + 17);
+        wheel.schedule(kStart + 17 + delays[i], 0, 1);
+
+        std::vector<TimerWheel::Expired> expired;
+        wheel.advance(kStart + 17 + delays[i] - 1, expired);
+        EXPECT_TRUE(expired.empty()) << "delay: " << delays[i];
+        wheel.advance(kStart + 17 + delays[i], expired);
+        EXPECT_EQ(expired.size(), 1) << "delay: " << delays[i];
+    }
+}
+
+// nextDeadline の時刻だけ起きても、期限ちょうどに期限切れになる
+TEST_F(TimerWheelTest, NextDeadlineReachesDeadline) {
+    wheel_.schedule(kStart + 5000, 0, 1);
+    EXPECT_EQ(runUntilExpired(), kStart + 5000);
+
+    wheel_.schedule(kStart + 5000 + 123456, 0, 2);
+    EXPECT_EQ(runUntilExpired(), kStart + 5000 + 123456);
+}
+
+TEST_F(TimerWheelTest, NextDeadlineIsNearest) {
+    wheel_.schedule(kStart + 30, 0, 1);
+    wheel_.schedule(kStart + 20, 0, 2);
+    ASSERT_TRUE(wheel_.nextDeadline().isSome());
+    EXPECT_EQ(wheel_.nextDeadline().unwrap(), kStart + 20);
+}
+
+// ホイールに収まらない遠い期限
+TEST_F(TimerWheelTest, VeryFarDeadline) {
+    const utils::Time::Millis deadline = kStart + 24ULL * 60 * 60 * 1000;
+    wheel_.schedule(deadline, 0, 1);
+    EXPECT_EQ(runUntilExpired(), deadline);
+}
+
+TEST_F(TimerWheelTest, ManyTimers) {
+    for (int i = 0; i < 1000; i++) {
+        wheel_.schedule(kStart + 1 + (i * 37) % 10000, 0, i);
+    }
+    std::size_t count = 0;
+    for (utils::Time::Millis now = kStart; now <= kStart + 10000; now += 100) {
+        count += advance(now).size();
+    }
+    EXPECT_EQ(count, 1000);
+    EXPECT_EQ(wheel_.size(), 0);
+}